@@ -7,84 +7,112 @@
 
 #include <sys/types.h>
 #include <stdio.h>
-#include <rand.h>
 #include <err.h>
 #include <stdlib.h>
 #include <string.h>
-#include <app/tests.h>
-#include <kernel/thread.h>
-#include <kernel/mutex.h>
-#include <kernel/semaphore.h>
-#include <kernel/event.h>
-#include <platform.h>
+#include <arch/ops.h>
+#include <lib/benchmark.h>
 
-const size_t BUFSIZE = (1024*1024);
-const uint ITER = 1024;
+#define BUFSIZE (1024*1024)
 
-__NO_INLINE static void bench_set_overhead(void)
+/* most of these work on a BUFSIZE buffer */
+static status_t bench_buf_alloc(uintptr_t arg, void **context)
 {
-    uint32_t *buf = malloc(BUFSIZE);
+    *context = calloc(1, BUFSIZE);
+    return *context ? NO_ERROR : ERR_NO_MEMORY;
+}
+
+static void bench_buf_free(void *context)
+{
+    free(context);
+}
 
-    uint count = arch_cycle_count();
-    for (uint i = 0; i < ITER; i++) {
+__NO_INLINE static void bench_loop_overhead(void *context, uintptr_t arg, uint iterations)
+{
+    for (uint i = 0; i < iterations; i++) {
         __asm__ volatile("");
     }
-    count = arch_cycle_count() - count;
+}
 
-    printf("took %u cycles overhead to loop %u times\n",
-           count, ITER);
+BENCHMARK(loop_overhead,
+          .name = "loop_overhead",
+          .run = bench_loop_overhead);
 
-    free(buf);
+__NO_INLINE static void bench_memset(void *context, uintptr_t size, uint iterations)
+{
+    for (uint i = 0; i < iterations; i++) {
+        memset(context, 0, size);
+    }
 }
 
-__NO_INLINE static void bench_memset(void)
+__NO_INLINE static void bench_memcpy(void *context, uintptr_t size, uint iterations)
 {
-    void *buf = malloc(BUFSIZE);
-
-    uint count = arch_cycle_count();
-    for (uint i = 0; i < ITER; i++) {
-        memset(buf, 0, BUFSIZE);
+    uint8_t *buf = context;
+    for (uint i = 0; i < iterations; i++) {
+        memcpy(buf, buf + BUFSIZE / 2, size);
     }
-    count = arch_cycle_count() - count;
-
-    uint64_t bytes_cycle = (BUFSIZE * ITER * 1000ULL) / count;
-    printf("took %u cycles to memset a buffer of size %u %d times (%u bytes), %llu.%03llu bytes/cycle\n",
-           count, BUFSIZE, ITER, BUFSIZE * ITER, bytes_cycle / 1000, bytes_cycle % 1000);
-
-    free(buf);
 }
 
+#define BENCH_MEMSET(size) \
+    BENCHMARK(memset_##size, \
+              .name = "memset." #size, \
+              .setup = bench_buf_alloc, .run = bench_memset, .teardown = bench_buf_free, \
+              .arg = size, .bytes = size)
+
+/* copies from the top half of the buffer to the bottom half */
+#define BENCH_MEMCPY(size) \
+    BENCHMARK(memcpy_##size, \
+              .name = "memcpy." #size, \
+              .setup = bench_buf_alloc, .run = bench_memcpy, .teardown = bench_buf_free, \
+              .arg = size, .bytes = size)
+
+BENCH_MEMSET(16);
+BENCH_MEMSET(64);
+BENCH_MEMSET(256);
+BENCH_MEMSET(1024);
+BENCH_MEMSET(4096);
+BENCH_MEMSET(16384);
+BENCH_MEMSET(65536);
+BENCH_MEMSET(262144);
+BENCH_MEMSET(1048576);
+
+BENCH_MEMCPY(16);
+BENCH_MEMCPY(64);
+BENCH_MEMCPY(256);
+BENCH_MEMCPY(1024);
+BENCH_MEMCPY(4096);
+BENCH_MEMCPY(16384);
+BENCH_MEMCPY(65536);
+BENCH_MEMCPY(262144);
+BENCH_MEMCPY(524288);
+
 #define bench_cset(type) \
-__NO_INLINE static void bench_cset_##type(void) \
+__NO_INLINE static void bench_cset_##type(void *context, uintptr_t arg, uint iterations) \
 { \
-    type *buf = malloc(BUFSIZE); \
+    type *buf = context; \
  \
-    uint count = arch_cycle_count(); \
-    for (uint i = 0; i < ITER; i++) { \
+    for (uint i = 0; i < iterations; i++) { \
         for (uint j = 0; j < BUFSIZE / sizeof(*buf); j++) { \
             buf[j] = 0; \
         } \
     } \
-    count = arch_cycle_count() - count; \
- \
-    uint64_t bytes_cycle = (BUFSIZE * ITER * 1000ULL) / count; \
-    printf("took %u cycles to manually clear a buffer using wordsize %d of size %u %d times (%u bytes), %llu.%03llu bytes/cycle\n", \
-           count, sizeof(*buf), BUFSIZE, ITER, BUFSIZE * ITER, bytes_cycle / 1000, bytes_cycle % 1000); \
+} \
  \
-    free(buf); \
-}
+BENCHMARK(cset_##type, \
+          .name = "cset." #type, \
+          .setup = bench_buf_alloc, .run = bench_cset_##type, .teardown = bench_buf_free, \
+          .bytes = BUFSIZE)
 
-bench_cset(uint8_t)
-bench_cset(uint16_t)
-bench_cset(uint32_t)
-bench_cset(uint64_t)
+bench_cset(uint8_t);
+bench_cset(uint16_t);
+bench_cset(uint32_t);
+bench_cset(uint64_t);
 
-__NO_INLINE static void bench_cset_wide(void)
+__NO_INLINE static void bench_cset_wide(void *context, uintptr_t arg, uint iterations)
 {
-    uint32_t *buf = malloc(BUFSIZE);
+    uint32_t *buf = context;
 
-    uint count = arch_cycle_count();
-    for (uint i = 0; i < ITER; i++) {
+    for (uint i = 0; i < iterations; i++) {
         for (uint j = 0; j < BUFSIZE / sizeof(*buf) / 8; j++) {
             buf[j*8] = 0;
             buf[j*8+1] = 0;
@@ -96,39 +124,19 @@ __NO_INLINE static void bench_cset_wide(void)
             buf[j*8+7] = 0;
         }
     }
-    count = arch_cycle_count() - count;
-
-    uint64_t bytes_cycle = (BUFSIZE * ITER * 1000ULL) / count;
-    printf("took %u cycles to manually clear a buffer of size %u %d times 8 words at a time (%u bytes), %llu.%03llu bytes/cycle\n",
-           count, BUFSIZE, ITER, BUFSIZE * ITER, bytes_cycle / 1000, bytes_cycle % 1000);
-
-    free(buf);
 }
 
-__NO_INLINE static void bench_memcpy(void)
-{
-    uint8_t *buf = calloc(1, BUFSIZE);
-
-    uint count = arch_cycle_count();
-    for (uint i = 0; i < ITER; i++) {
-        memcpy(buf, buf + BUFSIZE / 2, BUFSIZE / 2);
-    }
-    count = arch_cycle_count() - count;
-
-    uint64_t bytes_cycle = (BUFSIZE / 2 * ITER * 1000ULL) / count;
-    printf("took %u cycles to memcpy a buffer of size %u %d times (%u source bytes), %llu.%03llu source bytes/cycle\n",
-           count, BUFSIZE / 2, ITER, BUFSIZE / 2 * ITER, bytes_cycle / 1000, bytes_cycle % 1000);
-
-    free(buf);
-}
+BENCHMARK(cset_wide,
+          .name = "cset.wide",
+          .setup = bench_buf_alloc, .run = bench_cset_wide, .teardown = bench_buf_free,
+          .bytes = BUFSIZE);
 
 #if ARCH_ARM
-__NO_INLINE static void arm_bench_cset_stm(void)
+__NO_INLINE static void arm_bench_cset_stm(void *context, uintptr_t arg, uint iterations)
 {
-    uint32_t *buf = malloc(BUFSIZE);
+    uint32_t *buf = context;
 
-    uint count = arch_cycle_count();
-    for (uint i = 0; i < ITER; i++) {
+    for (uint i = 0; i < iterations; i++) {
         for (uint j = 0; j < BUFSIZE / sizeof(*buf) / 8; j++) {
             __asm__ volatile(
                 "stm    %0, {r0-r7};"
@@ -136,23 +144,19 @@ __NO_INLINE static void arm_bench_cset_stm(void)
             );
         }
     }
-    count = arch_cycle_count() - count;
-
-    uint64_t bytes_cycle = (BUFSIZE * ITER * 1000ULL) / count;
-    printf("took %u cycles to manually clear a buffer of size %u %d times 8 words at a time using stm (%u bytes), %llu.%03llu bytes/cycle\n",
-           count, BUFSIZE, ITER, BUFSIZE * ITER, bytes_cycle / 1000, bytes_cycle % 1000);
-
-    free(buf);
 }
 
+BENCHMARK(arm_cset_stm,
+          .name = "cset.stm",
+          .setup = bench_buf_alloc, .run = arm_bench_cset_stm, .teardown = bench_buf_free,
+          .bytes = BUFSIZE);
+
 #if       (__CORTEX_M >= 0x03)
-__NO_INLINE static void arm_bench_multi_issue(void)
+/* each iteration issues 8 integer ops */
+__NO_INLINE static void arm_bench_multi_issue(void *context, uintptr_t arg, uint iterations)
 {
-    uint32_t cycles;
     uint32_t a = 0, b = 0, c = 0, d = 0, e = 0, f = 0, g = 0, h = 0;
-#define ITER 1000000
-    uint count = ITER;
-    cycles = arch_cycle_count();
+    uint count = iterations;
     while (count--) {
         __asm__ volatile ("");
         __asm__ volatile ("add %0, %0, %0" : "=r" (a) : "r" (a));
@@ -164,77 +168,36 @@ __NO_INLINE static void arm_bench_multi_issue(void)
         __asm__ volatile ("and %0, %0, %0" : "=r" (g) : "r" (g));
         __asm__ volatile ("mov %0, %0" : "=r" (h) : "r" (h));
     }
-    cycles = arch_cycle_count() - cycles;
-
-    uint64_t bytes_cycle = (cycles * 1000ULL) / ITER;
-    printf("took %u cycles to issue 8 integer ops (%llu.%03llu cycles/iteration)\n", cycles, bytes_cycle / 1000, bytes_cycle % 1000);
-#undef ITER
 }
+
+BENCHMARK(arm_multi_issue,
+          .name = "arm.multi_issue",
+          .run = arm_bench_multi_issue);
 #endif // __CORTEX_M
 #endif // ARCH_ARM
 
 #if WITH_LIB_LIBM && !WITH_NO_FP
 #include <math.h>
 
-__NO_INLINE static void bench_sincos(void)
-{
-    printf("touching the floating point unit\n");
-    __UNUSED volatile double _hole = sin(0);
-
-    uint count = arch_cycle_count();
-    __UNUSED double a = sin(2.0);
-    count = arch_cycle_count() - count;
-    printf("took %u cycles for sin()\n", count);
-
-    count = arch_cycle_count();
-    a = cos(2.0);
-    count = arch_cycle_count() - count;
-    printf("took %u cycles for cos()\n", count);
-
-    count = arch_cycle_count();
-    a = sinf(2.0);
-    count = arch_cycle_count() - count;
-    printf("took %u cycles for sinf()\n", count);
-
-    count = arch_cycle_count();
-    a = cosf(2.0);
-    count = arch_cycle_count() - count;
-    printf("took %u cycles for cosf()\n", count);
-
-    count = arch_cycle_count();
-    a = sqrt(1234567.0);
-    count = arch_cycle_count() - count;
-    printf("took %u cycles for sqrt()\n", count);
-
-    count = arch_cycle_count();
-    a = sqrtf(1234567.0f);
-    count = arch_cycle_count() - count;
-    printf("took %u cycles for sqrtf()\n", count);
-}
-
-#endif // WITH_LIB_LIBM
-
-void benchmarks(void)
-{
-    bench_set_overhead();
-    bench_memset();
-    bench_memcpy();
-
-    bench_cset_uint8_t();
-    bench_cset_uint16_t();
-    bench_cset_uint32_t();
-    bench_cset_uint64_t();
-    bench_cset_wide();
-
-#if ARCH_ARM
-    arm_bench_cset_stm();
+#define bench_libm(func, type, input) \
+__NO_INLINE static void bench_##func(void *context, uintptr_t arg, uint iterations) \
+{ \
+    volatile type in = input; \
+    __UNUSED volatile type out; \
+    for (uint i = 0; i < iterations; i++) { \
+        out = func(in); \
+    } \
+} \
+ \
+BENCHMARK(libm_##func, \
+          .name = "libm." #func, \
+          .run = bench_##func)
 
-#if       (__CORTEX_M >= 0x03)
-    arm_bench_multi_issue();
-#endif
-#endif
-#if WITH_LIB_LIBM && !WITH_NO_FP
-    bench_sincos();
-#endif
-}
+bench_libm(sin, double, 2.0);
+bench_libm(cos, double, 2.0);
+bench_libm(sinf, float, 2.0f);
+bench_libm(cosf, float, 2.0f);
+bench_libm(sqrt, double, 1234567.0);
+bench_libm(sqrtf, float, 1234567.0f);
 
+#endif // WITH_LIB_LIBM
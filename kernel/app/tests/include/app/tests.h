@@ -18,7 +18,6 @@ int sleep_tests(void);
 int port_tests(void);
 void printf_tests(void);
 void clock_tests(void);
-void benchmarks(void);
 int fibo(int argc, const cmd_args *argv);
 int spinner(int argc, const cmd_args *argv);
 int ref_counted_tests(int argc, const cmd_args *argv);
@@ -0,0 +1,391 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <arch/ops.h>
+#include <err.h>
+#include <kernel/event.h>
+#include <kernel/mp.h>
+#include <kernel/thread.h>
+#include <kernel/timer.h>
+#include <kernel/vm.h>
+#include <lib/benchmark.h>
+#include <list.h>
+#include <platform.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Benchmarks of the scheduler, cross-cpu calls, the timer queue and the pmm.
+ * The "bench" console command in lib/benchmark runs them. */
+
+/* returns an online cpu other than |cpu|, or -1 */
+static int bench_other_cpu(uint cpu)
+{
+    mp_cpu_mask_t online = mp_get_online_mask() & ~(1u << cpu);
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        if (online & (1u << i))
+            return i;
+    }
+    return -1;
+}
+
+static thread_t *bench_thread(const char *name, thread_start_routine entry, void *arg, int cpu)
+{
+    thread_t *t = thread_create(name, entry, arg, HIGH_PRIORITY, DEFAULT_STACK_SIZE);
+    if (t) {
+        thread_set_pinned_cpu(t, cpu);
+        thread_resume(t);
+    }
+    return t;
+}
+
+/* Context switches: two threads on one cpu hand an event back and forth.
+ * Each iteration is a round trip, so two switches. */
+
+typedef struct {
+    event_t go;
+    event_t ping;
+    event_t pong;
+    event_t done;
+    uint count;
+    bool stop;
+    thread_t *threads[2];
+} bench_switch_t;
+
+static int bench_switch_ping(void *arg)
+{
+    bench_switch_t *s = arg;
+    for (;;) {
+        event_wait(&s->go);
+        if (s->stop)
+            break;
+        for (uint i = 0; i < s->count; i++) {
+            event_signal(&s->ping, true);
+            event_wait(&s->pong);
+        }
+        event_signal(&s->done, true);
+    }
+    return 0;
+}
+
+static int bench_switch_pong(void *arg)
+{
+    bench_switch_t *s = arg;
+    for (;;) {
+        event_wait(&s->ping);
+        if (s->stop)
+            break;
+        event_signal(&s->pong, true);
+    }
+    return 0;
+}
+
+static void bench_switch_teardown(void *context)
+{
+    bench_switch_t *s = context;
+    s->stop = true;
+    event_signal(&s->go, true);
+    event_signal(&s->ping, true);
+    for (uint i = 0; i < countof(s->threads); i++) {
+        if (s->threads[i])
+            thread_join(s->threads[i], NULL, INFINITE_TIME);
+    }
+    event_destroy(&s->go);
+    event_destroy(&s->ping);
+    event_destroy(&s->pong);
+    event_destroy(&s->done);
+    free(s);
+}
+
+static status_t bench_switch_setup(uintptr_t arg, void **context)
+{
+    bench_switch_t *s = calloc(1, sizeof(*s));
+    if (!s)
+        return ERR_NO_MEMORY;
+    event_init(&s->go, false, EVENT_FLAG_AUTOUNSIGNAL);
+    event_init(&s->ping, false, EVENT_FLAG_AUTOUNSIGNAL);
+    event_init(&s->pong, false, EVENT_FLAG_AUTOUNSIGNAL);
+    event_init(&s->done, false, EVENT_FLAG_AUTOUNSIGNAL);
+    *context = s;
+
+    /* off our own cpu where there's a choice, so we don't get in the way */
+    int cpu = bench_other_cpu(arch_curr_cpu_num());
+    if (cpu < 0)
+        cpu = arch_curr_cpu_num();
+    s->threads[0] = bench_thread("bench ping", bench_switch_ping, s, cpu);
+    s->threads[1] = bench_thread("bench pong", bench_switch_pong, s, cpu);
+    if (!s->threads[0] || !s->threads[1]) {
+        bench_switch_teardown(s);
+        return ERR_NO_MEMORY;
+    }
+    return NO_ERROR;
+}
+
+static void bench_switch(void *context, uintptr_t arg, uint iterations)
+{
+    bench_switch_t *s = context;
+    s->count = iterations;
+    event_signal(&s->go, true);
+    event_wait(&s->done);
+}
+
+BENCHMARK(sched_switch,
+          .name = "sched.switch_pingpong",
+          .setup = bench_switch_setup, .run = bench_switch,
+          .teardown = bench_switch_teardown);
+
+/* Wake-up latency: the time from event_signal() in one thread until the
+ * thread it wakes is running, with the two threads on the same cpu
+ * (arg 0) or on different cpus (arg 1).  A wakeup takes well under the
+ * microsecond resolution of current_time_hires(), so where there is a
+ * counter that all cpus agree on, the way ktrace timestamps events, each
+ * wakeup is timed with that. */
+
+#if __x86_64__
+uint64_t get_tsc_ticks_per_ms(void);
+#define bench_timestamp() rdtsc()
+#define bench_ticks_per_ms() get_tsc_ticks_per_ms()
+#else
+#define bench_timestamp() ((uint64_t)current_time_hires())
+#define bench_ticks_per_ms() (1000ull)
+#endif
+
+typedef struct {
+    event_t go;
+    event_t wake;
+    event_t ack;
+    event_t done;
+    uint count;
+    bool stop;
+    volatile uint64_t signaled;
+    uint64_t total;
+    thread_t *threads[2];
+} bench_wakeup_t;
+
+static int bench_wakeup_signaler(void *arg)
+{
+    bench_wakeup_t *w = arg;
+    for (;;) {
+        event_wait(&w->go);
+        if (w->stop)
+            break;
+        w->total = 0;
+        for (uint i = 0; i < w->count; i++) {
+            w->signaled = bench_timestamp();
+            event_signal(&w->wake, true);
+            event_wait(&w->ack);
+        }
+        event_signal(&w->done, true);
+    }
+    return 0;
+}
+
+static int bench_wakeup_waiter(void *arg)
+{
+    bench_wakeup_t *w = arg;
+    for (;;) {
+        event_wait(&w->wake);
+        if (w->stop)
+            break;
+        w->total += bench_timestamp() - w->signaled;
+        event_signal(&w->ack, true);
+    }
+    return 0;
+}
+
+static void bench_wakeup_teardown(void *context)
+{
+    bench_wakeup_t *w = context;
+    w->stop = true;
+    event_signal(&w->go, true);
+    event_signal(&w->wake, true);
+    for (uint i = 0; i < countof(w->threads); i++) {
+        if (w->threads[i])
+            thread_join(w->threads[i], NULL, INFINITE_TIME);
+    }
+    event_destroy(&w->go);
+    event_destroy(&w->wake);
+    event_destroy(&w->ack);
+    event_destroy(&w->done);
+    free(w);
+}
+
+static status_t bench_wakeup_setup(uintptr_t remote, void **context)
+{
+    uint cpu = arch_curr_cpu_num();
+    int other = bench_other_cpu(cpu);
+    if ((remote && other < 0) || bench_ticks_per_ms() == 0)
+        return ERR_NOT_SUPPORTED;
+
+    bench_wakeup_t *w = calloc(1, sizeof(*w));
+    if (!w)
+        return ERR_NO_MEMORY;
+    event_init(&w->go, false, EVENT_FLAG_AUTOUNSIGNAL);
+    event_init(&w->wake, false, EVENT_FLAG_AUTOUNSIGNAL);
+    event_init(&w->ack, false, EVENT_FLAG_AUTOUNSIGNAL);
+    event_init(&w->done, false, EVENT_FLAG_AUTOUNSIGNAL);
+    *context = w;
+
+    w->threads[0] = bench_thread("bench signaler", bench_wakeup_signaler, w, cpu);
+    w->threads[1] = bench_thread("bench waiter", bench_wakeup_waiter, w,
+                                 remote ? other : (int)cpu);
+    if (!w->threads[0] || !w->threads[1]) {
+        bench_wakeup_teardown(w);
+        return ERR_NO_MEMORY;
+    }
+    return NO_ERROR;
+}
+
+static uint64_t bench_wakeup(void *context, uintptr_t remote, uint iterations)
+{
+    bench_wakeup_t *w = context;
+    w->count = iterations;
+    event_signal(&w->go, true);
+    event_wait(&w->done);
+    return w->total * 1000000 / bench_ticks_per_ms();
+}
+
+BENCHMARK(sched_wakeup_local,
+          .name = "sched.wakeup_local",
+          .setup = bench_wakeup_setup, .run_timed = bench_wakeup,
+          .teardown = bench_wakeup_teardown,
+          .arg = 0);
+
+BENCHMARK(sched_wakeup_remote,
+          .name = "sched.wakeup_remote",
+          .setup = bench_wakeup_setup, .run_timed = bench_wakeup,
+          .teardown = bench_wakeup_teardown,
+          .arg = 1);
+
+/* mp_sync_exec() of an empty task, on one other cpu (arg 0) or on every
+ * other cpu (arg 1). */
+
+static void bench_sync_task(void *context)
+{
+}
+
+static status_t bench_sync_setup(uintptr_t all, void **context)
+{
+    return (bench_other_cpu(arch_curr_cpu_num()) < 0) ? ERR_NOT_SUPPORTED : NO_ERROR;
+}
+
+static void bench_sync_exec(void *context, uintptr_t all, uint iterations)
+{
+    for (uint i = 0; i < iterations; i++) {
+        /* the target must stay remote, so stay on this cpu */
+        arch_disable_ints();
+        mp_cpu_mask_t target = MP_CPU_ALL_BUT_LOCAL;
+        if (!all) {
+            int cpu = bench_other_cpu(arch_curr_cpu_num());
+            target = (cpu < 0) ? 0 : (1u << cpu);
+        }
+        mp_sync_exec(target, bench_sync_task, NULL);
+        arch_enable_ints();
+    }
+}
+
+BENCHMARK(mp_sync_exec_one,
+          .name = "mp.sync_exec_one",
+          .setup = bench_sync_setup, .run = bench_sync_exec,
+          .arg = 0);
+
+BENCHMARK(mp_sync_exec_all,
+          .name = "mp.sync_exec_all",
+          .setup = bench_sync_setup, .run = bench_sync_exec,
+          .arg = 1);
+
+/* Arming and cancelling a timer, with |arg| other timers already queued.
+ * None of them are due during the run. */
+
+#define BENCH_TIMER_DELAY 3600000 /* an hour */
+
+typedef struct {
+    uint count;
+    timer_t timers[];
+} bench_timers_t;
+
+static enum handler_return bench_timer_callback(timer_t *t, lk_time_t now, void *arg)
+{
+    return INT_NO_RESCHEDULE;
+}
+
+static void bench_timer_teardown(void *context)
+{
+    bench_timers_t *t = context;
+    for (uint i = 0; i < t->count + 1; i++)
+        timer_cancel(&t->timers[i]);
+    free(t);
+}
+
+static status_t bench_timer_setup(uintptr_t queued, void **context)
+{
+    bench_timers_t *t = malloc(sizeof(*t) + (queued + 1) * sizeof(timer_t));
+    if (!t)
+        return ERR_NO_MEMORY;
+    t->count = queued;
+    for (uint i = 0; i < queued + 1; i++)
+        timer_initialize(&t->timers[i]);
+    /* spread the queued timers either side of the one we time */
+    for (uint i = 0; i < queued; i++) {
+        timer_set_oneshot(&t->timers[i + 1], BENCH_TIMER_DELAY + i * 2 - queued,
+                          bench_timer_callback, NULL);
+    }
+    *context = t;
+    return NO_ERROR;
+}
+
+static void bench_timer(void *context, uintptr_t queued, uint iterations)
+{
+    bench_timers_t *t = context;
+    for (uint i = 0; i < iterations; i++) {
+        timer_set_oneshot(&t->timers[0], BENCH_TIMER_DELAY, bench_timer_callback, NULL);
+        timer_cancel(&t->timers[0]);
+    }
+}
+
+#define BENCH_TIMER(queued) \
+    BENCHMARK(timer_##queued, \
+              .name = "timer.set_cancel." #queued, \
+              .setup = bench_timer_setup, .run = bench_timer, \
+              .teardown = bench_timer_teardown, \
+              .arg = queued)
+
+BENCH_TIMER(0);
+BENCH_TIMER(16);
+BENCH_TIMER(256);
+
+/* Allocating and freeing |arg| pages at a time. */
+
+static void bench_pmm_page(void *context, uintptr_t arg, uint iterations)
+{
+    for (uint i = 0; i < iterations; i++) {
+        vm_page_t *page = pmm_alloc_page(0, NULL);
+        if (page)
+            pmm_free_page(page);
+    }
+}
+
+BENCHMARK(pmm_page,
+          .name = "pmm.alloc_free_page",
+          .run = bench_pmm_page,
+          .bytes = PAGE_SIZE);
+
+static void bench_pmm_pages(void *context, uintptr_t count, uint iterations)
+{
+    for (uint i = 0; i < iterations; i++) {
+        struct list_node list = LIST_INITIAL_VALUE(list);
+        pmm_alloc_pages(count, 0, &list);
+        pmm_free(&list);
+    }
+}
+
+#define BENCH_PMM_PAGES(count) \
+    BENCHMARK(pmm_pages_##count, \
+              .name = "pmm.alloc_free_pages." #count, \
+              .run = bench_pmm_pages, \
+              .arg = count, .bytes = count * PAGE_SIZE)
+
+BENCH_PMM_PAGES(16);
+BENCH_PMM_PAGES(256);
@@ -14,6 +14,7 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/cache_tests.c \
     $(LOCAL_DIR)/clock_tests.c \
     $(LOCAL_DIR)/fibo.c \
+    $(LOCAL_DIR)/kernel_benchmarks.c \
     $(LOCAL_DIR)/float.c \
     $(LOCAL_DIR)/float_instructions.S \
     $(LOCAL_DIR)/mem_tests.c \
@@ -26,6 +27,7 @@ MODULE_SRCS += \
 
 
 MODULE_DEPS += \
+    lib/benchmark \
     lib/safeint \
     lib/unittest \
     lib/mxtl \
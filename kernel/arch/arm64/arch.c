@@ -31,6 +31,21 @@ uint arm_num_cpus = 1;
 static thread_t _init_thread[SMP_MAX_CPUS - 1];
 #endif
 
+uint32_t arm64_zva_size;
+
+static void arm64_zva_init(void)
+{
+    uint64_t dczid = ARM64_READ_SYSREG(dczid_el0);
+
+    /* DZP set means dc zva is prohibited, BS is log2 of the block size in
+     * words; memset only uses blocks from 16 to 256 bytes */
+    if (dczid & (1u << 4))
+        return;
+    uint32_t size = 4u << (dczid & 0xf);
+    if (size >= 16 && size <= 256)
+        arm64_zva_size = size;
+}
+
 static void arm64_cpu_early_init(void)
 {
     uint64_t mmfr0 = ARM64_READ_SYSREG(ID_AA64MMFR0_EL1);
@@ -57,6 +72,7 @@ static void arm64_cpu_early_init(void)
 void arch_early_init(void)
 {
     arm64_cpu_early_init();
+    arm64_zva_init();
     platform_init_mmu_mappings();
 }
 
@@ -236,6 +236,13 @@ void arm64_irq(struct arm64_iframe_long *iframe, uint exception_flags)
 
     arm64_in_int_handler[curr_cpu] = false;
 
+    /* take a profile sample if the profiler's timer asked for one.  irq entry
+     * doesn't save x29, but doesn't touch it either, so the interrupted frame
+     * pointer is the one saved in our own frame record. */
+    uint64_t interrupted_fp = *(uint64_t *)__builtin_frame_address(0);
+    ktrace_profile_irq(iframe->elr, interrupted_fp,
+                       exception_flags & ARM64_EXCEPTION_FLAG_LOWER_EL);
+
     /* if we came from user space, check to see if we have any signals to handle */
     if (unlikely(exception_flags & ARM64_EXCEPTION_FLAG_LOWER_EL)) {
         /* in the case of receiving a kill signal, this function may not return,
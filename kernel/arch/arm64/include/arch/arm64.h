@@ -74,6 +74,10 @@ void arm64_fpu_context_switch(struct thread *oldthread, struct thread *newthread
 /* overridable syscall handler */
 void arm64_syscall(struct arm64_iframe_long *iframe, bool is_64bit, uint32_t syscall_imm, uint64_t pc);
 
+/* bytes zeroed by a dc zva, read by memset; zero if dc zva is prohibited or
+ * its block size is outside what memset handles */
+extern uint32_t arm64_zva_size;
+
 __END_CDECLS
 
 #endif // __ASSEMBLY__
@@ -377,6 +377,13 @@ void x86_exception_handler(x86_iframe_t *frame)
     /* at this point we're able to be rescheduled, so we're 'outside' of the int handler */
     arch_set_in_int_handler(false);
 
+    /* take a profile sample if the profiler's timer asked for one */
+#if ARCH_X86_64
+    ktrace_profile_irq(frame->ip, frame->rbp, from_user);
+#else
+    ktrace_profile_irq(frame->ip, frame->ebp, from_user);
+#endif
+
     /* if we came from user space, check to see if we have any signals to handle */
     if (unlikely(from_user)) {
         /* in the case of receiving a kill signal, this function may not return,
@@ -13,6 +13,7 @@
 #include <trace.h>
 
 #include <arch/ops.h>
+#include <arch/x86/string_ops.h>
 
 #define LOCAL_TRACE 0
 
@@ -23,6 +24,8 @@ uint32_t max_ext_cpuid = 0;
 
 enum x86_vendor_list x86_vendor;
 
+uint32_t x86_string_ops;
+
 static struct x86_model_info model_info;
 
 static int initialized = 0;
@@ -93,6 +96,10 @@ void x86_feature_init(void)
     if (model_info.family == 0xf || model_info.family == 0x6) {
         model_info.display_model += BITS_SHIFT(leaf->a, 19, 16) << 4;
     }
+
+    /* pick the string routine variants, once, on the boot cpu */
+    if (x86_feature_test(X86_FEATURE_ERMS))
+        x86_string_ops |= X86_STRING_OPS_ERMS;
 }
 
 bool x86_get_cpuid_subleaf(
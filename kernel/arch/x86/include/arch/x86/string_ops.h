@@ -0,0 +1,31 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+/* bits of x86_string_ops, which selects the memcpy and memset variants in
+ * lib/libc/string/arch/x86-64 */
+#define X86_STRING_OPS_ERMS     (1 << 0)    /* rep movsb/stosb are fast */
+
+/* operations of at least this many bytes use non-temporal stores, so page
+ * sized and larger copies and fills don't push everything else out of the
+ * cache */
+#define X86_STRING_NT_THRESHOLD 4096
+
+#ifndef __ASSEMBLER__
+
+#include <stdint.h>
+#include <magenta/compiler.h>
+
+__BEGIN_CDECLS
+
+/* Zero until x86_feature_init runs on the boot cpu, which leaves the string
+ * routines on rep movsq/stosq, present on every x86-64 cpu. */
+extern uint32_t x86_string_ops;
+
+__END_CDECLS
+
+#endif // __ASSEMBLER__
@@ -5,6 +5,14 @@
 // https://opensource.org/licenses/MIT
 
 #pragma once
+
+/* flags passed to the usercopy routines below */
+#define X86_USERCOPY_FLAG_SMAP  (1 << 0)    /* toggle SMAP around the copy */
+#define X86_USERCOPY_FLAG_ERMS  (1 << 1)    /* rep movsb is fast for large copies */
+
+#ifndef __ASSEMBLER__
+
+#include <arch/user_copy.h>
 #include <magenta/compiler.h>
 
 __BEGIN_CDECLS
@@ -18,14 +26,24 @@ status_t _x86_copy_from_user(
         void *dst,
         const void *src,
         size_t len,
-        bool smap_avail,
+        uint32_t flags,
         void **fault_return);
 
 status_t _x86_copy_to_user(
         void *dst,
         const void *src,
         size_t len,
-        bool smap_avail,
+        uint32_t flags,
+        void **fault_return);
+
+/* Copies every range in |vec| with a single SMAP window and fault handler.
+ * The caller must have already validated the user side of every range. */
+status_t _x86_copy_vec(
+        const user_copy_vec_t *vec,
+        size_t count,
+        uint32_t flags,
         void **fault_return);
 
 __END_CDECLS
+
+#endif // __ASSEMBLER__
@@ -5,6 +5,7 @@
 // https://opensource.org/licenses/MIT
 
 #include <assert.h>
+#include <stddef.h>
 #include <string.h>
 #include <trace.h>
 
@@ -17,18 +18,35 @@
 
 #define LOCAL_TRACE 0
 
+// The assembly walks user_copy_vec_t directly.
+static_assert(sizeof(user_copy_vec_t) == 24, "");
+static_assert(offsetof(user_copy_vec_t, dst) == 0, "");
+static_assert(offsetof(user_copy_vec_t, src) == 8, "");
+static_assert(offsetof(user_copy_vec_t, len) == 16, "");
+
+static bool can_access(const void *base, size_t len, bool for_write);
+
 static inline bool ac_flag(void)
 {
     return x86_save_flags() & X86_FLAGS_AC;
 }
 
+static inline uint32_t usercopy_flags(void)
+{
+    uint32_t flags = 0;
+    if (x86_feature_test(X86_FEATURE_SMAP))
+        flags |= X86_USERCOPY_FLAG_SMAP;
+    if (x86_feature_test(X86_FEATURE_ERMS))
+        flags |= X86_USERCOPY_FLAG_ERMS;
+    return flags;
+}
+
 status_t arch_copy_from_user(void *dst, const void *src, size_t len)
 {
     DEBUG_ASSERT(!ac_flag());
 
-    bool smap_avail = x86_feature_test(X86_FEATURE_SMAP);
     thread_t *thr = get_current_thread();
-    status_t status = _x86_copy_from_user(dst, src, len, smap_avail,
+    status_t status = _x86_copy_from_user(dst, src, len, usercopy_flags(),
                                           &thr->arch.page_fault_resume);
 
     DEBUG_ASSERT(!ac_flag());
@@ -39,15 +57,46 @@ status_t arch_copy_to_user(void *dst, const void *src, size_t len)
 {
     DEBUG_ASSERT(!ac_flag());
 
-    bool smap_avail = x86_feature_test(X86_FEATURE_SMAP);
     thread_t *thr = get_current_thread();
-    status_t status = _x86_copy_to_user(dst, src, len, smap_avail,
+    status_t status = _x86_copy_to_user(dst, src, len, usercopy_flags(),
                                         &thr->arch.page_fault_resume);
 
     DEBUG_ASSERT(!ac_flag());
     return status;
 }
 
+static status_t copy_vec(const user_copy_vec_t *vec, size_t count, bool to_user)
+{
+    DEBUG_ASSERT(!ac_flag());
+
+    // Validate every user range up front, so the copy itself can run under a
+    // single SMAP window and fault handler.
+    for (size_t i = 0; i < count; i++) {
+        if (vec[i].len == 0)
+            continue;
+        const void *user = to_user ? vec[i].dst : vec[i].src;
+        if (!can_access(user, vec[i].len, to_user))
+            return ERR_INVALID_ARGS;
+    }
+
+    thread_t *thr = get_current_thread();
+    status_t status = _x86_copy_vec(vec, count, usercopy_flags(),
+                                    &thr->arch.page_fault_resume);
+
+    DEBUG_ASSERT(!ac_flag());
+    return status;
+}
+
+status_t arch_copy_from_user_vec(const user_copy_vec_t *vec, size_t count)
+{
+    return copy_vec(vec, count, false);
+}
+
+status_t arch_copy_to_user_vec(const user_copy_vec_t *vec, size_t count)
+{
+    return copy_vec(vec, count, true);
+}
+
 static bool can_access(const void *base, size_t len, bool for_write)
 {
     LTRACEF("can_access: base %p, len %zu\n", base, len);
@@ -21,6 +21,7 @@ BUILDDIR_SUFFIX ?=
 DEBUG ?= 2
 ENABLE_BUILD_LISTFILES ?= false
 ENABLE_BUILD_SYSROOT ?= false
+ENABLE_LOCK_STATS ?= false
 CLANG ?= 0
 USE_GOLD ?= true
 LKNAME ?= magenta
@@ -95,6 +96,8 @@ GLOBAL_MODULE_LDFLAGS :=
 # Kernel compile flags
 KERNEL_INCLUDES := $(BUILDDIR) $(addsuffix /include,$(LKINC))
 KERNEL_COMPILEFLAGS := -fno-pic -ffreestanding -include $(KERNEL_CONFIG_HEADER)
+# keep frame pointers so the sampling profiler can record kernel stacks
+KERNEL_COMPILEFLAGS += -fno-omit-frame-pointer
 KERNEL_CFLAGS :=
 KERNEL_CPPFLAGS :=
 KERNEL_ASMFLAGS :=
@@ -340,6 +343,11 @@ GLOBAL_DEFINES += \
 	LK_DEBUGLEVEL=$(DEBUG)
 endif
 
+# count contended kernel locks? (see the lockstat console command)
+ifeq ($(call TOBOOL,$(ENABLE_LOCK_STATS)),true)
+KERNEL_DEFINES += WITH_LOCK_STATS=1
+endif
+
 # allow additional defines from outside the build system
 ifneq ($(EXTERNAL_DEFINES),)
 GLOBAL_DEFINES += $(EXTERNAL_DEFINES)
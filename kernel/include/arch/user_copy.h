@@ -39,4 +39,40 @@ status_t arch_copy_from_user(void *dst, const void *src, size_t len);
  */
 status_t arch_copy_to_user(void *dst, const void *src, size_t len);
 
+/*
+ * One range of a vectored user copy.  For arch_copy_from_user_vec |src| is the
+ * user pointer, for arch_copy_to_user_vec it is |dst|.
+ */
+typedef struct user_copy_vec {
+    void *dst;
+    const void *src;
+    size_t len;
+} user_copy_vec_t;
+
+/*
+ * @brief Copy a list of ranges from userspace into kernelspace
+ *
+ * Equivalent to calling arch_copy_from_user on each range in turn, but lets
+ * the architecture validate the ranges and set up fault handling once for
+ * the whole list.  On failure, some of the ranges may have been copied.
+ *
+ * @param vec The ranges to copy.
+ * @param count The number of entries in vec.
+ *
+ * @return NO_ERROR on success
+ */
+status_t arch_copy_from_user_vec(const user_copy_vec_t *vec, size_t count);
+
+/*
+ * @brief Copy a list of ranges from kernelspace into userspace
+ *
+ * The counterpart of arch_copy_from_user_vec.
+ *
+ * @param vec The ranges to copy.
+ * @param count The number of entries in vec.
+ *
+ * @return NO_ERROR on success
+ */
+status_t arch_copy_to_user_vec(const user_copy_vec_t *vec, size_t count);
+
 __END_CDECLS
@@ -0,0 +1,85 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <magenta/compiler.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <arch/spinlock.h>
+
+__BEGIN_CDECLS
+
+/* Lock contention statistics, built in with ENABLE_LOCK_STATS=true.
+ *
+ * Contended mutex and spinlock acquisitions are charged to a lock class:
+ * the class a mutex was given with mutex_set_lock_class(), else the class
+ * defined over the lock's address with LOCK_CLASS_STATIC(), else the catch
+ * all "mutex" or "spinlock" class, whose call sites still say where the
+ * lock was taken.  Classes are only updated with atomics, since they are
+ * charged from inside spin_lock() and with the thread lock held.
+ *
+ * Mutex waits are timed in microseconds, spinlock waits in cpu cycles.
+ */
+
+#define LOCK_CLASS_MUTEX 1
+#define LOCK_CLASS_SPINLOCK 2
+
+/* Call sites are kept in a small hash table per class.  A site probes a few
+ * slots from its hash, and when they are all taken it evicts the least
+ * contended of them, so the busiest sites stay put however many others come
+ * and go. */
+#define LOCK_CLASS_SITES 32
+#define LOCK_CLASS_SITE_PROBES 4
+
+typedef struct lock_class_site {
+    uintptr_t pc;
+    uint64_t count;
+    uint64_t wait;
+} lock_class_site_t;
+
+typedef struct lock_class {
+    const char *name;
+    uint32_t kind;
+    /* the address range of the static locks in this class, if any */
+    const void *start;
+    const void *end;
+
+    uint64_t contended;
+    uint64_t wait_total;
+    uint64_t wait_max;
+    /* contended acquisitions charged to sites that have since been evicted */
+    uint64_t other_sites;
+    lock_class_site_t sites[LOCK_CLASS_SITES];
+} lock_class_t;
+
+/* define a lock class for locks that are tagged with mutex_set_lock_class() */
+#define LOCK_CLASS(var, _name, _kind) \
+    __SECTION("lock_class") lock_class_t var = { \
+        .name = _name, .kind = _kind, .start = NULL, .end = NULL, \
+    }
+
+/* define a lock class for a static lock, or a static array of them */
+#define LOCK_CLASS_STATIC(var, _name, _kind, lock) \
+    __SECTION("lock_class") lock_class_t var = { \
+        .name = _name, .kind = _kind, .start = (lock), .end = (lock) + 1, \
+    }
+
+struct mutex;
+struct mx_lockstat;
+
+/* Called by mutex_acquire_timeout() with the thread lock held. */
+void lockstat_mutex_contended(struct mutex *m, uintptr_t pc, uint64_t wait);
+
+/* Called by spin_lock() when the lock is taken; acquires it. */
+void lockstat_spin_contended(spin_lock_t *lock);
+
+/* Copies out class |index|, returning false past the last class. */
+bool lockstat_get(unsigned int index, struct mx_lockstat *out);
+
+void lockstat_reset(void);
+
+__END_CDECLS
@@ -23,6 +23,9 @@ typedef struct mutex {
     thread_t *holder;
     int count;
     wait_queue_t wait;
+#if WITH_LOCK_STATS
+    struct lock_class *lock_class;
+#endif
 } mutex_t;
 
 #define MUTEX_INITIAL_VALUE(m) \
@@ -52,6 +55,14 @@ static inline void mutex_acquire(mutex_t *m)
     mutex_acquire_timeout(m, INFINITE_TIME);
 }
 
+#if WITH_LOCK_STATS
+/* charge contention on this mutex to |lc| (see kernel/lockstat.h) */
+static inline void mutex_set_lock_class(mutex_t *m, struct lock_class *lc)
+{
+    m->lock_class = lc;
+}
+#endif
+
 /* does the current thread hold the mutex? */
 static bool is_mutex_held(const mutex_t *m)
 {
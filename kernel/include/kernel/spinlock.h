@@ -10,12 +10,21 @@
 #include <magenta/compiler.h>
 #include <arch/spinlock.h>
 
+#if WITH_LOCK_STATS
+#include <kernel/lockstat.h>
+#endif
+
 __BEGIN_CDECLS
 
 /* interrupts should already be disabled */
 static inline void spin_lock(spin_lock_t *lock)
 {
+#if WITH_LOCK_STATS
+    if (unlikely(arch_spin_trylock(lock)))
+        lockstat_spin_contended(lock);
+#else
     arch_spin_lock(lock);
+#endif
 }
 
 /* Returns 0 on success, non-0 on failure */
@@ -77,6 +77,7 @@ enum vm_page_state {
     VM_PAGE_STATE_FREE,
     VM_PAGE_STATE_ALLOC,
     VM_PAGE_STATE_MMU, /* allocated to serve arch-specific mmu purposes */
+    VM_PAGE_STATE_CACHED, /* free, but held in a per-cpu pmm cache */
 };
 
 /* kernel address space */
@@ -17,6 +17,7 @@
 
 class VmRegion;
 class VmObject;
+struct VmRegionGapAugmentTraits;
 
 class VmAspace : public mxtl::DoublyLinkedListable<VmAspace*>
                , public mxtl::RefCounted<VmAspace> {
@@ -45,6 +46,14 @@ public:
     arch_aspace_t& arch_aspace() { return arch_aspace_; }
     bool is_user() const { return (flags_ & TYPE_MASK) == TYPE_USER; }
 
+    // wrappers around the arch_mmu routines for use by the vm layer. changes to the page
+    // tables can come from the address space or from any of the objects mapped into it, so
+    // they are serialized here. nests inside the aspace and vm object locks.
+    int MmuMap(vaddr_t vaddr, paddr_t paddr, size_t count, uint mmu_flags);
+    int MmuUnmap(vaddr_t vaddr, size_t count);
+    int MmuProtect(vaddr_t vaddr, size_t count, uint mmu_flags);
+    status_t MmuQuery(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags);
+
     // map a vm object at a given offset
     status_t MapObject(mxtl::RefPtr<VmObject> vmo, const char* name, uint64_t offset, size_t size,
                        void** ptr, uint8_t align_pow2, uint vmm_flags, uint arch_mmu_flags);
@@ -85,8 +94,20 @@ public:
 
     void Dump() const;
 
+    // memory usage of the address space. may fail with ERR_NO_MEMORY if the
+    // mapped objects can't be snapshotted.
+    struct Usage {
+        size_t mapped_bytes;    // total size of the regions
+        size_t resident_bytes;  // object pages currently mapped by the regions
+        size_t committed_bytes; // pages committed by the mapped objects, each object counted once
+    };
+    status_t GetUsage(Usage* usage) const;
+
 private:
-    using RegionTree = mxtl::WAVLTree<vaddr_t, mxtl::RefPtr<VmRegion>>;
+    using RegionTree = mxtl::WAVLTree<vaddr_t, mxtl::RefPtr<VmRegion>,
+                                      mxtl::DefaultKeyedObjectTraits<vaddr_t, VmRegion>,
+                                      mxtl::DefaultWAVLTreeTraits<mxtl::RefPtr<VmRegion>>,
+                                      VmRegionGapAugmentTraits>;
 
     // nocopy
     VmAspace(const VmAspace&) = delete;
@@ -111,6 +132,8 @@ private:
                                         uint arch_mmu_flags);
     vaddr_t AllocSpot(size_t size, uint8_t align_pow2, uint arch_mmu_flags,
                       RegionTree::iterator* after);
+    bool FindSpotInSubtree(const RegionTree::iterator& node, vaddr_t* pva, vaddr_t align,
+                           size_t size, uint arch_mmu_flags, RegionTree::iterator* after);
     mxtl::RefPtr<VmRegion> FindRegionLocked(vaddr_t vaddr);
     bool CheckGap(const RegionTree::iterator& prev,
                   const RegionTree::iterator& next,
@@ -128,6 +151,9 @@ private:
 
     mutable mutex_t lock_ = MUTEX_INITIAL_VALUE(lock_);
 
+    // serializes the Mmu* routines
+    mutex_t mmu_lock_ = MUTEX_INITIAL_VALUE(mmu_lock_);
+
     // ordered tree of regions
     RegionTree regions_;
 
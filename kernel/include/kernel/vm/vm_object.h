@@ -7,42 +7,120 @@
 #pragma once
 
 #include <assert.h>
+#include <kernel/event.h>
 #include <kernel/mutex.h>
 #include <kernel/vm.h>
+#include <kernel/vm/vm_region.h>
 #include <list.h>
 #include <stdint.h>
 #include <mxtl/array.h>
+#include <mxtl/intrusive_double_list.h>
 #include <mxtl/ref_counted.h>
 #include <mxtl/ref_ptr.h>
 #include <lib/user_copy/user_ptr.h>
 
+// Supplies the contents of a pager-backed vm object. The object asks for pages it is
+// missing through RequestPage and the pager hands them over later via VmObject::SupplyPages.
+class VmPageSource : public mxtl::RefCounted<VmPageSource> {
+public:
+    virtual ~VmPageSource() {}
+
+    // ask for the page at the given offset. called with the object's lock held, so it must
+    // not block or call back into the object.
+    virtual status_t RequestPage(uint64_t offset) = 0;
+
+    // true once the pager has gone away and won't supply any more pages.
+    // called without the object's lock held.
+    virtual bool IsClosed() = 0;
+};
+
+class VmObject;
+
+// A thread waiting for the pager to supply the page at an offset into a vm object.
+// Zero initialize it before handing it to VmObject::FaultPageLocked.
+struct VmPageRequest {
+    struct list_node node;
+    uint64_t offset;
+    event_t event;
+    status_t status;
+
+    // the pager-backed object the request is queued on
+    mxtl::RefPtr<VmObject> object;
+};
+
 // The base vm object that holds a range of bytes of data
 //
 // Can be created without mapping and used as a container of data, or mappable
 // into an address space via VmAspace::MapObject
 
-class VmObject : public mxtl::RefCounted<VmObject> {
+class VmObject : public mxtl::RefCounted<VmObject>,
+                 public mxtl::DoublyLinkedListable<VmObject*> {
 public:
     static mxtl::RefPtr<VmObject> Create(uint32_t pmm_alloc_flags, uint64_t size);
 
+    // create an object whose pages are filled in on demand by a pager.
+    // threads touching a missing page block until the page is supplied.
+    static mxtl::RefPtr<VmObject> CreatePaged(mxtl::RefPtr<VmPageSource> source, uint64_t size);
+
+    // create a copy-on-write clone of a range of this object.
+    // the clone is a snapshot of the range: it initially shares all of its pages with this
+    // object, and a page is copied the first time it is written through either of them, so
+    // neither sees the other's writes. the shared pages move into a hidden object that both
+    // become children of, and this object's mappings are made read-only.
+    // clones of a pager-backed object share its pages like a file instead, so they see pages
+    // supplied or written to it later for any page they haven't copied.
+    mxtl::RefPtr<VmObject> CloneCOW(uint64_t offset, uint64_t size);
+
     status_t Resize(uint64_t size);
 
     uint64_t size() const { return size_; }
 
+    // number of pages the object owns
+    size_t committed_pages() const { return committed_pages_; }
+
+    // true if this object or one of its ancestors gets its pages from a pager
+    bool is_paged() const { return paged_; }
+
     // add a page to the object
     status_t AddPage(vm_page_t* p, uint64_t offset);
 
     // find physical pages to back the range of the object
     int64_t CommitRange(uint64_t offset, uint64_t len);
 
+    // free the pages of the range, unmapping them from every region that maps the object.
+    // returns the number of bytes decommitted
+    int64_t DecommitRange(uint64_t offset, uint64_t len);
+
+    // commit the range and map its pages into every region that maps it, so later accesses
+    // don't have to fault them in one at a time. returns the number of bytes committed
+    int64_t Prefetch(uint64_t offset, uint64_t len);
+
+    // fill in missing pages of a pager-backed object from a user buffer and wake up anyone
+    // waiting for them. pages that are already present are left alone.
+    status_t SupplyPages(uint64_t offset, uint64_t len, user_ptr<const void> data);
+
     // find a contiguous run of physical pages to back the range of the object
     int64_t CommitRangeContiguous(uint64_t offset, uint64_t len, uint8_t alignment_log2 = 0);
 
     // get a pointer to a page at a given offset
     vm_page_t* GetPage(uint64_t offset);
 
+    // the object's lock. pages returned by the *Locked routines below are only stable while
+    // it is held, so anything mapping them has to do so before dropping it.
+    mutex_t* lock() { return &lock_; }
+
     // fault in a page at a given offset with PF_FLAGS
-    vm_page_t* FaultPage(uint64_t offset, uint pf_flags);
+    // shared, if passed, is set to true if the returned page isn't owned by this object
+    // (it belongs to an ancestor, or is the global zero page) and must not be mapped writable.
+    // if the page has to come from a pager, req is queued and null is returned with
+    // req->status set to ERR_SHOULD_WAIT; the caller drops the lock and calls WaitForPage.
+    vm_page_t* FaultPageLocked(uint64_t offset, uint pf_flags, bool* shared, VmPageRequest* req);
+    vm_page_t* GetPageLocked(uint64_t offset);
+
+    // block until a queued request has been serviced, returning its status. gives up with
+    // ERR_TIMED_OUT if the pager doesn't answer in time, or ERR_REMOTE_CLOSED if it goes away.
+    // must be called without any vm locks held.
+    static status_t WaitForPage(VmPageRequest* req);
 
     // read/write operators against kernel pointers only
     status_t Read(void* ptr, uint64_t offset, size_t len, size_t* bytes_read);
@@ -55,8 +133,20 @@ public:
     // translate a range of the vmo to physical addresses and store in the buffer
     status_t Lookup(uint64_t offset, uint64_t len, user_ptr<paddr_t>, size_t);
 
+    // track the regions that map this object
+    void AddMapping(VmRegion* r);
+    void RemoveMapping(VmRegion* r);
+
     void Dump();
 
+    // look for committed pages that are entirely zero, optionally giving them back to the pmm.
+    // reclaimed pages read as zero again through the global zero page.
+    // returns the number of zero pages found.
+    size_t ScanForZeroPages(bool reclaim);
+
+    // run ScanForZeroPages over every vm object in the system
+    static size_t ScanAllForZeroPages(bool reclaim);
+
 private:
     // kill copy constructors
     VmObject(const VmObject& o) = delete;
@@ -69,9 +159,34 @@ private:
     ~VmObject();
     friend mxtl::RefPtr<VmObject>;
 
-    // unlocked versions of the above routines
-    vm_page_t* FaultPageLocked(uint64_t offset, uint pf_flags);
-    vm_page_t* GetPageLocked(uint64_t offset);
+    // search the chain of parent objects for a page backing the offset into this object
+    vm_page_t* GetPageFromParentLocked(uint64_t offset);
+
+    // find the pager-backed object, this one or an ancestor, that is missing the page backing
+    // the offset, and queue req on it. returns ERR_SHOULD_WAIT if req was queued, NO_ERROR if
+    // no pager is involved.
+    status_t QueuePageRequestLocked(uint64_t offset, VmPageRequest* req);
+
+    // CommitRange for a clone of a pager-backed object
+    int64_t CommitRangeFromPager(uint64_t offset, uint64_t len);
+
+    // complete the requests waiting on a range of the object
+    void CompletePageRequestsLocked(uint64_t offset, uint64_t len, status_t status);
+
+    // fill a freshly allocated page for the given offset, copying from an ancestor if one
+    // has a page there, otherwise zeroing it unless it is already known to be zero
+    void InitPageLocked(vm_page_t* p, uint64_t offset, bool zeroed);
+
+    // unmap a range of the object from every region that maps it
+    void RangeChangeUpdateLocked(uint64_t offset, uint64_t len);
+
+    // copy everything this object has at offset onward, including what it sees of its
+    // ancestors, into a fresh clone
+    status_t CopyRangeLocked(VmObject* clone, uint64_t offset);
+
+    // if our parent is a hidden object that we are the last child of, take over the pages of
+    // it that we can see and drop it from the chain
+    void MergeParentLocked();
 
     // internal page list routine
     void AddPageToArray(size_t index, vm_page_t* p);
@@ -102,4 +217,39 @@ private:
 
     // list of all allocated pages
     list_node page_list_ = LIST_INITIAL_VALUE(page_list_);
+
+    // number of pages in page_list_
+    size_t committed_pages_ = 0;
+
+    // parent object and offset into it if this object is a copy-on-write clone
+    mxtl::RefPtr<VmObject> parent_;
+    uint64_t parent_offset_ = 0;
+
+    // number of live copy-on-write clones of this object
+    uint32_t num_children_ = 0;
+
+    // set if this object only holds the pages shared between the clones created from a
+    // visible object. it is never mapped or written, and goes away once only one of the
+    // clones is left.
+    bool hidden_ = false;
+
+    // list of regions that map this object
+    mxtl::DoublyLinkedList<VmRegion*, VmRegionObjectListTraits> mapping_list_;
+
+    // set once pages have been handed out by physical address or added from outside,
+    // after which they can't be reclaimed
+    bool pages_pinned_ = false;
+
+    // where missing pages come from, if this is a pager-backed object
+    mxtl::RefPtr<VmPageSource> source_;
+
+    // set if this object or an ancestor has a page source
+    bool paged_ = false;
+
+    // threads waiting for pages from source_
+    list_node page_requests_ = LIST_INITIAL_VALUE(page_requests_);
+
+    // set once a page not owned by this object has been handed out to be mapped, so
+    // newly committed pages need to be pushed out to existing mappings
+    bool shared_pages_mapped_ = false;
 };
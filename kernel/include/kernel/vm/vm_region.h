@@ -7,13 +7,17 @@
 #pragma once
 
 #include <assert.h>
+#include <kernel/vm.h>
 #include <stdint.h>
+#include <mxtl/algorithm.h>
+#include <mxtl/intrusive_double_list.h>
 #include <mxtl/intrusive_wavl_tree.h>
 #include <mxtl/ref_counted.h>
 #include <mxtl/ref_ptr.h>
 
 class VmAspace;
 class VmObject;
+struct VmPageRequest;
 
 class VmRegion : public mxtl::WAVLTreeContainable<mxtl::RefPtr<VmRegion>>
                , public mxtl::RefCounted<VmRegion> {
@@ -27,9 +31,27 @@ public:
     size_t size() const { return size_; }
     uint arch_mmu_flags() const { return arch_mmu_flags_; }
     uint64_t object_offset() const { return object_offset_; }
-
-    // set base address
-    void set_base(vaddr_t vaddr) { base_ = vaddr; }
+    const VmAspace& aspace() const { return *aspace_; }
+    const VmObject* object() const { return object_.get(); }
+    mxtl::RefPtr<VmObject> object_ref() const { return object_; }
+
+    // number of pages of the object currently mapped by the region
+    size_t resident_pages() const {
+        int pages = resident_pages_;
+        return (pages > 0) ? pages : 0;
+    }
+
+    // set base address, only valid before the region is added to its address space's tree
+    void set_base(vaddr_t vaddr) {
+        DEBUG_ASSERT(!InContainer());
+        base_ = vaddr;
+    }
+
+    // summary of the subtree rooted at this region in the address space's region tree,
+    // kept up to date by VmRegionGapAugmentTraits. only valid while the region is in the tree.
+    vaddr_t subtree_base() const { return subtree_base_; }
+    vaddr_t subtree_last() const { return subtree_last_; }
+    size_t subtree_max_gap() const { return subtree_max_gap_; }
 
     void Dump() const;
 
@@ -51,11 +73,26 @@ public:
     // change mapping permissions
     status_t Protect(uint arch_mmu_flags);
 
-    // page fault in an address into the region
-    status_t PageFault(vaddr_t va, uint pf_flags);
+    // page fault in an address into the region.
+    // returns ERR_SHOULD_WAIT if the page has to come from a pager, in which case req has been
+    // queued; the caller drops its locks, waits on it with VmObject::WaitForPage and retries.
+    status_t PageFault(vaddr_t va, uint pf_flags, VmPageRequest* req);
 
     mxtl::RefPtr<VmObject> vmo();
 
+    // unmap the part of this region that maps the given range of its object.
+    // called by the object with its lock held.
+    void UnmapObjectRangeLocked(uint64_t offset, uint64_t len);
+
+    // make the part of this region that maps the given range of its object read-only, so
+    // the next write faults. called by the object with its lock held.
+    void WriteProtectObjectRangeLocked(uint64_t offset, uint64_t len);
+
+    // map a page of the object at the given offset, if this region covers it and nothing is
+    // mapped there yet. shared pages aren't owned by the object and are mapped read-only.
+    // called by the object with its lock held.
+    void MapObjectPageLocked(uint64_t offset, vm_page_t* p, bool shared = false);
+
     // WAVL tree key function
     vaddr_t GetKey() const { return base(); }
 
@@ -67,6 +104,10 @@ private:
     VmRegion(const VmRegion&) = delete;
     VmRegion& operator=(const VmRegion&) = delete;
 
+    // map a page just faulted in from the object at va, fixing up whatever is mapped there.
+    // called with the object's lock held.
+    status_t MapFaultedPageLocked(vaddr_t va, vm_page_t* new_p, bool shared);
+
     // magic value
     static const uint32_t MAGIC = 0x564d5247; // VMRG
     uint32_t magic_ = MAGIC;
@@ -86,4 +127,54 @@ private:
     uint64_t object_offset_ = 0;
 
     char name_[32];
+
+    // updated by whoever changes the mappings, which may be the aspace or the object,
+    // so it is only ever touched atomically
+    volatile int resident_pages_ = 0;
+
+    // lowest address, last address and largest free gap between two regions in the
+    // subtree rooted here
+    friend struct VmRegionGapAugmentTraits;
+    vaddr_t subtree_base_ = 0;
+    vaddr_t subtree_last_ = 0;
+    size_t subtree_max_gap_ = 0;
+
+    // node for the object's list of regions that map it
+    friend struct VmRegionObjectListTraits;
+    mxtl::DoublyLinkedListNodeState<VmRegion*> object_list_node_state_;
+};
+
+// For use by VmObject to track the regions that map it, kept separate from the node state
+// the region uses in its address space's region tree.
+struct VmRegionObjectListTraits {
+    inline static mxtl::DoublyLinkedListNodeState<VmRegion*>& node_state(VmRegion& r) {
+        return r.object_list_node_state_;
+    }
+};
+
+// Augments the address space's region tree so that every region knows the size of the
+// largest free gap between the regions in its subtree. This lets VmAspace::AllocSpot skip
+// over whole subtrees that have no room instead of checking every gap in the address space.
+struct VmRegionGapAugmentTraits {
+    static constexpr bool IsAugmented = true;
+
+    static void UpdateAugmentedState(VmRegion* r, VmRegion* left, VmRegion* right) {
+        vaddr_t last = r->base_ + r->size_ - 1;
+
+        r->subtree_base_ = r->base_;
+        r->subtree_last_ = last;
+        r->subtree_max_gap_ = 0;
+
+        if (left) {
+            size_t gap = r->base_ - left->subtree_last_ - 1;
+            r->subtree_base_ = left->subtree_base_;
+            r->subtree_max_gap_ = mxtl::max(left->subtree_max_gap_, gap);
+        }
+        if (right) {
+            size_t gap = right->subtree_base_ - last - 1;
+            r->subtree_last_ = right->subtree_last_;
+            r->subtree_max_gap_ = mxtl::max(r->subtree_max_gap_,
+                                            mxtl::max(right->subtree_max_gap_, gap));
+        }
+    }
 };
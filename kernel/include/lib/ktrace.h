@@ -18,31 +18,29 @@ typedef struct {
     const char* name;
 } ktrace_probe_info_t;
 
-void* ktrace_open(uint32_t tag);
 void ktrace_tiny(uint32_t tag, uint32_t arg);
-static inline void ktrace(uint32_t tag, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
-    uint32_t* data = (uint32_t*) ktrace_open(tag);
-    if (data) {
-        data[0] = a; data[1] = b; data[2] = c; data[3] = d;
-    }
-}
+void ktrace(uint32_t tag, uint32_t a, uint32_t b, uint32_t c, uint32_t d);
 #define ktrace_probe0(name) { \
     static __SECTION("ktrace_probe") ktrace_probe_info_t info = { 0, name }; \
-    ktrace_open(TAG_PROBE_16(info.num)); \
+    ktrace(TAG_PROBE_16(info.num), 0, 0, 0, 0); \
 }
 #define ktrace_probe2(name,arg0,arg1) { \
     static __SECTION("ktrace_probe") ktrace_probe_info_t info = { 0, name }; \
-    uint32_t* args = ktrace_open(TAG_PROBE_24(info.num)); \
-    if (args) { \
-        args[0] = arg0; \
-        args[1] = arg1; \
-    } \
+    ktrace(TAG_PROBE_24(info.num), arg0, arg1, 0, 0); \
 }
 void ktrace_name(uint32_t tag, uint32_t id, uint32_t arg, const char* name);
 int ktrace_read_user(void* ptr, uint32_t off, uint32_t len);
 status_t ktrace_control(uint32_t action, uint32_t options);
+// changes every time tracing is started or rewound, never zero
+uint32_t ktrace_generation(void);
+// whether events with |tag| are being traced right now
+bool ktrace_tag_enabled(uint32_t tag);
+// whether full rings overwrite their oldest events rather than stopping the trace
+bool ktrace_ring_mode(void);
+// called by the arch irq handlers on the way out, with interrupts disabled,
+// with the interrupted pc and frame pointer
+void ktrace_profile_irq(uintptr_t pc, uintptr_t fp, bool user);
 #else
-static inline void* ktrace_open(uint32_t tag) { return NULL; }
 static inline void ktrace_tiny(uint32_t tag, uint32_t arg) {}
 static inline void ktrace(uint32_t tag, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {}
 static inline void ktrace_probe0(uint32_t n, const char* name) {}
@@ -58,9 +56,34 @@ static inline ssize_t ktrace_read_user(void* ptr, uint32_t off, uint32_t len) {
 static inline status_t ktrace_control(uint32_t action, uint32_t options) {
     return ERR_NOT_SUPPORTED;
 }
+static inline uint32_t ktrace_generation(void) {
+    return 1;
+}
+static inline bool ktrace_tag_enabled(uint32_t tag) {
+    return false;
+}
+static inline bool ktrace_ring_mode(void) {
+    return false;
+}
+static inline void ktrace_profile_irq(uintptr_t pc, uintptr_t fp, bool user) {}
 #endif
 
 #define KTRACE_DEFAULT_BUFSIZE 32 // MB
 #define KTRACE_DEFAULT_GRPMASK 0xFFF
 
 __END_CDECLS
+
+#ifdef __cplusplus
+#include <mxtl/ref_ptr.h>
+
+class VmObject;
+
+// the trace buffer, laid out as ktrace_buffer_header_t describes
+#if WITH_LIB_KTRACE
+status_t ktrace_get_vmo(mxtl::RefPtr<VmObject>* vmo);
+#else
+static inline status_t ktrace_get_vmo(mxtl::RefPtr<VmObject>* vmo) {
+    return ERR_NOT_SUPPORTED;
+}
+#endif
+#endif
@@ -0,0 +1,213 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <kernel/lockstat.h>
+
+#include <arch/ops.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <kernel/mutex.h>
+#include <magenta/lockstat.h>
+#include <stdio.h>
+#include <string.h>
+
+static_assert(LOCK_CLASS_MUTEX == MX_LOCKSTAT_MUTEX, "");
+static_assert(LOCK_CLASS_SPINLOCK == MX_LOCKSTAT_SPINLOCK, "");
+static_assert(LOCK_CLASS_SITES >= MX_LOCKSTAT_SITES, "");
+
+extern lock_class_t __start_lock_class[] __WEAK;
+extern lock_class_t __stop_lock_class[] __WEAK;
+
+/* everything without a class of its own */
+LOCK_CLASS(mutex_lock_class, "mutex", LOCK_CLASS_MUTEX);
+LOCK_CLASS(spinlock_lock_class, "spinlock", LOCK_CLASS_SPINLOCK);
+
+static lock_class_t *lockstat_find(const void *lock, uint32_t kind)
+{
+    for (lock_class_t *lc = __start_lock_class; lc != __stop_lock_class; lc++) {
+        if (lc->kind == kind && lock >= lc->start && lock < lc->end)
+            return lc;
+    }
+    return (kind == LOCK_CLASS_MUTEX) ? &mutex_lock_class : &spinlock_lock_class;
+}
+
+static void lockstat_record(lock_class_t *lc, uintptr_t pc, uint64_t wait)
+{
+    __atomic_fetch_add(&lc->contended, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&lc->wait_total, wait, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&lc->wait_max, __ATOMIC_RELAXED);
+    while (wait > max) {
+        if (__atomic_compare_exchange_n(&lc->wait_max, &max, wait, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            break;
+    }
+
+    /* find the site's slot, claiming a free one if it has none yet */
+    uint hash = (uint)(((uint64_t)pc * 0x9e3779b97f4a7c15ull) >> 32);
+    lock_class_site_t *victim = NULL;
+    uintptr_t victim_pc = 0;
+    uint64_t victim_count = UINT64_MAX;
+    for (uint i = 0; i < LOCK_CLASS_SITE_PROBES; i++) {
+        lock_class_site_t *site = &lc->sites[(hash + i) % LOCK_CLASS_SITES];
+        uintptr_t site_pc = __atomic_load_n(&site->pc, __ATOMIC_RELAXED);
+        if (site_pc == 0) {
+            if (__atomic_compare_exchange_n(&site->pc, &site_pc, pc, false,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                site_pc = pc;
+        }
+        if (site_pc == pc) {
+            __atomic_fetch_add(&site->count, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&site->wait, wait, __ATOMIC_RELAXED);
+            return;
+        }
+        uint64_t count = __atomic_load_n(&site->count, __ATOMIC_RELAXED);
+        if (count < victim_count) {
+            victim = site;
+            victim_pc = site_pc;
+            victim_count = count;
+        }
+    }
+
+    /* all taken: evict the least contended, whose counts go to other_sites.
+     * an update racing with the eviction may be charged to the wrong site. */
+    if (__atomic_compare_exchange_n(&victim->pc, &victim_pc, pc, false,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        victim_count = __atomic_exchange_n(&victim->count, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&victim->wait, wait, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&lc->other_sites, victim_count, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_add(&lc->other_sites, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void lockstat_mutex_contended(mutex_t *m, uintptr_t pc, uint64_t wait)
+{
+    /* the thread lock is held, so the class can be cached in the mutex */
+    if (!m->lock_class)
+        m->lock_class = lockstat_find(m, LOCK_CLASS_MUTEX);
+    lockstat_record(m->lock_class, pc, wait);
+}
+
+__NO_INLINE void lockstat_spin_contended(spin_lock_t *lock)
+{
+    /* spin_lock() is inlined, so our caller is where the lock was taken */
+    uintptr_t pc = (uintptr_t)__GET_CALLER();
+
+    uint32_t start = arch_cycle_count();
+    arch_spin_lock(lock);
+    uint32_t wait = arch_cycle_count() - start;
+
+    lockstat_record(lockstat_find(lock, LOCK_CLASS_SPINLOCK), pc, wait);
+}
+
+/* copies out the sites of |lc|, most contended first.  callers keep as many
+ * of the top sites as they have room for. */
+static uint lockstat_sites(const lock_class_t *lc, lock_class_site_t *sites)
+{
+    uint n = 0;
+    for (uint i = 0; i < LOCK_CLASS_SITES; i++) {
+        lock_class_site_t site = {
+            .pc = __atomic_load_n(&lc->sites[i].pc, __ATOMIC_RELAXED),
+            .count = __atomic_load_n(&lc->sites[i].count, __ATOMIC_RELAXED),
+            .wait = __atomic_load_n(&lc->sites[i].wait, __ATOMIC_RELAXED),
+        };
+        if (site.pc == 0 || site.count == 0)
+            continue;
+        uint j = n++;
+        for (; j > 0 && sites[j - 1].count < site.count; j--)
+            sites[j] = sites[j - 1];
+        sites[j] = site;
+    }
+    return n;
+}
+
+bool lockstat_get(unsigned int index, mx_lockstat_t *out)
+{
+    if (index >= (size_t)(__stop_lock_class - __start_lock_class))
+        return false;
+    const lock_class_t *lc = &__start_lock_class[index];
+
+    memset(out, 0, sizeof(*out));
+    strlcpy(out->name, lc->name, sizeof(out->name));
+    out->kind = lc->kind;
+    out->contended = __atomic_load_n(&lc->contended, __ATOMIC_RELAXED);
+    out->wait_total = __atomic_load_n(&lc->wait_total, __ATOMIC_RELAXED);
+    out->wait_max = __atomic_load_n(&lc->wait_max, __ATOMIC_RELAXED);
+
+    lock_class_site_t sites[LOCK_CLASS_SITES];
+    uint n = lockstat_sites(lc, sites);
+    for (uint i = 0; i < n && i < MX_LOCKSTAT_SITES; i++) {
+        out->sites[i].pc = sites[i].pc;
+        out->sites[i].count = sites[i].count;
+        out->sites[i].wait_total = sites[i].wait;
+    }
+    return true;
+}
+
+void lockstat_reset(void)
+{
+    /* racing with contention only loses a few counts */
+    for (lock_class_t *lc = __start_lock_class; lc != __stop_lock_class; lc++) {
+        __atomic_store_n(&lc->contended, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&lc->wait_total, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&lc->wait_max, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&lc->other_sites, 0, __ATOMIC_RELAXED);
+        for (uint i = 0; i < LOCK_CLASS_SITES; i++) {
+            __atomic_store_n(&lc->sites[i].count, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&lc->sites[i].wait, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&lc->sites[i].pc, 0, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+#if WITH_LIB_CONSOLE
+#include <lib/console.h>
+
+static void lockstat_dump(void)
+{
+    printf("%-24s %-5s %10s %14s %12s (mutex: usecs, spin: cycles)\n",
+           "class", "kind", "contended", "wait total", "wait max");
+    for (lock_class_t *lc = __start_lock_class; lc != __stop_lock_class; lc++) {
+        uint64_t contended = __atomic_load_n(&lc->contended, __ATOMIC_RELAXED);
+        if (contended == 0)
+            continue;
+        printf("%-24s %-5s %10" PRIu64 " %14" PRIu64 " %12" PRIu64 "\n",
+               lc->name, (lc->kind == LOCK_CLASS_MUTEX) ? "mutex" : "spin", contended,
+               __atomic_load_n(&lc->wait_total, __ATOMIC_RELAXED),
+               __atomic_load_n(&lc->wait_max, __ATOMIC_RELAXED));
+
+        lock_class_site_t sites[LOCK_CLASS_SITES];
+        uint n = lockstat_sites(lc, sites);
+        for (uint i = 0; i < n; i++) {
+            printf("    at %#" PRIxPTR ": %" PRIu64 " times, %" PRIu64 " waiting\n",
+                   sites[i].pc, sites[i].count, sites[i].wait);
+        }
+        uint64_t other = __atomic_load_n(&lc->other_sites, __ATOMIC_RELAXED);
+        if (other)
+            printf("    evicted sites: %" PRIu64 " times\n", other);
+    }
+}
+
+static int cmd_lockstat(int argc, const cmd_args *argv)
+{
+    if (argc > 1 && !strcmp(argv[1].str, "reset")) {
+        lockstat_reset();
+        return 0;
+    }
+    if (argc > 1) {
+        printf("usage: %s [reset]\n", argv[0].str);
+        return -1;
+    }
+
+    lockstat_dump();
+    return 0;
+}
+
+STATIC_COMMAND_START
+STATIC_COMMAND("lockstat", "lock contention statistics", &cmd_lockstat)
+STATIC_COMMAND_END(lockstat);
+#endif
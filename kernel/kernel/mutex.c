@@ -21,6 +21,11 @@
 #include <err.h>
 #include <kernel/thread.h>
 
+#if WITH_LOCK_STATS
+#include <kernel/lockstat.h>
+#include <platform.h>
+#endif
+
 /**
  * @brief  Initialize a mutex_t
  */
@@ -100,7 +105,15 @@ status_t mutex_acquire_timeout(mutex_t *m, lk_time_t timeout)
 #endif
 
     THREAD_LOCK(state);
+#if WITH_LOCK_STATS
+    bool contended = m->count > 0;
+    lk_bigtime_t wait_start = contended ? current_time_hires() : 0;
+#endif
     status_t ret = mutex_acquire_timeout_internal(m, timeout);
+#if WITH_LOCK_STATS
+    if (unlikely(contended))
+        lockstat_mutex_contended(m, (uintptr_t)__GET_CALLER(), current_time_hires() - wait_start);
+#endif
     THREAD_UNLOCK(state);
     return ret;
 }
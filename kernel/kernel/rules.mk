@@ -27,6 +27,9 @@ MODULE_SRCS := \
 	$(LOCAL_DIR)/mp.c \
 	$(LOCAL_DIR)/cmdline.c \
 
+ifeq ($(call TOBOOL,$(ENABLE_LOCK_STATS)),true)
+MODULE_SRCS += $(LOCAL_DIR)/lockstat.c
+endif
 
 ifeq ($(WITH_KERNEL_VM),1)
 MODULE_DEPS += kernel/vm
@@ -27,6 +27,7 @@
 #include <kernel/timer.h>
 #include <kernel/debug.h>
 #include <kernel/mp.h>
+#include <kernel/lockstat.h>
 #include <platform.h>
 #include <target.h>
 #include <lib/heap.h>
@@ -49,6 +50,9 @@ static struct list_node thread_list;
 
 /* master thread spinlock */
 spin_lock_t thread_lock = SPIN_LOCK_INITIAL_VALUE;
+#if WITH_LOCK_STATS
+LOCK_CLASS_STATIC(thread_lock_class, "thread_lock", LOCK_CLASS_SPINLOCK, &thread_lock);
+#endif
 
 /* the run queue */
 static struct list_node run_queue[NUM_PRIORITIES];
@@ -9,8 +9,11 @@
 #include <assert.h>
 #include <err.h>
 #include <inttypes.h>
+#include <arch/ops.h>
 #include <kernel/auto_lock.h>
+#include <kernel/lockstat.h>
 #include <kernel/mutex.h>
+#include <kernel/spinlock.h>
 #include <kernel/vm.h>
 #include <lib/console.h>
 #include <list.h>
@@ -24,6 +27,59 @@
 static struct list_node arena_list = LIST_INITIAL_VALUE(arena_list);
 static mutex_t lock = MUTEX_INITIAL_VALUE(lock);
 
+/* Per cpu caches of free pages. Single page allocations and frees are served out of
+ * the current cpu's cache, which is refilled from and drained to the arenas in batches,
+ * so most of them never touch the global lock.
+ * Pages sitting in a cache are in the CACHED state, which keeps the contiguous and
+ * range allocators from handing them out. Those allocators drain all of the caches
+ * back into the arenas when they can't otherwise find what they're looking for.
+ */
+#define PMM_CACHE_BATCH 32
+#define PMM_CACHE_MAX (PMM_CACHE_BATCH * 4)
+
+struct pmm_cache {
+    spin_lock_t lock;
+    struct list_node free_list;
+    size_t count;
+
+    /* stats */
+    uint64_t alloc_count;   /* pages allocated on this cpu */
+    uint64_t free_count;    /* pages freed on this cpu */
+    uint64_t hit_count;     /* single page allocations served out of the cache */
+    uint64_t refill_count;  /* batches pulled from the arenas */
+    uint64_t drain_count;   /* batches pushed back to the arenas */
+} __CPU_ALIGN;
+
+static struct pmm_cache caches[SMP_MAX_CPUS];
+
+#if WITH_LOCK_STATS
+LOCK_CLASS_STATIC(pmm_lock_class, "pmm", LOCK_CLASS_MUTEX, &lock);
+LOCK_CLASS_STATIC(pmm_cache_lock_class, "pmm cache", LOCK_CLASS_SPINLOCK, &caches);
+#endif
+static bool caches_initialized;
+
+static void pmm_cache_init(void) {
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        spin_lock_init(&caches[i].lock);
+        list_initialize(&caches[i].free_list);
+    }
+    caches_initialized = true;
+}
+
+/* lock and return the current cpu's cache. interrupts stay disabled while it is held,
+ * which also keeps the thread from migrating off of the cpu.
+ */
+static struct pmm_cache* pmm_cache_acquire(spin_lock_saved_state_t* state) {
+    arch_interrupt_save(state, SPIN_LOCK_FLAG_INTERRUPTS);
+    struct pmm_cache* c = &caches[arch_curr_cpu_num()];
+    spin_lock(&c->lock);
+    return c;
+}
+
+static void pmm_cache_release(struct pmm_cache* c, spin_lock_saved_state_t state) {
+    spin_unlock_irqrestore(&c->lock, state);
+}
+
 #define PAGE_BELONGS_TO_ARENA(page, arena)                    \
     (((uintptr_t)(page) >= (uintptr_t)(arena)->page_array) && \
      ((uintptr_t)(page) <                                     \
@@ -40,6 +96,10 @@ static inline bool page_is_free(const vm_page_t* page) {
     return page->state == VM_PAGE_STATE_FREE;
 }
 
+static inline bool page_is_cached(const vm_page_t* page) {
+    return page->state == VM_PAGE_STATE_CACHED;
+}
+
 paddr_t vm_page_to_paddr(const vm_page_t* page) {
     pmm_arena_t* a;
     list_for_every_entry (&arena_list, a, pmm_arena_t, node) {
@@ -83,6 +143,9 @@ status_t pmm_add_arena(pmm_arena_t* arena) {
 
 done_add:
 
+    if (!caches_initialized)
+        pmm_cache_init();
+
     /* zero out some of the structure */
     arena->free_count = 0;
     list_initialize(&arena->free_list);
@@ -106,10 +169,15 @@ done_add:
     return NO_ERROR;
 }
 
-vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
-    AutoLock al(lock);
+/* pull up to count pages off of the arenas onto list, returning the number of pages
+ * allocated. must be called with the lock held.
+ */
+static size_t alloc_pages_locked(size_t count, uint alloc_flags, struct list_node* list) {
+    DEBUG_ASSERT(is_mutex_held(&lock));
 
-    /* walk the arenas in order until we find one with a free page */
+    size_t allocated = 0;
+
+    /* walk the arenas in order, allocating as many pages as we can from each */
     pmm_arena_t* a;
     list_for_every_entry (&arena_list, a, pmm_arena_t, node) {
         /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
@@ -117,28 +185,174 @@ vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
             if ((a->flags & PMM_ARENA_FLAG_KMAP) == 0)
                 continue;
         }
-        vm_page_t* page = list_remove_head_type(&a->free_list, vm_page_t, node);
-        if (!page)
-            continue;
+        while (allocated < count) {
+            vm_page_t* page = list_remove_head_type(&a->free_list, vm_page_t, node);
+            if (!page)
+                break;
+
+            a->free_count--;
+
+            DEBUG_ASSERT(page_is_free(page));
+
+            page->state = VM_PAGE_STATE_ALLOC;
+            list_add_tail(list, &page->node);
+
+            allocated++;
+        }
+        if (allocated == count)
+            break;
+    }
+
+    return allocated;
+}
+
+/* return a list of allocated or cached pages to their arenas, returning the number of
+ * pages freed. must be called with the lock held.
+ */
+static size_t free_pages_locked(struct list_node* list) {
+    DEBUG_ASSERT(is_mutex_held(&lock));
+
+    size_t count = 0;
+    while (!list_is_empty(list)) {
+        vm_page_t* page = list_remove_head_type(list, vm_page_t, node);
+
+        DEBUG_ASSERT(!list_in_list(&page->node));
+        DEBUG_ASSERT(!page_is_free(page));
+
+        /* see which arena this page belongs to and add it */
+        pmm_arena_t* a;
+        list_for_every_entry (&arena_list, a, pmm_arena_t, node) {
+            if (PAGE_BELONGS_TO_ARENA(page, a)) {
+                page->state = VM_PAGE_STATE_FREE;
+
+                list_add_head(&a->free_list, &page->node);
+                a->free_count++;
+                count++;
+                break;
+            }
+        }
+    }
 
-        a->free_count--;
+    return count;
+}
+
+/* push every cpu's cached pages back into the arenas. must be called with the lock held. */
+static void drain_caches_locked(void) {
+    DEBUG_ASSERT(is_mutex_held(&lock));
+
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        struct pmm_cache* c = &caches[i];
+        struct list_node list = LIST_INITIAL_VALUE(list);
 
-        DEBUG_ASSERT(page_is_free(page));
+        spin_lock_saved_state_t state;
+        spin_lock_irqsave(&c->lock, state);
+        if (c->count > 0)
+            c->drain_count++;
+        vm_page_t* page;
+        while ((page = list_remove_head_type(&c->free_list, vm_page_t, node))) {
+            list_add_tail(&list, &page->node);
+        }
+        c->count = 0;
+        spin_unlock_irqrestore(&c->lock, state);
 
+        free_pages_locked(&list);
+    }
+}
+
+/* allocate up to count pages out of the current cpu's cache, refilling it from the
+ * arenas if it's empty. returns the number of pages added to list.
+ */
+static size_t pmm_cache_alloc(size_t count, struct list_node* list) {
+    spin_lock_saved_state_t state;
+    struct pmm_cache* c = pmm_cache_acquire(&state);
+
+    size_t allocated = 0;
+    while (allocated < count) {
+        vm_page_t* page = list_remove_head_type(&c->free_list, vm_page_t, node);
+        if (!page)
+            break;
+
+        DEBUG_ASSERT(page_is_cached(page));
         page->state = VM_PAGE_STATE_ALLOC;
+        list_add_tail(list, &page->node);
+
+        c->count--;
+        allocated++;
+    }
+    c->alloc_count += allocated;
+    if (allocated > 0)
+        c->hit_count++;
+
+    pmm_cache_release(c, state);
+
+    if (allocated > 0 || count > PMM_CACHE_BATCH)
+        return allocated;
+
+    /* the cache was empty, pull a batch out of the arenas and hand out the first few */
+    struct list_node batch = LIST_INITIAL_VALUE(batch);
+    size_t refilled;
+    {
+        AutoLock al(lock);
+        refilled = alloc_pages_locked(PMM_CACHE_BATCH, PMM_ALLOC_FLAG_ANY, &batch);
+    }
+    if (refilled == 0)
+        return 0;
+
+    while (allocated < count) {
+        vm_page_t* page = list_remove_head_type(&batch, vm_page_t, node);
+        if (!page)
+            break;
+        list_add_tail(list, &page->node);
+        allocated++;
+    }
+
+    c = pmm_cache_acquire(&state);
+
+    vm_page_t* page;
+    while ((page = list_remove_head_type(&batch, vm_page_t, node))) {
+        page->state = VM_PAGE_STATE_CACHED;
+        list_add_tail(&c->free_list, &page->node);
+        c->count++;
+    }
+    c->alloc_count += allocated;
+    c->refill_count++;
 
-        if (pa) {
-            /* compute the physical address of the page based on its offset into the arena */
-            *pa = PAGE_ADDRESS_FROM_ARENA(page, a);
+    pmm_cache_release(c, state);
+
+    return allocated;
+}
+
+vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
+    struct list_node list = LIST_INITIAL_VALUE(list);
+
+    /* only unrestricted allocations can be served out of the cache, since it may hold
+     * pages from any arena */
+    if (alloc_flags == PMM_ALLOC_FLAG_ANY)
+        pmm_cache_alloc(1, &list);
+
+    if (list_is_empty(&list)) {
+        AutoLock al(lock);
+
+        if (alloc_pages_locked(1, alloc_flags, &list) == 0) {
+            /* last ditch, free pages may be stuck in other cpus' caches */
+            drain_caches_locked();
+            alloc_pages_locked(1, alloc_flags, &list);
         }
+    }
 
-        LTRACEF("allocating page %p, pa %#" PRIxPTR "\n", page, PAGE_ADDRESS_FROM_ARENA(page, a));
+    vm_page_t* page = list_remove_head_type(&list, vm_page_t, node);
+    if (!page) {
+        LTRACEF("failed to allocate page\n");
+        return nullptr;
+    }
 
-        return page;
+    if (pa) {
+        *pa = vm_page_to_paddr(page);
     }
 
-    LTRACEF("failed to allocate page\n");
-    return nullptr;
+    LTRACEF("allocating page %p, pa %#" PRIxPTR "\n", page, vm_page_to_paddr(page));
+
+    return page;
 }
 
 size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) {
@@ -147,33 +361,21 @@ size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) {
     /* list must be initialized prior to calling this */
     DEBUG_ASSERT(list);
 
-    uint allocated = 0;
+    size_t allocated = 0;
     if (count == 0)
         return 0;
 
-    AutoLock al(lock);
+    /* small allocations come out of the cache first */
+    if (alloc_flags == PMM_ALLOC_FLAG_ANY)
+        allocated = pmm_cache_alloc(count, list);
 
-    /* walk the arenas in order, allocating as many pages as we can from each */
-    pmm_arena_t* a;
-    list_for_every_entry (&arena_list, a, pmm_arena_t, node) {
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a->flags & PMM_ARENA_FLAG_KMAP) == 0)
-                continue;
-        }
-        while (allocated < count) {
-            vm_page_t* page = list_remove_head_type(&a->free_list, vm_page_t, node);
-            if (!page)
-                return allocated;
+    if (allocated < count) {
+        AutoLock al(lock);
 
-            a->free_count--;
-
-            DEBUG_ASSERT(page_is_free(page));
-
-            page->state = VM_PAGE_STATE_ALLOC;
-            list_add_tail(list, &page->node);
-
-            allocated++;
+        allocated += alloc_pages_locked(count - allocated, alloc_flags, list);
+        if (allocated < count) {
+            drain_caches_locked();
+            allocated += alloc_pages_locked(count - allocated, alloc_flags, list);
         }
     }
 
@@ -191,6 +393,9 @@ size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list) {
 
     AutoLock al(lock);
 
+    /* the range may have pages sitting in the caches */
+    drain_caches_locked();
+
     /* walk through the arenas, looking to see if the physical page belongs to it */
     pmm_arena_t* a;
     list_for_every_entry (&arena_list, a, pmm_arena_t, node) {
@@ -225,16 +430,9 @@ size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list) {
     return allocated;
 }
 
-size_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignment_log2, paddr_t* pa,
-                            struct list_node* list) {
-    LTRACEF("count %zu, align %u\n", count, alignment_log2);
-
-    if (count == 0)
-        return 0;
-    if (alignment_log2 < PAGE_SIZE_SHIFT)
-        alignment_log2 = PAGE_SIZE_SHIFT;
-
-    AutoLock al(lock);
+static size_t alloc_contiguous_locked(size_t count, uint alloc_flags, uint8_t alignment_log2,
+                                      paddr_t* pa, struct list_node* list) {
+    DEBUG_ASSERT(is_mutex_held(&lock));
 
     pmm_arena_t* a;
     list_for_every_entry (&arena_list, a, pmm_arena_t, node) {
@@ -300,6 +498,31 @@ size_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignment_lo
         }
     }
 
+    return 0;
+}
+
+size_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignment_log2, paddr_t* pa,
+                            struct list_node* list) {
+    LTRACEF("count %zu, align %u\n", count, alignment_log2);
+
+    if (count == 0)
+        return 0;
+    if (alignment_log2 < PAGE_SIZE_SHIFT)
+        alignment_log2 = PAGE_SIZE_SHIFT;
+
+    AutoLock al(lock);
+
+    size_t allocated = alloc_contiguous_locked(count, alloc_flags, alignment_log2, pa, list);
+    if (allocated > 0)
+        return allocated;
+
+    /* cached pages may be breaking up the runs, put them back and try again */
+    drain_caches_locked();
+
+    allocated = alloc_contiguous_locked(count, alloc_flags, alignment_log2, pa, list);
+    if (allocated > 0)
+        return allocated;
+
     LTRACEF("couldn't find run\n");
     return 0;
 }
@@ -377,27 +600,52 @@ size_t pmm_free(struct list_node* list) {
 
     DEBUG_ASSERT(list);
 
-    AutoLock al(lock);
+    struct list_node drain = LIST_INITIAL_VALUE(drain);
+    size_t count = 0;
 
-    uint count = 0;
-    while (!list_is_empty(list)) {
-        vm_page_t* page = list_remove_head_type(list, vm_page_t, node);
+    /* stuff as many pages as will fit into the current cpu's cache */
+    spin_lock_saved_state_t state;
+    struct pmm_cache* c = pmm_cache_acquire(&state);
 
+    vm_page_t* page;
+    while (c->count < PMM_CACHE_MAX &&
+           (page = list_remove_head_type(list, vm_page_t, node))) {
         DEBUG_ASSERT(!list_in_list(&page->node));
-        DEBUG_ASSERT(!page_is_free(page));
+        DEBUG_ASSERT(!page_is_free(page) && !page_is_cached(page));
 
-        /* see which arena this page belongs to and add it */
-        pmm_arena_t* a;
-        list_for_every_entry (&arena_list, a, pmm_arena_t, node) {
-            if (PAGE_BELONGS_TO_ARENA(page, a)) {
-                page->state = VM_PAGE_STATE_FREE;
+        page->state = VM_PAGE_STATE_CACHED;
+        list_add_head(&c->free_list, &page->node);
+        c->count++;
+        count++;
+    }
 
-                list_add_head(&a->free_list, &page->node);
-                a->free_count++;
-                count++;
+    /* if the cache filled up, send the coldest batch back to the arenas along with the
+     * rest of the list so the next few frees have somewhere to go */
+    bool overflow = !list_is_empty(list);
+    if (overflow) {
+        for (size_t i = 0; i < PMM_CACHE_BATCH; i++) {
+            page = list_remove_tail_type(&c->free_list, vm_page_t, node);
+            if (!page)
                 break;
-            }
+            list_add_tail(&drain, &page->node);
+            c->count--;
         }
+        c->drain_count++;
+    }
+    c->free_count += count;
+
+    pmm_cache_release(c, state);
+
+    if (overflow) {
+        AutoLock al(lock);
+
+        size_t freed = free_pages_locked(list);
+        free_pages_locked(&drain);
+        count += freed;
+
+        c = pmm_cache_acquire(&state);
+        c->free_count += freed;
+        pmm_cache_release(c, state);
     }
 
     return count;
@@ -420,6 +668,8 @@ static const char* page_state_to_str(const vm_page_t* page) {
         return "alloc";
     case VM_PAGE_STATE_MMU:
         return "mmu";
+    case VM_PAGE_STATE_CACHED:
+        return "cached";
     default:
         return "unknown";
     }
@@ -467,6 +717,18 @@ static void dump_arena(const pmm_arena_t* arena, bool dump_pages) {
     }
 }
 
+static void dump_caches(void) {
+    printf("cpu   cached       allocs        frees         hits      refills       drains\n");
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        const struct pmm_cache* c = &caches[i];
+        if (c->alloc_count == 0 && c->free_count == 0)
+            continue;
+        printf("%3u %8zu %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+               i, c->count, c->alloc_count, c->free_count, c->hit_count, c->refill_count,
+               c->drain_count);
+    }
+}
+
 static int cmd_pmm(int argc, const cmd_args* argv) {
     if (argc < 2) {
     notenoughargs:
@@ -474,6 +736,8 @@ static int cmd_pmm(int argc, const cmd_args* argv) {
     usage:
         printf("usage:\n");
         printf("%s arenas\n", argv[0].str);
+        printf("%s caches\n", argv[0].str);
+        printf("%s drain_caches\n", argv[0].str);
         printf("%s alloc <count>\n", argv[0].str);
         printf("%s alloc_range <address> <count>\n", argv[0].str);
         printf("%s alloc_kpages <count>\n", argv[0].str);
@@ -488,6 +752,11 @@ static int cmd_pmm(int argc, const cmd_args* argv) {
     if (!strcmp(argv[1].str, "arenas")) {
         pmm_arena_t* a;
         list_for_every_entry (&arena_list, a, pmm_arena_t, node) { dump_arena(a, false); }
+    } else if (!strcmp(argv[1].str, "caches")) {
+        dump_caches();
+    } else if (!strcmp(argv[1].str, "drain_caches")) {
+        AutoLock al(lock);
+        drain_caches_locked();
     } else if (!strcmp(argv[1].str, "alloc")) {
         if (argc < 3)
             goto notenoughargs;
@@ -22,5 +22,7 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/vm_region.cpp \
     $(LOCAL_DIR)/vmm.cpp \
     $(LOCAL_DIR)/vm_unittest.cpp \
+    $(LOCAL_DIR)/zero_pool.cpp \
+    $(LOCAL_DIR)/zero_scan.cpp \
 
 include make/module.mk
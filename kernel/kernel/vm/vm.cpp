@@ -33,6 +33,14 @@ extern int __data_end;
 extern int __bss_start;
 extern int __bss_end;
 
+// a single page of zeros, mapped read-only to satisfy read faults on uncommitted pages
+static vm_page_t* zero_page;
+
+vm_page_t* vm_get_zero_page(void) {
+    DEBUG_ASSERT(zero_page);
+    return zero_page;
+}
+
 // mark the physical pages backing a range of virtual as in use.
 // allocate the physical pages and throw them away
 static void mark_pages_in_use(vaddr_t va, size_t len) {
@@ -78,6 +86,12 @@ void vm_init_preheap(uint level) {
 
         mark_pages_in_use(boot_alloc_start, boot_alloc_end - boot_alloc_start);
     }
+
+    // set up the shared zero page
+    paddr_t pa;
+    zero_page = pmm_alloc_page(0, &pa);
+    ASSERT(zero_page);
+    memset(paddr_to_kvaddr(pa), 0, PAGE_SIZE);
 }
 
 void vm_init_postheap(uint level) {
@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <trace.h>
+#include <mxtl/array.h>
 #include <mxtl/auto_call.h>
 #include <mxtl/intrusive_double_list.h>
 #include <mxtl/type_support.h>
@@ -163,6 +164,26 @@ mxtl::RefPtr<VmAspace> VmAspace::Create(uint32_t flags, const char* name) {
     return mxtl::move(aspace);
 }
 
+int VmAspace::MmuMap(vaddr_t vaddr, paddr_t paddr, size_t count, uint mmu_flags) {
+    AutoLock a(mmu_lock_);
+    return arch_mmu_map(&arch_aspace_, vaddr, paddr, count, mmu_flags);
+}
+
+int VmAspace::MmuUnmap(vaddr_t vaddr, size_t count) {
+    AutoLock a(mmu_lock_);
+    return arch_mmu_unmap(&arch_aspace_, vaddr, count);
+}
+
+int VmAspace::MmuProtect(vaddr_t vaddr, size_t count, uint mmu_flags) {
+    AutoLock a(mmu_lock_);
+    return arch_mmu_protect(&arch_aspace_, vaddr, count, mmu_flags);
+}
+
+status_t VmAspace::MmuQuery(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) {
+    AutoLock a(mmu_lock_);
+    return arch_mmu_query(&arch_aspace_, vaddr, paddr, mmu_flags);
+}
+
 void VmAspace::Rename(const char* name) {
     DEBUG_ASSERT(magic_ == MAGIC);
     strlcpy(name_, name ? name : "unnamed", sizeof(name_));
@@ -314,6 +335,47 @@ not_found:
     return true; // not_found: stop search
 }
 
+// search the subtree rooted at node for the first gap, in address order, that can hold a
+// region of the given size. the regions' gap summaries let us skip any subtree whose gaps
+// are all too small, so only gaps that could fit are handed to CheckGap. returns true if
+// the search should stop, with the result in *pva as with CheckGap.
+bool VmAspace::FindSpotInSubtree(const RegionTree::iterator& node, vaddr_t* pva, vaddr_t align,
+                                 size_t size, uint arch_mmu_flags,
+                                 RegionTree::iterator* after) {
+    if (!node.IsValid() || node->subtree_max_gap() < size)
+        return false;
+
+    // gaps within the left subtree come first
+    auto left = node.left();
+    if (FindSpotInSubtree(left, pva, align, size, arch_mmu_flags, after))
+        return true;
+
+    // then the gap between the left subtree and this region
+    if (left.IsValid() && node->base() - left->subtree_last() - 1 >= size) {
+        auto prev = node;
+        --prev;
+        if (CheckGap(prev, node, pva, align, size, arch_mmu_flags)) {
+            *after = node;
+            return true;
+        }
+    }
+
+    // then the gap between this region and the right subtree
+    auto right = node.right();
+    vaddr_t last = node->base() + node->size() - 1;
+    if (right.IsValid() && right->subtree_base() - last - 1 >= size) {
+        auto next = node;
+        ++next;
+        if (CheckGap(node, next, pva, align, size, arch_mmu_flags)) {
+            *after = next;
+            return true;
+        }
+    }
+
+    // and finally the gaps within the right subtree
+    return FindSpotInSubtree(right, pva, align, size, arch_mmu_flags, after);
+}
+
 // search for a spot to allocate for a region of a given size, returning an
 // iterator to the region after it in the list.
 vaddr_t VmAspace::AllocSpot(size_t size, uint8_t align_pow2, uint arch_mmu_flags,
@@ -328,22 +390,27 @@ vaddr_t VmAspace::AllocSpot(size_t size, uint8_t align_pow2, uint arch_mmu_flags
     vaddr_t align = 1UL << align_pow2;
 
     vaddr_t spot;
-
-    // Find the first gap in the address space which can contain a region of the requested size.
-    auto before_iter = regions_.end();
-    auto after_iter  = regions_.begin();
-    do {
-        if (CheckGap(before_iter, after_iter, &spot, align, size, arch_mmu_flags)) {
-            if (after)
-                *after = after_iter;
-            return spot;
+    RegionTree::iterator after_iter;
+
+    // Find the first gap in the address space which can contain a region of the requested
+    // size: the gap before the first region, any gap between two regions, then the gap
+    // after the last region.
+    if (CheckGap(regions_.end(), regions_.begin(), &spot, align, size, arch_mmu_flags)) {
+        after_iter = regions_.begin();
+    } else if (!FindSpotInSubtree(regions_.root(), &spot, align, size, arch_mmu_flags,
+                                  &after_iter)) {
+        auto last = regions_.end();
+        --last;
+        after_iter = regions_.end();
+        if (!CheckGap(last, after_iter, &spot, align, size, arch_mmu_flags)) {
+            // couldn't find anything
+            spot = -1;
         }
+    }
 
-        before_iter = after_iter++;
-    } while (before_iter.IsValid());
-
-    // couldn't find anything
-    return -1;
+    if (after)
+        *after = after_iter;
+    return spot;
 }
 
 // allocate a region and insert it into the list
@@ -450,19 +517,22 @@ status_t VmAspace::MapObject(mxtl::RefPtr<VmObject> vmo, const char* name, uint6
             return ERR_INVALID_ARGS;
     }
 
-    // hold the vmm lock for the rest of the function
-    AutoLock a(lock_);
+    mxtl::RefPtr<VmRegion> r;
+    {
+        AutoLock a(lock_);
 
-    // allocate a region and put it in the aspace list
-    auto r = AllocRegion(name, size, vaddr, align_pow2, vmm_flags, arch_mmu_flags);
-    if (!r) {
-        return ERR_NO_MEMORY;
-    }
+        // allocate a region and put it in the aspace list
+        r = AllocRegion(name, size, vaddr, align_pow2, vmm_flags, arch_mmu_flags);
+        if (!r) {
+            return ERR_NO_MEMORY;
+        }
 
-    // associate the vm object with it
-    r->SetObject(mxtl::move(vmo), offset);
+        // associate the vm object with it
+        r->SetObject(mxtl::move(vmo), offset);
+    }
 
-    // if we're committing it, map the region now
+    // if we're committing it, map the region now. this may have to wait for a pager, so it
+    // is done without the aspace lock; the object's lock keeps the mapping consistent.
     if (vmm_flags & VMM_FLAG_COMMIT) {
         auto err = r->MapRange(0, size, true);
         if (err < 0)
@@ -499,7 +569,7 @@ status_t VmAspace::ReserveSpace(const char* name, size_t size, vaddr_t vaddr) {
 
     // lookup how it's already mapped
     uint arch_mmu_flags = 0;
-    auto err = arch_mmu_query(&arch_aspace_, vaddr, nullptr, &arch_mmu_flags);
+    auto err = MmuQuery(vaddr, nullptr, &arch_mmu_flags);
     if (err) {
         // if it wasn't already mapped, use some sort of strict default
         arch_mmu_flags = ARCH_MMU_FLAG_CACHED | ARCH_MMU_FLAG_PERM_READ;
@@ -673,16 +743,31 @@ status_t VmAspace::PageFault(vaddr_t va, uint flags) {
     DEBUG_ASSERT(magic_ == MAGIC);
     LTRACEF("va %#" PRIxPTR ", flags %#x\n", va, flags);
 
-    // for now, hold the aspace lock across the page fault operation,
-    // which stops any other operations on the address space from moving
-    // the region out from underneath it
-    AutoLock a(lock_);
+    for (;;) {
+        VmPageRequest req = {};
+        {
+            // hold the aspace lock across the page fault operation, which stops any other
+            // operations on the address space from moving the region out from underneath it
+            AutoLock a(lock_);
 
-    auto r = FindRegionLocked(va);
-    if (unlikely(!r))
-        return ERR_NOT_FOUND;
+            auto r = FindRegionLocked(va);
+            if (unlikely(!r))
+                return ERR_NOT_FOUND;
+
+            status_t status = r->PageFault(va, flags, &req);
+            if (status != ERR_SHOULD_WAIT)
+                return status;
+        }
 
-    return r->PageFault(va, flags);
+        // wait for the pager without the aspace lock, so a slow pager doesn't stall every
+        // other thread using the address space, then look the region up again since it may
+        // have changed in the meantime
+        status_t status = VmObject::WaitForPage(&req);
+        if (status != NO_ERROR) {
+            TRACEF("ERROR: pager failed to supply page at va %#" PRIxPTR ": %d\n", va, status);
+            return status;
+        }
+    }
 }
 
 void VmAspace::Dump() const {
@@ -698,6 +783,60 @@ void VmAspace::Dump() const {
     }
 }
 
+static int object_ptr_cmp(const void* a, const void* b) {
+    uintptr_t pa = reinterpret_cast<uintptr_t>(*static_cast<VmObject* const*>(a));
+    uintptr_t pb = reinterpret_cast<uintptr_t>(*static_cast<VmObject* const*>(b));
+    return (pa > pb) - (pa < pb);
+}
+
+status_t VmAspace::GetUsage(Usage* usage) const {
+    DEBUG_ASSERT(magic_ == MAGIC);
+
+    // snapshot the mapped objects, holding a reference to each, so that they can be sorted
+    // and counted once each without holding the aspace lock. the array is allocated with
+    // the lock dropped, so retry if regions were added in the meantime.
+    mxtl::Array<VmObject*> objects;
+    size_t count = 0;
+    for (;;) {
+        size_t max_count;
+        {
+            AutoLock a(lock_);
+            max_count = regions_.size();
+        }
+
+        AllocChecker ac;
+        objects.reset(new (&ac) VmObject*[max_count], max_count);
+        if (!ac.check())
+            return ERR_NO_MEMORY;
+
+        AutoLock a(lock_);
+        if (regions_.size() > max_count)
+            continue;
+
+        *usage = {};
+        for (const auto& r : regions_) {
+            usage->mapped_bytes += r.size();
+            usage->resident_bytes += r.resident_pages() * PAGE_SIZE;
+            if (r.object())
+                objects[count++] = r.object_ref().leak_ref();
+        }
+        break;
+    }
+
+    // an object mapped more than once only counts for its first region
+    qsort(objects.get(), count, sizeof(objects[0]), object_ptr_cmp);
+    for (size_t i = 0; i < count; i++) {
+        if (i == 0 || objects[i] != objects[i - 1])
+            usage->committed_bytes += objects[i]->committed_pages() * PAGE_SIZE;
+    }
+
+    // drop the snapshot's references
+    for (size_t i = 0; i < count; i++)
+        mxtl::internal::MakeRefPtrNoAdopt(objects[i]);
+
+    return NO_ERROR;
+}
+
 void DumpAllAspaces() {
     AutoLock a(aspace_list_lock);
 
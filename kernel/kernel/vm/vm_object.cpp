@@ -11,6 +11,7 @@
 #include <err.h>
 #include <inttypes.h>
 #include <kernel/auto_lock.h>
+#include <kernel/lockstat.h>
 #include <kernel/vm.h>
 #include <lib/user_copy.h>
 #include <new.h>
@@ -20,6 +21,20 @@
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+// how long a thread waits for a pager to supply a page before giving up on it, and how
+// often it checks in the meantime whether the pager has gone away
+static const lk_time_t kPageRequestTimeout = 30000;
+static const lk_time_t kPageRequestPollInterval = 1000;
+
+// list of all vm objects, for the zero page scanner
+static mutex_t vmo_list_lock = MUTEX_INITIAL_VALUE(vmo_list_lock);
+static mxtl::DoublyLinkedList<VmObject*> vmos;
+
+#if WITH_LOCK_STATS
+LOCK_CLASS_STATIC(vmo_list_lock_class, "vmo_list_lock", LOCK_CLASS_MUTEX, &vmo_list_lock);
+LOCK_CLASS(vmo_lock_class, "VmObject::lock_", LOCK_CLASS_MUTEX);
+#endif
+
 static void ZeroPage(paddr_t pa) {
     void* ptr = paddr_to_kvaddr(pa);
     DEBUG_ASSERT(ptr);
@@ -27,11 +42,6 @@ static void ZeroPage(paddr_t pa) {
     memset(ptr, 0, PAGE_SIZE);
 }
 
-static void ZeroPage(vm_page_t* p) {
-    paddr_t pa = vm_page_to_paddr(p);
-    ZeroPage(pa);
-}
-
 static size_t OffsetToIndex(uint64_t offset) {
     uint64_t index64 = offset / PAGE_SIZE;
 
@@ -40,15 +50,39 @@ static size_t OffsetToIndex(uint64_t offset) {
     return static_cast<size_t>(index64);
 }
 
+static bool IsZeroPage(vm_page_t* p) {
+    const uint64_t* ptr = static_cast<const uint64_t*>(paddr_to_kvaddr(vm_page_to_paddr(p)));
+    DEBUG_ASSERT(ptr);
+
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+        if (ptr[i] != 0)
+            return false;
+    }
+    return true;
+}
+
 VmObject::VmObject(uint32_t pmm_alloc_flags)
     : pmm_alloc_flags_(pmm_alloc_flags) {
     LTRACEF("%p\n", this);
+
+#if WITH_LOCK_STATS
+    mutex_set_lock_class(&lock_, &vmo_lock_class);
+#endif
+
+    AutoLock a(vmo_list_lock);
+    vmos.push_back(this);
 }
 
 VmObject::~VmObject() {
     DEBUG_ASSERT(magic_ == MAGIC);
     LTRACEF("%p\n", this);
 
+    // get off the global list first so the scanner can't find us while we're torn down
+    {
+        AutoLock a(vmo_list_lock);
+        vmos.erase(*this);
+    }
+
     list_node list;
     list_initialize(&list);
 
@@ -70,10 +104,20 @@ VmObject::~VmObject() {
     }
 
     DEBUG_ASSERT(list_length(&page_list_) == 0);
+    DEBUG_ASSERT(mapping_list_.is_empty());
+    DEBUG_ASSERT(num_children_ == 0);
+    DEBUG_ASSERT(list_is_empty(&page_requests_));
 
     __UNUSED auto freed = pmm_free(&list);
     DEBUG_ASSERT(freed == count);
 
+    // drop our claim on the parent's pages
+    if (parent_) {
+        AutoLock a(parent_->lock_);
+        DEBUG_ASSERT(parent_->num_children_ > 0);
+        parent_->num_children_--;
+    }
+
     // clear our magic value
     magic_ = 0;
 }
@@ -99,19 +143,334 @@ mxtl::RefPtr<VmObject> VmObject::Create(uint32_t pmm_alloc_flags, uint64_t size)
     return vmo;
 }
 
+mxtl::RefPtr<VmObject> VmObject::CreatePaged(mxtl::RefPtr<VmPageSource> source, uint64_t size) {
+    DEBUG_ASSERT(source);
+
+    auto vmo = Create(PMM_ALLOC_FLAG_ANY, size);
+    if (!vmo)
+        return nullptr;
+
+    vmo->source_ = mxtl::move(source);
+    vmo->paged_ = true;
+
+    return vmo;
+}
+
+mxtl::RefPtr<VmObject> VmObject::CloneCOW(uint64_t offset, uint64_t size) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    LTRACEF("vmo %p offset %#" PRIx64 " size %#" PRIx64 "\n", this, offset, size);
+
+    if (!IS_PAGE_ALIGNED(offset))
+        return nullptr;
+
+    auto vmo = Create(pmm_alloc_flags_, size);
+    if (!vmo)
+        return nullptr;
+
+    AutoLock a(lock_);
+
+    MergeParentLocked();
+
+    // the clone isn't visible to anyone else yet, so it's safe to set it up without its lock
+    vmo->paged_ = paged_;
+
+    // the pager owns the contents of a pager-backed object, so clones look through to it
+    // like a file and only copy the pages written through them
+    if (source_) {
+        vmo->parent_ = mxtl::RefPtr<VmObject>(this);
+        vmo->parent_offset_ = offset;
+        num_children_++;
+        return vmo;
+    }
+
+    // pages whose physical addresses have been handed out have to stay put, and the kernel
+    // may touch its mappings in places it can't take a write fault, so copy the range into
+    // the clone up front in either case
+    bool copy = pages_pinned_;
+    for (const auto& r : mapping_list_) {
+        if (!r.aspace().is_user())
+            copy = true;
+    }
+    if (copy) {
+        // there's no waiting for the pager with the lock held
+        if (paged_)
+            return nullptr;
+
+        return (CopyRangeLocked(vmo.get(), offset) == NO_ERROR) ? vmo : nullptr;
+    }
+
+    // with nothing of our own to share, the clone can look straight through to whatever we
+    // do, as long as it doesn't see past our end
+    uint64_t end = offset + size;
+    if (committed_pages_ == 0 && end >= offset && end <= size_) {
+        if (parent_) {
+            vmo->parent_offset_ = parent_offset_ + offset;
+            if (vmo->parent_offset_ < offset)
+                return nullptr;
+
+            // locks are always acquired from child to parent
+            AutoLock pa(parent_->lock_);
+            vmo->parent_ = parent_;
+            parent_->num_children_++;
+        }
+        return vmo;
+    }
+
+    // move our pages into a hidden object, and make it the parent of both us and the clone.
+    // it takes our place under our own parent, if we have one.
+    auto hidden = Create(pmm_alloc_flags_, size_);
+    if (!hidden)
+        return nullptr;
+
+    {
+        AutoLock ha(hidden->lock_);
+
+        for (size_t index = 0; index < page_array_.size(); index++) {
+            vm_page_t* p = page_array_[index];
+            if (!p)
+                continue;
+
+            page_array_[index] = nullptr;
+            list_delete(&p->node);
+            committed_pages_--;
+            hidden->AddPageToArray(index, p);
+        }
+        DEBUG_ASSERT(committed_pages_ == 0);
+
+        hidden->hidden_ = true;
+        hidden->paged_ = paged_;
+        hidden->parent_ = mxtl::move(parent_);
+        hidden->parent_offset_ = parent_offset_;
+        hidden->num_children_ = 2;
+    }
+
+    LTRACEF("vmo %p moved %zu pages to hidden vmo %p\n", this, hidden->committed_pages_,
+            hidden.get());
+
+    parent_ = hidden;
+    parent_offset_ = 0;
+    vmo->parent_ = mxtl::move(hidden);
+    vmo->parent_offset_ = offset;
+
+    // all of our pages are shared with the clone now, so writes through our mappings have
+    // to fault and copy them first
+    for (auto& r : mapping_list_) {
+        r.WriteProtectObjectRangeLocked(0, size_);
+    }
+    shared_pages_mapped_ = true;
+
+    return vmo;
+}
+
+status_t VmObject::CopyRangeLocked(VmObject* clone, uint64_t offset) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    DEBUG_ASSERT(is_mutex_held(&lock_));
+
+    // the clone isn't visible to anyone else yet, so this can't deadlock
+    AutoLock a(clone->lock_);
+
+    for (size_t index = 0; index < clone->page_array_.size(); index++) {
+        uint64_t o = offset + index * PAGE_SIZE;
+        if (o < offset || o >= size_)
+            break;
+
+        vm_page_t* src = GetPageLocked(o);
+        if (!src)
+            src = GetPageFromParentLocked(o);
+        if (!src)
+            continue;
+
+        paddr_t pa;
+        vm_page_t* p = pmm_alloc_page(pmm_alloc_flags_, &pa);
+        if (!p)
+            return ERR_NO_MEMORY;
+
+        memcpy(paddr_to_kvaddr(pa), paddr_to_kvaddr(vm_page_to_paddr(src)), PAGE_SIZE);
+        clone->AddPageToArray(index, p);
+    }
+
+    return NO_ERROR;
+}
+
+void VmObject::AddMapping(VmRegion* r) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    AutoLock a(lock_);
+
+    mapping_list_.push_front(r);
+}
+
+void VmObject::RemoveMapping(VmRegion* r) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    AutoLock a(lock_);
+
+    // the region detaches itself when it's unmapped and again when it's destroyed
+    if (VmRegionObjectListTraits::node_state(*r).InContainer())
+        mapping_list_.erase(*r);
+}
+
+void VmObject::RangeChangeUpdateLocked(uint64_t offset, uint64_t len) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    DEBUG_ASSERT(is_mutex_held(&lock_));
+
+    for (auto& r : mapping_list_) {
+        r.UnmapObjectRangeLocked(offset, len);
+    }
+}
+
+void VmObject::MergeParentLocked() {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    DEBUG_ASSERT(is_mutex_held(&lock_));
+
+    if (!parent_ || !parent_->hidden_)
+        return;
+
+    mxtl::RefPtr<VmObject> hidden;
+    {
+        // locks are always acquired from child to parent
+        AutoLock a(parent_->lock_);
+
+        if (parent_->num_children_ != 1)
+            return;
+
+        LTRACEF("vmo %p merging hidden parent %p\n", this, parent_.get());
+
+        // the pages we can see and haven't copied become ours. they stay mapped read-only
+        // until the next write fault notices they're owned now.
+        for (size_t index = 0; index < page_array_.size(); index++) {
+            uint64_t o = parent_offset_ + index * PAGE_SIZE;
+            if (o < parent_offset_ || o >= parent_->size_)
+                break;
+
+            size_t parent_index = OffsetToIndex(o);
+            vm_page_t* p = parent_->page_array_[parent_index];
+            if (!p || page_array_[index])
+                continue;
+
+            parent_->page_array_[parent_index] = nullptr;
+            list_delete(&p->node);
+            parent_->committed_pages_--;
+            AddPageToArray(index, p);
+        }
+
+        // the hidden object can only be dropped from the chain if we don't see past its end,
+        // since whatever is beyond it reads as zero rather than coming from its parent
+        uint64_t end = parent_offset_ + size_;
+        uint64_t grandparent_offset = parent_offset_ + parent_->parent_offset_;
+        if (parent_->parent_ &&
+            (end < parent_offset_ || end > parent_->size_ || grandparent_offset < parent_offset_))
+            return;
+
+        // take its place under its parent, if it has one. the rest of its pages were only
+        // visible to the clones that are gone, and are freed along with it.
+        hidden = mxtl::move(parent_);
+        parent_ = mxtl::move(hidden->parent_);
+        parent_offset_ = parent_ ? grandparent_offset : 0;
+        hidden->num_children_ = 0;
+    }
+}
+
+size_t VmObject::ScanForZeroPages(bool reclaim) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    AutoLock a(lock_);
+
+    MergeParentLocked();
+
+    // clones may have our pages mapped, and we can't see their mappings to fix them up.
+    // a clone's own zero pages can't go either, since that would expose the parent's.
+    // missing pages of a pager-backed object don't read as zero.
+    if (parent_ || num_children_ > 0 || pages_pinned_ || source_)
+        return 0;
+
+    // the kernel may touch its mappings in places it can't take a fault
+    for (const auto& r : mapping_list_) {
+        if (!r.aspace().is_user())
+            return 0;
+    }
+
+    size_t count = 0;
+    for (size_t index = 0; index < page_array_.size(); index++) {
+        vm_page_t* p = page_array_[index];
+        if (!p || !IsZeroPage(p))
+            continue;
+
+        count++;
+        if (!reclaim)
+            continue;
+
+        // pull the page out of every mapping before looking at it again, since it may have
+        // been written through a mapping since the first check. after this any access
+        // faults and blocks on our lock.
+        uint64_t offset = index * PAGE_SIZE;
+        RangeChangeUpdateLocked(offset, PAGE_SIZE);
+        if (!IsZeroPage(p)) {
+            count--;
+            continue;
+        }
+
+        LTRACEF("reclaiming zero page %p at offset %#" PRIx64 "\n", p, offset);
+
+        page_array_[index] = nullptr;
+        list_delete(&p->node);
+        committed_pages_--;
+        pmm_free_page(p);
+    }
+
+    return count;
+}
+
+// Returns a reference to the first object on the global list after prev (or the first one,
+// if prev is null) that isn't already being destroyed, or null at the end of the list.
+static mxtl::RefPtr<VmObject> NextVmObject(VmObject* prev) {
+    AutoLock a(vmo_list_lock);
+
+    // prev is kept alive by the caller's reference, so it's still on the list
+    auto iter = prev ? ++vmos.make_iterator(*prev) : vmos.begin();
+    for (; iter != vmos.end(); ++iter) {
+        // an object whose last reference is gone stays on the list until its destructor
+        // gets the list lock, so skip it instead of resurrecting it
+        if (iter->AddRefMaybeInDestructor())
+            return mxtl::internal::MakeRefPtrNoAdopt(&*iter);
+    }
+    return nullptr;
+}
+
+size_t VmObject::ScanAllForZeroPages(bool reclaim) {
+    // hold a reference to each object while scanning it instead of holding the list lock
+    // across the whole scan, so object creation and destruction elsewhere in the system
+    // only ever wait for a single list step
+    size_t count = 0;
+    for (auto vmo = NextVmObject(nullptr); vmo; vmo = NextVmObject(vmo.get())) {
+        count += vmo->ScanForZeroPages(reclaim);
+    }
+
+    return count;
+}
+
 void VmObject::Dump() {
     DEBUG_ASSERT(magic_ == MAGIC);
 
     size_t count = 0;
+    size_t mappings = 0;
+    uint32_t children;
     {
         AutoLock a(lock_);
         for (size_t i = 0; i < page_array_.size(); i++) {
             if (page_array_[i])
                 count++;
         }
+        DEBUG_ASSERT(count == committed_pages_);
+        for (const auto& r : mapping_list_) {
+            (void)r;
+            mappings++;
+        }
+        children = num_children_;
+    }
+    printf("\t\tobject %p: ref %u size %#" PRIx64 ", %zu allocated pages, %zu mappings\n",
+           this, ref_count_debug(), size_, count, mappings);
+    if (parent_ || children) {
+        printf("\t\t\tparent %p offset %#" PRIx64 ", %u clones\n",
+               parent_.get(), parent_offset_, children);
     }
-    printf("\t\tobject %p: ref %u size %#" PRIx64 ", %zu allocated pages\n",
-           this, ref_count_debug(), size_, count);
 }
 
 status_t VmObject::Resize(uint64_t s) {
@@ -157,6 +516,7 @@ void VmObject::AddPageToArray(size_t index, vm_page_t* p) {
 
     DEBUG_ASSERT(!list_in_list(&p->node));
     list_add_tail(&page_list_, &p->node);
+    committed_pages_++;
 }
 
 status_t VmObject::AddPage(vm_page_t* p, uint64_t offset) {
@@ -175,11 +535,15 @@ status_t VmObject::AddPage(vm_page_t* p, uint64_t offset) {
 
     AddPageToArray(index, p);
 
+    // we don't know where this page came from, so never give it to the pmm
+    pages_pinned_ = true;
+
     return NO_ERROR;
 }
 
 vm_page_t* VmObject::GetPageLocked(uint64_t offset) {
     DEBUG_ASSERT(magic_ == MAGIC);
+    DEBUG_ASSERT(is_mutex_held(&lock_));
 
     if (offset >= size_)
         return nullptr;
@@ -196,13 +560,174 @@ vm_page_t* VmObject::GetPage(uint64_t offset) {
     return GetPageLocked(offset);
 }
 
-vm_page_t* VmObject::FaultPageLocked(uint64_t offset, uint pf_flags) {
+vm_page_t* VmObject::GetPageFromParentLocked(uint64_t offset) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    DEBUG_ASSERT(is_mutex_held(&lock_));
+
+    if (!parent_)
+        return nullptr;
+
+    uint64_t parent_offset = parent_offset_ + offset;
+    if (parent_offset < offset)
+        return nullptr; // wrapped, so off the end of the parent
+
+    // locks are always acquired from child to parent
+    AutoLock a(parent_->lock_);
+
+    // anything past the end of the parent reads as zero
+    if (parent_offset >= parent_->size_)
+        return nullptr;
+
+    vm_page_t* p = parent_->GetPageLocked(parent_offset);
+    if (p)
+        return p;
+
+    return parent_->GetPageFromParentLocked(parent_offset);
+}
+
+void VmObject::InitPageLocked(vm_page_t* p, uint64_t offset, bool zeroed) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    DEBUG_ASSERT(is_mutex_held(&lock_));
+
+    paddr_t pa = vm_page_to_paddr(p);
+
+    vm_page_t* src = GetPageFromParentLocked(offset);
+    if (!src) {
+        // TODO: remove once pmm returns zeroed pages
+        if (!zeroed)
+            ZeroPage(pa);
+        return;
+    }
+
+    LTRACEF("copying page %p into %p for offset %#" PRIx64 "\n", src, p, offset);
+
+    void* dst_ptr = paddr_to_kvaddr(pa);
+    void* src_ptr = paddr_to_kvaddr(vm_page_to_paddr(src));
+    DEBUG_ASSERT(dst_ptr && src_ptr);
+
+    memcpy(dst_ptr, src_ptr, PAGE_SIZE);
+}
+
+status_t VmObject::QueuePageRequestLocked(uint64_t offset, VmPageRequest* req) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    DEBUG_ASSERT(is_mutex_held(&lock_));
+
+    // past the end of the object, so it reads as zero
+    if (offset >= size_)
+        return NO_ERROR;
+
+    if (page_array_[OffsetToIndex(offset)])
+        return NO_ERROR;
+
+    if (!source_) {
+        if (!parent_)
+            return NO_ERROR;
+
+        uint64_t parent_offset = parent_offset_ + offset;
+        if (parent_offset < offset)
+            return NO_ERROR;
+
+        // locks are always acquired from child to parent
+        AutoLock a(parent_->lock_);
+        return parent_->QueuePageRequestLocked(parent_offset, req);
+    }
+
+    uint64_t page_offset = ROUNDDOWN(offset, PAGE_SIZE);
+
+    // only the first thread to wait on a page asks the pager for it
+    bool requested = false;
+    VmPageRequest* r;
+    list_for_every_entry (&page_requests_, r, VmPageRequest, node) {
+        if (r->offset == page_offset) {
+            requested = true;
+            break;
+        }
+    }
+    if (!requested) {
+        status_t status = source_->RequestPage(page_offset);
+        if (status != NO_ERROR)
+            return status;
+    }
+
+    LTRACEF("vmo %p waiting for page at offset %#" PRIx64 "\n", this, page_offset);
+
+    req->offset = page_offset;
+    req->status = ERR_SHOULD_WAIT;
+    req->object = mxtl::RefPtr<VmObject>(this);
+    event_init(&req->event, false, 0);
+    list_add_tail(&page_requests_, &req->node);
+
+    return ERR_SHOULD_WAIT;
+}
+
+status_t VmObject::WaitForPage(VmPageRequest* req) {
+    DEBUG_ASSERT(req->object && req->object->source_);
+    VmObject* object = req->object.get();
+
+    // wait in slices, checking in between whether the pager is still around
+    status_t status;
+    lk_time_t waited = 0;
+    for (;;) {
+        status = event_wait_timeout(&req->event, kPageRequestPollInterval, true);
+        if (status != ERR_TIMED_OUT)
+            break;
+
+        if (object->source_->IsClosed()) {
+            status = ERR_REMOTE_CLOSED;
+            break;
+        }
+
+        waited += kPageRequestPollInterval;
+        if (waited >= kPageRequestTimeout)
+            break;
+    }
+
+    {
+        AutoLock a(object->lock_);
+
+        // if we gave up, take the request off the queue, unless it was completed in the
+        // meantime, in which case it keeps the status it was completed with
+        if (list_in_list(&req->node)) {
+            LTRACEF("vmo %p gave up waiting for page at offset %#" PRIx64 ": %d\n",
+                    object, req->offset, status);
+            list_delete(&req->node);
+            req->status = status;
+        }
+    }
+
+    event_destroy(&req->event);
+    req->object.reset();
+
+    return req->status;
+}
+
+void VmObject::CompletePageRequestsLocked(uint64_t offset, uint64_t len, status_t status) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    DEBUG_ASSERT(is_mutex_held(&lock_));
+
+    VmPageRequest* r;
+    VmPageRequest* temp;
+    list_for_every_entry_safe (&page_requests_, r, temp, VmPageRequest, node) {
+        if (r->offset < offset || r->offset - offset >= len)
+            continue;
+
+        list_delete(&r->node);
+        r->status = status;
+        event_signal(&r->event, false);
+    }
+}
+
+vm_page_t* VmObject::FaultPageLocked(uint64_t offset, uint pf_flags, bool* shared,
+                                     VmPageRequest* req) {
     DEBUG_ASSERT(magic_ == MAGIC);
     DEBUG_ASSERT(is_mutex_held(&lock_));
 
     LTRACEF("vmo %p, offset %#" PRIx64 ", pf_flags %#x\n",
             this, offset, pf_flags);
 
+    if (shared)
+        *shared = false;
+
     if (offset >= size_)
         return nullptr;
 
@@ -212,33 +737,73 @@ vm_page_t* VmObject::FaultPageLocked(uint64_t offset, uint pf_flags) {
     if (p)
         return p;
 
-    // allocate a page
+    MergeParentLocked();
+    p = page_array_[index];
+    if (p)
+        return p;
+
+    // pages the pager hasn't supplied yet, to us or to the ancestor we'd copy from,
+    // have to be waited for
+    if (paged_) {
+        status_t status = req ? QueuePageRequestLocked(offset, req) : ERR_NOT_SUPPORTED;
+        if (status != NO_ERROR) {
+            if (req)
+                req->status = status;
+            return nullptr;
+        }
+    }
+
+    // reads can be satisfied directly out of an ancestor's page if there is one, or the
+    // zero page, without committing anything.
+    // clones don't use the zero page, since an ancestor may commit a page at this offset
+    // later, and there's no way to reach the clone's mappings from there to update them.
+    if (!(pf_flags & VMM_PF_FLAG_WRITE)) {
+        p = parent_ ? GetPageFromParentLocked(offset) : vm_get_zero_page();
+        if (p) {
+            LTRACEF("using shared page %p\n", p);
+            if (shared) {
+                *shared = true;
+                shared_pages_mapped_ = true;
+            }
+            return p;
+        }
+    }
+
+    // allocate a page, preferring an already zeroed one if there's nothing to copy into it
     paddr_t pa;
-    p = pmm_alloc_page(pmm_alloc_flags_, &pa);
+    bool zeroed = false;
+    if (!parent_ && pmm_alloc_flags_ == PMM_ALLOC_FLAG_ANY) {
+        p = zero_pool_alloc_page(&pa);
+        zeroed = (p != nullptr);
+    }
+    if (!p)
+        p = pmm_alloc_page(pmm_alloc_flags_, &pa);
     if (!p)
         return nullptr;
 
-    // TODO: remove once pmm returns zeroed pages
-    ZeroPage(pa);
+    InitPageLocked(p, offset, zeroed);
 
     AddPageToArray(index, p);
 
+    // regions that have a shared page mapped read-only at this offset need to fault
+    // again to pick up the new one
+    if (shared_pages_mapped_)
+        RangeChangeUpdateLocked(offset, PAGE_SIZE);
+
     LTRACEF("faulted in page %p, pa %#" PRIxPTR "\n", p, pa);
 
     return p;
 }
 
-vm_page_t* VmObject::FaultPage(uint64_t offset, uint pf_flags) {
-    DEBUG_ASSERT(magic_ == MAGIC);
-    AutoLock a(lock_);
-
-    return FaultPageLocked(offset, pf_flags);
-}
-
 int64_t VmObject::CommitRange(uint64_t offset, uint64_t len) {
     DEBUG_ASSERT(magic_ == MAGIC);
     LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
 
+    // only the pager can fill in pages of a pager-backed object. a clone of one may have to
+    // wait for it for the pages to copy, so it commits a page at a time like write faults do
+    if (paged_)
+        return source_ ? ERR_NOT_SUPPORTED : CommitRangeFromPager(offset, len);
+
     AutoLock a(lock_);
 
     // trim the size
@@ -264,13 +829,22 @@ int64_t VmObject::CommitRange(uint64_t offset, uint64_t len) {
     if (count == 0)
         return 0;
 
-    // allocate count number of pages
+    // allocate count number of pages, taking as many already zeroed ones as we can
+    list_node zeroed_list;
+    list_initialize(&zeroed_list);
     list_node page_list;
     list_initialize(&page_list);
 
-    size_t allocated = pmm_alloc_pages(count, pmm_alloc_flags_, &page_list);
+    size_t zeroed = 0;
+    if (!parent_ && pmm_alloc_flags_ == PMM_ALLOC_FLAG_ANY)
+        zeroed = zero_pool_alloc_pages(count, &zeroed_list);
+
+    size_t allocated = zeroed;
+    if (zeroed < count)
+        allocated += pmm_alloc_pages(count - zeroed, pmm_alloc_flags_, &page_list);
     if (allocated < count) {
         LTRACEF("failed to allocate enough pages (asked for %zu, got %zu)\n", count, allocated);
+        pmm_free(&zeroed_list);
         pmm_free(&page_list);
         return ERR_NO_MEMORY;
     }
@@ -279,20 +853,226 @@ int64_t VmObject::CommitRange(uint64_t offset, uint64_t len) {
     for (uint64_t o = offset; o < end; o += PAGE_SIZE) {
         size_t index = OffsetToIndex(o);
 
-        vm_page_t* p = list_remove_head_type(&page_list, vm_page_t, node);
+        // skip pages that were already committed
+        if (page_array_[index])
+            continue;
+
+        bool page_zeroed = true;
+        vm_page_t* p = list_remove_head_type(&zeroed_list, vm_page_t, node);
+        if (!p) {
+            p = list_remove_head_type(&page_list, vm_page_t, node);
+            page_zeroed = false;
+        }
         DEBUG_ASSERT(p);
 
-        // TODO: remove once pmm returns zeroed pages
-        ZeroPage(p);
+        InitPageLocked(p, o, page_zeroed);
 
         AddPageToArray(index, p);
     }
 
+    DEBUG_ASSERT(list_is_empty(&zeroed_list));
     DEBUG_ASSERT(list_is_empty(&page_list));
 
+    // any shared pages mapped in this range have been replaced with private ones
+    if (shared_pages_mapped_)
+        RangeChangeUpdateLocked(offset, end - offset);
+
     return len;
 }
 
+int64_t VmObject::CommitRangeFromPager(uint64_t offset, uint64_t len) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    DEBUG_ASSERT(paged_);
+
+    AutoLock a(lock_);
+
+    // trim the size
+    if (!TrimRange(offset, len, size_))
+        return ERR_OUT_OF_RANGE;
+
+    uint64_t end = ROUNDUP_PAGE_SIZE(offset + len);
+    for (uint64_t o = ROUNDDOWN(offset, PAGE_SIZE); o < end;) {
+        VmPageRequest req = {};
+        vm_page_t* p = FaultPageLocked(o, VMM_PF_FLAG_WRITE, nullptr, &req);
+        if (!p && req.status == ERR_SHOULD_WAIT) {
+            // drop the lock while the pager supplies the page, then try this page again
+            mutex_release(&lock_);
+            status_t status = WaitForPage(&req);
+            mutex_acquire(&lock_);
+            if (status != NO_ERROR)
+                return status;
+            continue;
+        }
+        if (!p)
+            return (req.status < 0) ? req.status : ERR_NO_MEMORY;
+
+        o += PAGE_SIZE;
+    }
+
+    return len;
+}
+
+int64_t VmObject::DecommitRange(uint64_t offset, uint64_t len) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
+
+    AutoLock a(lock_);
+
+    MergeParentLocked();
+
+    // the same restrictions as reclaiming zero pages apply: clones could see through to the
+    // parent, and pager-backed or pinned pages can't just go away.
+    if (parent_ || num_children_ > 0 || pages_pinned_ || source_)
+        return ERR_NOT_SUPPORTED;
+
+    // the kernel may touch its mappings in places it can't take a fault
+    for (const auto& r : mapping_list_) {
+        if (!r.aspace().is_user())
+            return ERR_NOT_SUPPORTED;
+    }
+
+    // trim the size
+    if (!TrimRange(offset, len, size_))
+        return ERR_OUT_OF_RANGE;
+
+    // was in range, just zero length
+    if (len == 0)
+        return 0;
+
+    uint64_t start = ROUNDDOWN(offset, PAGE_SIZE);
+    uint64_t end = ROUNDUP_PAGE_SIZE(offset + len);
+    DEBUG_ASSERT(end > start);
+
+    // pull the range out of every mapping first, after this any access faults and blocks on
+    // our lock until we're done
+    RangeChangeUpdateLocked(start, end - start);
+
+    list_node free_list;
+    list_initialize(&free_list);
+    size_t count = 0;
+    for (uint64_t o = start; o < end; o += PAGE_SIZE) {
+        size_t index = OffsetToIndex(o);
+        vm_page_t* p = page_array_[index];
+        if (!p)
+            continue;
+
+        page_array_[index] = nullptr;
+        list_delete(&p->node);
+        list_add_tail(&free_list, &p->node);
+        committed_pages_--;
+        count++;
+    }
+    pmm_free(&free_list);
+
+    return count * PAGE_SIZE;
+}
+
+int64_t VmObject::Prefetch(uint64_t offset, uint64_t len) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
+
+    bool clone;
+    {
+        AutoLock a(lock_);
+        MergeParentLocked();
+        clone = (parent_ != nullptr);
+    }
+
+    // clones map the pages they share with their parent read-only instead of copying them,
+    // the same as read faults would. the pager is asked for the missing pages of a
+    // pager-backed object instead, and they get mapped as they are supplied
+    int64_t committed = (paged_ || clone) ? 0 : CommitRange(offset, len);
+    if (committed < 0)
+        return committed;
+
+    AutoLock a(lock_);
+
+    // the range may have shrunk since it was committed
+    if (!TrimRange(offset, len, size_) || len == 0)
+        return committed;
+
+    uint64_t end = ROUNDUP_PAGE_SIZE(offset + len);
+    for (uint64_t o = ROUNDDOWN(offset, PAGE_SIZE); o < end; o += PAGE_SIZE) {
+        bool shared = false;
+        vm_page_t* p = GetPageLocked(o);
+        if (!p && parent_) {
+            p = GetPageFromParentLocked(o);
+            shared = (p != nullptr);
+        }
+        if (!p) {
+            if (source_) {
+                status_t status = source_->RequestPage(o);
+                if (status != NO_ERROR)
+                    return status;
+            }
+            continue;
+        }
+
+        // a later commit at this offset has to replace the read-only mapping
+        if (shared)
+            shared_pages_mapped_ = true;
+
+        for (auto& r : mapping_list_) {
+            r.MapObjectPageLocked(o, p, shared);
+        }
+    }
+
+    return committed;
+}
+
+status_t VmObject::SupplyPages(uint64_t offset, uint64_t len, user_ptr<const void> data) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    LTRACEF("vmo %p offset %#" PRIx64 ", len %#" PRIx64 "\n", this, offset, len);
+
+    if (!source_)
+        return ERR_NOT_SUPPORTED;
+
+    if (!IS_PAGE_ALIGNED(offset) || !data.is_user_address())
+        return ERR_INVALID_ARGS;
+
+    AutoLock a(lock_);
+
+    if (!InRange(offset, len, size_))
+        return ERR_OUT_OF_RANGE;
+
+    uint64_t end = ROUNDUP_PAGE_SIZE(offset + len);
+    for (uint64_t o = offset; o < end; o += PAGE_SIZE) {
+        size_t index = OffsetToIndex(o);
+
+        // the pager may answer the same request more than once
+        if (page_array_[index])
+            continue;
+
+        paddr_t pa;
+        vm_page_t* p = pmm_alloc_page(pmm_alloc_flags_, &pa);
+        if (!p)
+            return ERR_NO_MEMORY;
+
+        // the part of the last page past the end of the data reads as zero
+        uint8_t* dst = reinterpret_cast<uint8_t*>(paddr_to_kvaddr(pa));
+        size_t tocopy = static_cast<size_t>(MIN(PAGE_SIZE, offset + len - o));
+        status_t status = data.byte_offset(static_cast<size_t>(o - offset))
+                              .copy_array_from_user(dst, tocopy);
+        if (status != NO_ERROR) {
+            pmm_free_page(p);
+            return status;
+        }
+        if (tocopy < PAGE_SIZE)
+            memset(dst + tocopy, 0, PAGE_SIZE - tocopy);
+
+        AddPageToArray(index, p);
+
+        CompletePageRequestsLocked(o, PAGE_SIZE, NO_ERROR);
+
+        // push it out to the existing mappings so they don't all have to fault on it
+        for (auto& r : mapping_list_) {
+            r.MapObjectPageLocked(o, p);
+        }
+    }
+
+    return NO_ERROR;
+}
+
 int64_t VmObject::CommitRangeContiguous(uint64_t offset, uint64_t len, uint8_t alignment_log2) {
     DEBUG_ASSERT(magic_ == MAGIC);
     LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 ", alignment %hhu\n",
@@ -346,12 +1126,17 @@ int64_t VmObject::CommitRangeContiguous(uint64_t offset, uint64_t len, uint8_t a
         vm_page_t* p = list_remove_head_type(&page_list, vm_page_t, node);
         DEBUG_ASSERT(p);
 
-        // TODO: remove once pmm returns zeroed pages
-        ZeroPage(p);
+        InitPageLocked(p, o, false);
 
         AddPageToArray(index, p);
     }
 
+    if (shared_pages_mapped_)
+        RangeChangeUpdateLocked(offset, end - offset);
+
+    // the caller is likely to hand out the physical addresses of a contiguous run
+    pages_pinned_ = true;
+
     return count * PAGE_SIZE;
 }
 
@@ -381,9 +1166,19 @@ status_t VmObject::ReadWriteInternal(uint64_t offset, size_t len, size_t* bytes_
         size_t tocopy = MIN(PAGE_SIZE - page_offset, len);
 
         // fault in the page
-        vm_page_t* p = FaultPageLocked(offset, write ? VMM_PF_FLAG_WRITE : 0);
+        VmPageRequest req = {};
+        vm_page_t* p = FaultPageLocked(offset, write ? VMM_PF_FLAG_WRITE : 0, nullptr, &req);
+        if (!p && req.status == ERR_SHOULD_WAIT) {
+            // drop the lock while the pager supplies the page, then try this page again
+            mutex_release(&lock_);
+            status_t status = WaitForPage(&req);
+            mutex_acquire(&lock_);
+            if (status != NO_ERROR)
+                return status;
+            continue;
+        }
         if (!p)
-            return ERR_NO_MEMORY;
+            return (req.status < 0) ? req.status : ERR_NO_MEMORY;
 
         // compute the kernel mapping of this page
         paddr_t pa = vm_page_to_paddr(p);
@@ -493,6 +1288,9 @@ status_t VmObject::Lookup(uint64_t offset, uint64_t len, user_ptr<paddr_t> buffe
     if (unlikely(table_size > buffer_size))
         return ERR_BUFFER_TOO_SMALL;
 
+    // physical addresses are leaving the vm, so the pages can't be reclaimed from now on
+    pages_pinned_ = true;
+
     size_t index = 0;
     for (uint64_t off = start_page_offset; off != end_page_offset; off += PAGE_SIZE, index++) {
         // grab a pointer to the page only if it's already present
@@ -27,6 +27,17 @@ void vmm_init(void);
 // global vmm lock (for now)
 extern mutex_t vmm_lock;
 
+// the global read-only page of zeros
+vm_page_t* vm_get_zero_page(void);
+
+// pool of free pages zeroed ahead of time by a background thread.
+// both return pages in the allocated state, or nothing if the pool has run dry.
+vm_page_t* zero_pool_alloc_page(paddr_t* pa);
+size_t zero_pool_alloc_pages(size_t count, struct list_node* list);
+
+// number of pages currently in the zero pool
+size_t zero_pool_count(void);
+
 // utility function to test that offset + len is entirely within a range
 // returns false if out of range
 // NOTE: only use unsigned lengths
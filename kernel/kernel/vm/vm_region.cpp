@@ -7,9 +7,11 @@
 #include <kernel/vm/vm_region.h>
 
 #include "vm_priv.h"
+#include <arch/ops.h>
 #include <assert.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/auto_lock.h>
 #include <kernel/vm.h>
 #include <kernel/vm/vm_aspace.h>
 #include <kernel/vm/vm_object.h>
@@ -49,7 +51,10 @@ status_t VmRegion::Destroy() {
     LTRACEF("%p '%s'\n", this, name_);
 
     // detach from any object we have mapped
-    object_.reset();
+    if (object_) {
+        object_->RemoveMapping(this);
+        object_.reset();
+    }
 
     return NO_ERROR;
 }
@@ -68,11 +73,43 @@ void VmRegion::Dump() const {
 
 status_t VmRegion::Protect(uint arch_mmu_flags) {
     DEBUG_ASSERT(magic_ == MAGIC);
+
+    if (!object_) {
+        arch_mmu_flags_ = arch_mmu_flags;
+
+        auto err = aspace_->MmuProtect(base_, size_ / PAGE_SIZE, arch_mmu_flags);
+        LTRACEF("arch_mmu_protect returns %d\n", err);
+        // TODO: deal with error mapping here
+
+        return NO_ERROR;
+    }
+
+    // go page by page, since only some of the range may be mapped, and pages the object
+    // doesn't own (borrowed from a parent, or the zero page) have to stay read-only.
+    // the object's lock keeps it from changing which pages it owns underneath us.
+    AutoLock a(object_->lock());
+
     arch_mmu_flags_ = arch_mmu_flags;
 
-    auto err = arch_mmu_protect(&aspace_->arch_aspace(), base_, size_ / PAGE_SIZE, arch_mmu_flags);
-    LTRACEF("arch_mmu_protect returns %d\n", err);
-    // TODO: deal with error mapping here
+    for (size_t offset = 0; offset < size_; offset += PAGE_SIZE) {
+        vaddr_t va = base_ + offset;
+
+        uint page_flags;
+        paddr_t pa;
+        if (aspace_->MmuQuery(va, &pa, &page_flags) < 0)
+            continue;
+
+        uint new_flags = arch_mmu_flags;
+        vm_page_t* p = object_->GetPageLocked(object_offset_ + offset);
+        if (!p || vm_page_to_paddr(p) != pa)
+            new_flags &= ~ARCH_MMU_FLAG_PERM_WRITE;
+        if (new_flags == page_flags)
+            continue;
+
+        auto err = aspace_->MmuProtect(va, 1, new_flags);
+        LTRACEF("arch_mmu_protect returns %d\n", err);
+        // TODO: deal with error mapping here
+    }
 
     return NO_ERROR;
 }
@@ -81,8 +118,14 @@ int VmRegion::Unmap() {
     DEBUG_ASSERT(magic_ == MAGIC);
     LTRACEF("%p '%s'\n", this, name_);
 
+    // stop the object from mapping pages into us before tearing down the mappings, so
+    // nothing it maps in behind our back outlives the region
+    if (object_)
+        object_->RemoveMapping(this);
+
     // unmap the section of address space we cover
-    return arch_mmu_unmap(&aspace_->arch_aspace(), base_, size_ / PAGE_SIZE);
+    atomic_swap(&resident_pages_, 0);
+    return aspace_->MmuUnmap(base_, size_ / PAGE_SIZE);
 }
 
 status_t VmRegion::SetObject(mxtl::RefPtr<VmObject> o, uint64_t offset) {
@@ -96,9 +139,110 @@ status_t VmRegion::SetObject(mxtl::RefPtr<VmObject> o, uint64_t offset) {
     object_ = o;
     object_offset_ = offset;
 
+    // let the object know so it can unmap pages from us as they change underneath
+    object_->AddMapping(this);
+
     return NO_ERROR;
 }
 
+void VmRegion::UnmapObjectRangeLocked(uint64_t offset, uint64_t len) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+
+    // intersect the changed range of the object with the part we map
+    uint64_t start = MAX(offset, object_offset_);
+    uint64_t end = MIN(offset + len, object_offset_ + size_);
+    if (start >= end)
+        return;
+
+    start = ROUNDDOWN(start, PAGE_SIZE);
+    end = ROUNDUP(end, PAGE_SIZE);
+
+    vaddr_t va = base_ + static_cast<vaddr_t>(start - object_offset_);
+    size_t count = static_cast<size_t>(end - start) / PAGE_SIZE;
+
+    LTRACEF("%p '%s', unmapping va %#" PRIxPTR ", %zu pages\n", this, name_, va, count);
+
+    // only the pages that were actually mapped count against the resident size
+    int mapped = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint page_flags;
+        paddr_t pa;
+        if (aspace_->MmuQuery(va + i * PAGE_SIZE, &pa, &page_flags) >= 0)
+            mapped++;
+    }
+
+    aspace_->MmuUnmap(va, count);
+    atomic_add(&resident_pages_, -mapped);
+}
+
+void VmRegion::WriteProtectObjectRangeLocked(uint64_t offset, uint64_t len) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+
+    // intersect the range of the object with the part we map
+    uint64_t start = MAX(offset, object_offset_);
+    uint64_t end = MIN(offset + len, object_offset_ + size_);
+    if (start >= end)
+        return;
+
+    start = ROUNDDOWN(start, PAGE_SIZE);
+    end = ROUNDUP(end, PAGE_SIZE);
+
+    vaddr_t va = base_ + static_cast<vaddr_t>(start - object_offset_);
+    size_t count = static_cast<size_t>(end - start) / PAGE_SIZE;
+
+    LTRACEF("%p '%s', write protecting va %#" PRIxPTR ", %zu pages\n", this, name_, va, count);
+
+    // only touch the pages that are mapped writable, the rest will fault in read-only
+    for (size_t i = 0; i < count; i++, va += PAGE_SIZE) {
+        uint page_flags;
+        paddr_t pa;
+        if (aspace_->MmuQuery(va, &pa, &page_flags) < 0 ||
+            !(page_flags & ARCH_MMU_FLAG_PERM_WRITE))
+            continue;
+
+        auto err = aspace_->MmuProtect(va, 1, page_flags & ~ARCH_MMU_FLAG_PERM_WRITE);
+        if (err < 0)
+            TRACEF("error %d write protecting page at va %#" PRIxPTR "\n", err, va);
+    }
+}
+
+void VmRegion::MapObjectPageLocked(uint64_t offset, vm_page_t* p, bool shared) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+
+    if (offset < object_offset_ || offset - object_offset_ >= size_)
+        return;
+
+#if ARCH_ARM64
+    // executable mappings need the caches synced through the mapping, which the fault
+    // path takes care of
+    if (arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_EXECUTE)
+        return;
+#endif
+
+    vaddr_t va = base_ + static_cast<vaddr_t>(offset - object_offset_);
+
+    // leave anything that's already mapped alone
+    uint page_flags;
+    paddr_t pa;
+    if (aspace_->MmuQuery(va, &pa, &page_flags) >= 0)
+        return;
+
+    pa = vm_page_to_paddr(p);
+    LTRACEF_LEVEL(2, "mapping pa %#" PRIxPTR " to va %#" PRIxPTR "\n", pa, va);
+
+    // pages borrowed from a parent object are only ever mapped read-only
+    uint mmu_flags = arch_mmu_flags_;
+    if (shared)
+        mmu_flags &= ~ARCH_MMU_FLAG_PERM_WRITE;
+
+    auto ret = aspace_->MmuMap(va, pa, 1, mmu_flags);
+    if (ret < 0) {
+        TRACEF("error %d mapping page at va %#" PRIxPTR " pa %#" PRIxPTR "\n", ret, va, pa);
+        return;
+    }
+    atomic_add(&resident_pages_, 1);
+}
+
 status_t VmRegion::MapPhysicalRange(size_t offset, size_t len, paddr_t paddr, bool allow_remap) {
     DEBUG_ASSERT(magic_ == MAGIC);
     LTRACEF("%p '%s', offset %#zx, size %#zx, paddr %#" PRIxPTR ", remap %d\n",
@@ -118,15 +262,14 @@ status_t VmRegion::MapPhysicalRange(size_t offset, size_t len, paddr_t paddr, bo
     }
 
     if (allow_remap) {
-        auto ret = arch_mmu_unmap(&aspace_->arch_aspace(), base_ + offset, len / PAGE_SIZE);
+        auto ret = aspace_->MmuUnmap(base_ + offset, len / PAGE_SIZE);
         if (ret < 0) {
             TRACEF("error unmapping old region\n");
             return ret;
         }
     }
 
-    auto ret = arch_mmu_map(&aspace_->arch_aspace(), base_ + offset, paddr, len / PAGE_SIZE,
-                            arch_mmu_flags_);
+    auto ret = aspace_->MmuMap(base_ + offset, paddr, len / PAGE_SIZE, arch_mmu_flags_);
     if (ret < 0) {
         TRACEF("error %d mapping pages at va %#" PRIxPTR " pa %#" PRIxPTR "\n",
                ret, base_, paddr);
@@ -148,44 +291,51 @@ status_t VmRegion::MapRange(size_t offset, size_t len, bool commit) {
         return ERR_NO_MEMORY;
     }
 
-    // iterate through the range, grabbing a page from the underlying object and mapping it in
-    size_t o;
-    for (o = offset; o < offset + len; o += PAGE_SIZE) {
-        uint64_t vmo_offset = object_offset_ + o;
-        vm_page_t* p = object_->GetPage(vmo_offset);
-        if (!p) {
-            if (!commit) {
-                // no page to map, skip ahead
-                continue;
-            }
+    if (commit) {
+        int64_t committed = object_->CommitRange(object_offset_ + offset, len);
+        if (committed < 0) {
+            LTRACEF("error committing memory for region\n");
+            return (status_t)committed;
+        }
+    }
 
-            int64_t committed = object_->CommitRange(vmo_offset, PAGE_SIZE);
-            if (committed < 0 || committed != PAGE_SIZE) {
-                LTRACEF("error committing memory for region\n");
-                return (status_t)committed;
-            }
+    // map whatever the object has, holding its lock so none of the pages can be freed or
+    // replaced before they are mapped
+    AutoLock a(object_->lock());
 
-            p = object_->GetPage(vmo_offset);
-        }
+    // the address space doesn't hold its lock across this, so the region may have been
+    // unmapped in the meantime. it detaches from the object first, under the same lock.
+    if (!VmRegionObjectListTraits::node_state(*this).InContainer())
+        return ERR_BAD_STATE;
 
-        DEBUG_ASSERT(p);
+    for (size_t o = offset; o < offset + len; o += PAGE_SIZE) {
+        uint64_t vmo_offset = object_offset_ + o;
+        vm_page_t* p = object_->GetPageLocked(vmo_offset);
+        if (!p) {
+            // no page to map, skip ahead
+            continue;
+        }
 
         vaddr_t va = base_ + o;
         paddr_t pa = vm_page_to_paddr(p);
         LTRACEF_LEVEL(2, "mapping pa %#" PRIxPTR " to va %#" PRIxPTR "\n",
                       pa, va);
 
-        auto ret = arch_mmu_map(&aspace_->arch_aspace(), va, pa, 1, arch_mmu_flags_);
+        auto ret = aspace_->MmuMap(va, pa, 1, arch_mmu_flags_);
         if (ret < 0) {
-            TRACEF("error %d mapping page at va %#" PRIxPTR " pa %#" PRIxPTR
-                   "\n", ret, va, pa);
+            // the object may have mapped the page into us already
+            if (ret != ERR_ALREADY_EXISTS)
+                TRACEF("error %d mapping page at va %#" PRIxPTR " pa %#" PRIxPTR
+                       "\n", ret, va, pa);
+            continue;
         }
+        atomic_add(&resident_pages_, 1);
     }
 
     return NO_ERROR;
 }
 
-status_t VmRegion::PageFault(vaddr_t va, uint pf_flags) {
+status_t VmRegion::PageFault(vaddr_t va, uint pf_flags, VmPageRequest* req) {
     DEBUG_ASSERT(magic_ == MAGIC);
     DEBUG_ASSERT(va >= base_ && va <= base_ + size_ - 1);
 
@@ -213,9 +363,17 @@ status_t VmRegion::PageFault(vaddr_t va, uint pf_flags) {
     }
 
     if (!(pf_flags & VMM_PF_FLAG_NOT_PRESENT)) {
+        // a write to a present page that was mapped read-only in a writable region is a
+        // copy-on-write fault, so let it through
+        uint cur_flags;
+        paddr_t cur_pa;
+        bool cow_fault = (pf_flags & VMM_PF_FLAG_WRITE) &&
+                         aspace_->MmuQuery(va, &cur_pa, &cur_flags) >= 0 &&
+                         !(cur_flags & ARCH_MMU_FLAG_PERM_WRITE);
+
         // kernel attempting to access userspace, and permissions were fine, so
         // architecture prevented the cross-privilege access
-        if (!(pf_flags & VMM_PF_FLAG_USER) && aspace_->is_user()) {
+        if (!cow_fault && !(pf_flags & VMM_PF_FLAG_USER) && aspace_->is_user()) {
             TRACEF("ERROR: kernel faulted on user address\n");
             return ERR_ACCESS_DENIED;
         }
@@ -227,52 +385,86 @@ status_t VmRegion::PageFault(vaddr_t va, uint pf_flags) {
         return ERR_NO_MEMORY;
     }
 
-    // fault in or grab an existing page
-    vm_page_t* new_p = object_->FaultPage(vmo_offset, pf_flags);
+    // fault in or grab an existing page, and map it before dropping the object's lock.
+    // the object frees pages and pulls them out of its mappings under that lock, so a page
+    // mapped after dropping it could already be gone.
+    AutoLock a(object_->lock());
+
+    bool shared;
+    vm_page_t* new_p = object_->FaultPageLocked(vmo_offset, pf_flags, &shared, req);
     if (!new_p) {
+        // the caller waits for the pager to supply the page and tries again
+        if (req->status == ERR_SHOULD_WAIT)
+            return ERR_SHOULD_WAIT;
+
         TRACEF("ERROR: failed to fault in or grab existing page\n");
         return ERR_NO_MEMORY;
     }
+
+    return MapFaultedPageLocked(va, new_p, shared);
+}
+
+status_t VmRegion::MapFaultedPageLocked(vaddr_t va, vm_page_t* new_p, bool shared) {
+    DEBUG_ASSERT(is_mutex_held(object_->lock()));
+
     paddr_t new_pa = vm_page_to_paddr(new_p);
 
+    // pages borrowed from a parent object are only ever mapped read-only
+    uint mmu_flags = arch_mmu_flags_;
+    if (shared)
+        mmu_flags &= ~ARCH_MMU_FLAG_PERM_WRITE;
+
     // see if something is mapped here now
     // this may happen if we are one of multiple threads racing on a single address
     uint page_flags;
     paddr_t pa;
-    status_t err = arch_mmu_query(&aspace_->arch_aspace(), va, &pa, &page_flags);
+    status_t err = aspace_->MmuQuery(va, &pa, &page_flags);
     if (err >= 0) {
         LTRACEF("queried va, page at pa %#" PRIxPTR
                 ", flags %#x is already there\n",
                 pa, page_flags);
         if (pa == new_pa) {
             // page was already mapped, are the permissions compatible?
-            if (page_flags == arch_mmu_flags_)
+            if (page_flags == mmu_flags)
                 return NO_ERROR;
 
             // same page, different permission
-            auto ret = arch_mmu_protect(&aspace_->arch_aspace(), va, 1, arch_mmu_flags_);
+            auto ret = aspace_->MmuProtect(va, 1, mmu_flags);
             if (ret < 0) {
                 TRACEF("failed to modify permissions on existing mapping\n");
                 return ERR_NO_MEMORY;
             }
         } else {
-            // some other page is mapped there already
-            // currently this is an error situation, since there's no way for this to have
-            // happened, but in the future this will be a path for copy-on-write.
-            // TODO: implement
-            printf("KERN: thread %s faulted on va %#" PRIxPTR
-                   ", different page was present, unhandled\n",
-                   get_current_thread()->name, va);
-            return ERR_NOT_SUPPORTED;
+            // some other page is mapped there already, which happens when a copy-on-write
+            // fault replaced a parent's page with a private copy. swap in the new page.
+            LTRACEF("replacing pa %#" PRIxPTR " with pa %#" PRIxPTR " at va %#" PRIxPTR "\n",
+                    pa, new_pa, va);
+            auto ret = aspace_->MmuUnmap(va, 1);
+            if (ret < 0) {
+                TRACEF("failed to unmap old page\n");
+                return ERR_NO_MEMORY;
+            }
+            ret = aspace_->MmuMap(va, new_pa, 1, mmu_flags);
+            if (ret < 0) {
+                TRACEF("failed to map page\n");
+                return ERR_NO_MEMORY;
+            }
         }
     } else {
         // nothing was mapped there before, map it now
         LTRACEF("mapping pa %#" PRIxPTR " to va %#" PRIxPTR "\n", new_pa, va);
-        auto ret = arch_mmu_map(&aspace_->arch_aspace(), va, new_pa, 1, arch_mmu_flags_);
+        auto ret = aspace_->MmuMap(va, new_pa, 1, mmu_flags);
+        if (ret == ERR_ALREADY_EXISTS) {
+            // something else got a page mapped here first. let the access retry against it,
+            // and fault again if it isn't good enough.
+            LTRACEF("va %#" PRIxPTR " was mapped underneath us\n", va);
+            return NO_ERROR;
+        }
         if (ret < 0) {
             TRACEF("failed to map page\n");
             return ERR_NO_MEMORY;
         }
+        atomic_add(&resident_pages_, 1);
     }
 #if ARCH_ARM64
     if (arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_EXECUTE)
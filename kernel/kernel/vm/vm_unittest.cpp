@@ -4,14 +4,18 @@
 // license that can be found in the LICENSE file or at
 // https://opensource.org/licenses/MIT
 
+#include "vm_priv.h"
 #include <app/tests.h>
 #include <assert.h>
 #include <err.h>
+#include <inttypes.h>
+#include <kernel/thread.h>
 #include <kernel/vm.h>
 #include <kernel/vm/vm_aspace.h>
 #include <kernel/vm/vm_object.h>
 #include <kernel/vm/vm_region.h>
 #include <new.h>
+#include <platform.h>
 #include <unittest.h>
 #include <mxtl/array.h>
 
@@ -48,6 +52,32 @@ static bool pmm_tests(void* context) {
         EXPECT_EQ(alloc_count, ret, "pmm_free_page on a list of pages");
     }
 
+    // allocate a bunch of pages one at a time, enough to run through the per cpu cache
+    // a few times, then free them one at a time
+    unittest_printf("allocating a lot of single pages, then freeing them\n");
+    {
+        list_node list = LIST_INITIAL_VALUE(list);
+
+        static const size_t alloc_count = 1024;
+
+        size_t count = 0;
+        for (size_t i = 0; i < alloc_count; i++) {
+            vm_page_t* page = pmm_alloc_page(0, nullptr);
+            if (!page)
+                break;
+            list_add_tail(&list, &page->node);
+            count++;
+        }
+        EXPECT_EQ(alloc_count, count, "pmm_alloc_page many single pages");
+
+        size_t freed = 0;
+        vm_page_t* page;
+        while ((page = list_remove_head_type(&list, vm_page_t, node))) {
+            freed += pmm_free_page(page);
+        }
+        EXPECT_EQ(count, freed, "pmm_free_page many single pages");
+    }
+
     // allocate too many pages and make sure it fails nicely
     unittest_printf("allocating too many pages, then freeing them\n");
     {
@@ -566,12 +596,236 @@ static bool vmm_object_tests(void* context) {
         EXPECT_EQ(0, cmpres, "reading from object");
     }
 
+    unittest_printf("creating vm object, cloning it copy-on-write\n");
+    {
+        const uint arch_rw_flags = ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE;
+        static const size_t alloc_size = PAGE_SIZE * 16;
+
+        // create object and fill it with a pattern
+        auto vmo = VmObject::Create(PMM_ALLOC_FLAG_ANY, alloc_size);
+        EXPECT_TRUE(vmo, "vmobject creation\n");
+
+        AllocChecker ac;
+        mxtl::Array<uint8_t> a(new (&ac) uint8_t[alloc_size], alloc_size);
+        EXPECT_TRUE(ac.check(), "");
+        fill_region(99, a.get(), alloc_size);
+
+        size_t bytes_written = -1;
+        status_t err = vmo->Write(a.get(), 0, alloc_size, &bytes_written);
+        EXPECT_EQ(NO_ERROR, err, "writing to object");
+        EXPECT_EQ(alloc_size, bytes_written, "writing to object");
+
+        // clone it, skipping the first page
+        auto clone = vmo->CloneCOW(PAGE_SIZE, alloc_size - PAGE_SIZE);
+        EXPECT_TRUE(clone, "cloning object\n");
+
+        // map the clone and make sure it sees the parent's data
+        auto ka = VmAspace::kernel_aspace();
+        uint8_t* ptr;
+        err = ka->MapObject(clone, "test", 0, alloc_size - PAGE_SIZE, (void**)&ptr, 0, 0,
+                            arch_rw_flags);
+        EXPECT_EQ(NO_ERROR, err, "mapping clone");
+
+        int cmpres = memcmp(ptr, a.get() + PAGE_SIZE, alloc_size - PAGE_SIZE);
+        EXPECT_EQ(0, cmpres, "reading clone through mapping");
+
+        // write through the clone and make sure the parent didn't change
+        fill_region(42, ptr, PAGE_SIZE);
+        EXPECT_TRUE(test_region(42, ptr, PAGE_SIZE), "writing to clone");
+
+        mxtl::Array<uint8_t> b(new (&ac) uint8_t[alloc_size], alloc_size);
+        EXPECT_TRUE(ac.check(), "");
+        size_t bytes_read = -1;
+        err = vmo->Read(b.get(), 0, alloc_size, &bytes_read);
+        EXPECT_EQ(NO_ERROR, err, "reading from object");
+        cmpres = memcmp(b.get(), a.get(), alloc_size);
+        EXPECT_EQ(0, cmpres, "parent unchanged by write to clone");
+
+        // writes to the parent don't show up in the clone, whether or not it has copied
+        // the page yet
+        fill_region(7, a.get(), PAGE_SIZE);
+        err = vmo->Write(a.get(), PAGE_SIZE * 2, PAGE_SIZE, &bytes_written);
+        EXPECT_EQ(NO_ERROR, err, "writing to object");
+        cmpres = memcmp(ptr + PAGE_SIZE, b.get() + PAGE_SIZE * 2, PAGE_SIZE);
+        EXPECT_EQ(0, cmpres, "parent write not visible in clone");
+
+        err = vmo->Write(a.get(), PAGE_SIZE, PAGE_SIZE, &bytes_written);
+        EXPECT_EQ(NO_ERROR, err, "writing to object");
+        EXPECT_TRUE(test_region(42, ptr, PAGE_SIZE), "clone's copy is private");
+
+        // the parent still sees its own writes
+        err = vmo->Read(b.get(), PAGE_SIZE, PAGE_SIZE * 2, &bytes_read);
+        EXPECT_EQ(NO_ERROR, err, "reading from object");
+        EXPECT_TRUE(test_region(7, b.get(), PAGE_SIZE), "parent write visible in parent");
+        EXPECT_TRUE(test_region(7, b.get() + PAGE_SIZE, PAGE_SIZE),
+                    "parent write visible in parent");
+
+        err = ka->FreeRegion((vaddr_t)ptr);
+        EXPECT_EQ(NO_ERROR, err, "unmapping clone");
+    }
+
+    unittest_printf("creating vm object, reclaiming its zero pages\n");
+    {
+        static const size_t alloc_size = PAGE_SIZE * 4;
+
+        auto vmo = VmObject::Create(PMM_ALLOC_FLAG_ANY, alloc_size);
+        EXPECT_TRUE(vmo, "vmobject creation\n");
+
+        // commit two pages of zeros and one page of data
+        AllocChecker ac;
+        mxtl::Array<uint8_t> a(new (&ac) uint8_t[alloc_size], alloc_size);
+        EXPECT_TRUE(ac.check(), "");
+        memset(a.get(), 0, alloc_size);
+        fill_region(99, a.get() + PAGE_SIZE, PAGE_SIZE);
+
+        size_t bytes_written = -1;
+        status_t err = vmo->Write(a.get(), 0, PAGE_SIZE * 3, &bytes_written);
+        EXPECT_EQ(NO_ERROR, err, "writing to object");
+
+        EXPECT_EQ(2u, vmo->ScanForZeroPages(false), "counting zero pages");
+        EXPECT_EQ(2u, vmo->ScanForZeroPages(true), "reclaiming zero pages");
+        EXPECT_EQ(0u, vmo->ScanForZeroPages(false), "zero pages gone after reclaim");
+
+        // contents are unchanged
+        mxtl::Array<uint8_t> b(new (&ac) uint8_t[alloc_size], alloc_size);
+        EXPECT_TRUE(ac.check(), "");
+        size_t bytes_read = -1;
+        err = vmo->Read(b.get(), 0, alloc_size, &bytes_read);
+        EXPECT_EQ(NO_ERROR, err, "reading from object");
+        int cmpres = memcmp(b.get(), a.get(), alloc_size);
+        EXPECT_EQ(0, cmpres, "contents unchanged by reclaim");
+    }
+
     unittest_printf("done with vmm object based tests\n");
     END_TEST;
 }
 
+// map a large number of small regions into a fresh address space, then punch holes in it
+// and map into the fragmented space, timing how long it takes to place the regions
+static bool vmm_region_alloc_benchmark(void* context) {
+    BEGIN_TEST;
+    static const size_t region_count = 4096;
+    const uint arch_flags = ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_USER;
+
+    auto aspace = VmAspace::Create(0, "test aspace");
+    EXPECT_TRUE(aspace, "creating aspace");
+
+    auto vmo = VmObject::Create(PMM_ALLOC_FLAG_ANY, PAGE_SIZE * 2);
+    EXPECT_TRUE(vmo, "vmobject creation\n");
+
+    AllocChecker ac;
+    mxtl::Array<void*> ptrs(new (&ac) void*[region_count], region_count);
+    EXPECT_TRUE(ac.check(), "");
+
+    unittest_printf("mapping %zu regions\n", region_count);
+    lk_bigtime_t t = current_time_hires();
+    for (size_t i = 0; i < region_count; i++) {
+        status_t err = aspace->MapObject(vmo, "bench", 0, PAGE_SIZE, &ptrs[i], 0, 0, arch_flags);
+        EXPECT_EQ(NO_ERROR, err, "mapping region");
+    }
+    lk_bigtime_t map_time = current_time_hires() - t;
+
+    // free every other region, leaving a trail of one page holes
+    for (size_t i = 0; i < region_count; i += 2) {
+        status_t err = aspace->FreeRegion((vaddr_t)ptrs[i]);
+        EXPECT_EQ(NO_ERROR, err, "unmapping region");
+    }
+
+    // a single page should land in the first hole
+    void* ptr;
+    status_t err = aspace->MapObject(vmo, "bench", 0, PAGE_SIZE, &ptr, 0, 0, arch_flags);
+    EXPECT_EQ(NO_ERROR, err, "mapping region");
+    EXPECT_EQ(ptrs[0], ptr, "first fit");
+    aspace->FreeRegion((vaddr_t)ptr);
+
+    // two page regions fit in none of the holes, so every one of them has to be skipped
+    unittest_printf("mapping %zu regions into fragmented space\n", region_count / 2);
+    t = current_time_hires();
+    for (size_t i = 0; i < region_count / 2; i++) {
+        err = aspace->MapObject(vmo, "bench", 0, PAGE_SIZE * 2, &ptr, 0, 0, arch_flags);
+        EXPECT_EQ(NO_ERROR, err, "mapping region");
+    }
+    lk_bigtime_t frag_map_time = current_time_hires() - t;
+
+    unittest_printf("%zu maps took %" PRIu64 " usecs, %zu fragmented maps took %" PRIu64
+                    " usecs\n", region_count, map_time, region_count / 2, frag_map_time);
+
+    aspace->Destroy();
+    END_TEST;
+}
+
+// returns true if every byte of the page at |pa| is zero
+static bool page_is_zero(paddr_t pa) {
+    const uint64_t* ptr = static_cast<const uint64_t*>(paddr_to_kvaddr(pa));
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+        if (ptr[i] != 0)
+            return false;
+    }
+    return true;
+}
+
+// the pool is topped up by a low priority thread, so give it some time to run
+static void wait_for_zero_pool(void) {
+    for (int i = 0; i < 100 && zero_pool_count() == 0; i++)
+        thread_sleep(10);
+}
+
+static bool zero_pool_tests(void* context) {
+    BEGIN_TEST;
+
+    wait_for_zero_pool();
+    EXPECT_LT(0u, zero_pool_count(), "zero pool filled");
+
+    // pages handed out by the pool must be allocated and zeroed
+    unittest_printf("allocating a single page from the zero pool\n");
+    {
+        paddr_t pa;
+        vm_page_t* page = zero_pool_alloc_page(&pa);
+        EXPECT_NEQ(nullptr, page, "zero pool single page");
+        if (page) {
+            EXPECT_EQ(vm_page_to_paddr(page), pa, "zero pool single page address");
+            EXPECT_EQ(VM_PAGE_STATE_ALLOC, page->state, "zero pool single page state");
+            EXPECT_TRUE(page_is_zero(pa), "zero pool single page contents");
+
+            auto ret = pmm_free_page(page);
+            EXPECT_EQ(1u, ret, "pmm_free_page on a zero pool page");
+        }
+    }
+
+    // ask for more than the pool holds, so that it runs dry and comes back short
+    unittest_printf("draining the zero pool\n");
+    {
+        list_node list = LIST_INITIAL_VALUE(list);
+
+        static const size_t alloc_count = 1024;
+
+        size_t count = zero_pool_alloc_pages(alloc_count, &list);
+        EXPECT_LT(count, alloc_count, "zero pool ran dry");
+        EXPECT_EQ(count, list_length(&list), "zero pool list count");
+
+        bool all_zero = true;
+        vm_page_t* page;
+        list_for_every_entry (&list, page, vm_page_t, node) {
+            if (page->state != VM_PAGE_STATE_ALLOC || !page_is_zero(vm_page_to_paddr(page)))
+                all_zero = false;
+        }
+        EXPECT_TRUE(all_zero, "zero pool pages allocated and zeroed");
+
+        auto ret = pmm_free(&list);
+        EXPECT_EQ(count, ret, "pmm_free on zero pool pages");
+    }
+
+    // running low kicks the thread to refill the pool
+    wait_for_zero_pool();
+    EXPECT_LT(0u, zero_pool_count(), "zero pool refilled");
+
+    END_TEST;
+}
+
 UNITTEST_START_TESTCASE(vm_tests)
 UNITTEST("pmm tests", pmm_tests)
+UNITTEST("zero pool tests", zero_pool_tests)
 UNITTEST("vmm tests", vmm_tests)
 UNITTEST("vm object based test", vmm_object_tests)
+UNITTEST("region allocation benchmark", vmm_region_alloc_benchmark)
 UNITTEST_END_TESTCASE(vm_tests, "vmtests", "Virtual memory tests", NULL, NULL);
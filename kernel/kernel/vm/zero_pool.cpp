@@ -0,0 +1,196 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include "vm_priv.h"
+
+#include <assert.h>
+#include <err.h>
+#include <inttypes.h>
+#include <kernel/event.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread.h>
+#include <kernel/vm.h>
+#include <lib/console.h>
+#include <list.h>
+#include <lk/init.h>
+#include <string.h>
+#include <trace.h>
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+// A pool of free pages that were zeroed ahead of time by a low priority thread, so that
+// zero fill faults and commits can skip zeroing on the faulting thread.
+// The thread tops the pool back up to ZERO_POOL_MAX pages once it drops below
+// ZERO_POOL_LOW.
+#define ZERO_POOL_MAX 256
+#define ZERO_POOL_LOW (ZERO_POOL_MAX / 2)
+
+static spin_lock_t pool_lock = SPIN_LOCK_INITIAL_VALUE;
+static struct list_node pool_list = LIST_INITIAL_VALUE(pool_list);
+static size_t pool_count;
+
+// stats
+static uint64_t pool_hits;
+static uint64_t pool_misses;
+static uint64_t pool_zeroed;
+
+static event_t fill_event = EVENT_INITIAL_VALUE(fill_event, true, EVENT_FLAG_AUTOUNSIGNAL);
+
+// zero a page without dragging it through the cache, since it's unlikely to be touched
+// again before it's handed out
+static void zero_page_nt(void* ptr) {
+#if ARCH_X86_64
+    uint64_t* p = static_cast<uint64_t*>(ptr);
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i += 4) {
+        __asm__ volatile(
+            "movnti %1, 0(%0)\n"
+            "movnti %1, 8(%0)\n"
+            "movnti %1, 16(%0)\n"
+            "movnti %1, 24(%0)\n"
+            :: "r"(p + i), "r"(0ULL) : "memory");
+    }
+    // non temporal stores are weakly ordered, make sure they land before the page is
+    // published to the pool
+    __asm__ volatile("sfence" ::: "memory");
+#elif ARCH_ARM64
+    uint8_t* p = static_cast<uint8_t*>(ptr);
+    for (size_t i = 0; i < PAGE_SIZE; i += 64) {
+        __asm__ volatile(
+            "stnp xzr, xzr, [%0]\n"
+            "stnp xzr, xzr, [%0, #16]\n"
+            "stnp xzr, xzr, [%0, #32]\n"
+            "stnp xzr, xzr, [%0, #48]\n"
+            :: "r"(p + i) : "memory");
+    }
+    __asm__ volatile("dmb ishst" ::: "memory");
+#else
+    memset(ptr, 0, PAGE_SIZE);
+#endif
+}
+
+vm_page_t* zero_pool_alloc_page(paddr_t* pa) {
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&pool_lock, state);
+
+    vm_page_t* p = list_remove_head_type(&pool_list, vm_page_t, node);
+    if (p) {
+        pool_count--;
+        pool_hits++;
+    } else {
+        pool_misses++;
+    }
+    bool low = pool_count < ZERO_POOL_LOW;
+
+    spin_unlock_irqrestore(&pool_lock, state);
+
+    // kick the thread outside of the spinlock, since signaling may take the thread lock
+    if (low)
+        event_signal(&fill_event, false);
+
+    if (p && pa)
+        *pa = vm_page_to_paddr(p);
+
+    LTRACEF("page %p\n", p);
+
+    return p;
+}
+
+size_t zero_pool_alloc_pages(size_t count, struct list_node* list) {
+    size_t allocated = 0;
+
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&pool_lock, state);
+
+    while (allocated < count) {
+        vm_page_t* p = list_remove_head_type(&pool_list, vm_page_t, node);
+        if (!p)
+            break;
+        list_add_tail(list, &p->node);
+        pool_count--;
+        allocated++;
+    }
+    pool_hits += allocated;
+    pool_misses += count - allocated;
+    bool low = pool_count < ZERO_POOL_LOW;
+
+    spin_unlock_irqrestore(&pool_lock, state);
+
+    if (low)
+        event_signal(&fill_event, false);
+
+    LTRACEF("count %zu, allocated %zu\n", count, allocated);
+
+    return allocated;
+}
+
+size_t zero_pool_count(void) {
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&pool_lock, state);
+    size_t count = pool_count;
+    spin_unlock_irqrestore(&pool_lock, state);
+
+    return count;
+}
+
+static int zero_pool_thread(void* arg) {
+    for (;;) {
+        __UNUSED status_t err = event_wait(&fill_event);
+        DEBUG_ASSERT(err == NO_ERROR);
+
+        // top up the pool, giving up early if memory is tight so that the pool isn't
+        // holding on to pages someone else needs. this is the only thread that adds pages,
+        // so the count can only have dropped by the time the page is added.
+        while (zero_pool_count() < ZERO_POOL_MAX) {
+            paddr_t pa;
+            vm_page_t* p = pmm_alloc_page(PMM_ALLOC_FLAG_ANY, &pa);
+            if (!p)
+                break;
+
+            void* ptr = paddr_to_kvaddr(pa);
+            DEBUG_ASSERT(ptr);
+            zero_page_nt(ptr);
+
+            spin_lock_saved_state_t state;
+            spin_lock_irqsave(&pool_lock, state);
+
+            list_add_tail(&pool_list, &p->node);
+            pool_count++;
+            pool_zeroed++;
+
+            spin_unlock_irqrestore(&pool_lock, state);
+        }
+    }
+
+    return 0;
+}
+
+static void zero_pool_init(uint level) {
+    thread_t* t = thread_create("zero pool", &zero_pool_thread, nullptr, LOW_PRIORITY,
+                                DEFAULT_STACK_SIZE);
+    thread_detach_and_resume(t);
+}
+
+static int cmd_zero_pool(int argc, const cmd_args* argv) {
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&pool_lock, state);
+    size_t count = pool_count;
+    uint64_t hits = pool_hits;
+    uint64_t misses = pool_misses;
+    uint64_t zeroed = pool_zeroed;
+    spin_unlock_irqrestore(&pool_lock, state);
+
+    printf("zero pool: %zu pages (max %u, low %u)\n", count, ZERO_POOL_MAX, ZERO_POOL_LOW);
+    printf("\thits %" PRIu64 " misses %" PRIu64 " zeroed %" PRIu64 "\n", hits, misses, zeroed);
+    return NO_ERROR;
+}
+
+STATIC_COMMAND_START
+#if LK_DEBUGLEVEL > 0
+STATIC_COMMAND("zpool", "pre-zeroed page pool stats", &cmd_zero_pool)
+#endif
+STATIC_COMMAND_END(zpool);
+
+LK_INIT_HOOK(zero_pool, &zero_pool_init, LK_INIT_LEVEL_THREADING);
@@ -0,0 +1,89 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include "vm_priv.h"
+
+#include <err.h>
+#include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <kernel/thread.h>
+#include <kernel/vm/vm_object.h>
+#include <lib/console.h>
+#include <lk/init.h>
+#include <string.h>
+#include <trace.h>
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+// Optional background scanner that gives committed pages that are entirely zero back to
+// the pmm. Off by default, set vm.zero_scan_interval=<seconds> on the kernel command line
+// to turn it on.
+
+static uint64_t scan_passes;
+static uint64_t pages_reclaimed;
+
+static int zero_scan_thread(void* arg) {
+    lk_time_t interval = static_cast<lk_time_t>(reinterpret_cast<uintptr_t>(arg));
+
+    for (;;) {
+        thread_sleep(interval);
+
+        size_t count = VmObject::ScanAllForZeroPages(true);
+        LTRACEF("reclaimed %zu pages\n", count);
+
+        scan_passes++;
+        pages_reclaimed += count;
+    }
+
+    return 0;
+}
+
+static void zero_scan_init(uint level) {
+    uint32_t interval = cmdline_get_uint32("vm.zero_scan_interval", 0);
+    if (interval == 0)
+        return;
+
+    lk_time_t interval_ms = static_cast<lk_time_t>(interval) * 1000;
+    thread_t* t = thread_create("zero scan", &zero_scan_thread,
+                                reinterpret_cast<void*>(static_cast<uintptr_t>(interval_ms)),
+                                LOW_PRIORITY, DEFAULT_STACK_SIZE);
+    thread_detach_and_resume(t);
+}
+
+static int cmd_zero_scan(int argc, const cmd_args* argv) {
+    if (argc < 2) {
+    usage:
+        printf("usage:\n");
+        printf("%s stats\n", argv[0].str);
+        printf("%s count\n", argv[0].str);
+        printf("%s reclaim\n", argv[0].str);
+        return ERR_INTERNAL;
+    }
+
+    if (!strcmp(argv[1].str, "stats")) {
+        printf("%" PRIu64 " background passes, %" PRIu64 " pages reclaimed\n",
+               scan_passes, pages_reclaimed);
+    } else if (!strcmp(argv[1].str, "count")) {
+        size_t count = VmObject::ScanAllForZeroPages(false);
+        printf("%zu zero pages\n", count);
+    } else if (!strcmp(argv[1].str, "reclaim")) {
+        size_t count = VmObject::ScanAllForZeroPages(true);
+        printf("reclaimed %zu zero pages\n", count);
+    } else {
+        printf("unknown command\n");
+        goto usage;
+    }
+
+    return NO_ERROR;
+}
+
+STATIC_COMMAND_START
+#if LK_DEBUGLEVEL > 0
+STATIC_COMMAND("zscan", "scan for and reclaim zero pages", &cmd_zero_scan)
+#endif
+STATIC_COMMAND_END(zscan);
+
+LK_INIT_HOOK(zero_scan, &zero_scan_init, LK_INIT_LEVEL_THREADING);
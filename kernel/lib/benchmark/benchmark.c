@@ -0,0 +1,205 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/benchmark.h>
+
+#include <debug.h>
+#include <err.h>
+#include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <lk/init.h>
+#include <platform.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const benchmark_t __start_benchmarks[] __WEAK;
+extern const benchmark_t __stop_benchmarks[] __WEAK;
+
+/* keep a runaway benchmark from overflowing the per-iteration math */
+#define BENCH_MAX_ITERATIONS (1u << 30)
+
+static bool bench_match(const benchmark_t *b, const char *prefix)
+{
+    if (!prefix || !strcmp(prefix, "all"))
+        return true;
+    return !strncmp(b->name, prefix, strlen(prefix));
+}
+
+/* times one call to run() in nanoseconds */
+static uint64_t bench_time(const benchmark_t *b, void *context, uint iterations)
+{
+    if (b->run_timed)
+        return b->run_timed(context, b->arg, iterations);
+
+    lk_bigtime_t start = current_time_hires();
+    b->run(context, b->arg, iterations);
+    return (current_time_hires() - start) * 1000;
+}
+
+/* grows |iterations| until a call takes at least |usecs| */
+static uint bench_calibrate(const benchmark_t *b, void *context, uint usecs)
+{
+    uint64_t target = usecs * 1000ull;
+    uint iterations = 1;
+    for (;;) {
+        uint64_t ns = bench_time(b, context, iterations);
+        if (ns >= target || iterations >= BENCH_MAX_ITERATIONS)
+            return iterations;
+        /* clamp before growing, so the count can't wrap */
+        uint factor = (ns < target / 16) ? 16 : 2;
+        if (iterations > BENCH_MAX_ITERATIONS / factor)
+            iterations = BENCH_MAX_ITERATIONS;
+        else
+            iterations *= factor;
+    }
+}
+
+static void bench_sort(uint64_t *values, uint count)
+{
+    for (uint i = 1; i < count; i++) {
+        uint64_t v = values[i];
+        uint j = i;
+        for (; j > 0 && values[j - 1] > v; j--)
+            values[j] = values[j - 1];
+        values[j] = v;
+    }
+}
+
+/* |values| is sorted; nearest rank */
+static uint64_t bench_percentile(const uint64_t *values, uint count, uint percent)
+{
+    return values[((count - 1) * percent + 50) / 100];
+}
+
+/* prints picoseconds as nanoseconds */
+static void bench_print_ns(const char *key, uint64_t ps)
+{
+    printf(" %s=%" PRIu64 ".%03" PRIu64, key, ps / 1000, ps % 1000);
+}
+
+static void bench_run_one(const benchmark_t *b, const bench_options_t *options, uint64_t *ps)
+{
+    void *context = NULL;
+    if (b->setup) {
+        status_t status = b->setup(b->arg, &context);
+        if (status != NO_ERROR) {
+            printf("BENCH name=%s skipped=%d\n", b->name, status);
+            return;
+        }
+    }
+
+    /* calibrating doubles as the warmup */
+    uint iterations = bench_calibrate(b, context, options->trial_usecs);
+
+    uint64_t sum = 0;
+    for (uint i = 0; i < options->trials; i++) {
+        ps[i] = bench_time(b, context, iterations) * 1000 / iterations;
+        sum += ps[i];
+    }
+
+    if (b->teardown)
+        b->teardown(context);
+
+    bench_sort(ps, options->trials);
+    uint64_t p50 = bench_percentile(ps, options->trials, 50);
+
+    printf("BENCH name=%s iters=%u trials=%u", b->name, iterations, options->trials);
+    bench_print_ns("min", ps[0]);
+    bench_print_ns("p50", p50);
+    bench_print_ns("p90", bench_percentile(ps, options->trials, 90));
+    bench_print_ns("p99", bench_percentile(ps, options->trials, 99));
+    bench_print_ns("max", ps[options->trials - 1]);
+    bench_print_ns("mean", sum / options->trials);
+    printf(" unit=ns");
+    if (b->bytes && p50)
+        printf(" mbps=%" PRIu64, (uint64_t)b->bytes * 1000000 / p50);
+    printf("\n");
+}
+
+uint bench_run(const char *prefix, const bench_options_t *options)
+{
+    bench_options_t opts = *options;
+    if (opts.trials == 0)
+        opts.trials = BENCH_DEFAULT_TRIALS;
+    if (opts.trials > BENCH_MAX_TRIALS)
+        opts.trials = BENCH_MAX_TRIALS;
+    if (opts.trial_usecs == 0)
+        opts.trial_usecs = BENCH_DEFAULT_TRIAL_USECS;
+
+    uint64_t *ps = malloc(opts.trials * sizeof(*ps));
+    if (!ps)
+        return 0;
+
+    uint count = 0;
+    for (const benchmark_t *b = __start_benchmarks; b != __stop_benchmarks; b++) {
+        if (!bench_match(b, prefix))
+            continue;
+        bench_run_one(b, &opts, ps);
+        count++;
+    }
+
+    free(ps);
+    return count;
+}
+
+static void bench_boot_hook(uint level)
+{
+    const char *prefix = cmdline_get("bench.run");
+    if (!prefix)
+        return;
+
+    bench_options_t options = {
+        .trials = cmdline_get_uint32("bench.trials", BENCH_DEFAULT_TRIALS),
+        .trial_usecs = cmdline_get_uint32("bench.usecs", BENCH_DEFAULT_TRIAL_USECS),
+    };
+    dprintf(ALWAYS, "running boot benchmarks matching '%s'\n", prefix);
+    bench_run(prefix, &options);
+}
+
+/* before userspace starts, so it doesn't compete with us */
+LK_INIT_HOOK(benchmark, bench_boot_hook, LK_INIT_LEVEL_APPS - 2);
+
+#if WITH_LIB_CONSOLE
+#include <lib/console.h>
+
+static int cmd_bench(int argc, const cmd_args *argv)
+{
+    bench_options_t options = {
+        .trials = BENCH_DEFAULT_TRIALS,
+        .trial_usecs = BENCH_DEFAULT_TRIAL_USECS,
+    };
+    bool ran = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i].str, "-n") && i + 1 < argc) {
+            options.trials = argv[++i].u;
+        } else if (!strcmp(argv[i].str, "-t") && i + 1 < argc) {
+            options.trial_usecs = argv[++i].u;
+        } else if (!strcmp(argv[i].str, "list")) {
+            for (const benchmark_t *b = __start_benchmarks; b != __stop_benchmarks; b++)
+                printf("%s\n", b->name);
+            return 0;
+        } else if (argv[i].str[0] == '-') {
+            printf("usage: %s [-n trials] [-t trial usecs] [list | all | <name prefix> ...]\n",
+                   argv[0].str);
+            return -1;
+        } else {
+            if (bench_run(argv[i].str, &options) == 0)
+                printf("no benchmarks match '%s'\n", argv[i].str);
+            ran = true;
+        }
+    }
+
+    if (!ran)
+        bench_run(NULL, &options);
+    return 0;
+}
+
+STATIC_COMMAND_START
+STATIC_COMMAND("bench", "run benchmarks", &cmd_bench)
+STATIC_COMMAND_END(benchmark);
+#endif
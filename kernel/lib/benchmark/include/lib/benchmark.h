@@ -0,0 +1,74 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <magenta/compiler.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+__BEGIN_CDECLS
+
+/* In-kernel microbenchmarks.
+ *
+ * A benchmark is registered with BENCHMARK() and run from the "bench"
+ * console command, or at boot with bench.run=<name prefix|all>.  The
+ * harness first grows the number of iterations until one call to run()
+ * takes at least the trial time, then times a number of trials of that
+ * many iterations and prints the time per iteration as a single line:
+ *
+ *   BENCH name=memcpy.4096 iters=2048 trials=20 min=... p50=... p90=...
+ *         p99=... max=... mean=... unit=ns [mbps=...]
+ *
+ * so that runs can be compared by a script.
+ *
+ *   BENCHMARK(memcpy_4k,
+ *             .name = "memcpy.4096",
+ *             .setup = buf_alloc, .run = bench_memcpy, .teardown = buf_free,
+ *             .arg = 4096, .bytes = 4096);
+ */
+
+typedef struct benchmark {
+    const char *name;
+
+    /* optional: sets up *context once, before the first call to run() */
+    status_t (*setup)(uintptr_t arg, void **context);
+    /* performs |iterations| operations; timed by the harness */
+    void (*run)(void *context, uintptr_t arg, uint iterations);
+    /* instead of run(), for benchmarks that only time part of each
+     * operation: returns the nanoseconds they measured */
+    uint64_t (*run_timed)(void *context, uintptr_t arg, uint iterations);
+    /* optional: undoes setup() */
+    void (*teardown)(void *context);
+
+    uintptr_t arg;
+    /* if nonzero, the bytes moved by each operation, for a throughput figure */
+    size_t bytes;
+} benchmark_t;
+
+#define BENCHMARK(_id, ...) \
+    extern const benchmark_t __benchmark_##_id; \
+    const benchmark_t __benchmark_##_id __ALIGNED(sizeof(void *)) __SECTION("benchmarks") = { \
+        __VA_ARGS__ \
+    }
+
+typedef struct bench_options {
+    uint trials;
+    /* the minimum length of a trial, in microseconds */
+    uint trial_usecs;
+} bench_options_t;
+
+#define BENCH_DEFAULT_TRIALS 20
+#define BENCH_MAX_TRIALS 1000
+#define BENCH_DEFAULT_TRIAL_USECS 1000
+
+/* Runs the benchmarks whose names start with |prefix| ("all" or "" for
+ * all of them), returning how many ran. */
+uint bench_run(const char *prefix, const bench_options_t *options);
+
+__END_CDECLS
@@ -8,20 +8,36 @@
 
 #include <err.h>
 #include <dev/udisplay.h>
+#include <kernel/spinlock.h>
 #include <kernel/thread.h>
 #include <lib/user_copy.h>
 #include <lk/init.h>
 #include <platform.h>
 #include <string.h>
 
-#define DLOG_SIZE (64 * 1024)
+// The rings of all the cpus share one budget, so a kernel built for more
+// cpus gets smaller rings rather than using more memory.  Each ring is the
+// largest power of two that fits its share, within DLOG_MIN_SIZE and
+// DLOG_MAX_SIZE.
+#define DLOG_BUDGET (128 * 1024)
+#define DLOG_MIN_SIZE (4 * 1024)
+#define DLOG_MAX_SIZE (64 * 1024)
 
-static uint8_t DLOG_DATA[DLOG_SIZE];
+#define DLOG_FITS(n) (DLOG_BUDGET / SMP_MAX_CPUS >= (n))
+#define DLOG_SIZE (DLOG_FITS(DLOG_MAX_SIZE) ? DLOG_MAX_SIZE :     \
+                   DLOG_FITS(DLOG_MAX_SIZE / 2) ? DLOG_MAX_SIZE / 2 : \
+                   DLOG_FITS(DLOG_MAX_SIZE / 4) ? DLOG_MAX_SIZE / 4 : \
+                   DLOG_FITS(DLOG_MAX_SIZE / 8) ? DLOG_MAX_SIZE / 8 : \
+                   DLOG_MIN_SIZE)
+
+static_assert((DLOG_SIZE & (DLOG_SIZE - 1)) == 0, "dlog rings must be a power of two");
+static_assert(DLOG_SIZE >= DLOG_MAX_ENTRY, "dlog rings must hold the largest record");
+
+static uint8_t DLOG_DATA[SMP_MAX_CPUS][DLOG_SIZE];
 
 static dlog_t DLOG = {
-    .lock = MUTEX_INITIAL_VALUE(DLOG.lock),
     .size = DLOG_SIZE,
-    .data = DLOG_DATA,
+    .readers_lock = MUTEX_INITIAL_VALUE(DLOG.readers_lock),
     .readers = LIST_INITIAL_VALUE(DLOG.readers),
 };
 
@@ -29,13 +45,42 @@ static dlog_t DLOG = {
 
 #define ALIGN8(n) (((n) + 7) & (~7))
 
+// Marks the unused space at the end of a ring when the next record
+// didn't fit there.  Space too small for a record header is unmarked.
+#define DLOG_PAD 0xFFFF
+
+#define RING_DATA(log, ring) (DLOG_DATA[(ring) - (log)->rings])
+#define RING_OFFSET(log, pos) ((size_t)((pos) & ((log)->size - 1)))
 #define REC(ptr, off) ((dlog_record_t*)((ptr) + (off)))
 
-// To avoid complexity with splitting record headers, this is
-// a mostly-circular buffer -- each record has a next index
-// that can be used to advance to the next record, allowing the
-// leftover space not large enough for a full record at the end
-// to be skipped easily.
+// The position after the record at |pos|, which the ring still holds.
+static uint64_t dlog_next(dlog_t* log, dlog_ring_t* ring, uint64_t pos) {
+    size_t off = RING_OFFSET(log, pos);
+    size_t room = log->size - off;
+    if (room < sizeof(dlog_record_t)) {
+        return pos + room;
+    }
+    dlog_record_t* rec = REC(RING_DATA(log, ring), off);
+    if (rec->datalen == DLOG_PAD) {
+        return pos + room;
+    }
+    return pos + ALIGN8(sizeof(dlog_record_t) + rec->datalen);
+}
+
+static void dlog_notify(dlog_t* log) {
+    dlog_reader_t* rdr;
+    mutex_acquire(&log->readers_lock);
+    list_for_every_entry (&log->readers, rdr, dlog_reader_t, node) {
+        event_signal(&rdr->event, false);
+    }
+    mutex_release(&log->readers_lock);
+}
+
+// Records go into the current cpu's ring, overwriting its oldest records
+// when it is full.  With interrupts disabled nothing else writes that ring,
+// so the only shared state a writer touches is the wake flag, and readers
+// are only signalled when one of them has run out of records and is
+// about to wait.
 status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
     dlog_t* log = &DLOG;
 
@@ -50,87 +95,168 @@ status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
     // Keep record headers uint64 aligned
     size_t sz = ALIGN8(len + sizeof(dlog_record_t));
 
-    mutex_acquire(&log->lock);
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
 
-    // Determine location of new record and next record after it
-    uint32_t dst = log->head;
-    uint32_t end = log->head + sz;
-    uint32_t nxt = end;
-    if ((nxt + DLOG_MAX_ENTRY) > log->size) {
-        nxt = 0;
-    }
+    dlog_ring_t* ring = &log->rings[arch_curr_cpu_num()];
+    uint8_t* data = RING_DATA(log, ring);
 
-    // Advance our tail if we write past it.
-    if (log->head != log->tail) {
-        while ((log->tail >= dst) && (log->tail < end)) {
-            log->tail = REC(log->data, log->tail)->next;
-        }
+    // Records don't wrap: if this one doesn't fit at the end of the
+    // ring, pad out the end and start over at the beginning.
+    uint64_t start = ring->head;
+    size_t room = log->size - RING_OFFSET(log, start);
+    uint64_t dst = (room < sz) ? start + room : start;
+    uint64_t end = dst + sz;
+
+    // Let readers know what is about to be overwritten before doing it.
+    uint64_t tail = ring->tail;
+    while (tail + log->size < end) {
+        tail = dlog_next(log, ring, tail);
     }
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
 
-    // Notify readers and advance their tails if necessary
-    dlog_reader_t* rdr;
-    list_for_every_entry (&log->readers, rdr, dlog_reader_t, node) {
-        if (rdr->tail == log->head) {
-            // Reader view was empty, point reader's tail
-            // at the message we're writing now
-            rdr->tail = dst;
-        } else {
-            // If we're about to overwrite the message at
-            // the reader's tail, advance that tail.
-            // This will never cause the reader view to be "empty".
-            while ((rdr->tail >= dst) && (rdr->tail < end)) {
-                rdr->tail = REC(log->data, rdr->tail)->next;
-            }
-        }
-        event_signal(&rdr->event, false);
+    if ((dst != start) && (room >= sizeof(dlog_record_t))) {
+        REC(data, RING_OFFSET(log, start))->datalen = DLOG_PAD;
     }
 
-    // Write the new record
-    dlog_record_t* rec = REC(log->data, dst);
-    rec->next = nxt;
+    dlog_record_t* rec = REC(data, RING_OFFSET(log, dst));
+    rec->reserved = 0;
     rec->datalen = len;
     rec->flags = flags;
     rec->timestamp = current_time_hires() * 1000ULL;
     memcpy(rec->data, ptr, len);
 
-    // Advance the head pointer
-    log->head = nxt;
+    __atomic_store_n(&ring->head, end, __ATOMIC_RELEASE);
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 
-    mutex_release(&log->lock);
+    // Pairs with the fence in dlog_wait(): either the reader sees this
+    // record, or we see it waiting.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&log->wake, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&log->wake, 0, __ATOMIC_RELAXED)) {
+        dlog_notify(log);
+    }
     return NO_ERROR;
 }
 
-// TODO: support reading multiple messages at a time
+// Copies the header of the next record in |ring| for the reader at |*pos|,
+// moving |*pos| past any padding and up to the tail if the reader has been
+// overtaken.  Returns false if the reader has read everything.
+static bool dlog_peek(dlog_t* log, dlog_ring_t* ring, uint64_t* pos, dlog_record_t* hdr) {
+    uint8_t* data = RING_DATA(log, ring);
+    for (;;) {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (*pos < tail) {
+            *pos = tail;
+        }
+        if (*pos >= head) {
+            return false;
+        }
+
+        size_t off = RING_OFFSET(log, *pos);
+        size_t room = log->size - off;
+        if (room < sizeof(dlog_record_t)) {
+            *pos += room;
+            continue;
+        }
+        memcpy(hdr, REC(data, off), sizeof(*hdr));
+
+        // Only trust what we copied if the writer hadn't started
+        // overwriting it by the time we were done.
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (*pos < __atomic_load_n(&ring->tail, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        if (hdr->datalen == DLOG_PAD) {
+            *pos += room;
+            continue;
+        }
+        return true;
+    }
+}
+
+// Copies the record at |pos| into |rec|, which has room for DLOG_MAX_ENTRY
+// bytes.  Returns false if it was overwritten in the meantime.
+static bool dlog_copy(dlog_t* log, dlog_ring_t* ring, uint64_t pos, dlog_record_t* rec) {
+    dlog_record_t* src = REC(RING_DATA(log, ring), RING_OFFSET(log, pos));
+    memcpy(rec, src, sizeof(*rec));
+    if (rec->datalen > MAX_DATA_SIZE) {
+        return false;
+    }
+    memcpy(rec->data, src->data, rec->datalen);
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return pos >= __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+}
+
+// Records from the different cpus are merged by timestamp.
 // TODO: filter with flags
 status_t dlog_read_etc(dlog_reader_t* rdr, uint32_t flags, void* ptr, size_t len, bool user) {
     dlog_t* log = rdr->log;
-    status_t r = ERR_BAD_STATE;
+    uint8_t buffer[DLOG_MAX_ENTRY];
+    dlog_record_t* rec = (dlog_record_t*)buffer;
+    size_t done = 0;
+    status_t r = NO_ERROR;
+
+    mutex_acquire(&rdr->lock);
+    while (r == NO_ERROR) {
+        // Find the oldest record not yet read
+        dlog_ring_t* next = NULL;
+        uint64_t timestamp = 0;
+        for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+            dlog_record_t hdr;
+            if (dlog_peek(log, &log->rings[cpu], &rdr->pos[cpu], &hdr) &&
+                ((next == NULL) || (hdr.timestamp < timestamp))) {
+                next = &log->rings[cpu];
+                timestamp = hdr.timestamp;
+            }
+        }
+        if (next == NULL) {
+            break;
+        }
+        uint64_t* pos = &rdr->pos[next - log->rings];
+        if (!dlog_copy(log, next, *pos, rec)) {
+            // Overwritten after we peeked; look again
+            continue;
+        }
 
-    mutex_acquire(&log->lock);
-    if (rdr->tail != log->head) {
-        dlog_record_t* rec = REC(log->data, rdr->tail);
         size_t copylen = rec->datalen + sizeof(dlog_record_t);
-        if (copylen > len) {
-            r = ERR_BUFFER_TOO_SMALL;
-        } else {
-            if (user) {
-                r = copy_to_user_unsafe(ptr, rec, copylen);
-                if (r == NO_ERROR) {
-                    r = copylen;
-                }
-            } else {
-                memcpy(ptr, rec, copylen);
-                r = copylen;
+        if (copylen > len - done) {
+            if (done == 0) {
+                r = ERR_BUFFER_TOO_SMALL;
             }
-            rdr->tail = rec->next;
-            if (rdr->tail == log->head) {
-                // Nothing left to read, we're in the "empty" state now.
-                event_unsignal(&rdr->event);
+            break;
+        }
+        if (user) {
+            r = copy_to_user_unsafe((uint8_t*)ptr + done, rec, copylen);
+        } else {
+            memcpy((uint8_t*)ptr + done, rec, copylen);
+        }
+        if (r == NO_ERROR) {
+            *pos += ALIGN8(copylen);
+            done += ALIGN8(copylen);
+            if (!(flags & DLOG_FLAG_BATCH) || (done >= len)) {
+                break;
             }
         }
     }
-    mutex_release(&log->lock);
-    return r;
+    mutex_release(&rdr->lock);
+
+    if (r != NO_ERROR) {
+        return r;
+    }
+    if (done == 0) {
+        return ERR_BAD_STATE;
+    }
+    // a single record is as long as it is, not padded out, and the padding
+    // after the last record of a batch may not fit in the buffer
+    if (!(flags & DLOG_FLAG_BATCH)) {
+        done = rec->datalen + sizeof(dlog_record_t);
+    }
+    return (done > len) ? len : done;
 }
 
 void dlog_reader_init(dlog_reader_t* rdr) {
@@ -138,27 +264,47 @@ void dlog_reader_init(dlog_reader_t* rdr) {
 
     rdr->log = log;
     event_init(&rdr->event, false, 0);
+    mutex_init(&rdr->lock);
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        rdr->pos[cpu] = __atomic_load_n(&log->rings[cpu].tail, __ATOMIC_RELAXED);
+    }
 
-    mutex_acquire(&log->lock);
+    mutex_acquire(&log->readers_lock);
     list_add_tail(&log->readers, &rdr->node);
-    rdr->tail = log->tail;
-    if (log->head != log->tail) {
-        event_signal(&rdr->event, false);
-    }
-    mutex_release(&log->lock);
+    mutex_release(&log->readers_lock);
 }
 
 void dlog_reader_destroy(dlog_reader_t* rdr) {
     dlog_t* log = rdr->log;
 
-    mutex_acquire(&log->lock);
+    mutex_acquire(&log->readers_lock);
     list_delete(&rdr->node);
     event_destroy(&rdr->event);
-    mutex_release(&log->lock);
+    mutex_release(&log->readers_lock);
+    mutex_destroy(&rdr->lock);
+}
+
+static bool dlog_readable(dlog_reader_t* rdr) {
+    dlog_t* log = rdr->log;
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        if (rdr->pos[cpu] < __atomic_load_n(&log->rings[cpu].head, __ATOMIC_RELAXED)) {
+            return true;
+        }
+    }
+    return false;
 }
 
+// Waits for records the reader hasn't read.  Writers only signal readers
+// when the wake flag is set, so one batch of records costs one wakeup.
 void dlog_wait(dlog_reader_t* rdr) {
-    event_wait(&rdr->event);
+    dlog_t* log = rdr->log;
+
+    event_unsignal(&rdr->event);
+    __atomic_store_n(&log->wake, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!dlog_readable(rdr)) {
+        event_wait(&rdr->event);
+    }
 }
 
 static void cputs(const char* data, size_t len) {
@@ -174,31 +320,35 @@ void __kernel_serial_write(const char *str, size_t len);
 void __kernel_console_write(const char *str, size_t len);
 
 static int debuglog_reader(void* arg) {
-    uint8_t buffer[DLOG_MAX_ENTRY + 1];
+    uint64_t buffer[(4 * DLOG_MAX_ENTRY) / sizeof(uint64_t)];
     char tmp[DLOG_MAX_ENTRY + 64];
-    dlog_record_t* rec = (dlog_record_t*)buffer;
     dlog_reader_t reader;
+    status_t len;
     int n;
 
     dlog_reader_init(&reader);
     for (;;) {
         dlog_wait(&reader);
-        while (dlog_read(&reader, 0, rec, DLOG_MAX_ENTRY) > 0) {
-            if (rec->datalen && (rec->data[rec->datalen - 1] == '\n')) {
-                rec->data[rec->datalen - 1] = 0;
-            } else {
-                rec->data[rec->datalen] = 0;
-            }
-            n = snprintf(tmp, sizeof(tmp), "[%05d.%03d] %c %s\n",
-                         (int) (rec->timestamp / 1000000000ULL),
-                         (int) ((rec->timestamp / 1000000ULL) % 1000ULL),
-                         (rec->flags & DLOG_FLAG_KERNEL) ? 'K' : 'U',
-                         rec->data);
-            if (n > (int)sizeof(tmp)) {
-                n = sizeof(tmp);
+        while ((len = dlog_read(&reader, DLOG_FLAG_BATCH, buffer, sizeof(buffer))) > 0) {
+            for (status_t off = 0; off < len;) {
+                dlog_record_t* rec = (dlog_record_t*)((uint8_t*)buffer + off);
+                off += ALIGN8(sizeof(dlog_record_t) + rec->datalen);
+
+                int datalen = rec->datalen;
+                if (datalen && (rec->data[datalen - 1] == '\n')) {
+                    datalen--;
+                }
+                n = snprintf(tmp, sizeof(tmp), "[%05d.%03d] %c %.*s\n",
+                             (int) (rec->timestamp / 1000000000ULL),
+                             (int) ((rec->timestamp / 1000000ULL) % 1000ULL),
+                             (rec->flags & DLOG_FLAG_KERNEL) ? 'K' : 'U',
+                             datalen, rec->data);
+                if (n > (int)sizeof(tmp)) {
+                    n = sizeof(tmp);
+                }
+                __kernel_console_write(tmp, n);
+                __kernel_serial_write(tmp, n);
             }
-            __kernel_console_write(tmp, n);
-            __kernel_serial_write(tmp, n);
         }
     }
     return NO_ERROR;
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <magenta/compiler.h>
+#include <arch/ops.h>
 #include <kernel/event.h>
 #include <kernel/mutex.h>
 #include <list.h>
@@ -29,35 +30,49 @@ __BEGIN_CDECLS
 #define DLOG_FLAG_MASK      0x0F00
 
 #define DLOG_FLAG_WAIT      0x80000000
+#define DLOG_FLAG_BATCH     0x20000000
 
 #define DLOG_MAX_ENTRY      256
 // clang-format on
 
 typedef struct dlog dlog_t;
+typedef struct dlog_ring dlog_ring_t;
 typedef struct dlog_record dlog_record_t;
 typedef struct dlog_reader dlog_reader_t;
 
-struct dlog {
-    mutex_t lock;
+// Each cpu writes its records into its own ring, with interrupts disabled,
+// so writers never wait for each other.  Positions count bytes written to
+// the ring since boot, so a record at |pos| starts |pos % size| bytes in.
+struct dlog_ring {
+    uint64_t head;      // end of the newest record
+    uint64_t tail;      // start of the oldest record not overwritten
+} __CPU_ALIGN;
 
-    uint32_t size;
-    uint32_t head;
-    uint32_t tail;
+struct dlog {
+    uint32_t size;      // of each ring
     bool paused;
-    void* data;
 
+    // set by a reader about to wait, cleared by the writer that wakes them
+    int wake;
+
+    mutex_t readers_lock;
     struct list_node readers;
+
+    dlog_ring_t rings[SMP_MAX_CPUS];
 };
 
 struct dlog_reader {
     struct list_node node;
     event_t event;
     dlog_t* log;
-    uint32_t tail;
+
+    // serializes reads; the reader's own position in each ring
+    mutex_t lock;
+    uint64_t pos[SMP_MAX_CPUS];
 };
 
 struct dlog_record {
-    uint32_t next;
+    uint32_t reserved;
     uint16_t datalen;
     uint16_t flags;
     uint64_t timestamp;
@@ -67,6 +82,10 @@ struct dlog_record {
 void dlog_reader_init(dlog_reader_t* rdr);
 void dlog_reader_destroy(dlog_reader_t* rdr);
 status_t dlog_write(uint32_t flags, const void* ptr, size_t len);
+
+// Reads the oldest unread record, or with DLOG_FLAG_BATCH as many as fit,
+// oldest first, each starting at a multiple of 8 bytes.  Returns the number
+// of bytes read, or ERR_BAD_STATE if there is nothing to read.
 status_t dlog_read_etc(dlog_reader_t* rdr, uint32_t flags, void* ptr, size_t len, bool user);
 static inline status_t dlog_read(dlog_reader_t* rdr, uint32_t flags, void* ptr, size_t len) {
     return dlog_read_etc(rdr, flags, ptr, len, false);
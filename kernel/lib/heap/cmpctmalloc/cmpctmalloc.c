@@ -12,7 +12,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <arch/ops.h>
 #include <kernel/thread.h>
+#include <kernel/lockstat.h>
 #include <kernel/mutex.h>
 #include <kernel/spinlock.h>
 #include <lib/cmpctmalloc.h>
@@ -24,11 +26,20 @@
 // Allocation strategy takes place with a global mutex.  Freelist entries are
 // kept in linked lists with 8 different sizes per binary order of magnitude
 // and the header size is two words with eager coalescing on free.
+//
+// Small allocations are served from per-CPU caches in front of the global
+// heap, see the "Per-CPU caches" section below.
 
 #if defined(DEBUG) || LK_DEBUGLEVEL > 2
 #define CMPCT_DEBUG
 #endif
 
+// Tag the blocks held in the per-CPU caches, so that a block freed twice is
+// caught instead of being cached, and later handed out, twice.
+#if LK_DEBUGLEVEL > 1
+#define CMPCT_CACHE_DEBUG
+#endif
+
 #define LOCAL_TRACE 0
 
 #define ALLOC_FILL 0x99
@@ -86,7 +97,56 @@ struct heap {
 // Heap static vars.
 static struct heap theheap;
 
+// Per-CPU caches.
+//
+// Each CPU keeps a LIFO list of recently freed blocks for every small size
+// class, linked through the first word of their payloads.  Allocating and
+// freeing small objects then only takes a short per-CPU spinlock; the heap
+// mutex is taken once per batch when a list runs dry (refill) or overflows
+// (spill).  Cached blocks keep their allocated header, so the global heap
+// sees them as in use until they are spilled or drained by cmpct_trim.  With
+// CMPCT_CACHE_DEBUG their left pointer also carries a cached tag, next to
+// the free tag.
+
+// Payload sizes up to this are cached.  Size classes are the allocation
+// buckets: 8-spaced up to 128, then 16-spaced up to 256.
+#define CACHE_MAX_SIZE 256
+#define CACHE_CLASSES 24
+// A class list holding more than this spills half of it back to the heap.
+#define CACHE_LIST_MAX 32
+// A class list that runs dry is refilled with this many blocks.
+#define CACHE_REFILL 16
+
+struct cache_class_stats {
+    uint64_t allocs;   // Allocations of this class.
+    uint64_t hits;     // Of those, served without taking the heap mutex.
+    uint64_t frees;    // Frees kept in the cache.
+    uint64_t refills;  // Batches taken from the heap.
+    uint64_t spills;   // Batches given back to the heap.
+};
+
+struct cpu_cache {
+    spin_lock_t lock;
+    void *lists[CACHE_CLASSES];
+    uint32_t counts[CACHE_CLASSES];
+    struct cache_class_stats stats[CACHE_CLASSES];
+} __CPU_ALIGN;
+
+static struct cpu_cache cpu_caches[SMP_MAX_CPUS];
+
+#if WITH_LOCK_STATS
+LOCK_CLASS_STATIC(heap_lock_class, "heap", LOCK_CLASS_MUTEX, &theheap.lock);
+LOCK_CLASS_STATIC(heap_cache_lock_class, "heap cache", LOCK_CLASS_SPINLOCK, &cpu_caches);
+#endif
+
+// Set by the heap tests, which look at the layout of the global heap.
+static volatile bool cache_bypass;
+
 static ssize_t heap_grow(size_t len, free_t **bucket);
+static void *alloc_locked(size_t size);
+static void free_locked(header_t *header);
+static void cache_drain_locked(void);
+static size_t cache_class_size(int index);
 
 static void lock(void)
 {
@@ -126,6 +186,30 @@ void cmpct_dump(void)
         }
     }
     unlock();
+
+    dprintf(INFO, "\tper-cpu cache:\n");
+    dprintf(INFO, "\t%6s %8s %12s %12s %6s %12s %10s %10s\n",
+            "size", "cached", "allocs", "hits", "hit%", "frees", "refills", "spills");
+    for (int i = 0; i < CACHE_CLASSES; i++) {
+        struct cache_class_stats total = {0};
+        uint32_t cached = 0;
+        for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+            struct cpu_cache *cache = &cpu_caches[cpu];
+            // Unlocked snapshot, good enough for statistics.
+            cached += cache->counts[i];
+            total.allocs += cache->stats[i].allocs;
+            total.hits += cache->stats[i].hits;
+            total.frees += cache->stats[i].frees;
+            total.refills += cache->stats[i].refills;
+            total.spills += cache->stats[i].spills;
+        }
+        if (total.allocs == 0 && total.frees == 0) continue;
+        dprintf(INFO, "\t%6zu %8u %12" PRIu64 " %12" PRIu64 " %5" PRIu64 "%% %12" PRIu64
+                " %10" PRIu64 " %10" PRIu64 "\n",
+                cache_class_size(i), cached, total.allocs, total.hits,
+                total.allocs ? total.hits * 100 / total.allocs : 0,
+                total.frees, total.refills, total.spills);
+    }
 }
 
 // Operates in sizes that don't include the allocation header.
@@ -185,6 +269,33 @@ static int size_to_index_freeing(size_t size)
     return size_to_index_helper(size, &dummy, 0, 0);
 }
 
+// Returns the cache class for an allocation of |size| bytes, and the payload
+// size of blocks in that class, or -1 if it is too big to be cached.
+static int cache_class_allocating(size_t size, size_t *rounded_up_out)
+{
+    if (size > CACHE_MAX_SIZE) return -1;
+    size_t rounded_up;
+    size_to_index_allocating(size, &rounded_up);
+    *rounded_up_out = rounded_up;
+    return size_to_index_freeing(rounded_up);
+}
+
+// Returns the cache class an allocated block with |size| bytes of payload can
+// be kept in, or -1 if it can't be cached.  Blocks that were not split
+// exactly go to the class they can satisfy.
+static int cache_class_freeing(size_t size)
+{
+    if (size > CACHE_MAX_SIZE) return -1;
+    return size_to_index_freeing(size);
+}
+
+// The payload size of blocks handed out by a cache class.
+static size_t cache_class_size(int index)
+{
+    if (index < 15) return (size_t)(index + 1) << 3;
+    return 128 + (size_t)(index - 15) * 16;
+}
+
 static inline header_t *tag_as_free(void *left)
 {
     return (header_t *)((uintptr_t)left | 1);
@@ -200,6 +311,25 @@ static inline header_t *untag(void *left)
     return (header_t *)((uintptr_t)left & ~1);
 }
 
+// The cached tag is set and cleared without the heap lock, while a
+// neighbour being freed under the lock may be updating the same left pointer,
+// so both sides update it atomically.
+#ifdef CMPCT_CACHE_DEBUG
+static inline void tag_as_cached(header_t *header)
+{
+    uintptr_t old = __atomic_fetch_or((uintptr_t *)&header->left, 2, __ATOMIC_RELAXED);
+    DEBUG_ASSERT((old & 2) == 0);  // Double free!
+}
+
+static inline void untag_cached(header_t *header)
+{
+    __atomic_fetch_and((uintptr_t *)&header->left, ~(uintptr_t)2, __ATOMIC_RELAXED);
+}
+#else
+static inline void tag_as_cached(header_t *header) {}
+static inline void untag_cached(header_t *header) {}
+#endif
+
 static inline header_t *right_header(header_t *header)
 {
     return (header_t *)((char *)header + header->size);
@@ -308,8 +438,17 @@ static void *create_allocation_header(
 
 static void FixLeftPointer(header_t *right, header_t *new_left)
 {
+#ifdef CMPCT_CACHE_DEBUG
+    // Keeps the free and cached tags.
+    uintptr_t *word = (uintptr_t *)&right->left;
+    uintptr_t old = __atomic_load_n(word, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(word, &old, ((uintptr_t)new_left & ~3) | (old & 3),
+                                        false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+#else
     int tag = (uintptr_t)right->left & 1;
     right->left = (header_t *)(((uintptr_t)new_left & ~1) | tag);
+#endif
 }
 
 static void WasteFreeMemory(void)
@@ -559,12 +698,51 @@ static void cmpct_test_return_to_os(void)
     ASSERT(remaining == theheap.remaining);
 }
 
+static void cmpct_test_cache(void)
+{
+    ASSERT(cache_class_freeing(CACHE_MAX_SIZE) == CACHE_CLASSES - 1);
+    for (int i = 0; i < CACHE_CLASSES; i++) {
+        size_t size = cache_class_size(i);
+        size_t rounded_up;
+        // On 64 bit the 8 byte class is never allocated from.
+        if (size >= sizeof(free_t) - sizeof(header_t)) {
+            ASSERT(cache_class_allocating(size, &rounded_up) == i);
+            ASSERT(rounded_up == size);
+            ASSERT(cache_class_allocating(size - 1, &rounded_up) == i);
+        }
+        ASSERT(cache_class_freeing(size) == i);
+    }
+
+    // Allocate more than a cache list holds of every class, so that we go
+    // through refills and spills, and check that no block is handed out
+    // twice.
+    static char *ptr[CACHE_LIST_MAX * 3];
+    for (size_t size = 1; size <= CACHE_MAX_SIZE; size += 7) {
+        for (unsigned i = 0; i < countof(ptr); i++) {
+            ptr[i] = cmpct_alloc(size);
+            ASSERT(ptr[i] != NULL);
+            memset(ptr[i], (int)i, size);
+        }
+        for (unsigned i = 0; i < countof(ptr); i++) {
+            for (size_t j = 0; j < size; j++) ASSERT(ptr[i][j] == (char)i);
+            cmpct_free(ptr[i]);
+        }
+    }
+}
+
 void cmpct_test(void)
 {
+    cmpct_test_cache();
+
+    // The remaining tests look at how blocks are laid out in the global heap,
+    // so keep the per-CPU caches out of the way.
+    cmpct_trim();
+    cache_bypass = true;
     cmpct_test_buckets();
     cmpct_test_get_back_newly_freed();
     cmpct_test_return_to_os();
     cmpct_test_trim();
+    cache_bypass = false;
     cmpct_dump();
     void *ptr[16];
 
@@ -653,6 +831,8 @@ void cmpct_trim(void)
     // header. They might be at the start or the end of a block, so we can trim
     // them and free the page(s).
     lock();
+    // Cached blocks pin their neighbours, so give them back first.
+    cache_drain_locked();
     for (int bucket = size_to_index_freeing(PAGE_SIZE);
             bucket < NUMBER_OF_BUCKETS;
             bucket++) {
@@ -719,18 +899,150 @@ void cmpct_trim(void)
     unlock();
 }
 
+// Takes a block from the current CPU's cache, refilling the cache from the
+// heap if it is empty.
+static void *cache_alloc(int index, size_t size)
+{
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+    struct cpu_cache *cache = &cpu_caches[arch_curr_cpu_num()];
+    spin_lock(&cache->lock);
+    cache->stats[index].allocs++;
+    void *result = cache->lists[index];
+    if (result != NULL) {
+        cache->lists[index] = *(void **)result;
+        cache->counts[index]--;
+        cache->stats[index].hits++;
+        untag_cached((header_t *)result - 1);
+    }
+    spin_unlock_restore(&cache->lock, state, SPIN_LOCK_FLAG_INTERRUPTS);
+    if (result != NULL) return result;
+
+    // Miss.  Take a batch from the heap under a single acquisition of the
+    // mutex, keep the first block and cache the rest.
+    lock();
+    result = alloc_locked(size);
+    void *head = NULL;
+    void *tail = NULL;
+    uint32_t count = 0;
+    if (result != NULL) {
+        for (; count < CACHE_REFILL - 1; count++) {
+            void *block = alloc_locked(size);
+            if (block == NULL) break;
+            tag_as_cached((header_t *)block - 1);
+            *(void **)block = head;
+            head = block;
+            if (tail == NULL) tail = block;
+        }
+    }
+    unlock();
+    if (head == NULL) return result;
+
+    // We may have migrated while we had the mutex, so look up the cache again.
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+    cache = &cpu_caches[arch_curr_cpu_num()];
+    spin_lock(&cache->lock);
+    *(void **)tail = cache->lists[index];
+    cache->lists[index] = head;
+    cache->counts[index] += count;
+    cache->stats[index].refills++;
+    spin_unlock_restore(&cache->lock, state, SPIN_LOCK_FLAG_INTERRUPTS);
+    return result;
+}
+
+// Puts a block in the current CPU's cache, spilling the least recently used
+// half of the class list back to the heap if it gets too long.
+static void cache_free(int index, void *payload)
+{
+    header_t *header = (header_t *)payload - 1;
+    tag_as_cached(header);
+#ifdef CMPCT_DEBUG
+    memset(payload, FREE_FILL, header->size - sizeof(header_t));
+#endif
+    void *spill = NULL;
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+    struct cpu_cache *cache = &cpu_caches[arch_curr_cpu_num()];
+    spin_lock(&cache->lock);
+    *(void **)payload = cache->lists[index];
+    cache->lists[index] = payload;
+    cache->stats[index].frees++;
+    if (++cache->counts[index] > CACHE_LIST_MAX) {
+        void *keep = payload;
+        for (uint32_t i = 1; i < CACHE_LIST_MAX / 2; i++) keep = *(void **)keep;
+        spill = *(void **)keep;
+        *(void **)keep = NULL;
+        cache->counts[index] = CACHE_LIST_MAX / 2;
+        cache->stats[index].spills++;
+    }
+    spin_unlock_restore(&cache->lock, state, SPIN_LOCK_FLAG_INTERRUPTS);
+    if (spill == NULL) return;
+
+    lock();
+    while (spill != NULL) {
+        void *next = *(void **)spill;
+        untag_cached((header_t *)spill - 1);
+        free_locked((header_t *)spill - 1);
+        spill = next;
+    }
+    unlock();
+}
+
+// Gives every cached block back to the heap.  Called with the lock.
+static void cache_drain_locked(void)
+{
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        struct cpu_cache *cache = &cpu_caches[cpu];
+        for (int i = 0; i < CACHE_CLASSES; i++) {
+            spin_lock_saved_state_t state;
+            spin_lock_irqsave(&cache->lock, state);
+            void *list = cache->lists[i];
+            cache->lists[i] = NULL;
+            cache->counts[i] = 0;
+            spin_unlock_irqrestore(&cache->lock, state);
+            while (list != NULL) {
+                void *next = *(void **)list;
+                untag_cached((header_t *)list - 1);
+                free_locked((header_t *)list - 1);
+                list = next;
+            }
+        }
+    }
+}
+
 void *cmpct_alloc(size_t size)
 {
     if (size == 0u) return NULL;
 
+    if (!cache_bypass) {
+        size_t rounded_up;
+        int index = cache_class_allocating(size, &rounded_up);
+        if (index >= 0) {
+            void *result = cache_alloc(index, rounded_up);
+#ifdef CMPCT_DEBUG
+            if (result != NULL) memset(result, ALLOC_FILL, size);
+#endif
+            return result;
+        }
+    }
+
     if (size + sizeof(header_t) > (1u << HEAP_ALLOC_VIRTUAL_BITS)) return large_alloc(size);
 
+    lock();
+    void *result = alloc_locked(size);
+    unlock();
+    return result;
+}
+
+// Allocates from the free lists, growing the heap if needed.  Called with the
+// lock, for sizes below the large allocation threshold.
+static void *alloc_locked(size_t size)
+{
     size_t rounded_up;
     int start_bucket = size_to_index_allocating(size, &rounded_up);
 
     rounded_up += sizeof(header_t);
 
-    lock();
     int bucket = find_nonempty_bucket(start_bucket);
     if (bucket == -1) {
         // Grow heap by at least 12% if we can.
@@ -739,7 +1051,6 @@ void *cmpct_alloc(size_t size)
                                 MAX(HEAP_GROW_SIZE, rounded_up)));
         while (heap_grow(growby, NULL) < 0) {
             if (growby <= rounded_up) {
-                unlock();
                 return NULL;
             }
             growby = MAX(growby >> 1, rounded_up);
@@ -769,7 +1080,6 @@ void *cmpct_alloc(size_t size)
     memset(result, ALLOC_FILL, size);
     memset(((char *)result) + size, PADDING_FILL, rounded_up - size - sizeof(header_t));
 #endif
-    unlock();
     return result;
 }
 
@@ -807,8 +1117,23 @@ void cmpct_free(void *payload)
     if (payload == NULL) return;
     header_t *header = (header_t *)payload - 1;
     DEBUG_ASSERT(!is_tagged_as_free(header));  // Double free!
-    size_t size = header->size;
+    if (!cache_bypass) {
+        int index = cache_class_freeing(header->size - sizeof(header_t));
+        if (index >= 0) {
+            cache_free(index, payload);
+            return;
+        }
+    }
     lock();
+    free_locked(header);
+    unlock();
+}
+
+// Returns a block to the free lists, coalescing with its neighbours.  Called
+// with the lock.
+static void free_locked(header_t *header)
+{
+    size_t size = header->size;
     header_t *left = header->left;
     if (left != NULL && is_tagged_as_free(left)) {
         // Coalesce with left free object.
@@ -837,7 +1162,6 @@ void cmpct_free(void *payload)
             free_memory(header, left, size);
         }
     }
-    unlock();
 }
 
 void *cmpct_realloc(void *payload, size_t size)
@@ -896,6 +1220,10 @@ void cmpct_init(void)
         theheap.free_list_bits[i] = 0;
     }
 
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        spin_lock_init(&cpu_caches[cpu].lock);
+    }
+
     size_t initial_alloc = HEAP_GROW_SIZE - 2 * sizeof(header_t);
 
     theheap.remaining = 0;
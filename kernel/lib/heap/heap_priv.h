@@ -0,0 +1,25 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <magenta/compiler.h>
+
+__BEGIN_CDECLS
+
+#if HEAP_PROFILE
+
+/* returns the site to charge an allocation of size bytes made by caller */
+uint32_t heap_profile_alloc(void *caller, size_t size);
+
+/* uncharges an allocation made with heap_profile_alloc */
+void heap_profile_free(uint32_t site, size_t size);
+
+#endif
+
+__END_CDECLS
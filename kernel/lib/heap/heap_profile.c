@@ -0,0 +1,173 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/heap.h>
+
+#include <assert.h>
+#include <debug.h>
+#include <err.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <kernel/mutex.h>
+#include <kernel/spinlock.h>
+
+#include "heap_priv.h"
+
+#if HEAP_PROFILE
+
+// Allocation sites are kept in an open addressed hash table keyed by the
+// caller's return address.  Slot 0 is never hashed to and collects the
+// allocations of any sites that do not fit in the table.
+#define SITE_TABLE_SIZE 1024
+#define SITE_OVERFLOW 0
+
+static heap_site_t sites[SITE_TABLE_SIZE];
+static spin_lock_t site_lock = SPIN_LOCK_INITIAL_VALUE;
+
+// Snapshot buffer for heap_profile_get_sites, so it does not have to allocate
+// (and recurse into the profiler) or sort with the spinlock held.
+static heap_site_t snapshot[SITE_TABLE_SIZE];
+static mutex_t snapshot_lock = MUTEX_INITIAL_VALUE(snapshot_lock);
+
+static uint32_t site_hash(uintptr_t caller)
+{
+    uint64_t h = (uint64_t)caller * 0x9e3779b97f4a7c15ull;
+    return (uint32_t)(h >> 32) & (SITE_TABLE_SIZE - 1);
+}
+
+uint32_t heap_profile_alloc(void *caller, size_t size)
+{
+    uintptr_t key = (uintptr_t)caller;
+    uint32_t index = site_hash(key);
+
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&site_lock, state);
+
+    heap_site_t *site = NULL;
+    for (uint32_t probe = 0; probe < SITE_TABLE_SIZE; probe++) {
+        uint32_t i = (index + probe) & (SITE_TABLE_SIZE - 1);
+        if (i == SITE_OVERFLOW) continue;
+        if (sites[i].caller == key || sites[i].caller == 0) {
+            if (sites[i].caller == 0) {
+                sites[i].caller = key;
+                sites[i].min_size = size;
+            }
+            index = i;
+            site = &sites[i];
+            break;
+        }
+    }
+    if (site == NULL) {
+        index = SITE_OVERFLOW;
+        site = &sites[SITE_OVERFLOW];
+        if (site->total_count == 0) site->min_size = size;
+    }
+
+    site->live_bytes += size;
+    site->live_count++;
+    site->total_count++;
+    if (size < site->min_size) site->min_size = size;
+    if (size > site->max_size) site->max_size = size;
+
+    spin_unlock_irqrestore(&site_lock, state);
+    return index;
+}
+
+void heap_profile_free(uint32_t index, size_t size)
+{
+    DEBUG_ASSERT(index < SITE_TABLE_SIZE);
+
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&site_lock, state);
+    DEBUG_ASSERT(sites[index].live_count > 0 && sites[index].live_bytes >= size);
+    sites[index].live_bytes -= size;
+    sites[index].live_count--;
+    spin_unlock_irqrestore(&site_lock, state);
+}
+
+static int cmp_bytes(const void *a, const void *b)
+{
+    const heap_site_t *sa = a, *sb = b;
+    if (sa->live_bytes != sb->live_bytes) return sa->live_bytes > sb->live_bytes ? -1 : 1;
+    if (sa->live_count != sb->live_count) return sa->live_count > sb->live_count ? -1 : 1;
+    return 0;
+}
+
+static int cmp_count(const void *a, const void *b)
+{
+    const heap_site_t *sa = a, *sb = b;
+    if (sa->live_count != sb->live_count) return sa->live_count > sb->live_count ? -1 : 1;
+    if (sa->live_bytes != sb->live_bytes) return sa->live_bytes > sb->live_bytes ? -1 : 1;
+    return 0;
+}
+
+ssize_t heap_profile_get_sites(heap_site_t *out, size_t max, enum heap_site_order order)
+{
+    mutex_acquire(&snapshot_lock);
+
+    size_t count = 0;
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&site_lock, state);
+    for (size_t i = 0; i < SITE_TABLE_SIZE; i++) {
+        // Sites with nothing live are not interesting for leaks or bloat.
+        if (sites[i].live_count != 0) snapshot[count++] = sites[i];
+    }
+    spin_unlock_irqrestore(&site_lock, state);
+
+    qsort(snapshot, count, sizeof(snapshot[0]),
+          order == HEAP_SITE_BY_COUNT ? cmp_count : cmp_bytes);
+
+    memcpy(out, snapshot, MIN(count, max) * sizeof(snapshot[0]));
+
+    mutex_release(&snapshot_lock);
+    return count;
+}
+
+static void dump_sites(const char *title, enum heap_site_order order, heap_site_t *top, size_t count)
+{
+    size_t n = MIN((size_t)heap_profile_get_sites(top, count, order), count);
+    printf("top %zu allocation sites by %s:\n", count, title);
+    printf("%18s %12s %10s %12s %10s %10s\n",
+           "caller", "live bytes", "live", "total", "min size", "max size");
+    for (size_t i = 0; i < n; i++) {
+        printf("%#18" PRIxPTR " %12zu %10zu %12" PRIu64 " %10zu %10zu\n",
+               top[i].caller, top[i].live_bytes, top[i].live_count,
+               top[i].total_count, top[i].min_size, top[i].max_size);
+    }
+}
+
+void heap_profile_dump(size_t count)
+{
+    if (count == 0) {
+        printf("count must be at least 1\n");
+        return;
+    }
+
+    heap_site_t *top = calloc(count, sizeof(*top));
+    if (top == NULL) {
+        printf("not enough memory to list %zu sites\n", count);
+        return;
+    }
+    dump_sites("bytes", HEAP_SITE_BY_BYTES, top, count);
+    dump_sites("count", HEAP_SITE_BY_COUNT, top, count);
+    free(top);
+}
+
+#else // !HEAP_PROFILE
+
+ssize_t heap_profile_get_sites(heap_site_t *out, size_t max, enum heap_site_order order)
+{
+    return ERR_NOT_SUPPORTED;
+}
+
+void heap_profile_dump(size_t count)
+{
+    printf("heap profiling is not built in, build with HEAP_PROFILE=1\n");
+}
+
+#endif
@@ -19,6 +19,8 @@
 #include <lib/console.h>
 #include <lib/page_alloc.h>
 
+#include "heap_priv.h"
+
 #define LOCAL_TRACE 0
 
 /* heap tracing */
@@ -122,6 +124,110 @@ static inline void HEAP_TRIM(void) { dlmalloc_trim(0); }
 #error need to select valid heap implementation or provide wrapper
 #endif
 
+#if HEAP_PROFILE
+/* with profiling every allocation is preceded by a tag naming its call site */
+#define HEAP_PROFILE_MAGIC (0x68707266) // 'hprf'
+
+struct heap_profile_tag {
+    void *base;     /* what the underlying heap returned */
+    size_t size;    /* what the caller asked for */
+    uint32_t site;
+    uint32_t magic;
+};
+static_assert(sizeof(struct heap_profile_tag) % 8 == 0, "");
+
+static void *profile_tag(void *base, size_t offset, size_t size, void *caller)
+{
+    if (base == NULL)
+        return NULL;
+
+    void *ptr = (char *)base + offset;
+    struct heap_profile_tag *tag = (struct heap_profile_tag *)ptr - 1;
+    tag->base = base;
+    tag->size = size;
+    tag->site = heap_profile_alloc(caller, size);
+    tag->magic = HEAP_PROFILE_MAGIC;
+    return ptr;
+}
+
+static struct heap_profile_tag *profile_untag(void *ptr)
+{
+    struct heap_profile_tag *tag = (struct heap_profile_tag *)ptr - 1;
+    ASSERT_MSG(tag->magic == HEAP_PROFILE_MAGIC, "bad heap pointer %p\n", ptr);
+    return tag;
+}
+
+static void *profiled_malloc(size_t size, void *caller)
+{
+    size_t offset = sizeof(struct heap_profile_tag);
+    if (size + offset < size)
+        return NULL;
+    return profile_tag(HEAP_MALLOC(size + offset), offset, size, caller);
+}
+
+static void *profiled_memalign(size_t boundary, size_t size, void *caller)
+{
+    /* keep the payload aligned by padding the tag out to the boundary */
+    size_t offset = ROUNDUP(sizeof(struct heap_profile_tag), MAX(boundary, sizeof(void *)));
+    if (size + offset < size)
+        return NULL;
+    return profile_tag(HEAP_MEMALIGN(boundary, size + offset), offset, size, caller);
+}
+
+static void *profiled_calloc(size_t count, size_t size, void *caller)
+{
+    size_t realsize = count * size;
+    if (size != 0 && realsize / size != count)
+        return NULL;
+    void *ptr = profiled_malloc(realsize, caller);
+    if (ptr)
+        memset(ptr, 0, realsize);
+    return ptr;
+}
+
+static void profiled_free(void *ptr)
+{
+    if (ptr == NULL)
+        return;
+
+    struct heap_profile_tag *tag = profile_untag(ptr);
+    heap_profile_free(tag->site, tag->size);
+    tag->magic = 0;
+    HEAP_FREE(tag->base);
+}
+
+static void *profiled_realloc(void *ptr, size_t size, void *caller)
+{
+    if (ptr == NULL)
+        return profiled_malloc(size, caller);
+    if (size == 0) {
+        profiled_free(ptr);
+        return NULL;
+    }
+
+    /* always move, so the new block is charged to the new caller */
+    size_t old_size = profile_untag(ptr)->size;
+    void *ptr2 = profiled_malloc(size, caller);
+    if (ptr2 == NULL)
+        return NULL;
+    memcpy(ptr2, ptr, MIN(size, old_size));
+    profiled_free(ptr);
+    return ptr2;
+}
+
+#define HEAP_MALLOC_CALLER(s, caller) profiled_malloc(s, caller)
+#define HEAP_MEMALIGN_CALLER(b, s, caller) profiled_memalign(b, s, caller)
+#define HEAP_CALLOC_CALLER(n, s, caller) profiled_calloc(n, s, caller)
+#define HEAP_REALLOC_CALLER(p, s, caller) profiled_realloc(p, s, caller)
+#define HEAP_FREE_TAGGED(p) profiled_free(p)
+#else
+#define HEAP_MALLOC_CALLER(s, caller) HEAP_MALLOC(s)
+#define HEAP_MEMALIGN_CALLER(b, s, caller) HEAP_MEMALIGN(b, s)
+#define HEAP_CALLOC_CALLER(n, s, caller) HEAP_CALLOC(n, s)
+#define HEAP_REALLOC_CALLER(p, s, caller) HEAP_REALLOC(p, s)
+#define HEAP_FREE_TAGGED(p) HEAP_FREE(p)
+#endif
+
 static void heap_free_delayed_list(void)
 {
     struct list_node list;
@@ -139,7 +245,7 @@ static void heap_free_delayed_list(void)
 
     while ((node = list_remove_head(&list))) {
         LTRACEF("freeing node %p\n", node);
-        HEAP_FREE(node);
+        HEAP_FREE_TAGGED(node);
     }
 }
 
@@ -158,7 +264,7 @@ void heap_trim(void)
     HEAP_TRIM();
 }
 
-void *malloc(size_t size)
+void *heap_malloc_caller(size_t size, void *caller)
 {
     DEBUG_ASSERT(!arch_in_int_handler());
 
@@ -169,12 +275,17 @@ void *malloc(size_t size)
         heap_free_delayed_list();
     }
 
-    void *ptr = HEAP_MALLOC(size);
+    void *ptr = HEAP_MALLOC_CALLER(size, caller);
     if (heap_trace)
-        printf("caller %p malloc %zu -> %p\n", __GET_CALLER(), size, ptr);
+        printf("caller %p malloc %zu -> %p\n", caller, size, ptr);
     return ptr;
 }
 
+void *malloc(size_t size)
+{
+    return heap_malloc_caller(size, __GET_CALLER());
+}
+
 void *memalign(size_t boundary, size_t size)
 {
     DEBUG_ASSERT(!arch_in_int_handler());
@@ -186,7 +297,7 @@ void *memalign(size_t boundary, size_t size)
         heap_free_delayed_list();
     }
 
-    void *ptr = HEAP_MEMALIGN(boundary, size);
+    void *ptr = HEAP_MEMALIGN_CALLER(boundary, size, __GET_CALLER());
     if (heap_trace)
         printf("caller %p memalign %zu, %zu -> %p\n", __GET_CALLER(), boundary, size, ptr);
     return ptr;
@@ -203,7 +314,7 @@ void *calloc(size_t count, size_t size)
         heap_free_delayed_list();
     }
 
-    void *ptr = HEAP_CALLOC(count, size);
+    void *ptr = HEAP_CALLOC_CALLER(count, size, __GET_CALLER());
     if (heap_trace)
         printf("caller %p calloc %zu, %zu -> %p\n", __GET_CALLER(), count, size, ptr);
     return ptr;
@@ -220,7 +331,7 @@ void *realloc(void *ptr, size_t size)
         heap_free_delayed_list();
     }
 
-    void *ptr2 = HEAP_REALLOC(ptr, size);
+    void *ptr2 = HEAP_REALLOC_CALLER(ptr, size, __GET_CALLER());
     if (heap_trace)
         printf("caller %p realloc %p, %zu -> %p\n", __GET_CALLER(), ptr, size, ptr2);
     return ptr2;
@@ -234,7 +345,7 @@ void free(void *ptr)
     if (heap_trace)
         printf("caller %p free %p\n", __GET_CALLER(), ptr);
 
-    HEAP_FREE(ptr);
+    HEAP_FREE_TAGGED(ptr);
 }
 
 /* critical section time delayed free */
@@ -342,6 +453,7 @@ notenoughargs:
 usage:
         printf("usage:\n");
         printf("\t%s info\n", argv[0].str);
+        printf("\t%s prof [count]\n", argv[0].str);
         printf("\t%s trace\n", argv[0].str);
         printf("\t%s trim\n", argv[0].str);
         printf("\t%s alloc <size> [alignment]\n", argv[0].str);
@@ -352,6 +464,8 @@ usage:
 
     if (strcmp(argv[1].str, "info") == 0) {
         heap_dump();
+    } else if (strcmp(argv[1].str, "prof") == 0) {
+        heap_profile_dump((argc >= 3) ? argv[2].u : 20);
     } else if (strcmp(argv[1].str, "test") == 0) {
         heap_test();
     } else if (strcmp(argv[1].str, "trace") == 0) {
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include <magenta/compiler.h>
 
@@ -28,4 +29,30 @@ void heap_delayed_free(void *);
 /* tell the heap to return any free pages it can find */
 void heap_trim(void);
 
+/* malloc on behalf of caller, for wrappers such as operator new */
+void *heap_malloc_caller(size_t size, void *caller) __MALLOC;
+
+/* heap allocation-site profiling, available when built with HEAP_PROFILE=1 */
+typedef struct heap_site {
+    uintptr_t caller;       /* return address of the allocation, 0 for sites that did not fit */
+    size_t live_bytes;      /* bytes currently allocated from this site */
+    size_t live_count;      /* allocations currently live from this site */
+    uint64_t total_count;   /* allocations made from this site since boot */
+    size_t min_size;        /* smallest and largest allocation requested */
+    size_t max_size;
+} heap_site_t;
+
+enum heap_site_order {
+    HEAP_SITE_BY_BYTES,
+    HEAP_SITE_BY_COUNT,
+};
+
+/* copies up to max of the busiest sites into sites, sorted by order.
+ * returns the number of sites with live allocations, which may be more than
+ * max, or ERR_NOT_SUPPORTED if profiling is not built in */
+ssize_t heap_profile_get_sites(heap_site_t *sites, size_t max, enum heap_site_order order);
+
+/* prints the top count sites by bytes and by count */
+void heap_profile_dump(size_t count);
+
 __END_CDECLS;
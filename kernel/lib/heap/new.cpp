@@ -50,13 +50,13 @@ bool AllocChecker::check() {
 }
 
 void *operator new(size_t s, AllocChecker* ac) noexcept {
-    auto mem = malloc(s);
+    auto mem = heap_malloc_caller(s, __GET_CALLER());
     ac->arm(s, mem != nullptr);
     return mem;
 }
 
 void *operator new[](size_t s, AllocChecker* ac) noexcept {
-    auto mem = malloc(s);
+    auto mem = heap_malloc_caller(s, __GET_CALLER());
     ac->arm(s, mem != nullptr);
     return mem;
 }
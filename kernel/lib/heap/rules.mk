@@ -12,6 +12,7 @@ KERNEL_INCLUDES += $(LOCAL_DIR)/include
 MODULE := $(LOCAL_DIR)
 
 MODULE_SRCS += \
+	$(LOCAL_DIR)/heap_profile.c \
 	$(LOCAL_DIR)/heap_wrapper.c \
 	$(LOCAL_DIR)/page_alloc.c \
 	$(LOCAL_DIR)/new.cpp
@@ -29,4 +30,10 @@ endif
 
 KERNEL_DEFINES += LK_HEAP_IMPLEMENTATION=$(LK_HEAP_IMPLEMENTATION)
 
+# record the call site of every live allocation, see heap_profile.c
+HEAP_PROFILE ?= false
+ifeq ($(call TOBOOL,$(HEAP_PROFILE)),true)
+KERNEL_DEFINES += HEAP_PROFILE=1
+endif
+
 include make/module.mk
@@ -6,15 +6,24 @@
 
 #include <debug.h>
 #include <err.h>
+#include <limits.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include <arch/defines.h>
 #include <arch/ops.h>
 #include <arch/user_copy.h>
+#include <kernel/auto_lock.h>
 #include <kernel/cmdline.h>
+#include <kernel/spinlock.h>
 #include <kernel/vm/vm_aspace.h>
+#include <kernel/vm/vm_object.h>
 #include <lib/ktrace.h>
 #include <lk/init.h>
 #include <magenta/user_thread.h>
+#include <mxtl/ref_ptr.h>
+
+#include "ktrace_priv.h"
 
 #if __x86_64__
 extern "C" uint64_t get_tsc_ticks_per_ms(void);
@@ -53,86 +62,370 @@ static void ktrace_report_probes(void) {
     }
 }
 
-typedef struct ktrace_state {
-    // where the next record will be written
-    int offset;
+// Events are written to per-cpu rings of fixed size slots, so a writer only
+// touches its own cpu's cache lines and needs no atomics: the slot is claimed
+// and filled with interrupts disabled, which also keeps the thread on the
+// cpu.  Fixed size slots let a wrapped ring be parsed from its oldest slot.
+// Metadata and name records, which have no timestamp and must survive the
+// rings wrapping, go to a shared area at the front of the buffer.  The whole
+// buffer is a vmo that privileged processes can map read-only; its layout
+// and the published write positions are described in <magenta/ktrace.h>.
+// ktrace_read_user offers the name area followed by the rings merged by
+// timestamp, in the usual record format.
+
+typedef struct ktrace_cpu {
+    // next slot to be written
+    uint32_t next;
+
+    // this cpu's ring of KTRACE_RECSIZE byte slots
+    uint8_t* slots;
+} __ALIGNED(CACHE_LINE) ktrace_cpu_t;
 
+typedef struct ktrace_state {
     // mask of groups we allow, 0 == tracing disabled
     int grpmask;
 
-    // total size of the trace buffer
-    uint32_t bufsize;
+    // overwrite the oldest events when a ring is full, rather than stopping
+    bool ring_mode;
 
-    // offset where tracing was stopped, 0 if tracing active
-    uint32_t marker;
+    // bumped whenever tracing is started or rewound, so that user processes
+    // know to name their events again
+    int generation;
 
-    // raw trace buffer
-    uint8_t* buffer;
+    // usable size of the name area
+    uint32_t namesize;
+
+    // number of slots in each cpu's ring
+    uint32_t ring_slots;
+
+    uint32_t num_cpus;
+
+    // the shared header, at the start of the raw trace buffer
+    ktrace_buffer_header_t* hdr;
+
+    // the name area, after the header
+    uint8_t* names;
+
+    ktrace_cpu_t cpu[SMP_MAX_CPUS];
 } ktrace_state_t;
 
+static_assert(SMP_MAX_CPUS <= KTRACE_BUFFER_MAX_CPUS, "too many cpus for ktrace_buffer_header_t");
+static_assert(sizeof(ktrace_buffer_header_t) <= PAGE_SIZE, "ktrace_buffer_header_t too large");
+
 static ktrace_state_t KTRACE_STATE;
 
+// the buffer, for handing out to user space
+static mxtl::RefPtr<VmObject> ktrace_vmo;
+
+// The merged view is produced on demand.  The reader keeps its place so
+// sequential reads are linear; reading from offset 0 takes a fresh snapshot
+// of the rings, and seeking backwards replays the merge from the start.
+// While tracing in ring mode the writers can overwrite events after the
+// snapshot is taken, so each event is copied out and checked against its
+// ring's head before it is used.  Overwritten events are dropped, and the
+// view is padded out to its snapshot size with zeros, which readers take as
+// the end of the trace.
+typedef struct ktrace_reader {
+    // size of the merged view, and of the name area at its front
+    uint32_t size;
+    uint32_t namelen;
+
+    // offset in the merged view of the next unconsumed event
+    uint32_t pos;
+
+    // each ring's head, oldest slot, and number of slots in the snapshot,
+    // and how many of those have been consumed
+    uint64_t head[SMP_MAX_CPUS];
+    uint32_t first[SMP_MAX_CPUS];
+    uint32_t count[SMP_MAX_CPUS];
+    uint32_t index[SMP_MAX_CPUS];
+
+    // each ring's next unconsumed event, copied out once it has been checked
+    bool staged[SMP_MAX_CPUS];
+    uint8_t next[SMP_MAX_CPUS][KTRACE_RECSIZE];
+
+    uint8_t bounce[1024];
+} ktrace_reader_t;
+
+static ktrace_reader_t KTRACE_READER;
+static mutex_t ktrace_reader_lock = MUTEX_INITIAL_VALUE(ktrace_reader_lock);
+
+static inline int* ktrace_names_len(ktrace_state_t* ks) {
+    return reinterpret_cast<int*>(&ks->hdr->names_len);
+}
+
+static inline ktrace_header_t* ktrace_slot(ktrace_state_t* ks, uint32_t cpu, uint32_t n) {
+    return (ktrace_header_t*) (ks->cpu[cpu].slots + n * KTRACE_RECSIZE);
+}
+
+static void ktrace_reader_rewind(ktrace_reader_t* kr) {
+    kr->pos = kr->namelen;
+    memset(kr->index, 0, sizeof(kr->index));
+    memset(kr->staged, 0, sizeof(kr->staged));
+}
+
+static void ktrace_reader_snapshot(ktrace_state_t* ks, ktrace_reader_t* kr) {
+    uint32_t n = atomic_load(ktrace_names_len(ks));
+    kr->namelen = (n > ks->namesize) ? ks->namesize : n;
+    kr->size = kr->namelen;
+
+    for (uint32_t cpu = 0; cpu < ks->num_cpus; cpu++) {
+        uint64_t head = __atomic_load_n(&ks->hdr->cpu[cpu].head, __ATOMIC_ACQUIRE);
+        kr->head[cpu] = head;
+        if (head > ks->ring_slots) {
+            kr->first[cpu] = (uint32_t)(head % ks->ring_slots);
+            kr->count[cpu] = ks->ring_slots;
+        } else {
+            kr->first[cpu] = 0;
+            kr->count[cpu] = (uint32_t)head;
+        }
+        for (uint32_t i = 0; i < kr->count[cpu]; i++) {
+            uint32_t slot = (kr->first[cpu] + i) % ks->ring_slots;
+            kr->size += KTRACE_LEN(ktrace_slot(ks, cpu, slot)->tag);
+        }
+    }
+
+    ktrace_reader_rewind(kr);
+}
+
+// Copies this ring's next unconsumed event into the reader, skipping any
+// that have been overwritten since the snapshot.  Returns false if the ring
+// has nothing left.
+static bool ktrace_reader_stage(ktrace_state_t* ks, ktrace_reader_t* kr, uint32_t cpu) {
+    // the snapshot's events are numbered from here, event i being in slot
+    // i % ring_slots
+    uint64_t base = kr->head[cpu] - kr->count[cpu];
+
+    while (!kr->staged[cpu] && (kr->index[cpu] < kr->count[cpu])) {
+        uint32_t slot = (kr->first[cpu] + kr->index[cpu]) % ks->ring_slots;
+        memcpy(kr->next[cpu], ktrace_slot(ks, cpu, slot), KTRACE_RECSIZE);
+
+        // the writer publishes head before it starts on the next slot, so
+        // if head hasn't reached this event's slot on the next lap, the copy
+        // is intact.  a head that went backwards means the trace was rewound.
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint64_t head = __atomic_load_n(&ks->hdr->cpu[cpu].head, __ATOMIC_RELAXED);
+        uint64_t seq = base + kr->index[cpu];
+        if ((head < kr->head[cpu]) || (head >= seq + ks->ring_slots)) {
+            if (head < kr->head[cpu]) {
+                kr->index[cpu] = kr->count[cpu];
+            } else {
+                // everything up to the slot being written next is gone too
+                uint64_t oldest = head - ks->ring_slots + 1;
+                uint64_t skip = (oldest > seq) ? (oldest - seq) : 1;
+                uint32_t left = kr->count[cpu] - kr->index[cpu];
+                kr->index[cpu] += (skip < left) ? (uint32_t)skip : left;
+            }
+            continue;
+        }
+
+        uint32_t reclen = KTRACE_LEN(((ktrace_header_t*)kr->next[cpu])->tag);
+        if ((reclen < KTRACE_HDRSIZE) || (reclen > KTRACE_RECSIZE)) {
+            kr->index[cpu]++;
+            continue;
+        }
+        kr->staged[cpu] = true;
+    }
+    return kr->staged[cpu];
+}
+
+// Returns the oldest unconsumed event across all rings, and its cpu.
+static ktrace_header_t* ktrace_reader_peek(ktrace_state_t* ks, ktrace_reader_t* kr,
+                                           uint32_t* cpu_out) {
+    ktrace_header_t* oldest = NULL;
+    for (uint32_t cpu = 0; cpu < ks->num_cpus; cpu++) {
+        if (ktrace_reader_stage(ks, kr, cpu)) {
+            ktrace_header_t* hdr = (ktrace_header_t*)kr->next[cpu];
+            if ((oldest == NULL) || (hdr->ts < oldest->ts)) {
+                oldest = hdr;
+                *cpu_out = cpu;
+            }
+        }
+    }
+    return oldest;
+}
+
 int ktrace_read_user(void* ptr, uint32_t off, uint32_t len) {
     ktrace_state_t* ks = &KTRACE_STATE;
+    ktrace_reader_t* kr = &KTRACE_READER;
 
-    // Buffer size is limited by the marker if set,
-    // otherwise limited by offset (last written point).
-    // Offset can end up pointing past the end, so clip
-    // it to the actual buffer size to be safe.
-    uint32_t max;
-    if (ks->marker) {
-        max = ks->marker;
-    } else {
-        max = ks->offset;
-        if (max > ks->bufsize) {
-            max = ks->bufsize;
-        }
+    if (ks->hdr == NULL) {
+        return 0;
     }
 
+    AutoLock lock(&ktrace_reader_lock);
+
     // null read is a query for trace buffer size
     if (ptr == NULL) {
-        return max;
+        ktrace_reader_snapshot(ks, kr);
+        return kr->size;
+    }
+    if (off == 0) {
+        ktrace_reader_snapshot(ks, kr);
     }
 
     // constrain read to available buffer
-    if (off >= max) {
+    if (off >= kr->size) {
         return 0;
     }
-    if (len > (max - off)) {
-        len = max - off;
+    if (len > (kr->size - off)) {
+        len = kr->size - off;
     }
 
-    if (arch_copy_to_user(ptr, ks->buffer + off, len) != NO_ERROR) {
+    uint8_t* out = static_cast<uint8_t*>(ptr);
+    uint32_t done = 0;
+
+    // the name area is copied straight out
+    if (off < kr->namelen) {
+        done = kr->namelen - off;
+        if (done > len) {
+            done = len;
+        }
+        if (arch_copy_to_user(out, ks->names + off, done) != NO_ERROR) {
+            return ERR_INVALID_ARGS;
+        }
+        out += done;
+    }
+
+    if ((off + done) < kr->pos) {
+        ktrace_reader_rewind(kr);
+    }
+
+    // then events, oldest first, staged through the bounce buffer
+    uint32_t staged = 0;
+    while (done < len) {
+        uint32_t cpu;
+        uint32_t reclen;
+        const uint8_t* src;
+        ktrace_header_t* hdr = ktrace_reader_peek(ks, kr, &cpu);
+        if (hdr != NULL) {
+            reclen = KTRACE_LEN(hdr->tag);
+            src = reinterpret_cast<uint8_t*>(hdr);
+        } else {
+            // events were dropped, pad out to the size the snapshot promised
+            reclen = kr->size - kr->pos;
+            src = NULL;
+        }
+        uint32_t skip = (off + done) - kr->pos;
+        if (skip < reclen) {
+            uint32_t n = reclen - skip;
+            if (n > (len - done)) {
+                n = len - done;
+            }
+            while (n > 0) {
+                if (staged == sizeof(kr->bounce)) {
+                    if (arch_copy_to_user(out, kr->bounce, staged) != NO_ERROR) {
+                        return ERR_INVALID_ARGS;
+                    }
+                    out += staged;
+                    staged = 0;
+                }
+                uint32_t chunk = MIN(n, (uint32_t)sizeof(kr->bounce) - staged);
+                if (src != NULL) {
+                    memcpy(kr->bounce + staged, src + skip, chunk);
+                } else {
+                    memset(kr->bounce + staged, 0, chunk);
+                }
+                staged += chunk;
+                skip += chunk;
+                done += chunk;
+                n -= chunk;
+            }
+            if (skip < reclen) {
+                // the read ends inside this event, leave it for the next one
+                break;
+            }
+        }
+        if (hdr == NULL) {
+            break;
+        }
+        kr->staged[cpu] = false;
+        kr->index[cpu]++;
+        kr->pos += reclen;
+    }
+    if (staged && (arch_copy_to_user(out, kr->bounce, staged) != NO_ERROR)) {
         return ERR_INVALID_ARGS;
     }
-    return len;
+    return done;
+}
+
+status_t ktrace_get_vmo(mxtl::RefPtr<VmObject>* vmo) {
+    if (!ktrace_vmo) {
+        return ERR_NOT_SUPPORTED;
+    }
+    *vmo = ktrace_vmo;
+    return NO_ERROR;
+}
+
+static void ktrace_rewind(ktrace_state_t* ks) {
+    for (uint32_t cpu = 0; cpu < ks->num_cpus; cpu++) {
+        ks->cpu[cpu].next = 0;
+        __atomic_store_n(&ks->hdr->cpu[cpu].head, 0, __ATOMIC_RELEASE);
+    }
+
+    // clear the names so mapped readers can tell where the written ones end,
+    // and roll back to just after the metadata
+    memset(ks->names + KTRACE_RECSIZE * 2, 0, ks->namesize - KTRACE_RECSIZE * 2);
+    atomic_store(ktrace_names_len(ks), KTRACE_RECSIZE * 2);
+}
+
+static void ktrace_next_generation(ktrace_state_t* ks) {
+    // stay positive, since it is handed to user space as a status, and skip
+    // zero, which user processes take to mean they have named nothing yet
+    int old = atomic_load(&ks->generation);
+    while (!atomic_cmpxchg(&ks->generation, &old, (old == INT_MAX) ? 1 : old + 1)) {
+    }
+}
+
+uint32_t ktrace_generation(void) {
+    return static_cast<uint32_t>(atomic_load(&KTRACE_STATE.generation));
+}
+
+bool ktrace_tag_enabled(uint32_t tag) {
+    return (tag & atomic_load(&KTRACE_STATE.grpmask)) != 0;
+}
+
+bool ktrace_ring_mode(void) {
+    return KTRACE_STATE.ring_mode;
+}
+
+static void ktrace_set_ring_mode(ktrace_state_t* ks, bool ring_mode) {
+    ks->ring_mode = ring_mode;
+    ks->hdr->flags = ring_mode ? KTRACE_BUFFER_FLAG_RING : 0;
 }
 
 status_t ktrace_control(uint32_t action, uint32_t options) {
     ktrace_state_t* ks = &KTRACE_STATE;
+    if (ks->hdr == NULL) {
+        return ERR_NOT_SUPPORTED;
+    }
+
     switch (action) {
     case KTRACE_ACTION_START:
+    case KTRACE_ACTION_START_RING:
         options = KTRACE_GRP_TO_MASK(options);
-        ks->marker = 0;
+        ktrace_set_ring_mode(ks, action == KTRACE_ACTION_START_RING);
+        ktrace_next_generation(ks);
         atomic_store(&ks->grpmask, options ? options : KTRACE_GRP_TO_MASK(KTRACE_GRP_ALL));
         ktrace_report_live_threads();
         break;
     case KTRACE_ACTION_STOP: {
         atomic_store(&ks->grpmask, 0);
-        uint32_t n = ks->offset;
-        if (n > ks->bufsize) {
-            ks->marker = ks->bufsize;
-        } else {
-            ks->marker = n;
-        }
+        // freeze the view readers will see
+        AutoLock lock(&ktrace_reader_lock);
+        ktrace_reader_snapshot(ks, &KTRACE_READER);
         break;
     }
     case KTRACE_ACTION_REWIND:
-        // roll back to just after the metadata
-        atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
+        ktrace_rewind(ks);
+        ktrace_next_generation(ks);
         ktrace_report_syscalls();
         ktrace_report_probes();
         break;
+    case KTRACE_ACTION_PROFILE_START:
+        return ktrace_profile_control(true, options);
+    case KTRACE_ACTION_PROFILE_STOP:
+        return ktrace_profile_control(false, 0);
     default:
         return ERR_INVALID_ARGS;
     }
@@ -154,23 +447,52 @@ void ktrace_init(unsigned level) {
 
     mb *= (1024*1024);
 
+    mxtl::RefPtr<VmObject> vmo = VmObject::Create(PMM_ALLOC_FLAG_ANY, mb);
+    if (!vmo) {
+        dprintf(INFO, "ktrace: cannot alloc buffer\n");
+        return;
+    }
+    if (vmo->CommitRange(0, mb) != (int64_t)mb) {
+        dprintf(INFO, "ktrace: cannot commit buffer\n");
+        return;
+    }
+
     status_t status;
+    uint8_t* buffer;
     VmAspace* aspace = VmAspace::kernel_aspace();
-    if ((status = aspace->Alloc("ktrace", mb, (void**)&ks->buffer, 0, VMM_FLAG_COMMIT,
-                                ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE)) < 0) {
-        dprintf(INFO, "ktrace: cannot alloc buffer %d\n", status);
+    if ((status = aspace->MapObject(vmo, "ktrace", 0, mb, (void**)&buffer, 0, VMM_FLAG_COMMIT,
+                                    ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE)) < 0) {
+        dprintf(INFO, "ktrace: cannot map buffer %d\n", status);
         return;
     }
+    ktrace_vmo = mxtl::move(vmo);
+
+    // After the header page, the name area takes up to a sixteenth of the
+    // buffer and the rest is split evenly between the cpus.
+    uint32_t rings = ROUNDUP(mb / 16, PAGE_SIZE);
+    ks->hdr = (ktrace_buffer_header_t*) buffer;
+    ks->names = buffer + PAGE_SIZE;
+    ks->namesize = rings - PAGE_SIZE;
+    ks->num_cpus = arch_max_num_cpus();
+    ks->ring_slots = (mb - rings) / ks->num_cpus / KTRACE_RECSIZE;
+    for (uint32_t cpu = 0; cpu < ks->num_cpus; cpu++) {
+        ks->cpu[cpu].slots = buffer + rings + cpu * ks->ring_slots * KTRACE_RECSIZE;
+    }
 
-    // The last packet written can overhang the end of the buffer,
-    // so we reduce the reported size by the max size of a record
-    ks->bufsize = mb - 256;
+    ks->hdr->version = KTRACE_VERSION;
+    ks->hdr->num_cpus = ks->num_cpus;
+    ks->hdr->names_offset = PAGE_SIZE;
+    ks->hdr->names_size = ks->namesize;
+    ks->hdr->rings_offset = rings;
+    ks->hdr->ring_slots = ks->ring_slots;
+    ktrace_set_ring_mode(ks, cmdline_get_bool("ktrace.ring", false));
 
-    dprintf(INFO, "ktrace: buffer at %p (%u bytes)\n", ks->buffer, mb);
+    dprintf(INFO, "ktrace: buffer at %p (%u bytes, %u cpus, %s)\n", buffer, mb,
+            ks->num_cpus, ks->ring_mode ? "ring" : "one-shot");
 
     // write metadata to the first two event slots
     uint64_t n = ktrace_ticks_per_ms();
-    ktrace_rec_32b_t* rec = (ktrace_rec_32b_t*) ks->buffer;
+    ktrace_rec_32b_t* rec = (ktrace_rec_32b_t*) ks->names;
     rec[0].tag = TAG_VERSION;
     rec[0].a = KTRACE_VERSION;
     rec[1].tag = TAG_TICKS_PER_MS;
@@ -178,7 +500,8 @@ void ktrace_init(unsigned level) {
     rec[1].b = (uint32_t)(n >> 32);
 
     // enable tracing
-    atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
+    atomic_store(ktrace_names_len(ks), KTRACE_RECSIZE * 2);
+    atomic_store(&ks->generation, 1);
     ktrace_report_syscalls();
     ktrace_report_probes();
     atomic_store(&ks->grpmask, KTRACE_GRP_TO_MASK(grpmask));
@@ -187,43 +510,66 @@ void ktrace_init(unsigned level) {
     ktrace_report_live_threads();
 }
 
-void ktrace_tiny(uint32_t tag, uint32_t arg) {
-    uint64_t ts = ktrace_timestamp();
-    ktrace_state_t* ks = &KTRACE_STATE;
-    if (tag & atomic_load(&ks->grpmask)) {
-        tag = (tag & 0xFFFFFFF0) | 2;
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_HDRSIZE)) >= (int)ks->bufsize) {
+// Claims the next slot in this cpu's ring, writes the event and publishes
+// it.  The payload is |args|, as much of it as the tag's length calls for.
+static void ktrace_write(ktrace_state_t* ks, uint32_t tag, uint32_t tid, const uint32_t* args) {
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    uint32_t cpu = arch_curr_cpu_num();
+    ktrace_cpu_t* kc = &ks->cpu[cpu];
+    uint32_t n = kc->next;
+    if (n >= ks->ring_slots) {
+        if (!ks->ring_mode) {
             // if we arrive at the end, stop
             atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_header_t* hdr = (ktrace_header_t*) (ks->buffer + off);
-            hdr->ts = ts;
-            hdr->tag = tag;
-            hdr->tid = arg;
+            goto done;
         }
+        n = 0;
+    }
+    kc->next = n + 1;
+
+    // make sure the head published for the last event is visible before
+    // this one starts overwriting a slot a reader may be copying out
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    {
+        ktrace_header_t* hdr = (ktrace_header_t*) (kc->slots + n * KTRACE_RECSIZE);
+        hdr->ts = ktrace_timestamp();
+        hdr->tag = tag;
+        hdr->tid = tid;
+        memcpy(hdr + 1, args, KTRACE_LEN(tag) - KTRACE_HDRSIZE);
+
+        // only this cpu writes its head
+        uint64_t* head = &ks->hdr->cpu[cpu].head;
+        __atomic_store_n(head, *head + 1, __ATOMIC_RELEASE);
     }
+
+done:
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 }
 
-void* ktrace_open(uint32_t tag) {
-    uint64_t ts = ktrace_timestamp();
+void ktrace_tiny(uint32_t tag, uint32_t arg) {
     ktrace_state_t* ks = &KTRACE_STATE;
-    if (!(tag & atomic_load(&ks->grpmask))) {
-        return NULL;
+    if (tag & atomic_load(&ks->grpmask)) {
+        ktrace_write(ks, (tag & 0xFFFFFFF0) | 2, arg, NULL);
     }
+}
 
-    int off;
-    if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= (int)ks->bufsize) {
-        // if we arrive at the end, stop
-        atomic_store(&ks->grpmask, 0);
-        return NULL;
+void ktrace(uint32_t tag, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    ktrace_state_t* ks = &KTRACE_STATE;
+    if (tag & atomic_load(&ks->grpmask)) {
+        DEBUG_ASSERT(KTRACE_LEN(tag) <= KTRACE_RECSIZE);
+        uint32_t args[4] = { a, b, c, d };
+        ktrace_write(ks, tag, (uint32_t)get_current_thread()->user_tid, args);
     }
+}
 
-    ktrace_header_t* hdr = (ktrace_header_t*) (ks->buffer + off);
-    hdr->ts = ts;
-    hdr->tag = tag;
-    hdr->tid = (uint32_t)get_current_thread()->user_tid;
-    return hdr + 1;
+void ktrace_etc(uint32_t tag, uint32_t tid, const uint32_t* args) {
+    ktrace_state_t* ks = &KTRACE_STATE;
+    if (tag & atomic_load(&ks->grpmask)) {
+        ktrace_write(ks, tag, tid, args);
+    }
 }
 
 void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char* name, bool always) {
@@ -234,18 +580,25 @@ void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char* name,
         // set size to: sizeof(hdr) + len + 1, round up to multiple of 8
         tag = (tag & 0xFFFFFFF0) | ((KTRACE_NAMESIZE + len + 1 + 7) >> 3);
 
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= (int)ks->bufsize) {
-            // if we arrive at the end, stop
-            atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_rec_name_t* rec = (ktrace_rec_name_t*) (ks->buffer + off);
-            rec->tag = tag;
-            rec->id = id;
-            rec->arg = arg;
-            memcpy(rec->name, name, len);
-            rec->name[len] = 0;
-        }
+        // names are rare, so they share one area; when it fills, later names
+        // are dropped but events are still recorded.  the space is claimed
+        // with a compare and swap so that the length never runs past the end
+        // of the area and a full area stays full.
+        int reclen = KTRACE_LEN(tag);
+        int off = atomic_load(ktrace_names_len(ks));
+        do {
+            if (off > (int)ks->namesize - reclen) {
+                return;
+            }
+        } while (!atomic_cmpxchg(ktrace_names_len(ks), &off, off + reclen));
+
+        ktrace_rec_name_t* rec = (ktrace_rec_name_t*) (ks->names + off);
+        rec->id = id;
+        rec->arg = arg;
+        memcpy(rec->name, name, len);
+        rec->name[len] = 0;
+        // the tag goes last, mapped readers take a zero tag as unwritten
+        __atomic_store_n(&rec->tag, tag, __ATOMIC_RELEASE);
     }
 }
 
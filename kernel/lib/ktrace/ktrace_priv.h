@@ -0,0 +1,18 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <err.h>
+#include <stdint.h>
+
+// Writes an event with |tid| in the thread id field, for events that put
+// something else there.  Like ktrace(), does nothing unless the event's
+// group is being traced.
+void ktrace_etc(uint32_t tag, uint32_t tid, const uint32_t* args);
+
+// Starts sampling every |period| ms on every cpu, or stops.
+status_t ktrace_profile_control(bool start, uint32_t period);
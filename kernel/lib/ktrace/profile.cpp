@@ -0,0 +1,188 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <err.h>
+#include <stdint.h>
+
+#include <arch/mmu.h>
+#include <arch/ops.h>
+#include <kernel/auto_lock.h>
+#include <kernel/mp.h>
+#include <kernel/mutex.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread.h>
+#include <kernel/timer.h>
+#include <kernel/vm.h>
+#include <lib/ktrace.h>
+
+#include "ktrace_priv.h"
+
+// Sampling profiler
+//
+// A periodic timer on each cpu marks the cpu as due a sample, and the arch
+// irq code takes it as the timer interrupt returns, since only then is the
+// interrupted pc at hand.  Timers only need a clock, so this works on any
+// machine, emulated ones included.
+
+static mutex_t profile_lock = MUTEX_INITIAL_VALUE(profile_lock);
+static bool profile_running;
+static lk_time_t profile_period;
+static timer_t profile_timer[SMP_MAX_CPUS];
+static volatile bool profile_pending[SMP_MAX_CPUS];
+
+static enum handler_return profile_tick(timer_t* timer, lk_time_t now, void* arg) {
+    profile_pending[arch_curr_cpu_num()] = true;
+    return INT_NO_RESCHEDULE;
+}
+
+static void profile_start_cpu(void* arg) {
+    uint cpu = arch_curr_cpu_num();
+    timer_cancel(&profile_timer[cpu]);
+    timer_set_periodic(&profile_timer[cpu], profile_period, profile_tick, NULL);
+}
+
+static void profile_stop_cpu(void* arg) {
+    uint cpu = arch_curr_cpu_num();
+    timer_cancel(&profile_timer[cpu]);
+    profile_pending[cpu] = false;
+}
+
+status_t ktrace_profile_control(bool start, uint32_t period) {
+    AutoLock lock(&profile_lock);
+
+    if (!profile_running) {
+        for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+            timer_initialize(&profile_timer[cpu]);
+        }
+    }
+    if (start) {
+        profile_period = period ? period : 1;
+        mp_sync_exec(MP_CPU_ALL, profile_start_cpu, NULL);
+    } else if (profile_running) {
+        mp_sync_exec(MP_CPU_ALL, profile_stop_cpu, NULL);
+    }
+    profile_running = start;
+    return NO_ERROR;
+}
+
+// Walks the frame pointer chain of the current thread's kernel stack.  Each
+// frame starts with the caller's frame pointer and the return address, on
+// both x86-64 and arm64.
+static uint32_t profile_walk_kernel(uintptr_t fp, uintptr_t* pcs) {
+    thread_t* t = get_current_thread();
+    if (t->stack == NULL) {
+        return 0;
+    }
+    uintptr_t lo = reinterpret_cast<uintptr_t>(t->stack);
+    uintptr_t hi = lo + t->stack_size;
+
+    uint32_t n = 0;
+    while (n < KTRACE_PROFILE_MAX_FRAMES) {
+        if ((fp < lo) || (fp > hi - 2 * sizeof(uintptr_t)) || (fp & (sizeof(uintptr_t) - 1))) {
+            break;
+        }
+        const uintptr_t* frame = reinterpret_cast<const uintptr_t*>(fp);
+        pcs[n++] = frame[1];
+        // stacks grow down, so callers' frames are at higher addresses
+        if (frame[0] <= fp) {
+            break;
+        }
+        fp = frame[0];
+    }
+    return n;
+}
+
+// Reads a word of the interrupted thread's user stack.  Samples are taken
+// with interrupts disabled, where a page fault can't be taken, so rather than
+// copying from the user address this looks the page up in the page tables
+// and reads it through the kernel's physical map.  A page that isn't present,
+// isn't user accessible or isn't normal cached memory ends the walk, so a
+// frame pointer into an mmio mapping can't make us read device registers.
+// If the page is unmapped while it is being read the sample gets a bogus
+// frame, but nothing faults.
+static bool profile_read_user(arch_aspace_t* aspace, uintptr_t va, uintptr_t* out) {
+    paddr_t pa;
+    uint flags;
+    if (arch_mmu_query(aspace, va, &pa, &flags) != NO_ERROR) {
+        return false;
+    }
+    if (!(flags & ARCH_MMU_FLAG_PERM_USER) ||
+        ((flags & ARCH_MMU_FLAG_CACHE_MASK) != ARCH_MMU_FLAG_CACHED)) {
+        return false;
+    }
+    const uintptr_t* ptr = static_cast<const uintptr_t*>(paddr_to_kvaddr(pa));
+    if (ptr == NULL) {
+        return false;
+    }
+    *out = *ptr;
+    return true;
+}
+
+// The same for user stacks, a word at a time, since an aligned word never
+// straddles a page.  The frame pointer is whatever the thread left in the
+// register, so it is checked against the user address space before the
+// page tables are asked about it.
+static uint32_t profile_walk_user(uintptr_t fp, uintptr_t* pcs) {
+    thread_t* t = get_current_thread();
+    if (t->aspace == NULL) {
+        return 0;
+    }
+    arch_aspace_t* aspace = vmm_get_arch_aspace(t->aspace);
+
+    uint32_t n = 0;
+    while (n < KTRACE_PROFILE_MAX_FRAMES) {
+        if ((fp == 0) || (fp & (sizeof(uintptr_t) - 1))) {
+            break;
+        }
+        if (!is_user_address(fp) || !is_user_address(fp + 2 * sizeof(uintptr_t) - 1)) {
+            break;
+        }
+        uintptr_t frame[2];
+        if (!profile_read_user(aspace, fp, &frame[0]) ||
+            !profile_read_user(aspace, fp + sizeof(uintptr_t), &frame[1])) {
+            break;
+        }
+        pcs[n++] = frame[1];
+        if (frame[0] <= fp) {
+            break;
+        }
+        fp = frame[0];
+    }
+    return n;
+}
+
+void ktrace_profile_irq(uintptr_t pc, uintptr_t fp, bool user) {
+    uint cpu = arch_curr_cpu_num();
+    if (likely(!profile_pending[cpu])) {
+        return;
+    }
+    profile_pending[cpu] = false;
+
+    // gather the frames before writing anything, so the sample and its
+    // frames go out together
+    uintptr_t pcs[KTRACE_PROFILE_MAX_FRAMES];
+    uint32_t n = user ? profile_walk_user(fp, pcs) : profile_walk_kernel(fp, pcs);
+
+    // the sample and its frames must be adjacent in this cpu's ring
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    cpu = arch_curr_cpu_num();
+    thread_t* t = get_current_thread();
+    ktrace(TAG_PROFILE_SAMPLE, static_cast<uint32_t>(pc), static_cast<uint32_t>((uint64_t)pc >> 32),
+           static_cast<uint32_t>(t->user_pid), (n << 16) | ((user ? 1 : 0) << 8) | cpu);
+    for (uint32_t i = 0; i < n; i += 2) {
+        uint64_t pc0 = pcs[i];
+        uint64_t pc1 = (i + 1 < n) ? pcs[i + 1] : 0;
+        uint32_t args[4] = {
+            static_cast<uint32_t>(pc0), static_cast<uint32_t>(pc0 >> 32),
+            static_cast<uint32_t>(pc1), static_cast<uint32_t>(pc1 >> 32),
+        };
+        ktrace_etc(TAG_PROFILE_FRAMES, cpu, args);
+    }
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+}
@@ -83,6 +83,9 @@ public:
 
     mx_status_t Wait(IOP_Packet** packet);
 
+    // true once every handle to the port has been closed, after which Queue() fails
+    bool IsClosed();
+
 private:
     IOPortDispatcher(uint32_t options);
     void FreePackets_NoLock();
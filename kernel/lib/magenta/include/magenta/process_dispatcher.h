@@ -133,6 +133,11 @@ public:
 
     status_t GetThreads(mxtl::Array<mx_record_process_thread_t>* threads);
 
+    status_t GetMemoryInfo(mx_record_process_memory_t* info);
+
+    // list every process in the system
+    static status_t GetProcessList(mxtl::Array<mx_record_process_list_t>* processes);
+
     // exception handling support
     status_t SetExceptionPort(mxtl::RefPtr<ExceptionPort> eport, bool debugger);
     void ResetExceptionPort(bool debugger);
@@ -154,6 +159,12 @@ public:
     uint32_t get_bad_handle_policy() const { return bad_handle_policy_; }
     mx_status_t set_bad_handle_policy(uint32_t new_policy);
 
+    // Counts one user trace record of the given kind against this process's
+    // share of the trace |generation|.  Returns false, without counting it, once
+    // |limit| records of that kind have been written in the generation.
+    enum class TraceQuota { EVENTS, NAMES, COUNT };
+    bool ChargeTraceQuota(TraceQuota quota, uint32_t generation, uint32_t limit);
+
     mx_status_t Map(mxtl::RefPtr<VmObjectDispatcher> vmo, uint32_t vmo_rights,
                     uint64_t offset, mx_size_t len,
                     uintptr_t* ptr, uint32_t flags);
@@ -227,6 +238,10 @@ private:
 
     uint32_t bad_handle_policy_ = MX_POLICY_BAD_HANDLE_IGNORE;
 
+    // user trace records written, by kind: the generation they were written in
+    // in the upper half and how many in the lower half
+    uint64_t trace_quota_[static_cast<size_t>(TraceQuota::COUNT)] = {};
+
     // The user-friendly process name. For debug purposes only.
     char name_[THREAD_NAME_LENGTH / 2] = {};
 
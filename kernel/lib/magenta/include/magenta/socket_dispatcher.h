@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <iovec.h>
 #include <stdint.h>
 
 #include <kernel/mutex.h>
@@ -43,6 +44,11 @@ public:
     mx_ssize_t Read(void* dest, mx_size_t len, bool from_user);
     mx_ssize_t OOB_Read(void* dest, mx_size_t len, bool from_user);
 
+    // Vectored versions of Write() and Read(). The iovecs live in kernel memory but describe
+    // user buffers.
+    mx_ssize_t WriteV(const mx_iovec_t* iov, uint32_t iov_count);
+    mx_ssize_t ReadV(const mx_iovec_t* iov, uint32_t iov_count);
+
     void OnPeerZeroHandles();
 
     status_t UserSignal(uint32_t clear_mask, uint32_t set_mask) final;
@@ -54,10 +60,16 @@ private:
         bool Init(uint32_t len);
         mx_size_t Write(const void* src, mx_size_t len, bool from_user);
         mx_size_t Read(void* dest, mx_size_t len, bool from_user);
+        status_t WriteUserV(const mx_iovec_t* iov, uint32_t iov_count, mx_size_t* written);
+        status_t ReadUserV(const mx_iovec_t* iov, uint32_t iov_count, mx_size_t* read);
         mx_size_t free() const;
         bool empty() const;
 
     private:
+        // The free space and the data in the buffer, as up to two runs each.
+        void FreeRuns(iovec_t runs[2]) const;
+        void DataRuns(iovec_t runs[2]) const;
+
         mx_size_t head_ = 0u;
         mx_size_t tail_ = 0u;
         uint32_t len_pow2_ = 0u;
@@ -70,6 +82,7 @@ private:
     mx_ssize_t WriteHelper(const void* src, mx_size_t len, bool from_user, bool is_oob);
     mx_ssize_t WriteSelf(const void* src, mx_size_t len, bool from_user);
     mx_ssize_t OOB_WriteSelf(const void* src, mx_size_t len, bool from_user);
+    mx_ssize_t WriteSelfV(const mx_iovec_t* iov, uint32_t iov_count);
 
     const uint32_t flags_;
     NonIrqStateTracker state_tracker_;
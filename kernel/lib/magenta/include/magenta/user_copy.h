@@ -6,6 +6,10 @@
 
 #pragma once
 
+#include <iovec.h>
+#include <lib/user_copy.h>
+#include <lib/user_copy/user_ptr.h>
+#include <magenta/syscalls-types.h>
 #include <mxtl/string_piece.h>
 
 status_t magenta_copy_from_user(const void* src, void* dest, size_t len);
@@ -14,3 +18,16 @@ status_t magenta_copy_user_string(const char* src, size_t src_len, char* buf, si
                                   mxtl::StringPiece* sp);
 
 status_t magenta_copy_user_dynamic(const void* src, void** dst, size_t len, size_t max_len);
+
+// Copies in |count| iovecs (at most MX_IOVEC_MAX) from user memory into |iov|, and computes the
+// total length of the buffers they describe. The buffers themselves are not touched.
+status_t magenta_copy_user_iovec(user_ptr<const mx_iovec_t> src, uint32_t count, mx_iovec_t* iov,
+                                 size_t* total_len);
+
+// Pairs up the user buffers in |iov| with the kernel buffers in |kbufs| in order, filling in
+// |vec| with the copies needed to move data between them, in the direction given by |to_user|.
+// Stops when either side runs out or |vec| is full. Returns the number of entries filled in and
+// sets |*len| to the number of bytes they cover.
+size_t magenta_build_user_copy_vec(const mx_iovec_t* iov, uint32_t iov_count,
+                                   const iovec_t* kbufs, uint kbuf_count, bool to_user,
+                                   user_copy_vec_t* vec, size_t max_vec, size_t* len);
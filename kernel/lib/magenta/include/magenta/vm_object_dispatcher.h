@@ -13,6 +13,7 @@
 
 #include <sys/types.h>
 
+class IOPortDispatcher;
 class VmObject;
 class VmAspace;
 
@@ -21,14 +22,22 @@ public:
     static status_t Create(mxtl::RefPtr<VmObject> vmo, mxtl::RefPtr<Dispatcher>* dispatcher,
                            mx_rights_t* rights);
 
+    // create a pager-backed object, which asks for missing pages by queueing
+    // mx_page_request_packet_t packets with |key| on |port|
+    static status_t CreatePaged(uint64_t size, mxtl::RefPtr<IOPortDispatcher> port, uint64_t key,
+                                mxtl::RefPtr<Dispatcher>* dispatcher, mx_rights_t* rights);
+
     ~VmObjectDispatcher() final;
     mx_obj_type_t get_type() const final { return MX_OBJ_TYPE_VMEM; }
+    StateTracker* get_state_tracker() final { return &state_tracker_; }
 
     mx_ssize_t Read(user_ptr<void> user_data, mx_size_t length, uint64_t offset);
     mx_ssize_t Write(user_ptr<const void> user_data, mx_size_t length, uint64_t offset);
     mx_status_t SetSize(uint64_t);
     mx_status_t GetSize(uint64_t* size);
+    mx_status_t GetInfo(mx_record_vmo_t* info);
     mx_status_t RangeOp(uint32_t op, uint64_t offset, uint64_t size, user_ptr<void> buffer, size_t buffer_size, mx_rights_t);
+    mx_status_t Clone(uint32_t options, uint64_t offset, uint64_t size, mxtl::RefPtr<VmObject>* clone_vmo);
 
     // XXX really belongs in process
     mx_status_t Map(mxtl::RefPtr<VmAspace> aspace, uint32_t vmo_rights, uint64_t offset, mx_size_t len,
@@ -37,5 +46,15 @@ public:
 private:
     explicit VmObjectDispatcher(mxtl::RefPtr<VmObject> vmo);
 
+    // queue a range of the object to be committed and mapped by the prefetch thread
+    mx_status_t Prefetch(uint64_t offset, uint64_t size);
+    void DoPrefetch(uint64_t offset, uint64_t size);
+    static int PrefetchThread(void* arg);
+
     mxtl::RefPtr<VmObject> vmo_;
+
+    NonIrqStateTracker state_tracker_;
+
+    // number of prefetch requests queued or running, protected by the prefetch queue lock
+    uint32_t pending_prefetches_ = 0;
 };
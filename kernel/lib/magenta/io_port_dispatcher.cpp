@@ -139,6 +139,11 @@ mx_status_t IOPortDispatcher::Queue(IOP_Packet* packet) {
     return NO_ERROR;
 }
 
+bool IOPortDispatcher::IsClosed() {
+    AutoLock al(&lock_);
+    return no_clients_;
+}
+
 void* IOPortDispatcher::Signal(void* cookie, uint64_t key, mx_signals_t signal) {
     IOP_Signal* node;
     int prev_count;
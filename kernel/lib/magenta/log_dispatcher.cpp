@@ -52,7 +52,7 @@ status_t LogDispatcher::ReadFromUser(void* ptr, size_t len, uint32_t flags) {
         return ERR_BAD_STATE;
     }
     for (;;) {
-        mx_status_t r = dlog_read_user(&reader_, 0, ptr, len);
+        mx_status_t r = dlog_read_user(&reader_, flags & DLOG_FLAG_BATCH, ptr, len);
         if ((r == ERR_BAD_STATE) && (flags & MX_LOG_FLAG_WAIT)) {
             dlog_wait(&reader_);
             continue;
@@ -9,6 +9,7 @@
 #include <trace.h>
 
 #include <kernel/auto_lock.h>
+#include <kernel/lockstat.h>
 #include <kernel/mutex.h>
 
 #include <lk/init.h>
@@ -39,6 +40,9 @@ constexpr size_t kMaxHandleCount = 32 * 1024;
 
 // The handle arena and its mutex.
 mutex_t handle_mutex = MUTEX_INITIAL_VALUE(handle_mutex);
+#if WITH_LOCK_STATS
+LOCK_CLASS_STATIC(handle_mutex_class, "handle_mutex", LOCK_CLASS_MUTEX, &handle_mutex);
+#endif
 mxtl::TypedArena<Handle> handle_arena;
 
 // The system exception port.
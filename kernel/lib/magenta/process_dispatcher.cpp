@@ -14,6 +14,7 @@
 #include <string.h>
 #include <trace.h>
 
+#include <arch/ops.h>
 #include <kernel/auto_lock.h>
 #include <kernel/thread.h>
 #include <kernel/vm.h>
@@ -408,6 +409,38 @@ status_t ProcessDispatcher::GetThreads(mxtl::Array<mx_record_process_thread_t>*
     return NO_ERROR;
 }
 
+status_t ProcessDispatcher::GetMemoryInfo(mx_record_process_memory_t* info) {
+    VmAspace::Usage usage;
+    status_t status = aspace_->GetUsage(&usage);
+    if (status != NO_ERROR)
+        return status;
+
+    info->mapped_bytes = usage.mapped_bytes;
+    info->resident_bytes = usage.resident_bytes;
+    info->committed_bytes = usage.committed_bytes;
+
+    return NO_ERROR;
+}
+
+status_t ProcessDispatcher::GetProcessList(mxtl::Array<mx_record_process_list_t>* out_processes) {
+    AutoLock lock(&global_process_list_mutex_);
+    size_t n = global_process_list_.size_slow();
+    mxtl::Array<mx_record_process_list_t> processes;
+    AllocChecker ac;
+    processes.reset(new (&ac) mx_record_process_list_t[n], n);
+    if (!ac.check())
+        return ERR_NO_MEMORY;
+    size_t i = 0;
+    for (const auto& process : global_process_list_) {
+        processes[i].koid = process.get_koid();
+        strlcpy(processes[i].name, process.name_, sizeof(processes[i].name));
+        ++i;
+    }
+    DEBUG_ASSERT(i == n);
+    *out_processes = mxtl::move(processes);
+    return NO_ERROR;
+}
+
 status_t ProcessDispatcher::SetExceptionPort(mxtl::RefPtr<ExceptionPort> eport, bool debugger) {
     // Lock both |state_lock_| and |exception_lock_| to ensure the process
     // doesn't transition to dead while we're setting the exception handler.
@@ -490,6 +523,22 @@ mx_status_t ProcessDispatcher::set_bad_handle_policy(uint32_t new_policy) {
     return NO_ERROR;
 }
 
+bool ProcessDispatcher::ChargeTraceQuota(TraceQuota quota, uint32_t generation,
+                                         uint32_t limit) {
+    volatile uint64_t* charged = &trace_quota_[static_cast<size_t>(quota)];
+    uint64_t old = atomic_load_u64(charged);
+    for (;;) {
+        // a new generation starts the count over
+        uint32_t count = (static_cast<uint32_t>(old >> 32) == generation)
+                             ? static_cast<uint32_t>(old) : 0;
+        if (count >= limit)
+            return false;
+        uint64_t charge = (static_cast<uint64_t>(generation) << 32) | (count + 1);
+        if (atomic_cmpxchg_u64(charged, &old, charge))
+            return true;
+    }
+}
+
 const char* StateToString(ProcessDispatcher::State state) {
     switch (state) {
     case ProcessDispatcher::State::INITIAL:
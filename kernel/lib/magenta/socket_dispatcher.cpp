@@ -22,6 +22,7 @@
 
 #include <magenta/handle.h>
 #include <magenta/io_port_client.h>
+#include <magenta/user_copy.h>
 
 #define LOCAL_TRACE 0
 
@@ -138,6 +139,56 @@ mx_size_t SocketDispatcher::CBuf::Read(void* dest, mx_size_t len, bool from_user
     return ret;
 }
 
+void SocketDispatcher::CBuf::FreeRuns(iovec_t runs[2]) const {
+    mx_size_t avail = free();
+    mx_size_t first = MIN(valpow2(len_pow2_) - head_, avail);
+    runs[0] = { buf_ + head_, first };
+    runs[1] = { buf_, avail - first };
+}
+
+void SocketDispatcher::CBuf::DataRuns(iovec_t runs[2]) const {
+    mx_size_t used = modpow2((uint)(head_ - tail_), len_pow2_);
+    mx_size_t first = MIN(valpow2(len_pow2_) - tail_, used);
+    runs[0] = { buf_ + tail_, first };
+    runs[1] = { buf_, used - first };
+}
+
+status_t SocketDispatcher::CBuf::WriteUserV(const mx_iovec_t* iov, uint32_t iov_count,
+                                            mx_size_t* written) {
+    iovec_t runs[2];
+    FreeRuns(runs);
+
+    // Gather straight from the user buffers into the ring.
+    user_copy_vec_t vec[MX_IOVEC_MAX + 1];
+    size_t len;
+    size_t count = magenta_build_user_copy_vec(iov, iov_count, runs, countof(runs), false,
+                                               vec, countof(vec), &len);
+    if (copy_from_user_vec_unsafe(vec, count) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+
+    head_ = INC_POINTER(len_pow2_, head_, len);
+    *written = len;
+    return NO_ERROR;
+}
+
+status_t SocketDispatcher::CBuf::ReadUserV(const mx_iovec_t* iov, uint32_t iov_count,
+                                           mx_size_t* read) {
+    iovec_t runs[2];
+    DataRuns(runs);
+
+    // Scatter straight from the ring into the user buffers.
+    user_copy_vec_t vec[MX_IOVEC_MAX + 1];
+    size_t len;
+    size_t count = magenta_build_user_copy_vec(iov, iov_count, runs, countof(runs), true,
+                                               vec, countof(vec), &len);
+    if (copy_to_user_vec_unsafe(vec, count) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+
+    tail_ = INC_POINTER(len_pow2_, tail_, len);
+    *read = len;
+    return NO_ERROR;
+}
+
 // static
 status_t SocketDispatcher::Create(uint32_t flags,
                                   mxtl::RefPtr<Dispatcher>* dispatcher0,
@@ -277,6 +328,44 @@ mx_ssize_t SocketDispatcher::WriteSelf(const void* src, mx_size_t len, bool from
     return st;
 }
 
+mx_ssize_t SocketDispatcher::WriteV(const mx_iovec_t* iov, uint32_t iov_count) {
+    mxtl::RefPtr<SocketDispatcher> other;
+    {
+        AutoLock lock(&lock_);
+        if (!other_)
+            return ERR_REMOTE_CLOSED;
+        other = other_;
+    }
+
+    return other->WriteSelfV(iov, iov_count);
+}
+
+mx_ssize_t SocketDispatcher::WriteSelfV(const mx_iovec_t* iov, uint32_t iov_count) {
+    AutoLock lock(&lock_);
+
+    if (!cbuf_.free())
+        return ERR_SHOULD_WAIT;
+
+    bool was_empty = cbuf_.empty();
+
+    mx_size_t st;
+    status_t status = cbuf_.WriteUserV(iov, iov_count, &st);
+    if (status != NO_ERROR)
+        return status;
+
+    if (st > 0) {
+        if (was_empty)
+            state_tracker_.UpdateSatisfied(0u, MX_SIGNAL_READABLE);
+        if (iopc_)
+            iopc_->Signal(MX_SIGNAL_READABLE, st, &lock_);
+    }
+
+    if (!cbuf_.free())
+        other_->state_tracker_.UpdateSatisfied(MX_SIGNAL_WRITABLE, 0u);
+
+    return st;
+}
+
 mx_ssize_t SocketDispatcher::OOB_WriteSelf(const void* src, mx_size_t len, bool from_user) {
     AutoLock lock(&lock_);
     if (oob_len_)
@@ -316,6 +405,27 @@ mx_ssize_t SocketDispatcher::Read(void* dest, mx_size_t len, bool from_user) {
     return st;
 }
 
+mx_ssize_t SocketDispatcher::ReadV(const mx_iovec_t* iov, uint32_t iov_count) {
+    AutoLock lock(&lock_);
+    if (cbuf_.empty())
+        return ERR_SHOULD_WAIT;
+
+    bool was_full = cbuf_.free() == 0u;
+
+    mx_size_t st;
+    status_t status = cbuf_.ReadUserV(iov, iov_count, &st);
+    if (status != NO_ERROR)
+        return status;
+
+    if (cbuf_.empty())
+        state_tracker_.UpdateSatisfied(MX_SIGNAL_READABLE, 0u);
+
+    if (was_full && (st > 0))
+        other_->state_tracker_.UpdateSatisfied(0u, MX_SIGNAL_WRITABLE);
+
+    return st;
+}
+
 mx_ssize_t SocketDispatcher::OOB_Read(void* dest, mx_size_t len, bool from_user) {
     AutoLock lock(&lock_);
     if (!oob_len_)
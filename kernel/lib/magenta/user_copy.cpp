@@ -6,6 +6,7 @@
 
 #include <new.h>
 #include <stdint.h>
+#include <sys/types.h>
 
 #include <lib/user_copy.h>
 #include <magenta/user_copy.h>
@@ -51,3 +52,61 @@ status_t magenta_copy_user_dynamic(const void* src, void** dest, size_t len, siz
     *dest = buf;
     return NO_ERROR;
 }
+
+status_t magenta_copy_user_iovec(user_ptr<const mx_iovec_t> src, uint32_t count, mx_iovec_t* iov,
+                                 size_t* total_len) {
+    if (count > MX_IOVEC_MAX) return ERR_OUT_OF_RANGE;
+    if (count > 0 && !src) return ERR_INVALID_ARGS;
+
+    if (src.copy_array_from_user(iov, count) != NO_ERROR) return ERR_INVALID_ARGS;
+
+    size_t total = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (iov[i].length > 0 && iov[i].buffer == nullptr) return ERR_INVALID_ARGS;
+        if (total + iov[i].length < total) return ERR_OUT_OF_RANGE;
+        total += iov[i].length;
+    }
+    *total_len = total;
+    return NO_ERROR;
+}
+
+size_t magenta_build_user_copy_vec(const mx_iovec_t* iov, uint32_t iov_count,
+                                   const iovec_t* kbufs, uint kbuf_count, bool to_user,
+                                   user_copy_vec_t* vec, size_t max_vec, size_t* len) {
+    size_t n = 0;
+    size_t total = 0;
+    uint32_t i = 0;
+    size_t iov_offset = 0;
+    uint k = 0;
+    size_t kbuf_offset = 0;
+
+    while (i < iov_count && k < kbuf_count && n < max_vec) {
+        size_t user_left = iov[i].length - iov_offset;
+        if (user_left == 0) {
+            i++;
+            iov_offset = 0;
+            continue;
+        }
+        size_t kernel_left = kbufs[k].iov_len - kbuf_offset;
+        if (kernel_left == 0) {
+            k++;
+            kbuf_offset = 0;
+            continue;
+        }
+
+        size_t chunk = (user_left < kernel_left) ? user_left : kernel_left;
+        uint8_t* user = static_cast<uint8_t*>(iov[i].buffer) + iov_offset;
+        uint8_t* kernel = static_cast<uint8_t*>(kbufs[k].iov_base) + kbuf_offset;
+        vec[n].dst = to_user ? user : kernel;
+        vec[n].src = to_user ? kernel : user;
+        vec[n].len = chunk;
+        n++;
+
+        total += chunk;
+        iov_offset += chunk;
+        kbuf_offset += chunk;
+    }
+
+    *len = total;
+    return n;
+}
@@ -6,6 +6,11 @@
 
 #include <magenta/vm_object_dispatcher.h>
 
+#include <magenta/io_port_dispatcher.h>
+
+#include <kernel/auto_lock.h>
+#include <kernel/event.h>
+#include <kernel/thread.h>
 #include <kernel/vm/vm_aspace.h>
 #include <kernel/vm/vm_object.h>
 
@@ -15,8 +20,63 @@
 #include <inttypes.h>
 #include <trace.h>
 
+#include <mxtl/algorithm.h>
+#include <mxtl/intrusive_double_list.h>
+#include <mxtl/unique_ptr.h>
+
 #define LOCAL_TRACE 0
 
+// largest amount of an object the prefetch thread commits and maps in one go,
+// so that one big request doesn't hold the object's lock for too long
+static const uint64_t kPrefetchChunkSize = 2 * 1024 * 1024;
+
+namespace {
+
+// asks a user space pager for pages by queueing packets on a port
+class PortPageSource final : public VmPageSource {
+public:
+    PortPageSource(mxtl::RefPtr<IOPortDispatcher> port, uint64_t key)
+        : port_(mxtl::move(port)), key_(key) {}
+
+    status_t RequestPage(uint64_t offset) final {
+        mx_page_request_packet_t pkt = {};
+        pkt.hdr.key = key_;
+        pkt.hdr.type = MX_PORT_PKT_TYPE_PAGE_REQUEST;
+        pkt.offset = offset;
+        pkt.length = PAGE_SIZE;
+
+        auto iopk = IOP_Packet::Make(&pkt, sizeof(pkt));
+        if (!iopk)
+            return ERR_NO_MEMORY;
+
+        // fails once the pager has closed all of its handles to the port
+        return port_->Queue(iopk);
+    }
+
+    bool IsClosed() final {
+        return port_->IsClosed();
+    }
+
+private:
+    mxtl::RefPtr<IOPortDispatcher> port_;
+    const uint64_t key_;
+};
+
+struct PrefetchRequest : public mxtl::DoublyLinkedListable<mxtl::unique_ptr<PrefetchRequest>> {
+    mxtl::RefPtr<VmObjectDispatcher> disp;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// queue of outstanding MX_VMO_OP_WILLNEED requests, serviced by a single
+// kernel thread that is created the first time anything is queued
+Mutex prefetch_lock;
+mxtl::DoublyLinkedList<mxtl::unique_ptr<PrefetchRequest>> prefetch_queue;
+event_t prefetch_event = EVENT_INITIAL_VALUE(prefetch_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+thread_t* prefetch_thread;
+
+} // namespace
+
 constexpr mx_rights_t kDefaultVmoRights =
     MX_RIGHT_DUPLICATE | MX_RIGHT_TRANSFER | MX_RIGHT_READ | MX_RIGHT_WRITE | MX_RIGHT_EXECUTE | MX_RIGHT_MAP;
 
@@ -33,8 +93,24 @@ status_t VmObjectDispatcher::Create(mxtl::RefPtr<VmObject> vmo,
     return NO_ERROR;
 }
 
+status_t VmObjectDispatcher::CreatePaged(uint64_t size, mxtl::RefPtr<IOPortDispatcher> port,
+                                         uint64_t key, mxtl::RefPtr<Dispatcher>* dispatcher,
+                                         mx_rights_t* rights) {
+    AllocChecker ac;
+    auto source = mxtl::AdoptRef<VmPageSource>(new (&ac) PortPageSource(mxtl::move(port), key));
+    if (!ac.check())
+        return ERR_NO_MEMORY;
+
+    auto vmo = VmObject::CreatePaged(mxtl::move(source), size);
+    if (!vmo)
+        return ERR_NO_MEMORY;
+
+    return Create(mxtl::move(vmo), dispatcher, rights);
+}
+
 VmObjectDispatcher::VmObjectDispatcher(mxtl::RefPtr<VmObject> vmo)
-    : vmo_(vmo) {}
+    : vmo_(vmo),
+      state_tracker_(true, mx_signals_state_t{MX_VMO_SIGNAL_PREFETCHED, MX_VMO_SIGNAL_PREFETCHED}) {}
 
 VmObjectDispatcher::~VmObjectDispatcher() {}
 
@@ -68,6 +144,31 @@ mx_status_t VmObjectDispatcher::GetSize(uint64_t* size) {
     return NO_ERROR;
 }
 
+mx_status_t VmObjectDispatcher::GetInfo(mx_record_vmo_t* info) {
+    info->size = vmo_->size();
+    info->committed_bytes = vmo_->committed_pages() * PAGE_SIZE;
+
+    return NO_ERROR;
+}
+
+mx_status_t VmObjectDispatcher::Clone(uint32_t options, uint64_t offset, uint64_t size,
+                                      mxtl::RefPtr<VmObject>* clone_vmo) {
+    LTRACEF("options %#x offset %#" PRIx64 " size %#" PRIx64 "\n", options, offset, size);
+
+    // copy-on-write is the only kind of clone right now
+    if (options != MX_VMO_CLONE_COPY_ON_WRITE)
+        return ERR_INVALID_ARGS;
+
+    if (!IS_PAGE_ALIGNED(offset))
+        return ERR_INVALID_ARGS;
+
+    *clone_vmo = vmo_->CloneCOW(offset, size);
+    if (!*clone_vmo)
+        return ERR_NO_MEMORY;
+
+    return NO_ERROR;
+}
+
 mx_status_t VmObjectDispatcher::RangeOp(uint32_t op, uint64_t offset, uint64_t size,
                                         user_ptr<void> buffer, size_t buffer_size, mx_rights_t rights) {
     LTRACEF("op %u offset %#" PRIx64 " size %#" PRIx64
@@ -85,9 +186,16 @@ mx_status_t VmObjectDispatcher::RangeOp(uint32_t op, uint64_t offset, uint64_t s
             // TODO: handle partial commits
             return NO_ERROR;
         }
-        case MX_VMO_OP_DECOMMIT:
-            // TODO: handle
-            return ERR_NOT_SUPPORTED;
+        case MX_VMO_OP_DECOMMIT: {
+            if (!(rights & MX_RIGHT_WRITE))
+                return ERR_ACCESS_DENIED;
+
+            auto decommitted = vmo_->DecommitRange(offset, size);
+            if (decommitted < 0)
+                return static_cast<mx_status_t>(decommitted);
+
+            return NO_ERROR;
+        }
         case MX_VMO_OP_LOCK:
         case MX_VMO_OP_UNLOCK:
             // TODO: handle
@@ -104,11 +212,112 @@ mx_status_t VmObjectDispatcher::RangeOp(uint32_t op, uint64_t offset, uint64_t s
         case MX_VMO_OP_CACHE_SYNC:
             // TODO: handle
             return ERR_NOT_SUPPORTED;
+        case MX_VMO_OP_WILLNEED:
+            if (!(rights & MX_RIGHT_READ))
+                return ERR_ACCESS_DENIED;
+
+            return Prefetch(offset, size);
+        case MX_VMO_OP_SUPPLY:
+            if (!(rights & MX_RIGHT_WRITE))
+                return ERR_ACCESS_DENIED;
+            if (buffer_size < size)
+                return ERR_BUFFER_TOO_SMALL;
+
+            return vmo_->SupplyPages(offset, size, buffer.reinterpret<const void>());
         default:
             return ERR_INVALID_ARGS;
     }
 }
 
+mx_status_t VmObjectDispatcher::Prefetch(uint64_t offset, uint64_t size) {
+    uint64_t vmo_size = vmo_->size();
+    if (offset >= vmo_size)
+        return ERR_OUT_OF_RANGE;
+    if (size == 0)
+        return NO_ERROR;
+
+    // trim the request to the current end of the object
+    size = mxtl::min(size, vmo_size - offset);
+
+    AllocChecker ac;
+    mxtl::unique_ptr<PrefetchRequest> req(new (&ac) PrefetchRequest);
+    if (!ac.check())
+        return ERR_NO_MEMORY;
+
+    req->disp = mxtl::RefPtr<VmObjectDispatcher>(this);
+    req->offset = offset;
+    req->size = size;
+
+    AutoLock lock(&prefetch_lock);
+
+    if (!prefetch_thread) {
+        thread_t* t = thread_create("vmo prefetch", &VmObjectDispatcher::PrefetchThread, nullptr,
+                                    DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+        if (!t)
+            return ERR_NO_MEMORY;
+        thread_detach_and_resume(t);
+        prefetch_thread = t;
+    }
+
+    // the signal drops on the first outstanding request and is raised again
+    // by the prefetch thread once the last one has been serviced
+    if (pending_prefetches_++ == 0)
+        state_tracker_.UpdateSatisfied(MX_VMO_SIGNAL_PREFETCHED, 0u);
+
+    prefetch_queue.push_back(mxtl::move(req));
+    event_signal(&prefetch_event, true);
+
+    return NO_ERROR;
+}
+
+void VmObjectDispatcher::DoPrefetch(uint64_t offset, uint64_t size) {
+    LTRACEF("offset %#" PRIx64 " size %#" PRIx64 "\n", offset, size);
+
+    while (size > 0) {
+        uint64_t len = mxtl::min(size, kPrefetchChunkSize);
+
+        // stop early if the object ran out of memory or was shrunk underneath us,
+        // the pages will simply be faulted in later
+        auto committed = vmo_->Prefetch(offset, len);
+        if (committed < 0) {
+            LTRACEF("prefetch of %#" PRIx64 " failed: %" PRId64 "\n", offset, committed);
+            break;
+        }
+
+        offset += len;
+        size -= len;
+    }
+
+    AutoLock lock(&prefetch_lock);
+
+    DEBUG_ASSERT(pending_prefetches_ > 0);
+    if (--pending_prefetches_ == 0)
+        state_tracker_.UpdateSatisfied(0u, MX_VMO_SIGNAL_PREFETCHED);
+}
+
+int VmObjectDispatcher::PrefetchThread(void*) {
+    for (;;) {
+        __UNUSED status_t err = event_wait(&prefetch_event);
+        DEBUG_ASSERT(err == NO_ERROR);
+
+        for (;;) {
+            mxtl::unique_ptr<PrefetchRequest> req;
+            {
+                AutoLock lock(&prefetch_lock);
+                req = prefetch_queue.pop_front();
+            }
+            if (!req)
+                break;
+
+            req->disp->DoPrefetch(req->offset, req->size);
+
+            // dropping the request may release the last reference to the dispatcher
+        }
+    }
+
+    return 0;
+}
+
 mx_status_t VmObjectDispatcher::Map(mxtl::RefPtr<VmAspace> aspace, uint32_t vmo_rights, uint64_t offset, mx_size_t len,
                                     uintptr_t* _ptr, uint32_t flags) {
     LTRACEF("vmo_rights 0x%x flags 0x%x\n", vmo_rights, flags);
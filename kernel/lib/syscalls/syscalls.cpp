@@ -4,7 +4,9 @@
 // license that can be found in the LICENSE file or at
 // https://opensource.org/licenses/MIT
 
+#include <arch/ops.h>
 #include <err.h>
+#include <kernel/spinlock.h>
 #include <lib/user_copy.h>
 
 #include <magenta/magenta.h>
@@ -29,6 +31,116 @@ int sys_invalid_syscall(void) {
     return ERR_BAD_SYSCALL;
 }
 
+// Always-on syscall statistics.  Each syscall gets a dense index, in
+// syscalls.inc order, into per-cpu counters that are only written by their
+// own cpu with interrupts disabled, so they need no locks or atomics.
+
+enum syscall_index : uint32_t {
+#define MAGENTA_SYSCALL_DEF(nargs64, nargs32, n, ret, name, args...) SYSCALL_INDEX_##name,
+#include <magenta/syscalls.inc>
+    SYSCALL_INDEX_INVALID,
+    SYSCALL_INDEX_COUNT,
+};
+
+// A call fails if it returns a signed type and the result is negative.
+template <typename T>
+static constexpr uint8_t syscall_sign_bit() {
+    return (static_cast<T>(-1) < static_cast<T>(0)) ? sizeof(T) * 8 - 1 : 0;
+}
+
+template <>
+constexpr uint8_t syscall_sign_bit<void>() {
+    return 0;
+}
+
+static const struct {
+    uint32_t num;
+    uint8_t sign_bit;   // 0 if the syscall can't fail
+    const char* name;
+} syscall_info[SYSCALL_INDEX_COUNT] = {
+#define MAGENTA_SYSCALL_DEF(nargs64, nargs32, n, ret, name, args...)                               \
+    { n, syscall_sign_bit<ret>(), #name },
+#include <magenta/syscalls.inc>
+    { UINT32_MAX, syscall_sign_bit<int>(), "invalid" },
+};
+
+struct syscall_stat {
+    uint64_t calls;
+    uint64_t timed_calls;
+    uint64_t errors;
+    uint64_t cycles;
+    uint64_t max_cycles;
+};
+
+struct syscall_cpu_stats {
+    syscall_stat stat[SYSCALL_INDEX_COUNT];
+} __CPU_ALIGN;
+
+static syscall_cpu_stats syscall_stats[SMP_MAX_CPUS];
+
+// A 64-bit cycle count, so long calls don't wrap.  The 32-bit arm cycle
+// counter is all there is there.
+static inline uint64_t syscall_timestamp(void) {
+#if ARCH_X86_64
+    return rdtsc();
+#elif ARCH_ARM64
+    return ARM64_READ_SYSREG(pmccntr_el0);
+#else
+    return arch_cycle_count();
+#endif
+}
+
+static inline void syscall_stats_record(uint32_t index, uint entry_cpu, uint64_t start,
+                                        uint64_t ret) {
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    uint cpu = arch_curr_cpu_num();
+    syscall_stat* s = &syscall_stats[cpu].stat[index];
+    s->calls++;
+    uint8_t sign_bit = syscall_info[index].sign_bit;
+    if (sign_bit && ((ret >> sign_bit) & 1))
+        s->errors++;
+    // cycle counters aren't comparable across cpus everywhere
+    if (cpu == entry_cpu) {
+#if ARCH_ARM
+        uint64_t cycles = static_cast<uint32_t>(syscall_timestamp() - start);
+#else
+        uint64_t cycles = syscall_timestamp() - start;
+#endif
+        s->timed_calls++;
+        s->cycles += cycles;
+        if (cycles > s->max_cycles)
+            s->max_cycles = cycles;
+    }
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+}
+
+uint32_t syscall_stats_count(void) {
+    return SYSCALL_INDEX_COUNT;
+}
+
+bool syscall_stats_get(uint cpu, uint32_t index, mx_record_syscall_stat_t* rec) {
+    DEBUG_ASSERT(cpu < SMP_MAX_CPUS && index < SYSCALL_INDEX_COUNT);
+
+    const syscall_stat* s = &syscall_stats[cpu].stat[index];
+    uint64_t calls = s->calls;
+    if (calls == 0)
+        return false;
+
+    memset(rec, 0, sizeof(*rec));
+    strlcpy(rec->name, syscall_info[index].name, sizeof(rec->name));
+    rec->num = syscall_info[index].num;
+    rec->cpu = cpu;
+    rec->calls = calls;
+    rec->timed_calls = s->timed_calls;
+    rec->errors = s->errors;
+    rec->cycles = s->cycles;
+    rec->max_cycles = s->max_cycles;
+    return true;
+}
+
 #if ARCH_ARM
 
 using syscall_func = int64_t (*)(uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t e,
@@ -37,6 +149,8 @@ using syscall_func = int64_t (*)(uint32_t a, uint32_t b, uint32_t c, uint32_t d,
 extern "C" void arm_syscall_handler(struct arm_fault_frame* frame) {
     uint64_t ret = 0;
     uint32_t syscall_num = frame->r[12];
+    uint entry_cpu;
+    uint64_t start;
 
     /* check for magic value to differentiate our syscalls */
     if (unlikely((syscall_num & 0xf0f00000) != 0xf0f00000)) {
@@ -47,6 +161,9 @@ extern "C" void arm_syscall_handler(struct arm_fault_frame* frame) {
     }
     syscall_num &= 0x000fffff;
 
+    entry_cpu = arch_curr_cpu_num();
+    start = syscall_timestamp();
+
     /* re-enable interrupts to maintain kernel preemptiveness */
     arch_enable_ints();
 
@@ -57,21 +174,26 @@ extern "C" void arm_syscall_handler(struct arm_fault_frame* frame) {
      * uses them or not, which is safe for simple arg passing.
      */
     syscall_func sfunc;
+    uint32_t index;
 
     switch (syscall_num) {
 #define MAGENTA_SYSCALL_DEF(nargs64, nargs32, n, ret, name, args...)                               \
     case n:                                                                                        \
         sfunc = reinterpret_cast<syscall_func>(sys_##name);                                        \
+        index = SYSCALL_INDEX_##name;                                                              \
         break;
 #include <magenta/syscalls.inc>
         default:
             sfunc = reinterpret_cast<syscall_func>(sys_invalid_syscall);
+            index = SYSCALL_INDEX_INVALID;
     }
 
     /* call the routine */
     ret = sfunc(frame->r[0], frame->r[1], frame->r[2], frame->r[3], frame->r[4],
                          frame->r[5], frame->r[6], frame->r[7]);
 
+    syscall_stats_record(index, entry_cpu, start, ret);
+
     LTRACEF_LEVEL(2, "ret 0x%llx\n", ret);
 
 out:
@@ -103,6 +225,9 @@ extern "C" void arm64_syscall(struct arm64_iframe_long* frame, bool is_64bit, ui
         return;
     }
 
+    uint entry_cpu = arch_curr_cpu_num();
+    uint64_t start = syscall_timestamp();
+
     /* re-enable interrupts to maintain kernel preemptiveness */
     arch_enable_ints();
 
@@ -113,21 +238,26 @@ extern "C" void arm64_syscall(struct arm64_iframe_long* frame, bool is_64bit, ui
      * uses them or not, which is safe for simple arg passing.
      */
     syscall_func sfunc;
+    uint32_t index;
 
     switch (syscall_num) {
 #define MAGENTA_SYSCALL_DEF(nargs64, nargs32, n, ret, name, args...)                               \
     case n:                                                                                        \
         sfunc = reinterpret_cast<syscall_func>(sys_##name);                                        \
+        index = SYSCALL_INDEX_##name;                                                              \
         break;
 #include <magenta/syscalls.inc>
         default:
             sfunc = reinterpret_cast<syscall_func>(sys_invalid_syscall);
+            index = SYSCALL_INDEX_INVALID;
     }
 
     /* call the routine */
     uint64_t ret = sfunc(frame->r[0], frame->r[1], frame->r[2], frame->r[3], frame->r[4],
                          frame->r[5], frame->r[6], frame->r[7]);
 
+    syscall_stats_record(index, entry_cpu, start, ret);
+
     LTRACEF_LEVEL(2, "ret %#" PRIx64 "\n", ret);
 
     /* put the return code back */
@@ -162,7 +292,9 @@ extern "C" uint64_t x86_64_syscall(uint64_t arg1, uint64_t arg2, uint64_t arg3,
     }
     syscall_num &= 0xffffffff;
 
-    ktrace_tiny(TAG_SYSCALL_ENTER, (static_cast<uint32_t>(syscall_num) << 8) | arch_curr_cpu_num());
+    uint entry_cpu = arch_curr_cpu_num();
+    ktrace_tiny(TAG_SYSCALL_ENTER, (static_cast<uint32_t>(syscall_num) << 8) | entry_cpu);
+    uint64_t start = syscall_timestamp();
 
     /* re-enable interrupts to maintain kernel preemptiveness */
     arch_enable_ints();
@@ -175,20 +307,25 @@ extern "C" uint64_t x86_64_syscall(uint64_t arg1, uint64_t arg2, uint64_t arg3,
      * uses them or not, which is safe for simple arg passing.
      */
     syscall_func sfunc;
+    uint32_t index;
 
     switch (syscall_num) {
 #define MAGENTA_SYSCALL_DEF(nargs64, nargs32, n, ret, name, args...)                               \
     case n:                                                                                        \
         sfunc = reinterpret_cast<syscall_func>(sys_##name);                                        \
+        index = SYSCALL_INDEX_##name;                                                              \
         break;
 #include <magenta/syscalls.inc>
         default:
             sfunc = reinterpret_cast<syscall_func>(sys_invalid_syscall);
+            index = SYSCALL_INDEX_INVALID;
     }
 
     /* call the routine */
     uint64_t ret = sfunc(arg1, arg2, arg3, arg4, arg5, arg6, arg7, arg8);
 
+    syscall_stats_record(index, entry_cpu, start, ret);
+
     /* check to see if there are any pending signals */
     thread_process_pending_signals();
 
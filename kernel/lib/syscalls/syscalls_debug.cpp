@@ -13,6 +13,7 @@
 #include <trace.h>
 
 #include <kernel/auto_lock.h>
+#include <kernel/lockstat.h>
 #include <kernel/vm/vm_object.h>
 #include <kernel/vm/vm_region.h>
 
@@ -24,9 +25,11 @@
 #include <lk/init.h>
 #include <platform/debug.h>
 
+#include <magenta/lockstat.h>
 #include <magenta/process_dispatcher.h>
 #include <magenta/thread_dispatcher.h>
 #include <magenta/user_copy.h>
+#include <magenta/vm_object_dispatcher.h>
 
 #include <mxtl/array.h>
 
@@ -293,6 +296,125 @@ mx_status_t sys_ktrace_control(mx_handle_t handle, uint32_t action, uint32_t opt
     return ktrace_control(action, options);
 }
 
+mx_handle_t sys_ktrace_get_vmo(mx_handle_t handle) {
+    // TODO: finer grained validation
+    mx_status_t status;
+    if ((status = validate_resource_handle(handle)) < 0) {
+        return status;
+    }
+
+    mxtl::RefPtr<VmObject> vmo;
+    if ((status = ktrace_get_vmo(&vmo)) != NO_ERROR) {
+        return status;
+    }
+
+    mxtl::RefPtr<Dispatcher> dispatcher;
+    mx_rights_t rights;
+    if ((status = VmObjectDispatcher::Create(mxtl::move(vmo), &dispatcher, &rights)) != NO_ERROR) {
+        return status;
+    }
+    // only the kernel writes the trace buffer
+    rights &= ~(MX_RIGHT_WRITE | MX_RIGHT_EXECUTE);
+
+    HandleUniquePtr vmo_handle(MakeHandle(mxtl::move(dispatcher), rights));
+    if (!vmo_handle) {
+        return ERR_NO_MEMORY;
+    }
+
+    auto up = ProcessDispatcher::GetCurrent();
+    mx_handle_t hv = up->MapHandleToValue(vmo_handle.get());
+    up->AddHandle(mxtl::move(vmo_handle));
+    return hv;
+}
+
+// User events need no resource handle: they can only be tagged as user
+// events and are stamped with the caller's thread and process, so they
+// can't be mistaken for kernel events.  Instead each process only gets a
+// share of the trace between starts and rewinds, so that one process can't
+// fill the shared name area, or in one-shot mode the rings, and crowd out
+// everyone else.  In ring mode old events are overwritten anyway, so events
+// aren't charged there, and nothing is charged while user events are off.
+static constexpr uint32_t kUserTraceEventQuota = 64 * 1024;
+static constexpr uint32_t kUserTraceNameQuota = 256;
+
+// Returns the trace generation, which user processes use to tell when they
+// need to name their events again.
+mx_status_t sys_ktrace_write(uint32_t tag, uint32_t id, uint32_t arg0, uint32_t arg1) {
+    switch (tag) {
+    case TAG_USER_BEGIN:
+    case TAG_USER_END:
+    case TAG_USER_COUNTER:
+    case TAG_USER_FLOW_BEGIN:
+    case TAG_USER_FLOW_STEP:
+    case TAG_USER_FLOW_END:
+        break;
+    default:
+        return ERR_INVALID_ARGS;
+    }
+
+    uint32_t generation = ktrace_generation();
+    if (!ktrace_tag_enabled(tag))
+        return static_cast<mx_status_t>(generation);
+
+    auto up = ProcessDispatcher::GetCurrent();
+    if (!ktrace_ring_mode() &&
+        !up->ChargeTraceQuota(ProcessDispatcher::TraceQuota::EVENTS, generation,
+                              kUserTraceEventQuota))
+        return ERR_NO_RESOURCES;
+
+    auto pid = static_cast<uint32_t>(up->get_koid());
+    ktrace(tag, id, arg0, arg1, pid);
+    return static_cast<mx_status_t>(generation);
+}
+
+mx_status_t sys_ktrace_name(uint32_t id, user_ptr<const char> name, uint32_t len) {
+    // names longer than a name record holds are truncated
+    char buf[32];
+    len = MIN(len, sizeof(buf) - 1);
+    if (magenta_copy_from_user(name.get(), buf, len) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+    buf[len] = 0;
+
+    auto up = ProcessDispatcher::GetCurrent();
+    if (!up->ChargeTraceQuota(ProcessDispatcher::TraceQuota::NAMES, ktrace_generation(),
+                              kUserTraceNameQuota))
+        return ERR_NO_RESOURCES;
+
+    auto pid = static_cast<uint32_t>(up->get_koid());
+    ktrace_name(TAG_USER_NAME, id, pid, buf);
+    return NO_ERROR;
+}
+
+// Returns the number of lock classes copied out, as many as fit in |len|.
+mx_ssize_t sys_lockstat_read(mx_handle_t handle, uint32_t options, user_ptr<void> buffer,
+                             uint32_t len) {
+    // TODO: finer grained validation
+    mx_status_t status;
+    if ((status = validate_resource_handle(handle)) < 0) {
+        return status;
+    }
+
+#if WITH_LOCK_STATS
+    if (options & ~MX_LOCKSTAT_RESET)
+        return ERR_INVALID_ARGS;
+
+    auto out = buffer.reinterpret<mx_lockstat_t>();
+    uint32_t count = 0;
+    mx_lockstat_t stats;
+    while (count < len / sizeof(stats) && lockstat_get(count, &stats)) {
+        if (out.element_offset(count).copy_to_user(stats) != NO_ERROR)
+            return ERR_INVALID_ARGS;
+        count++;
+    }
+
+    if (options & MX_LOCKSTAT_RESET)
+        lockstat_reset();
+    return count;
+#else
+    return ERR_NOT_SUPPORTED;
+#endif
+}
+
 mx_status_t sys_thread_read_state(mx_handle_t handle, uint32_t state_kind,
                                   user_ptr<void> _buffer_ptr, user_ptr<uint32_t> _buffer_len)
 {
@@ -23,6 +23,7 @@
 
 #include <lib/console.h>
 #include <lib/crypto/global_prng.h>
+#include <lib/heap.h>
 #include <lib/ktrace.h>
 #include <lib/user_copy.h>
 #include <lib/user_copy/user_ptr.h>
@@ -40,6 +41,7 @@
 #include <magenta/thread_dispatcher.h>
 #include <magenta/user_copy.h>
 #include <magenta/user_thread.h>
+#include <magenta/vm_object_dispatcher.h>
 #include <magenta/wait_set_dispatcher.h>
 
 #include <mxtl/ref_ptr.h>
@@ -250,6 +252,267 @@ mx_ssize_t sys_object_get_info(mx_handle_t handle, uint32_t topic, uint16_t topi
             size_t result_bytes = thread_offset + (num_to_copy * topic_size);
             return result_bytes;
         }
+        case MX_INFO_PROCESS_MEMORY: {
+            // grab a reference to the dispatcher
+            mxtl::RefPtr<ProcessDispatcher> process;
+            auto error = up->GetDispatcher<ProcessDispatcher>(handle, &process, MX_RIGHT_READ);
+            if (error < 0)
+                return error;
+
+            // test that they've asking for an appropriate version
+            if (topic_size != 0 && topic_size != sizeof(mx_record_process_memory_t))
+                return ERR_INVALID_ARGS;
+
+            // make sure they passed us a buffer
+            if (!_buffer)
+                return ERR_INVALID_ARGS;
+
+            // test that we have at least enough target buffer to support the header and one record
+            if (buffer_size < sizeof(mx_info_header_t) + topic_size)
+                return ERR_BUFFER_TOO_SMALL;
+
+            // build the info structure
+            mx_info_process_memory_t info = {};
+
+            // fill in the header
+            info.hdr.topic = topic;
+            info.hdr.avail_topic_size = sizeof(info.rec);
+            info.hdr.topic_size = topic_size;
+            info.hdr.avail_count = 1;
+            info.hdr.count = 1;
+
+            mx_size_t tocopy;
+            if (topic_size == 0) {
+                // just copy the header
+                tocopy = sizeof(info.hdr);
+            } else {
+                auto err = process->GetMemoryInfo(&info.rec);
+                if (err != NO_ERROR)
+                    return err;
+
+                tocopy = sizeof(info);
+            }
+
+            if (_buffer.copy_array_to_user(&info, tocopy) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+
+            return tocopy;
+        }
+        case MX_INFO_VMO: {
+            // grab a reference to the dispatcher
+            mxtl::RefPtr<VmObjectDispatcher> vmo;
+            auto error = up->GetDispatcher<VmObjectDispatcher>(handle, &vmo, MX_RIGHT_READ);
+            if (error < 0)
+                return error;
+
+            // test that they've asking for an appropriate version
+            if (topic_size != 0 && topic_size != sizeof(mx_record_vmo_t))
+                return ERR_INVALID_ARGS;
+
+            // make sure they passed us a buffer
+            if (!_buffer)
+                return ERR_INVALID_ARGS;
+
+            // test that we have at least enough target buffer to support the header and one record
+            if (buffer_size < sizeof(mx_info_header_t) + topic_size)
+                return ERR_BUFFER_TOO_SMALL;
+
+            // build the info structure
+            mx_info_vmo_t info = {};
+
+            // fill in the header
+            info.hdr.topic = topic;
+            info.hdr.avail_topic_size = sizeof(info.rec);
+            info.hdr.topic_size = topic_size;
+            info.hdr.avail_count = 1;
+            info.hdr.count = 1;
+
+            mx_size_t tocopy;
+            if (topic_size == 0) {
+                // just copy the header
+                tocopy = sizeof(info.hdr);
+            } else {
+                auto err = vmo->GetInfo(&info.rec);
+                if (err != NO_ERROR)
+                    return err;
+
+                tocopy = sizeof(info);
+            }
+
+            if (_buffer.copy_array_to_user(&info, tocopy) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+
+            return tocopy;
+        }
+        case MX_INFO_PROCESS_LIST: {
+            //TODO: list the processes of a job instead
+            // for now there is only the one global list, so listing it takes the root resource
+            mx_status_t status = validate_resource_handle(handle);
+            if (status != NO_ERROR)
+                return status;
+
+            // test that they've asking for an appropriate version
+            if (topic_size != 0 && topic_size != sizeof(mx_record_process_list_t))
+                return ERR_INVALID_ARGS;
+
+            // make sure they passed us a buffer
+            if (!_buffer)
+                return ERR_INVALID_ARGS;
+
+            // test that we have at least enough target buffer to at least support the header
+            if (buffer_size < sizeof(mx_info_header_t))
+                return ERR_BUFFER_TOO_SMALL;
+
+            // as with threads, the list is a snapshot that may be stale by the time the caller
+            // looks at it
+            mxtl::Array<mx_record_process_list_t> processes;
+            status = ProcessDispatcher::GetProcessList(&processes);
+            if (status != NO_ERROR)
+                return status;
+            size_t actual_num_processes = processes.size();
+            if (actual_num_processes > UINT32_MAX)
+                return ERR_BAD_STATE;
+            size_t process_offset = offsetof(mx_info_process_list_t, rec);
+            size_t num_space_for =
+                (buffer_size - process_offset) / sizeof(mx_record_process_list_t);
+            size_t num_to_copy = 0;
+            if (topic_size > 0)
+                num_to_copy = MIN(actual_num_processes, num_space_for);
+
+            mx_info_header_t hdr;
+            hdr.topic = topic;
+            hdr.avail_topic_size = sizeof(mx_record_process_list_t);
+            hdr.topic_size = topic_size;
+            hdr.avail_count = static_cast<uint32_t>(actual_num_processes);
+            hdr.count = static_cast<uint32_t>(num_to_copy);
+
+            if (_buffer.copy_array_to_user(&hdr, sizeof(hdr)) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+            auto process_result_buffer = _buffer.byte_offset(process_offset);
+            if (process_result_buffer.reinterpret<mx_record_process_list_t>().copy_array_to_user(processes.get(), num_to_copy) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+            size_t result_bytes = process_offset + (num_to_copy * topic_size);
+            return result_bytes;
+        }
+        case MX_INFO_KERNEL_HEAP_SITES: {
+            // the callers reveal kernel addresses, so this takes the root resource
+            mx_status_t status = validate_resource_handle(handle);
+            if (status != NO_ERROR)
+                return status;
+
+            // test that they've asking for an appropriate version
+            if (topic_size != 0 && topic_size != sizeof(mx_record_kernel_heap_site_t))
+                return ERR_INVALID_ARGS;
+
+            // make sure they passed us a buffer
+            if (!_buffer)
+                return ERR_INVALID_ARGS;
+
+            // test that we have at least enough target buffer to at least support the header
+            if (buffer_size < sizeof(mx_info_header_t))
+                return ERR_BUFFER_TOO_SMALL;
+
+            size_t site_offset = offsetof(mx_info_kernel_heap_sites_t, rec);
+            size_t num_space_for =
+                (buffer_size - site_offset) / sizeof(mx_record_kernel_heap_site_t);
+            if (topic_size == 0)
+                num_space_for = 0;
+            // the profiler keeps at most this many sites
+            num_space_for = MIN(num_space_for, 1024u);
+
+            mxtl::Array<heap_site_t> sites;
+            if (num_space_for > 0) {
+                AllocChecker ac;
+                sites.reset(new (&ac) heap_site_t[num_space_for], num_space_for);
+                if (!ac.check())
+                    return ERR_NO_MEMORY;
+            }
+            ssize_t actual_num_sites =
+                heap_profile_get_sites(sites.get(), num_space_for, HEAP_SITE_BY_BYTES);
+            if (actual_num_sites < 0)
+                return static_cast<mx_status_t>(actual_num_sites);
+            if (static_cast<size_t>(actual_num_sites) > UINT32_MAX)
+                return ERR_BAD_STATE;
+            size_t num_to_copy = MIN(static_cast<size_t>(actual_num_sites), num_space_for);
+
+            mx_info_header_t hdr;
+            hdr.topic = topic;
+            hdr.avail_topic_size = sizeof(mx_record_kernel_heap_site_t);
+            hdr.topic_size = topic_size;
+            hdr.avail_count = static_cast<uint32_t>(actual_num_sites);
+            hdr.count = static_cast<uint32_t>(num_to_copy);
+
+            if (_buffer.copy_array_to_user(&hdr, sizeof(hdr)) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+            auto site_result_buffer =
+                _buffer.byte_offset(site_offset).reinterpret<mx_record_kernel_heap_site_t>();
+            for (size_t i = 0; i < num_to_copy; i++) {
+                mx_record_kernel_heap_site_t rec;
+                rec.caller = sites[i].caller;
+                rec.live_bytes = sites[i].live_bytes;
+                rec.live_count = sites[i].live_count;
+                rec.total_count = sites[i].total_count;
+                rec.min_size = sites[i].min_size;
+                rec.max_size = sites[i].max_size;
+                if (site_result_buffer.element_offset(i).copy_to_user(rec) != NO_ERROR)
+                    return ERR_INVALID_ARGS;
+            }
+            size_t result_bytes = site_offset + (num_to_copy * topic_size);
+            return result_bytes;
+        }
+        case MX_INFO_SYSCALL_STATS: {
+            // the counts show what every process is doing, so this takes the root resource
+            mx_status_t status = validate_resource_handle(handle);
+            if (status != NO_ERROR)
+                return status;
+
+            // test that they've asking for an appropriate version
+            if (topic_size != 0 && topic_size != sizeof(mx_record_syscall_stat_t))
+                return ERR_INVALID_ARGS;
+
+            // make sure they passed us a buffer
+            if (!_buffer)
+                return ERR_INVALID_ARGS;
+
+            // test that we have at least enough target buffer to at least support the header
+            if (buffer_size < sizeof(mx_info_header_t))
+                return ERR_BUFFER_TOO_SMALL;
+
+            size_t stat_offset = offsetof(mx_info_syscall_stats_t, rec);
+            size_t num_space_for =
+                (buffer_size - stat_offset) / sizeof(mx_record_syscall_stat_t);
+            if (topic_size == 0)
+                num_space_for = 0;
+
+            // the counters are copied out as they are, without stopping other cpus
+            auto stat_result_buffer =
+                _buffer.byte_offset(stat_offset).reinterpret<mx_record_syscall_stat_t>();
+            size_t actual_num_stats = 0;
+            for (uint cpu = 0; cpu < arch_max_num_cpus(); cpu++) {
+                for (uint32_t i = 0; i < syscall_stats_count(); i++) {
+                    mx_record_syscall_stat_t rec;
+                    if (!syscall_stats_get(cpu, i, &rec))
+                        continue;
+                    if (actual_num_stats < num_space_for &&
+                        stat_result_buffer.element_offset(actual_num_stats).copy_to_user(rec) != NO_ERROR)
+                        return ERR_INVALID_ARGS;
+                    actual_num_stats++;
+                }
+            }
+            size_t num_to_copy = MIN(actual_num_stats, num_space_for);
+
+            mx_info_header_t hdr;
+            hdr.topic = topic;
+            hdr.avail_topic_size = sizeof(mx_record_syscall_stat_t);
+            hdr.topic_size = topic_size;
+            hdr.avail_count = static_cast<uint32_t>(actual_num_stats);
+            hdr.count = static_cast<uint32_t>(num_to_copy);
+
+            if (_buffer.copy_array_to_user(&hdr, sizeof(hdr)) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+            size_t result_bytes = stat_offset + (num_to_copy * topic_size);
+            return result_bytes;
+        }
         default:
             return ERR_NOT_FOUND;
     }
@@ -1113,3 +1376,56 @@ mx_ssize_t sys_socket_read(mx_handle_t handle, uint32_t flags,
         socket->OOB_Read(_buffer.get(), size, true) :
         socket->Read(_buffer.get(), size, true);
 }
+
+mx_ssize_t sys_socket_writev(mx_handle_t handle, uint32_t flags,
+                             user_ptr<const mx_iovec_t> _iov, uint32_t iov_count) {
+    LTRACEF("handle %d\n", handle);
+
+    // Control messages are small enough not to need gathering.
+    if (flags != 0u)
+        return ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<SocketDispatcher> socket;
+    mx_status_t status = up->GetDispatcher(handle, &socket, MX_RIGHT_WRITE);
+    if (status != NO_ERROR)
+        return status;
+
+    mx_iovec_t iov[MX_IOVEC_MAX];
+    size_t total_len;
+    status = magenta_copy_user_iovec(_iov, iov_count, iov, &total_len);
+    if (status != NO_ERROR)
+        return status;
+    // the count of bytes moved comes back as the result, so it has to fit
+    if (total_len > static_cast<size_t>(SSIZE_MAX))
+        return ERR_OUT_OF_RANGE;
+
+    return socket->WriteV(iov, iov_count);
+}
+
+mx_ssize_t sys_socket_readv(mx_handle_t handle, uint32_t flags,
+                            user_ptr<const mx_iovec_t> _iov, uint32_t iov_count) {
+    LTRACEF("handle %d\n", handle);
+
+    if (flags != 0u)
+        return ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<SocketDispatcher> socket;
+    mx_status_t status = up->GetDispatcher(handle, &socket, MX_RIGHT_READ);
+    if (status != NO_ERROR)
+        return status;
+
+    mx_iovec_t iov[MX_IOVEC_MAX];
+    size_t total_len;
+    status = magenta_copy_user_iovec(_iov, iov_count, iov, &total_len);
+    if (status != NO_ERROR)
+        return status;
+    // the count of bytes moved comes back as the result, so it has to fit
+    if (total_len > static_cast<size_t>(SSIZE_MAX))
+        return ERR_OUT_OF_RANGE;
+
+    return socket->ReadV(iov, iov_count);
+}
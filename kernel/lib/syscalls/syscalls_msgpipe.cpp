@@ -73,42 +73,26 @@ mx_status_t sys_msgpipe_create(user_ptr<mx_handle_t> out_handle /* array of size
     return NO_ERROR;
 }
 
-mx_status_t sys_msgpipe_read(mx_handle_t handle_value,
-                             user_ptr<void> _bytes,
-                             user_ptr<uint32_t> _num_bytes,
-                             user_ptr<mx_handle_t> _handles,
-                             user_ptr<uint32_t> _num_handles,
-                             uint32_t flags) {
-    LTRACEF("handle %d bytes %p num_bytes %p handles %p num_handles %p",
-            handle_value, _bytes.get(), _num_bytes.get(), _handles.get(), _num_handles.get());
-
-    auto up = ProcessDispatcher::GetCurrent();
-
-    mxtl::RefPtr<MessagePipeDispatcher> msg_pipe;
-    mx_status_t result = up->GetDispatcher(handle_value, &msg_pipe, MX_RIGHT_READ);
-    if (result != NO_ERROR)
-        return result;
-
-    uint32_t num_bytes = 0;
+// Reads the next message from |msg_pipe| into the user buffers described by |iov|, which can hold
+// |num_bytes| bytes in total. The rest is as for mx_msgpipe_read().
+static mx_status_t msgpipe_read(ProcessDispatcher* up,
+                                mxtl::RefPtr<MessagePipeDispatcher> msg_pipe,
+                                const mx_iovec_t* iov, uint32_t iov_count, uint32_t num_bytes,
+                                user_ptr<uint32_t> _num_bytes,
+                                user_ptr<mx_handle_t> _handles,
+                                user_ptr<uint32_t> _num_handles) {
     uint32_t num_handles = 0;
 
-    if (_num_bytes) {
-        if (_num_bytes.copy_from_user(&num_bytes) != NO_ERROR)
-            return ERR_INVALID_ARGS;
-    }
-
     if (_num_handles) {
         if (_num_handles.copy_from_user(&num_handles) != NO_ERROR)
             return ERR_INVALID_ARGS;
     }
 
-    if (_bytes && !_num_bytes)
-        return ERR_INVALID_ARGS;
     if (_handles && !_num_handles)
         return ERR_INVALID_ARGS;
 
     mxtl::unique_ptr<MessagePacket> msg;
-    result = msg_pipe->Read(&num_bytes, &num_handles, &msg);
+    mx_status_t result = msg_pipe->Read(&num_bytes, &num_handles, &msg);
     if (result != NO_ERROR && result != ERR_BUFFER_TOO_SMALL)
         return result;
 
@@ -126,7 +110,13 @@ mx_status_t sys_msgpipe_read(mx_handle_t handle_value,
         return result;
 
     if (num_bytes > 0u) {
-        if (_bytes.copy_array_to_user(msg->data.get(), num_bytes) != NO_ERROR)
+        // Scatter the message across the caller's buffers with a single user copy.
+        iovec_t data = { msg->data.get(), num_bytes };
+        user_copy_vec_t vec[MX_IOVEC_MAX];
+        size_t len;
+        size_t count = magenta_build_user_copy_vec(iov, iov_count, &data, 1, true,
+                                                   vec, countof(vec), &len);
+        if (len != num_bytes || copy_to_user_vec_unsafe(vec, count) != NO_ERROR)
             return ERR_INVALID_ARGS;
     }
 
@@ -157,24 +147,74 @@ mx_status_t sys_msgpipe_read(mx_handle_t handle_value,
     return result;
 }
 
-mx_status_t sys_msgpipe_write(mx_handle_t handle_value,
-                              user_ptr<const void> _bytes, uint32_t num_bytes,
-                              user_ptr<const mx_handle_t> _handles, uint32_t num_handles,
+mx_status_t sys_msgpipe_read(mx_handle_t handle_value,
+                             user_ptr<void> _bytes,
+                             user_ptr<uint32_t> _num_bytes,
+                             user_ptr<mx_handle_t> _handles,
+                             user_ptr<uint32_t> _num_handles,
+                             uint32_t flags) {
+    LTRACEF("handle %d bytes %p num_bytes %p handles %p num_handles %p",
+            handle_value, _bytes.get(), _num_bytes.get(), _handles.get(), _num_handles.get());
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<MessagePipeDispatcher> msg_pipe;
+    mx_status_t result = up->GetDispatcher(handle_value, &msg_pipe, MX_RIGHT_READ);
+    if (result != NO_ERROR)
+        return result;
+
+    uint32_t num_bytes = 0;
+
+    if (_num_bytes) {
+        if (_num_bytes.copy_from_user(&num_bytes) != NO_ERROR)
+            return ERR_INVALID_ARGS;
+    }
+
+    if (_bytes && !_num_bytes)
+        return ERR_INVALID_ARGS;
+
+    mx_iovec_t iov = { _bytes.get(), num_bytes };
+    return msgpipe_read(up, mxtl::move(msg_pipe), &iov, 1u, num_bytes,
+                        _num_bytes, _handles, _num_handles);
+}
+
+mx_status_t sys_msgpipe_readv(mx_handle_t handle_value,
+                              user_ptr<const mx_iovec_t> _iov, uint32_t iov_count,
+                              user_ptr<uint32_t> _num_bytes,
+                              user_ptr<mx_handle_t> _handles,
+                              user_ptr<uint32_t> _num_handles,
                               uint32_t flags) {
-    LTRACEF("handle %d bytes %p num_bytes %u handles %p num_handles %u flags 0x%x\n",
-            handle_value, _bytes.get(), num_bytes, _handles.get(), num_handles, flags);
+    LTRACEF("handle %d iov %p iov_count %u num_bytes %p handles %p num_handles %p",
+            handle_value, _iov.get(), iov_count, _num_bytes.get(), _handles.get(),
+            _num_handles.get());
 
     auto up = ProcessDispatcher::GetCurrent();
 
     mxtl::RefPtr<MessagePipeDispatcher> msg_pipe;
-    mx_status_t result = up->GetDispatcher(handle_value, &msg_pipe, MX_RIGHT_WRITE);
+    mx_status_t result = up->GetDispatcher(handle_value, &msg_pipe, MX_RIGHT_READ);
+    if (result != NO_ERROR)
+        return result;
+
+    mx_iovec_t iov[MX_IOVEC_MAX];
+    size_t total_len;
+    result = magenta_copy_user_iovec(_iov, iov_count, iov, &total_len);
     if (result != NO_ERROR)
         return result;
 
+    // Nothing bigger than kMaxMessageSize can arrive, so clamping doesn't lose anything.
+    uint32_t num_bytes = static_cast<uint32_t>(mxtl::min<size_t>(total_len, kMaxMessageSize));
+    return msgpipe_read(up, mxtl::move(msg_pipe), iov, iov_count, num_bytes,
+                        _num_bytes, _handles, _num_handles);
+}
+
+// Writes a message made up of the user buffers described by |iov|, |num_bytes| bytes in total, to
+// |msg_pipe|. The rest is as for mx_msgpipe_write().
+static mx_status_t msgpipe_write(ProcessDispatcher* up,
+                                 mxtl::RefPtr<MessagePipeDispatcher> msg_pipe,
+                                 const mx_iovec_t* iov, uint32_t iov_count, size_t num_bytes,
+                                 user_ptr<const mx_handle_t> _handles, uint32_t num_handles) {
     bool is_reply_pipe = msg_pipe->is_reply_pipe();
 
-    if (num_bytes > 0u && !_bytes)
-        return ERR_INVALID_ARGS;
     if (num_handles > 0u && !_handles)
         return ERR_INVALID_ARGS;
 
@@ -183,25 +223,28 @@ mx_status_t sys_msgpipe_write(mx_handle_t handle_value,
     if (num_handles > kMaxMessageHandles)
         return ERR_OUT_OF_RANGE;
 
+    AllocChecker ac;
     mxtl::Array<uint8_t> bytes;
-
     if (num_bytes > 0u) {
-        void* copy;
-        result = magenta_copy_user_dynamic(_bytes.get(), &copy, num_bytes, kMaxMessageSize);
-        if (result != NO_ERROR)
-            return result;
-        bytes.reset(reinterpret_cast<uint8_t*>(copy), num_bytes);
+        bytes.reset(new (&ac) uint8_t[num_bytes], num_bytes);
+        if (!ac.check())
+            return ERR_NO_MEMORY;
     }
 
-    AllocChecker ac;
     mxtl::InlineArray<mx_handle_t, kMsgpipeWriteHandlesInlineCount> handles(&ac, num_handles);
     if (!ac.check())
         return ERR_NO_MEMORY;
-    if (num_handles > 0u) {
-        result = _handles.copy_array_from_user(handles.get(), num_handles);
-        if (result != NO_ERROR)
-            return result;
-    }
+
+    // Gather the bytes and bring in the handle values with a single user copy.
+    iovec_t data = { bytes.get(), num_bytes };
+    user_copy_vec_t vec[MX_IOVEC_MAX + 1];
+    size_t len;
+    size_t count = magenta_build_user_copy_vec(iov, iov_count, &data, 1, false,
+                                               vec, countof(vec) - 1, &len);
+    DEBUG_ASSERT(len == num_bytes);
+    vec[count++] = { handles.get(), _handles.get(), num_handles * sizeof(mx_handle_t) };
+    if (copy_from_user_vec_unsafe(vec, count) != NO_ERROR)
+        return ERR_INVALID_ARGS;
 
     mxtl::Array<Handle*> handle_list(new (&ac) Handle*[num_handles], num_handles);
     if (!ac.check())
@@ -255,7 +298,7 @@ mx_status_t sys_msgpipe_write(mx_handle_t handle_value,
         }
     }
 
-    result = msg_pipe->Write(mxtl::move(bytes), mxtl::move(handle_list));
+    mx_status_t result = msg_pipe->Write(mxtl::move(bytes), mxtl::move(handle_list));
 
     if (result != NO_ERROR) {
         // Write failed, put back the handles into this process.
@@ -265,7 +308,52 @@ mx_status_t sys_msgpipe_write(mx_handle_t handle_value,
         }
     }
 
-    ktrace(TAG_MSGPIPE_WRITE, (uint32_t)msg_pipe->get_koid(), num_bytes, num_handles, 0);
+    ktrace(TAG_MSGPIPE_WRITE, (uint32_t)msg_pipe->get_koid(), (uint32_t)num_bytes, num_handles, 0);
     return result;
 }
 
+mx_status_t sys_msgpipe_write(mx_handle_t handle_value,
+                              user_ptr<const void> _bytes, uint32_t num_bytes,
+                              user_ptr<const mx_handle_t> _handles, uint32_t num_handles,
+                              uint32_t flags) {
+    LTRACEF("handle %d bytes %p num_bytes %u handles %p num_handles %u flags 0x%x\n",
+            handle_value, _bytes.get(), num_bytes, _handles.get(), num_handles, flags);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<MessagePipeDispatcher> msg_pipe;
+    mx_status_t result = up->GetDispatcher(handle_value, &msg_pipe, MX_RIGHT_WRITE);
+    if (result != NO_ERROR)
+        return result;
+
+    if (num_bytes > 0u && !_bytes)
+        return ERR_INVALID_ARGS;
+
+    mx_iovec_t iov = { const_cast<void*>(_bytes.get()), num_bytes };
+    return msgpipe_write(up, mxtl::move(msg_pipe), &iov, 1u, num_bytes, _handles, num_handles);
+}
+
+mx_status_t sys_msgpipe_writev(mx_handle_t handle_value,
+                               user_ptr<const mx_iovec_t> _iov, uint32_t iov_count,
+                               user_ptr<const mx_handle_t> _handles, uint32_t num_handles,
+                               uint32_t flags) {
+    LTRACEF("handle %d iov %p iov_count %u handles %p num_handles %u flags 0x%x\n",
+            handle_value, _iov.get(), iov_count, _handles.get(), num_handles, flags);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<MessagePipeDispatcher> msg_pipe;
+    mx_status_t result = up->GetDispatcher(handle_value, &msg_pipe, MX_RIGHT_WRITE);
+    if (result != NO_ERROR)
+        return result;
+
+    mx_iovec_t iov[MX_IOVEC_MAX];
+    size_t num_bytes;
+    result = magenta_copy_user_iovec(_iov, iov_count, iov, &num_bytes);
+    if (result != NO_ERROR)
+        return result;
+
+    return msgpipe_write(up, mxtl::move(msg_pipe), iov, iov_count, num_bytes,
+                         _handles, num_handles);
+}
+
@@ -16,3 +16,10 @@
 // On the kernel side, we define the type-safe user_ptr<> for syscall user pointer params.
 #define USER_PTR(type) user_ptr<type>
 #include <magenta/syscalls.inc>
+
+// Syscall statistics, kept by the dispatcher in syscalls.cpp.  Each syscall
+// has an index below syscall_stats_count(); syscall_stats_get() copies out
+// the counts for one of them on one cpu, and returns false if it hasn't been
+// called there.
+uint32_t syscall_stats_count(void);
+bool syscall_stats_get(uint cpu, uint32_t index, mx_record_syscall_stat_t* rec);
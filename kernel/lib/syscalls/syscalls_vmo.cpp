@@ -14,6 +14,7 @@
 #include <lib/user_copy.h>
 #include <lib/user_copy/user_ptr.h>
 
+#include <magenta/io_port_dispatcher.h>
 #include <magenta/magenta.h>
 #include <magenta/process_dispatcher.h>
 #include <magenta/user_copy.h>
@@ -142,6 +143,79 @@ mx_status_t sys_vmo_op_range(mx_handle_t handle, uint32_t op, uint64_t offset, u
     return vmo->RangeOp(op, offset, size, buffer, buffer_size, vmo_rights);
 }
 
+mx_handle_t sys_vmo_clone(mx_handle_t handle, uint32_t options, uint64_t offset, uint64_t size) {
+    LTRACEF("handle %d options %#x offset %#" PRIx64 " size %#" PRIx64 "\n",
+            handle, options, offset, size);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    // lookup the dispatcher from handle; a clone is a copy of the contents,
+    // so it takes the rights to read and to duplicate them
+    mxtl::RefPtr<VmObjectDispatcher> vmo;
+    mx_rights_t vmo_rights;
+    mx_status_t status = up->GetDispatcher(handle, &vmo, &vmo_rights);
+    if (status != NO_ERROR)
+        return status;
+    if ((vmo_rights & (MX_RIGHT_READ | MX_RIGHT_DUPLICATE)) != (MX_RIGHT_READ | MX_RIGHT_DUPLICATE))
+        return ERR_ACCESS_DENIED;
+
+    // create the clone
+    mxtl::RefPtr<VmObject> clone_vmo;
+    status = vmo->Clone(options, offset, size, &clone_vmo);
+    if (status != NO_ERROR)
+        return status;
+
+    // create a Vm Object dispatcher
+    mxtl::RefPtr<Dispatcher> dispatcher;
+    mx_rights_t rights;
+    status = VmObjectDispatcher::Create(mxtl::move(clone_vmo), &dispatcher, &rights);
+    if (status != NO_ERROR)
+        return status;
+
+    // the clone is a private copy, so it may be written, but it gets no other
+    // rights that the source handle lacked
+    rights = vmo_rights | MX_RIGHT_WRITE;
+
+    // create a handle and attach the dispatcher to it
+    HandleUniquePtr clone_handle(MakeHandle(mxtl::move(dispatcher), rights));
+    if (!clone_handle)
+        return ERR_NO_MEMORY;
+
+    mx_handle_t hv = up->MapHandleToValue(clone_handle.get());
+    up->AddHandle(mxtl::move(clone_handle));
+
+    return hv;
+}
+
+mx_handle_t sys_vmo_create_paged(uint64_t size, mx_handle_t port_handle, uint64_t key) {
+    LTRACEF("size %#" PRIx64 " port %d key %#" PRIx64 "\n", size, port_handle, key);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    // page requests go out on this port
+    mxtl::RefPtr<IOPortDispatcher> port;
+    mx_status_t status = up->GetDispatcher(port_handle, &port, MX_RIGHT_WRITE);
+    if (status != NO_ERROR)
+        return status;
+
+    // create a Vm Object dispatcher
+    mxtl::RefPtr<Dispatcher> dispatcher;
+    mx_rights_t rights;
+    status = VmObjectDispatcher::CreatePaged(size, mxtl::move(port), key, &dispatcher, &rights);
+    if (status != NO_ERROR)
+        return status;
+
+    // create a handle and attach the dispatcher to it
+    HandleUniquePtr handle(MakeHandle(mxtl::move(dispatcher), rights));
+    if (!handle)
+        return ERR_NO_MEMORY;
+
+    mx_handle_t hv = up->MapHandleToValue(handle.get());
+    up->AddHandle(mxtl::move(handle));
+
+    return hv;
+}
+
 mx_status_t sys_process_map_vm(mx_handle_t proc_handle, mx_handle_t vmo_handle,
                                uint64_t offset, mx_size_t len, user_ptr<uintptr_t> user_ptr,
                                uint32_t flags) {
@@ -18,6 +18,12 @@ inline status_t copy_to_user_unsafe(void* dst, const void* src, size_t len) {
 inline status_t copy_from_user_unsafe(void* dst, const void* src, size_t len) {
   return arch_copy_from_user(dst, src, len);
 }
+inline status_t copy_to_user_vec_unsafe(const user_copy_vec_t* vec, size_t count) {
+  return arch_copy_to_user_vec(vec, count);
+}
+inline status_t copy_from_user_vec_unsafe(const user_copy_vec_t* vec, size_t count) {
+  return arch_copy_from_user_vec(vec, count);
+}
 
 // Convenience functions for common data types.
 #define MAKE_COPY_TO_USER_UNSAFE(name, type) \
@@ -22,3 +22,21 @@ __WEAK status_t arch_copy_to_user(void *dst, const void *src, size_t len) {
     memcpy(dst, src, len);
     return NO_ERROR;
 }
+
+__WEAK status_t arch_copy_from_user_vec(const user_copy_vec_t *vec, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        status_t status = arch_copy_from_user(vec[i].dst, vec[i].src, vec[i].len);
+        if (status != NO_ERROR)
+            return status;
+    }
+    return NO_ERROR;
+}
+
+__WEAK status_t arch_copy_to_user_vec(const user_copy_vec_t *vec, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        status_t status = arch_copy_to_user(vec[i].dst, vec[i].src, vec[i].len);
+        if (status != NO_ERROR)
+            return status;
+    }
+    return NO_ERROR;
+}
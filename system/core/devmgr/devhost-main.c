@@ -6,6 +6,7 @@
 #include "devmgr.h"
 #include "devhost.h"
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,6 +17,7 @@
 #include <launchpad/launchpad.h>
 
 #include <magenta/ktrace.h>
+#include <magenta/lockstat.h>
 #include <magenta/processargs.h>
 #include <magenta/syscalls.h>
 #include <magenta/types.h>
@@ -92,6 +94,29 @@ void devhost_launch_devhost(mx_device_t* parent, const char* name, uint32_t prot
     devmgr_launch_devhost(procname, argc, argv, hdevice, hrpc);
 }
 
+static mx_status_t dump_lockstat(void) {
+    mx_lockstat_t stats[32];
+    mx_ssize_t count = mx_lockstat_read(get_root_resource(), MX_LOCKSTAT_RESET,
+                                        stats, sizeof(stats));
+    if (count < 0) {
+        return count;
+    }
+    printf("%-24s %10s %14s %12s (mutex: usecs, spin: cycles)\n",
+           "class", "contended", "wait total", "wait max");
+    for (mx_ssize_t i = 0; i < count; i++) {
+        if (stats[i].contended == 0) {
+            continue;
+        }
+        printf("%-24s %10" PRIu64 " %14" PRIu64 " %12" PRIu64 "\n", stats[i].name, stats[i].contended,
+               stats[i].wait_total, stats[i].wait_max);
+        for (int j = 0; j < MX_LOCKSTAT_SITES && stats[i].sites[j].pc; j++) {
+            printf("    at %#" PRIx64 ": %" PRIu64 " times, %" PRIu64 " waiting\n", stats[i].sites[j].pc,
+                   stats[i].sites[j].count, stats[i].sites[j].wait_total);
+        }
+    }
+    return NO_ERROR;
+}
+
 mx_status_t devmgr_control(const char* cmd) {
     if (!strcmp(cmd, "help")) {
         printf("dump        - dump device tree\n"
@@ -102,6 +127,9 @@ mx_status_t devmgr_control(const char* cmd) {
                "kerneldebug - send a command to the kernel\n"
                "ktraceoff   - stop kernel tracing\n"
                "ktraceon    - start kernel tracing\n"
+               "profileon   - start sampling into the kernel trace\n"
+               "profileoff  - stop sampling\n"
+               "lockstat    - show and clear kernel lock contention\n"
                "acpi-ps0    - invoke the _PS0 method on an acpi object\n"
                );
         return NO_ERROR;
@@ -132,6 +160,17 @@ mx_status_t devmgr_control(const char* cmd) {
         mx_ktrace_control(get_root_resource(), KTRACE_ACTION_REWIND, 0);
         return NO_ERROR;
     }
+    if (!strcmp(cmd, "profileon")) {
+        mx_ktrace_control(get_root_resource(), KTRACE_ACTION_PROFILE_START, 1);
+        return NO_ERROR;
+    }
+    if (!strcmp(cmd, "profileoff")) {
+        mx_ktrace_control(get_root_resource(), KTRACE_ACTION_PROFILE_STOP, 0);
+        return NO_ERROR;
+    }
+    if (!strcmp(cmd, "lockstat")) {
+        return dump_lockstat();
+    }
     if (!strncmp(cmd, "mojo:", 5)) {
         return mx_msgpipe_write(mojo_launcher, cmd, strlen(cmd), NULL, 0, 0);
     }
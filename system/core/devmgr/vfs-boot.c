@@ -9,6 +9,9 @@
 
 #include <ddk/device.h>
 
+#include <magenta/device/device.h>
+#include <magenta/syscalls.h>
+
 #include <mxio/debug.h>
 #include <mxio/vfs.h>
 
@@ -68,7 +71,9 @@ static mx_status_t vnb_create(vnode_t* vn, vnode_t** out, const char* name, size
 
 mx_handle_t vfs_get_vmofile(vnode_t* vn, mx_off_t* off, mx_off_t* len) {
     vnboot_t* vnb = vn->pdata;
-    mx_handle_t vmo = mx_handle_duplicate(vnb->vmo, MX_RIGHT_READ | MX_RIGHT_DUPLICATE | MX_RIGHT_TRANSFER);
+    // map and execute, so that clients can run binaries straight out of bootfs
+    mx_handle_t vmo = mx_handle_duplicate(vnb->vmo, MX_RIGHT_READ | MX_RIGHT_DUPLICATE |
+                                          MX_RIGHT_TRANSFER | MX_RIGHT_MAP | MX_RIGHT_EXECUTE);
     xprintf("vmofile: %x (%x) off=%" PRIu64 " len=%zd\n", vmo, vnb->vmo, vnb->off, vnb->datalen);
     if (vmo > 0) {
         *off = vnb->off;
@@ -77,6 +82,32 @@ mx_handle_t vfs_get_vmofile(vnode_t* vn, mx_off_t* off, mx_off_t* len) {
     return vmo;
 }
 
+static ssize_t vnb_ioctl(vnode_t* vn, uint32_t op, const void* in_buf, size_t in_len,
+                         void* out_buf, size_t out_len) {
+    vnboot_t* vnb = vn->pdata;
+    switch (op) {
+    case IOCTL_DEVICE_GET_FILE_VMO: {
+        if ((in_len != 0) || (out_len != sizeof(mx_handle_t))) {
+            return ERR_INVALID_ARGS;
+        }
+        if (vn->dnode != NULL) {
+            return ERR_WRONG_TYPE;
+        }
+        // the pages are already in the bootfs vmo, so a clone of the file's
+        // range hands them out without copying
+        mx_handle_t vmo = mx_vmo_clone(vnb->vmo, MX_VMO_CLONE_COPY_ON_WRITE,
+                                       vnb->off, vnb->datalen);
+        if (vmo < 0) {
+            return vmo;
+        }
+        memcpy(out_buf, &vmo, sizeof(vmo));
+        return sizeof(vmo);
+    }
+    default:
+        return memfs_ioctl(vn, op, in_buf, in_len, out_buf, out_len);
+    }
+}
+
 static vnode_ops_t vn_boot_ops = {
     .release = vnb_release,
     .open = memfs_open,
@@ -87,7 +118,7 @@ static vnode_ops_t vn_boot_ops = {
     .getattr = vnb_getattr,
     .readdir = memfs_readdir,
     .create = vnb_create,
-    .ioctl = memfs_ioctl,
+    .ioctl = vnb_ioctl,
     .unlink = memfs_unlink,
     .rename = memfs_rename_none,
 };
@@ -38,6 +38,14 @@
 #define IOCTL_DEVICE_GET_DEVICE_NAME \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_DEVICE, 4)
 
+// Return a VMO holding a file's contents, for mapping it rather than
+// reading it.  The VMO is a copy-on-write clone, so writes to it never
+// reach the file, and its pages are only brought in when they are touched.
+//   in: none
+//   out: handle to the VMO
+#define IOCTL_DEVICE_GET_FILE_VMO \
+    IOCTL(IOCTL_KIND_GET_HANDLE, IOCTL_FAMILY_DEVICE, 5)
+
 // Indicates if there's data available to read,
 // or room to write, or an error condition.
 #define DEVICE_SIGNAL_READABLE MX_SIGNAL_SIGNAL0
@@ -58,3 +66,6 @@ IOCTL_WRAPPER_VAROUT(ioctl_device_get_driver_name, IOCTL_DEVICE_GET_DRIVER_NAME,
 
 // ssize_t ioctl_device_get_device_name(int fd, char* out, size_t out_len);
 IOCTL_WRAPPER_VAROUT(ioctl_device_get_device_name, IOCTL_DEVICE_GET_DEVICE_NAME, char);
+
+// ssize_t ioctl_device_get_file_vmo(int fd, mx_handle_t* out);
+IOCTL_WRAPPER_OUT(ioctl_device_get_file_vmo, IOCTL_DEVICE_GET_FILE_VMO, mx_handle_t);
@@ -31,6 +31,8 @@
 #define IOCTL_FAMILY_BCM            0x18  // ioctls for BCM28xx chipset
 #define IOCTL_FAMILY_AUDIO          0x19
 #define IOCTL_FAMILY_MIDI           0x1A
+#define IOCTL_FAMILY_KTRACE         0x1B
+#define IOCTL_FAMILY_SYSINFO        0x1C
 
 // IOCTL constructor
 // --K-FFNN
@@ -0,0 +1,25 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+// clang-format off
+
+#include <magenta/device/ioctl.h>
+#include <magenta/device/ioctl-wrapper.h>
+#include <magenta/types.h>
+
+__BEGIN_CDECLS
+
+// Return a read-only vmo of the kernel trace buffer, laid out as
+// ktrace_buffer_header_t in <magenta/ktrace.h> describes
+//   in: none
+//   out: mx_handle_t
+#define IOCTL_KTRACE_GET_VMO \
+    IOCTL(IOCTL_KIND_GET_HANDLE, IOCTL_FAMILY_KTRACE, 1)
+
+// ssize_t ioctl_ktrace_get_vmo(int fd, mx_handle_t* out);
+IOCTL_WRAPPER_OUT(ioctl_ktrace_get_vmo, IOCTL_KTRACE_GET_VMO, mx_handle_t);
+
+__END_CDECLS
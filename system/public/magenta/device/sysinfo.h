@@ -0,0 +1,25 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+// clang-format off
+
+#include <magenta/device/ioctl.h>
+#include <magenta/device/ioctl-wrapper.h>
+#include <magenta/types.h>
+
+__BEGIN_CDECLS
+
+// Return a handle to the root resource, which the system information
+// topics of mx_object_get_info() require
+//   in: none
+//   out: mx_handle_t
+#define IOCTL_SYSINFO_GET_ROOT_RESOURCE \
+    IOCTL(IOCTL_KIND_GET_HANDLE, IOCTL_FAMILY_SYSINFO, 1)
+
+// ssize_t ioctl_sysinfo_get_root_resource(int fd, mx_handle_t* out);
+IOCTL_WRAPPER_OUT(ioctl_sysinfo_get_root_resource, IOCTL_SYSINFO_GET_ROOT_RESOURCE, mx_handle_t);
+
+__END_CDECLS
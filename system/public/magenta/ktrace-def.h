@@ -17,6 +17,7 @@ KTRACE_DEF(0x022,NAME,PROC_NAME,META) // pid, 0, name[]
 KTRACE_DEF(0x023,NAME,SYSCALL_NAME,META) // num, 0, name[]
 KTRACE_DEF(0x024,NAME,IRQ_NAME,META) // num, 0, name[]
 KTRACE_DEF(0x025,NAME,PROBE_NAME,META) // num, 0, name[]
+KTRACE_DEF(0x026,NAME,USER_NAME,META) // id, pid, name[]
 
 KTRACE_DEF(0x030,16B,IRQ_ENTER,IRQ) // (irqn << 8) | cpu
 KTRACE_DEF(0x031,16B,IRQ_EXIT,IRQ) // (irqn << 8) | cpu
@@ -50,5 +51,13 @@ KTRACE_DEF(0x143,32B,PORT_QUEUE,IPC) // id, size
 
 KTRACE_DEF(0x150,32B,WAIT_ONE,IPC) // id, signals, timeoutlo, timeouthi
 KTRACE_DEF(0x151,32B,WAIT_ONE_DONE,IPC) // id, status, pending
+KTRACE_DEF(0x160,32B,USER_BEGIN,USER) // id, arg0, arg1, pid
+KTRACE_DEF(0x161,32B,USER_END,USER) // id, arg0, arg1, pid
+KTRACE_DEF(0x162,32B,USER_COUNTER,USER) // id, value_lo, value_hi, pid
+KTRACE_DEF(0x163,32B,USER_FLOW_BEGIN,USER) // id, flow_lo, flow_hi, pid
+KTRACE_DEF(0x164,32B,USER_FLOW_STEP,USER) // id, flow_lo, flow_hi, pid
+KTRACE_DEF(0x165,32B,USER_FLOW_END,USER) // id, flow_lo, flow_hi, pid
+KTRACE_DEF(0x170,32B,PROFILE_SAMPLE,PROFILE) // pc_lo, pc_hi, pid, (frames<<16)|(user<<8)|cpu
+KTRACE_DEF(0x171,32B,PROFILE_FRAMES,PROFILE) // pc_lo, pc_hi, pc_lo, pc_hi
 
 #undef KTRACE_DEF
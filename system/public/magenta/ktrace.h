@@ -45,6 +45,8 @@ __BEGIN_CDECLS
 #define KTRACE_GRP_IPC            0x010
 #define KTRACE_GRP_IRQ            0x020
 #define KTRACE_GRP_PROBE          0x040
+#define KTRACE_GRP_USER           0x080
+#define KTRACE_GRP_PROFILE        0x100
 
 #define KTRACE_GRP_TO_MASK(grp)   ((grp) << 20)
 
@@ -74,6 +76,43 @@ typedef struct ktrace_rec_name {
     char name[1];
 } ktrace_rec_name_t;
 
+// Layout of the trace buffer as mapped from mx_ktrace_get_vmo().
+//
+// The buffer starts with a ktrace_buffer_header_t, padded to a page.  The
+// name area follows at names_offset: the version and tick rate records, then
+// name records packed back to back.  names_len counts the bytes claimed there
+// and never runs past names_size: names that don't fit are dropped.  A record
+// that has been claimed but not yet written reads as a zero tag.
+//
+// Then come num_cpus rings of ring_slots slots of KTRACE_RECSIZE bytes, one
+// ring per cpu, at rings_offset.  Every event takes one slot whatever its
+// length.  cpu[n].head counts the events written to ring n since the last
+// rewind and is updated once the event is complete: event i is in slot
+// i % ring_slots.  In ring mode, events before head - ring_slots have been
+// overwritten, and event head - ring_slots may be being overwritten, so a
+// collector should re-read head after copying events out and discard any
+// event i for which head has reached i + ring_slots.  A head that goes
+// backwards means the trace was rewound.
+#define KTRACE_BUFFER_MAX_CPUS    32
+
+#define KTRACE_BUFFER_FLAG_RING   1 // overwriting the oldest events when full
+
+typedef struct ktrace_buffer_header {
+    uint32_t version;
+    uint32_t flags;
+    uint32_t num_cpus;
+    uint32_t names_offset;
+    uint32_t names_size;
+    int32_t names_len;
+    uint32_t rings_offset;
+    uint32_t ring_slots;
+    uint32_t reserved[8];
+    struct {
+        uint64_t head;
+        uint64_t reserved[7]; // one cache line per cpu
+    } cpu[KTRACE_BUFFER_MAX_CPUS];
+} ktrace_buffer_header_t;
+
 #define KTRACE_DEF(num,type,name,group) TAG_##name = KTRACE_TAG_##type(num,KTRACE_GRP_##group),
 enum {
 #include <magenta/ktrace-def.h>
@@ -86,5 +125,23 @@ enum {
 #define KTRACE_ACTION_START    1 // options = grpmask, 0 = all
 #define KTRACE_ACTION_STOP     2 // options ignored
 #define KTRACE_ACTION_REWIND   3 // options ignored
+#define KTRACE_ACTION_START_RING 4 // options = grpmask, 0 = all; overwrite the
+                                   // oldest events when full instead of stopping
+#define KTRACE_ACTION_PROFILE_START 5 // options = sample period in ms, 0 = 1
+#define KTRACE_ACTION_PROFILE_STOP  6 // options ignored
+
+// Profile samples
+//
+// While profiling, every cpu is interrupted once a sample period and
+// records where it was as a PROFILE_SAMPLE event: the pc, the thread and
+// process, and the number of return addresses that follow, found by
+// walking frame pointers.  Those come in PROFILE_FRAMES events, two per
+// event, innermost first, written right after the sample on the same cpu
+// with the cpu number in place of the thread id.
+#define KTRACE_PROFILE_MAX_FRAMES 8
+
+#define KTRACE_PROFILE_CPU(d)     ((d) & 0xFF)
+#define KTRACE_PROFILE_USER(d)    (((d) >> 8) & 1)
+#define KTRACE_PROFILE_FRAMES(d)  (((d) >> 16) & 0xFF)
 
 __END_CDECLS
\ No newline at end of file
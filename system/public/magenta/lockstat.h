@@ -0,0 +1,47 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Kernel lock contention statistics, as returned by mx_lockstat_read().
+//
+// The kernel only keeps these when built with ENABLE_LOCK_STATS=true;
+// otherwise mx_lockstat_read() returns ERR_NOT_SUPPORTED.  There is one
+// record per lock class.  Waits on mutexes are in microseconds and waits
+// on spinlocks are in cpu cycles.
+
+#define MX_LOCKSTAT_MUTEX 1u
+#define MX_LOCKSTAT_SPINLOCK 2u
+
+// mx_lockstat_read() options: clear the statistics once they have been read
+#define MX_LOCKSTAT_RESET 1u
+
+#define MX_LOCKSTAT_SITES 4
+
+typedef struct mx_lockstat_site {
+    uint64_t pc;            // where the lock was taken, 0 if unused
+    uint64_t count;         // contended acquisitions from here
+    uint64_t wait_total;
+} mx_lockstat_site_t;
+
+typedef struct mx_lockstat {
+    char name[32];
+    uint32_t kind;          // MX_LOCKSTAT_MUTEX or MX_LOCKSTAT_SPINLOCK
+    uint32_t reserved;
+    uint64_t contended;     // acquisitions that had to wait
+    uint64_t wait_total;
+    uint64_t wait_max;
+    // the call sites with the most contended acquisitions, most first
+    mx_lockstat_site_t sites[MX_LOCKSTAT_SITES];
+} mx_lockstat_t;
+
+#ifdef __cplusplus
+}
+#endif
@@ -147,6 +147,11 @@ typedef enum {
     MX_INFO_HANDLE_BASIC,
     MX_INFO_PROCESS,
     MX_INFO_PROCESS_THREADS,
+    MX_INFO_PROCESS_MEMORY,
+    MX_INFO_VMO,
+    MX_INFO_PROCESS_LIST,
+    MX_INFO_KERNEL_HEAP_SITES,
+    MX_INFO_SYSCALL_STATS,
 } mx_object_info_topic_t;
 
 typedef enum {
@@ -219,6 +224,79 @@ typedef struct mx_info_process_threads {
     mx_record_process_thread_t rec[];
 } mx_info_process_threads_t;
 
+typedef struct mx_record_process_memory {
+    uint64_t mapped_bytes;      // total size of the process's mappings
+    uint64_t resident_bytes;    // memory currently mapped in by the process's mappings
+    uint64_t committed_bytes;   // memory committed by the VM objects the process maps
+} mx_record_process_memory_t;
+
+// Returned for topic MX_INFO_PROCESS_MEMORY
+typedef struct mx_info_process_memory {
+    mx_info_header_t hdr;
+    mx_record_process_memory_t rec;
+} mx_info_process_memory_t;
+
+typedef struct mx_record_vmo {
+    uint64_t size;
+    uint64_t committed_bytes;   // memory committed by the object itself
+} mx_record_vmo_t;
+
+// Returned for topic MX_INFO_VMO
+typedef struct mx_info_vmo {
+    mx_info_header_t hdr;
+    mx_record_vmo_t rec;
+} mx_info_vmo_t;
+
+typedef struct mx_record_process_list {
+    mx_koid_t koid;
+    char name[32];              // nul terminated, may be truncated
+} mx_record_process_list_t;
+
+// Returned for topic MX_INFO_PROCESS_LIST, which for now takes the root resource
+// and lists every process in the system
+typedef struct mx_info_process_list {
+    mx_info_header_t hdr;
+    mx_record_process_list_t rec[];
+} mx_info_process_list_t;
+
+typedef struct mx_record_kernel_heap_site {
+    uint64_t caller;            // kernel return address of the allocation, 0 for overflow
+    uint64_t live_bytes;        // bytes currently allocated from this site
+    uint64_t live_count;        // allocations currently live from this site
+    uint64_t total_count;       // allocations made from this site since boot
+    uint64_t min_size;          // smallest and largest allocation requested
+    uint64_t max_size;
+} mx_record_kernel_heap_site_t;
+
+// Returned for topic MX_INFO_KERNEL_HEAP_SITES, which takes the root resource and
+// lists the kernel heap allocation sites with live allocations, by live bytes.
+// Fails with ERR_NOT_SUPPORTED unless the kernel was built with HEAP_PROFILE=1.
+typedef struct mx_info_kernel_heap_sites {
+    mx_info_header_t hdr;
+    mx_record_kernel_heap_site_t rec[];
+} mx_info_kernel_heap_sites_t;
+
+typedef struct mx_record_syscall_stat {
+    char name[32];              // nul terminated, may be truncated
+    uint32_t num;               // syscall number, UINT32_MAX for unknown numbers
+    uint32_t cpu;               // the cpu the calls finished on
+    uint64_t calls;             // calls since boot
+    uint64_t timed_calls;       // calls that finished on the cpu they started on
+    uint64_t errors;            // calls that returned a negative status
+    uint64_t cycles;            // cpu cycles spent in the timed calls
+    uint64_t max_cycles;        // longest call, in cpu cycles
+} mx_record_syscall_stat_t;
+
+// Returned for topic MX_INFO_SYSCALL_STATS, which takes the root resource and
+// has a record for each syscall on each cpu it has been made on.  Cycles are
+// only counted for calls that finish on the cpu they started on, so the
+// average call takes cycles / timed_calls.  On 32-bit arm a call longer than
+// 2^32 cycles wraps.
+typedef struct mx_info_syscall_stats {
+    mx_info_header_t hdr;
+    mx_record_syscall_stat_t rec[];
+} mx_info_syscall_stats_t;
+
 // Defines and structures related to mx_pci_*()
 // Info returned to dev manager for PCIe devices when probing.
 typedef struct mx_pcie_get_nth_info {
@@ -299,6 +377,9 @@ typedef struct mx_log_record {
 
 #define MX_LOG_FLAG_WAIT      0x80000000
 #define MX_LOG_FLAG_READABLE  0x40000000
+// Read as many records as fit, oldest first, each starting at a multiple
+// of 8 bytes, rather than one.
+#define MX_LOG_FLAG_BATCH     0x20000000
 
 // Defines and structures for mx_port_*()
 
@@ -308,6 +389,7 @@ typedef struct mx_log_record {
 #define MX_PORT_PKT_TYPE_IOSN      1u
 #define MX_PORT_PKT_TYPE_USER      2u
 #define MX_PORT_PKT_TYPE_EXCEPTION 3u
+#define MX_PORT_PKT_TYPE_PAGE_REQUEST 4u
 
 typedef struct mx_packet_header {
     uint64_t key;
@@ -328,6 +410,14 @@ typedef struct mx_exception_packet {
     mx_exception_report_t report;
 } mx_exception_packet_t;
 
+// Sent by a pager-backed VM object when it needs the page at |offset|;
+// answered with MX_VMO_OP_SUPPLY.
+typedef struct mx_page_request_packet {
+    mx_packet_header_t hdr;
+    uint64_t offset;
+    uint64_t length;
+} mx_page_request_packet_t;
+
 // Structure for mx_waitset_*():
 
 typedef struct mx_waitset_result {
@@ -376,6 +466,16 @@ typedef struct mx_waitset_result {
 #define MX_SOCKET_CONTROL                1u
 #define MX_SOCKET_CONTROL_MAX_LEN     1024u
 
+// Scatter/gather vectors for mx_msgpipe_{read,write}v and mx_socket_{read,write}v.
+
+typedef struct mx_iovec {
+    void* buffer;
+    mx_size_t length;
+} mx_iovec_t;
+
+// The most entries a single vectored call accepts.
+#define MX_IOVEC_MAX                    16u
+
 // mx_thread_read_state, mx_thread_write_state
 // The maximum size of thread state, in bytes, that can be processed by the
 // read_state/write_state syscalls. It exists so code can expect a sane limit
@@ -410,6 +510,15 @@ typedef struct mx_waitset_result mx_wait_set_result_t;
 #define MX_VMO_OP_UNLOCK                4u
 #define MX_VMO_OP_LOOKUP                5u
 #define MX_VMO_OP_CACHE_SYNC            6u
+#define MX_VMO_OP_WILLNEED              7u
+#define MX_VMO_OP_SUPPLY                8u
+
+// VM Object signals
+// Asserted while no MX_VMO_OP_WILLNEED operation on the object is outstanding
+#define MX_VMO_SIGNAL_PREFETCHED        MX_SIGNAL_SIGNAL0
+
+// VM Object clone flags
+#define MX_VMO_CLONE_COPY_ON_WRITE      1u
 
 #ifdef __cplusplus
 }
@@ -250,6 +250,11 @@ char* _json(char* out, const char* name, va_list ap) {
             out += sprintf(out, "\"%s\":%u", name + 1, val32);
             comma = 1;
             break;
+        case '$':
+            val64 = va_arg(ap, uint64_t);
+            out += sprintf(out, "\"%s\":%" PRIu64, name + 1, val64);
+            comma = 1;
+            break;
         case '@':
             val64 = va_arg(ap, uint64_t);
             if (val64 == 0) {
@@ -696,6 +701,91 @@ void evt_wait_one_done(evt_info_t* ei, uint32_t id, uint32_t pending, uint32_t s
     SYSCALL("op", "wait_one() done", "#oid", id, "#pending", pending, "#status", status);
 }
 
+// user trace events are named by a hash of the name, so keep the names
+// apart from the objects
+typedef struct user_name user_name_t;
+struct user_name {
+    user_name_t* next;
+    uint32_t id;
+    char name[32];
+};
+
+user_name_t* user_names[BUCKETS];
+
+void evt_user_name(uint32_t id, const char* name) {
+    unsigned n = OBJBUCKET(id);
+    user_name_t* un;
+    for (un = user_names[n]; un != NULL; un = un->next) {
+        if (un->id == id) {
+            break;
+        }
+    }
+    if (un == NULL) {
+        un = calloc(1, sizeof(user_name_t));
+        un->id = id;
+        un->next = user_names[n];
+        user_names[n] = un;
+    }
+    snprintf(un->name, sizeof(un->name), "%s", name);
+}
+
+const char* user_name(uint32_t id) {
+    for (user_name_t* un = user_names[OBJBUCKET(id)]; un != NULL; un = un->next) {
+        if (un->id == id) {
+            return un->name;
+        }
+    }
+    // the name never made it into the trace: the name area was full, or the
+    // process had used up its share of it
+    static char name[32];
+    sprintf(name, "user:%08x", id);
+    return name;
+}
+
+// user events go on a track of their own beside the thread, since their
+// durations needn't nest inside the thread's running slices
+void evt_user(evt_info_t* ei, uint32_t event, uint32_t id, uint32_t pid,
+              uint32_t arg0, uint32_t arg1) {
+    if (is_object(pid, F_INVISIBLE)) {
+        return;
+    }
+    char tidstr[64];
+    sprintf(tidstr, "user:%u", ei->tid);
+    char xid[64];
+    sprintf(xid, "%" PRIx64, ((uint64_t)arg1 << 32) | arg0);
+    const char* name = user_name(id);
+
+    switch (event) {
+    case EVT_USER_BEGIN:
+        json_rec(ei->ts, "B", name, "user",
+                 "#pid", pid, "tid", tidstr,
+                 "{args", "#arg", arg0, "}", NULL);
+        break;
+    case EVT_USER_END:
+        json_rec(ei->ts, "E", name, "user",
+                 "#pid", pid, "tid", tidstr,
+                 "{args", "#arg", arg0, "}", NULL);
+        break;
+    case EVT_USER_COUNTER:
+        json_rec(ei->ts, "C", name, "user",
+                 "#pid", pid, "tid", tidstr,
+                 "{args", "$value", ((uint64_t)arg1 << 32) | arg0, "}", NULL);
+        break;
+    case EVT_USER_FLOW_BEGIN:
+        json_rec(ei->ts, "s", name, "user",
+                 "id", xid, "#pid", pid, "tid", tidstr, NULL);
+        break;
+    case EVT_USER_FLOW_STEP:
+        json_rec(ei->ts, "t", name, "user",
+                 "id", xid, "#pid", pid, "tid", tidstr, NULL);
+        break;
+    case EVT_USER_FLOW_END:
+        json_rec(ei->ts, "f", name, "user",
+                 "bp", "e", "id", xid, "#pid", pid, "tid", tidstr, NULL);
+        break;
+    }
+}
+
 int usage(void) {
     fprintf(stderr,
             "usage: ktracedump [ <option> ]* <tracefile>\n\n"
@@ -708,6 +798,7 @@ int usage(void) {
             "        -syscalls    show syscall timelines\n"
             "        -all         enable all tracing features\n"
             "        -stats       print summary of trace at end\n"
+            "        -summary     print latency and per-thread statistics only\n"
             "        -onlypid=... only display pid(s) listed (comma separated)\n"
             );
     return -1;
@@ -755,8 +846,507 @@ typedef union {
     uint8_t raw[256];
 } ktrace_record_t;
 
+// Summary mode
+//
+// Computes latency distributions and per-object statistics in one streaming
+// pass.  Memory is proportional to the number of threads, pipes and syscalls
+// seen, not to the length of the trace.
+
+// Log-linear histogram of nanosecond values: exact below 8, then 8 buckets
+// per power of two, so percentiles are reported within 12.5%.
+#define HIST_SUB_BITS 3
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct hist {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint32_t bucket[HIST_BUCKETS];
+} hist_t;
+
+static unsigned hist_index(uint64_t v) {
+    if (v < HIST_SUB) {
+        return v;
+    }
+    unsigned e = 63 - __builtin_clzll(v);
+    unsigned sub = (v >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1);
+    return (e - HIST_SUB_BITS + 1) * HIST_SUB + sub;
+}
+
+// the largest value that lands in bucket n
+static uint64_t hist_bucket_max(unsigned n) {
+    if (n < HIST_SUB) {
+        return n;
+    }
+    unsigned e = n / HIST_SUB + HIST_SUB_BITS - 1;
+    uint64_t base = ((uint64_t)(HIST_SUB + n % HIST_SUB)) << (e - HIST_SUB_BITS);
+    return base + (1ULL << (e - HIST_SUB_BITS)) - 1;
+}
+
+static void hist_add(hist_t* h, uint64_t v) {
+    h->count++;
+    h->sum += v;
+    if (v > h->max) {
+        h->max = v;
+    }
+    h->bucket[hist_index(v)]++;
+}
+
+// value below which |pct| percent of the samples fall
+static uint64_t hist_percentile(hist_t* h, unsigned pct) {
+    uint64_t want = (h->count * pct + 99) / 100;
+    uint64_t seen = 0;
+    for (unsigned n = 0; n < HIST_BUCKETS; n++) {
+        seen += h->bucket[n];
+        if (seen >= want) {
+            uint64_t v = hist_bucket_max(n);
+            return (v > h->max) ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+static void hist_print(const char* name, hist_t* h) {
+    printf("  %-28s %10" PRIu64 " %12.3f %12.3f %12.3f %14.3f\n", name, h->count,
+           hist_percentile(h, 50) / 1000.0, hist_percentile(h, 99) / 1000.0,
+           h->max / 1000.0, h->sum / 1000.0);
+}
+
+static void hist_print_header(const char* title) {
+    printf("\n%-30s %10s %12s %12s %12s %14s\n", title, "count",
+           "p50(us)", "p99(us)", "max(us)", "total(us)");
+}
+
+typedef struct sc_info sc_info_t;
+struct sc_info {
+    sc_info_t* next;
+    uint32_t num;
+    char name[32];
+    hist_t latency;
+};
+
+// what a cpu or thread is doing, for pairing syscall enter and exit
+typedef struct sc_pending {
+    uint64_t ts;
+    uint32_t num;
+    uint32_t active;
+} sc_pending_t;
+
+// threads are keyed by their kernel thread id, which user threads have too
+typedef struct thread_info thread_info_t;
+struct thread_info {
+    thread_info_t* next;
+    uint32_t ktid;
+    uint32_t tid;
+    char name[32];
+    uint64_t last_ts;
+    uint32_t last_state;
+    uint32_t running;
+    uint64_t run_time;
+    uint64_t wait_time;
+    uint64_t preempt_time;
+    uint32_t switches;
+    uint32_t preemptions;
+    sc_pending_t syscall;
+};
+
+// each direction of a pipe is keyed by the endpoint written to, and keeps
+// the timestamps of messages not yet read, up to a fixed depth
+#define PIPE_PENDING 256
+
+typedef struct pipe_info pipe_info_t;
+struct pipe_info {
+    pipe_info_t* next;
+    uint32_t id;
+    uint32_t other;
+    uint32_t head;
+    uint32_t tail;
+    uint64_t* pending;
+    uint64_t dropped;
+    hist_t latency;
+};
+
+#define SUMMARY_MAX_CPUS 64
+
+typedef struct summary {
+    sc_info_t* syscalls[BUCKETS];
+    thread_info_t* threads[BUCKETS];
+    pipe_info_t* pipes[BUCKETS];
+    uint32_t nthreads;
+    uint32_t npipes;
+    uint32_t nsyscalls;
+
+    // the thread each cpu is running, and syscalls entered on cpus whose
+    // thread isn't known yet
+    thread_info_t* current[SUMMARY_MAX_CPUS];
+    sc_pending_t cpu_syscall[SUMMARY_MAX_CPUS];
+
+    hist_t runq_delay;
+    uint64_t unmatched_reads;
+} summary_t;
+
+static sc_info_t* find_syscall(summary_t* s, uint32_t num) {
+    unsigned n = OBJBUCKET(num);
+    for (sc_info_t* sc = s->syscalls[n]; sc != NULL; sc = sc->next) {
+        if (sc->num == num) {
+            return sc;
+        }
+    }
+    sc_info_t* sc = calloc(1, sizeof(sc_info_t));
+    sc->num = num;
+    snprintf(sc->name, sizeof(sc->name), "syscall %u", num);
+    sc->next = s->syscalls[n];
+    s->syscalls[n] = sc;
+    s->nsyscalls++;
+    return sc;
+}
+
+static thread_info_t* find_thread(summary_t* s, uint32_t ktid) {
+    unsigned n = OBJBUCKET(ktid);
+    for (thread_info_t* t = s->threads[n]; t != NULL; t = t->next) {
+        if (t->ktid == ktid) {
+            return t;
+        }
+    }
+    thread_info_t* t = calloc(1, sizeof(thread_info_t));
+    t->ktid = ktid;
+    t->next = s->threads[n];
+    s->threads[n] = t;
+    s->nthreads++;
+    return t;
+}
+
+static pipe_info_t* find_pipe(summary_t* s, uint32_t id, int create) {
+    unsigned n = OBJBUCKET(id);
+    for (pipe_info_t* p = s->pipes[n]; p != NULL; p = p->next) {
+        if (p->id == id) {
+            return p;
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+    pipe_info_t* p = calloc(1, sizeof(pipe_info_t));
+    p->id = id;
+    p->next = s->pipes[n];
+    s->pipes[n] = p;
+    s->npipes++;
+    return p;
+}
+
+static void summary_syscall(summary_t* s, uint64_t ts, uint32_t arg, int enter) {
+    uint32_t num = arg >> 8;
+    uint32_t cpu = arg & 0xFF;
+    if (cpu >= SUMMARY_MAX_CPUS) {
+        return;
+    }
+    // the records don't say which thread made the call, so go by what the
+    // context switches say the cpu is running
+    sc_pending_t* sp;
+    if (s->current[cpu]) {
+        sp = &s->current[cpu]->syscall;
+    } else {
+        sp = &s->cpu_syscall[cpu];
+    }
+    if (enter) {
+        sp->ts = ts;
+        sp->num = num;
+        sp->active = 1;
+    } else if (sp->active && (sp->num == num)) {
+        hist_add(&find_syscall(s, num)->latency, ticks_to_ts(ts - sp->ts));
+        sp->active = 0;
+    }
+}
+
+static void summary_context_switch(summary_t* s, uint64_t ts, uint32_t oldtid,
+                                   uint32_t newtid, uint32_t state, uint32_t cpu,
+                                   uint32_t oldktid, uint32_t newktid) {
+    thread_info_t* t = find_thread(s, oldktid);
+    if (oldtid) {
+        t->tid = oldtid;
+    }
+    if (t->running) {
+        t->run_time += ticks_to_ts(ts - t->last_ts);
+    }
+    t->running = 0;
+    t->last_ts = ts;
+    t->last_state = state;
+    t->switches++;
+    if (state == THREAD_READY) {
+        t->preemptions++;
+    }
+
+    t = find_thread(s, newktid);
+    if (newtid) {
+        t->tid = newtid;
+    }
+    if (!t->running && t->last_ts) {
+        uint64_t delta = ticks_to_ts(ts - t->last_ts);
+        if (t->last_state == THREAD_READY) {
+            // it was runnable all along, so this was time in the run queue
+            t->preempt_time += delta;
+            hist_add(&s->runq_delay, delta);
+        } else {
+            t->wait_time += delta;
+        }
+    }
+    t->running = 1;
+    t->last_ts = ts;
+    if (cpu < SUMMARY_MAX_CPUS) {
+        s->current[cpu] = t;
+        s->cpu_syscall[cpu].active = 0;
+    }
+}
+
+static void summary_msgpipe_write(summary_t* s, uint64_t ts, uint32_t id) {
+    pipe_info_t* p = find_pipe(s, id, 1);
+    if (p->pending == NULL) {
+        p->pending = malloc(PIPE_PENDING * sizeof(uint64_t));
+    }
+    if ((p->head - p->tail) == PIPE_PENDING) {
+        // forget the oldest rather than grow without bound
+        p->tail++;
+        p->dropped++;
+    }
+    p->pending[p->head++ % PIPE_PENDING] = ts;
+}
+
+static void summary_msgpipe_read(summary_t* s, uint64_t ts, uint32_t id) {
+    pipe_info_t* reader = find_pipe(s, id, 0);
+    pipe_info_t* p = reader ? find_pipe(s, reader->other, 0) : NULL;
+    if ((p == NULL) || (p->head == p->tail)) {
+        // written before the trace started, or the pipe was never seen
+        s->unmatched_reads++;
+        return;
+    }
+    hist_add(&p->latency, ticks_to_ts(ts - p->pending[p->tail++ % PIPE_PENDING]));
+}
+
+static void summary_msgpipe_create(summary_t* s, uint32_t id0, uint32_t id1) {
+    find_pipe(s, id0, 1)->other = id1;
+    find_pipe(s, id1, 1)->other = id0;
+}
+
+static void summary_object_delete(summary_t* s, uint32_t id) {
+    // messages still queued will never be read, so stop tracking them
+    pipe_info_t* p = find_pipe(s, id, 0);
+    if (p && p->pending) {
+        free(p->pending);
+        p->pending = NULL;
+        p->head = p->tail = 0;
+    }
+}
+
+static int cmp_thread(const void* a, const void* b) {
+    const thread_info_t* ta = *(thread_info_t* const*)a;
+    const thread_info_t* tb = *(thread_info_t* const*)b;
+    if (ta->run_time != tb->run_time) {
+        return (ta->run_time < tb->run_time) ? 1 : -1;
+    }
+    return (ta->ktid < tb->ktid) ? -1 : 1;
+}
+
+static int cmp_syscall(const void* a, const void* b) {
+    const sc_info_t* sa = *(sc_info_t* const*)a;
+    const sc_info_t* sb = *(sc_info_t* const*)b;
+    if (sa->latency.sum != sb->latency.sum) {
+        return (sa->latency.sum < sb->latency.sum) ? 1 : -1;
+    }
+    return (sa->num < sb->num) ? -1 : 1;
+}
+
+static int cmp_pipe(const void* a, const void* b) {
+    const pipe_info_t* pa = *(pipe_info_t* const*)a;
+    const pipe_info_t* pb = *(pipe_info_t* const*)b;
+    if (pa->latency.count != pb->latency.count) {
+        return (pa->latency.count < pb->latency.count) ? 1 : -1;
+    }
+    return (pa->id < pb->id) ? -1 : 1;
+}
+
+static void summary_print(summary_t* s, uint64_t events, uint64_t duration) {
+    printf("events: %" PRIu64 "  elapsed: %" PRIu64 ".%06" PRIu64 " s\n",
+           events, duration / 1000000000UL, (duration % 1000000000UL) / 1000UL);
+
+    sc_info_t** scs = calloc(s->nsyscalls + 1, sizeof(sc_info_t*));
+    unsigned count = 0;
+    for (unsigned n = 0; n < BUCKETS; n++) {
+        for (sc_info_t* sc = s->syscalls[n]; sc != NULL; sc = sc->next) {
+            if (sc->latency.count) {
+                scs[count++] = sc;
+            }
+        }
+    }
+    qsort(scs, count, sizeof(sc_info_t*), cmp_syscall);
+    hist_print_header("syscall latency");
+    for (unsigned n = 0; n < count; n++) {
+        hist_print(scs[n]->name, &scs[n]->latency);
+    }
+    free(scs);
+
+    thread_info_t** ts = calloc(s->nthreads + 1, sizeof(thread_info_t*));
+    count = 0;
+    for (unsigned n = 0; n < BUCKETS; n++) {
+        for (thread_info_t* t = s->threads[n]; t != NULL; t = t->next) {
+            ts[count++] = t;
+        }
+    }
+    qsort(ts, count, sizeof(thread_info_t*), cmp_thread);
+    printf("\n%-10s %-10s %-24s %14s %14s %14s %10s %10s\n", "thread", "ktid", "name",
+           "run(us)", "wait(us)", "preempt(us)", "switches", "preempts");
+    for (unsigned n = 0; n < count; n++) {
+        thread_info_t* t = ts[n];
+        printf("%-10u %08x   %-24s %14.3f %14.3f %14.3f %10u %10u\n", t->tid, t->ktid,
+               t->name[0] ? t->name : (t->tid ? "-" : "kernel"),
+               t->run_time / 1000.0, t->wait_time / 1000.0, t->preempt_time / 1000.0,
+               t->switches, t->preemptions);
+    }
+    free(ts);
+
+    hist_print_header("run queue delay");
+    hist_print("preempted to running", &s->runq_delay);
+
+    pipe_info_t** ps = calloc(s->npipes + 1, sizeof(pipe_info_t*));
+    count = 0;
+    hist_t all;
+    memset(&all, 0, sizeof(all));
+    for (unsigned n = 0; n < BUCKETS; n++) {
+        for (pipe_info_t* p = s->pipes[n]; p != NULL; p = p->next) {
+            if (p->latency.count == 0) {
+                continue;
+            }
+            ps[count++] = p;
+            all.count += p->latency.count;
+            all.sum += p->latency.sum;
+            if (p->latency.max > all.max) {
+                all.max = p->latency.max;
+            }
+            for (unsigned b = 0; b < HIST_BUCKETS; b++) {
+                all.bucket[b] += p->latency.bucket[b];
+            }
+        }
+    }
+    qsort(ps, count, sizeof(pipe_info_t*), cmp_pipe);
+    hist_print_header("msgpipe write to read");
+    hist_print("all pipes", &all);
+    for (unsigned n = 0; n < count; n++) {
+        char name[64];
+        snprintf(name, sizeof(name), "%08x -> %08x", ps[n]->id, ps[n]->other);
+        hist_print(name, &ps[n]->latency);
+        if (ps[n]->dropped) {
+            printf("  %-28s %10" PRIu64 " messages unread when tracking was dropped\n",
+                   "", ps[n]->dropped);
+        }
+    }
+    if (s->unmatched_reads) {
+        printf("  %" PRIu64 " reads of messages written before the trace began\n",
+               s->unmatched_reads);
+    }
+    free(ps);
+}
+
+int summarize(const char* fn) {
+    FILE* fp;
+    if ((fp = fopen(fn, "rb")) == NULL) {
+        fprintf(stderr, "error: cannot open '%s'\n", fn);
+        return -1;
+    }
+    setvbuf(fp, NULL, _IOFBF, 1024 * 1024);
+
+    summary_t* s = calloc(1, sizeof(summary_t));
+    ktrace_record_t rec;
+    uint64_t events = 0;
+    uint64_t ts_first = 0;
+    uint64_t ts_last = 0;
+
+    while (fread(rec.raw, sizeof(ktrace_header_t), 1, fp) == 1) {
+        uint32_t tag = rec.hdr.tag;
+        uint32_t len = KTRACE_LEN(tag);
+        if (tag == 0) {
+            break;
+        }
+        if (len < sizeof(ktrace_header_t)) {
+            fprintf(stderr, "eof: short record\n");
+            break;
+        }
+        len -= sizeof(ktrace_header_t);
+        if (len && (fread(rec.raw + sizeof(ktrace_header_t), len, 1, fp) != 1)) {
+            fprintf(stderr, "eof: short payload\n");
+            break;
+        }
+        events++;
+
+        // name records have no timestamp
+        switch (KTRACE_EVENT(tag)) {
+        case EVT_SYSCALL_NAME:
+            snprintf(find_syscall(s, rec.name.id)->name, 32, "%s", recname(&rec.name));
+            continue;
+        case EVT_KTHREAD_NAME:
+            snprintf(find_thread(s, rec.name.id)->name, 32, "%s", recname(&rec.name));
+            continue;
+        case EVT_THREAD_NAME:
+        case EVT_PROC_NAME:
+        case EVT_IRQ_NAME:
+        case EVT_PROBE_NAME:
+        case EVT_USER_NAME:
+            continue;
+        }
+
+        uint64_t ts = rec.hdr.ts;
+        if (KTRACE_GROUP(tag) != KTRACE_GRP_META) {
+            if (ts_first == 0) {
+                ts_first = ts;
+            }
+            ts_last = ts;
+        }
+
+        switch (KTRACE_EVENT(tag)) {
+        case EVT_TICKS_PER_MS:
+            ticks_per_ms = ((uint64_t)rec.x4.a) | (((uint64_t)rec.x4.b) << 32);
+            break;
+        case EVT_SYSCALL_ENTER:
+            summary_syscall(s, ts, rec.hdr.tid, 1);
+            break;
+        case EVT_SYSCALL_EXIT:
+            summary_syscall(s, ts, rec.hdr.tid, 0);
+            break;
+        case EVT_CONTEXT_SWITCH:
+            summary_context_switch(s, ts, rec.hdr.tid, rec.x4.a, rec.x4.b >> 16,
+                                   rec.x4.b & 0xFFFF, rec.x4.c, rec.x4.d);
+            break;
+        case EVT_MSGPIPE_CREATE:
+            summary_msgpipe_create(s, rec.x4.a, rec.x4.b);
+            break;
+        case EVT_MSGPIPE_WRITE:
+            summary_msgpipe_write(s, ts, rec.x4.a);
+            break;
+        case EVT_MSGPIPE_READ:
+            summary_msgpipe_read(s, ts, rec.x4.a);
+            break;
+        case EVT_OBJECT_DELETE:
+            summary_object_delete(s, rec.x4.a);
+            break;
+        }
+    }
+    fclose(fp);
+
+    // threads still running at the end ran until the last event
+    for (unsigned n = 0; n < BUCKETS; n++) {
+        for (thread_info_t* t = s->threads[n]; t != NULL; t = t->next) {
+            if (t->running) {
+                t->run_time += ticks_to_ts(ts_last - t->last_ts);
+            }
+        }
+    }
+
+    summary_print(s, events, ticks_to_ts(ts_last - ts_first));
+    return 0;
+}
+
 int main(int argc, char** argv) {
     int show_stats = 0;
+    int summary = 0;
     stats_t s;
     ktrace_record_t rec;
     objinfo_t* oi;
@@ -792,6 +1382,8 @@ int main(int argc, char** argv) {
             with_syscalls = 1;
         } else if (!strcmp(argv[1], "-stats")) {
             show_stats = 1;
+        } else if (!strcmp(argv[1], "-summary")) {
+            summary = 1;
         } else if (!strncmp(argv[1], "-onlypid=", 9)) {
             char* next;
             for (char* x = argv[1] + 9; x != NULL; x = next) {
@@ -818,6 +1410,10 @@ int main(int argc, char** argv) {
         return usage();
     }
 
+    if (summary) {
+        return summarize(argv[1]);
+    }
+
     int fd;
     if ((fd = open(argv[1], O_RDONLY)) < 0) {
         fprintf(stderr, "error: cannot open '%s'\n", argv[0]);
@@ -999,6 +1595,32 @@ int main(int argc, char** argv) {
             trace("WAIT_DONE   id=%08x pending=%08x result=%08x\n", rec.x4.a, rec.x4.b, rec.x4.c);
             evt_wait_one_done(&ei, rec.x4.a, rec.x4.b, rec.x4.c);
             break;
+        case EVT_USER_NAME:
+            trace("USER_NAME   id=%08x pid=%08x '%s'\n", rec.name.id, rec.name.arg,
+                  recname(&rec.name));
+            evt_user_name(rec.name.id, recname(&rec.name));
+            break;
+        case EVT_USER_BEGIN:
+        case EVT_USER_END:
+        case EVT_USER_COUNTER:
+        case EVT_USER_FLOW_BEGIN:
+        case EVT_USER_FLOW_STEP:
+        case EVT_USER_FLOW_END:
+            trace("USER_EVENT  ev=%03x id=%08x '%s' pid=%08x args=%08x,%08x\n",
+                  KTRACE_EVENT(tag), rec.x4.a, user_name(rec.x4.a), rec.x4.d,
+                  rec.x4.b, rec.x4.c);
+            evt_user(&ei, KTRACE_EVENT(tag), rec.x4.a, rec.x4.d, rec.x4.b, rec.x4.c);
+            break;
+        case EVT_PROFILE_SAMPLE:
+            trace("PROF_SAMPLE pc=%08x%08x pid=%08x cpu=%u %s frames=%u\n",
+                  rec.x4.b, rec.x4.a, rec.x4.c, KTRACE_PROFILE_CPU(rec.x4.d),
+                  KTRACE_PROFILE_USER(rec.x4.d) ? "user" : "kernel",
+                  KTRACE_PROFILE_FRAMES(rec.x4.d));
+            break;
+        case EVT_PROFILE_FRAMES:
+            trace("PROF_FRAMES cpu=%u %08x%08x %08x%08x\n",
+                  rec.hdr.tid, rec.x4.b, rec.x4.a, rec.x4.d, rec.x4.c);
+            break;
         default:
             trace("UNKNOWN_TAG id=%08x tag=%08x\n", rec.hdr.tid, tag);
             break;
@@ -17,25 +17,34 @@ int main(int argc, char** argv) {
     }
     if ((h = mx_log_create(MX_LOG_FLAG_READABLE)) < 0) {
         printf("dlog: cannot open log\n");
+        return -1;
     }
 
-    char buf[MX_LOG_RECORD_MAX];
-    mx_log_record_t* rec = (mx_log_record_t*)buf;
+    // records are read many at a time and written out in one go
+    static uint64_t buf[8192 / sizeof(uint64_t)];
+    static char out[sizeof(buf) * 2];
     for (;;) {
-        if (mx_log_read(h, MX_LOG_RECORD_MAX, rec, tail ? MX_LOG_FLAG_WAIT : 0) > 0) {
-            char tmp[64];
-            snprintf(tmp, 64, "[%05d.%03d] %c ",
-                     (int)(rec->timestamp / 1000000000ULL),
-                     (int)((rec->timestamp / 1000000ULL) % 1000ULL),
-                     (rec->flags & MX_LOG_FLAG_KERNEL) ? 'K' : 'U');
-            write(1, tmp, strlen(tmp));
-            write(1, rec->data, rec->datalen);
-            if ((rec->datalen == 0) || (rec->data[rec->datalen - 1] != '\n')) {
-                write(1, "\n", 1);
-            }
-        } else {
+        mx_ssize_t len = mx_log_read(h, sizeof(buf), buf,
+                                     MX_LOG_FLAG_BATCH | (tail ? MX_LOG_FLAG_WAIT : 0));
+        if (len <= 0) {
             break;
         }
+        size_t n = 0;
+        for (mx_ssize_t off = 0; off < len;) {
+            mx_log_record_t* rec = (mx_log_record_t*)((char*)buf + off);
+            off += (sizeof(mx_log_record_t) + rec->datalen + 7) & ~7;
+
+            int datalen = rec->datalen;
+            if ((datalen > 0) && (rec->data[datalen - 1] == '\n')) {
+                datalen--;
+            }
+            n += snprintf(out + n, sizeof(out) - n, "[%05d.%03d] %c %.*s\n",
+                          (int)(rec->timestamp / 1000000000ULL),
+                          (int)((rec->timestamp / 1000000ULL) % 1000ULL),
+                          (rec->flags & MX_LOG_FLAG_KERNEL) ? 'K' : 'U',
+                          datalen, rec->data);
+        }
+        write(1, out, n);
     }
     return 0;
 }
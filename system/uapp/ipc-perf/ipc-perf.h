@@ -0,0 +1,44 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <magenta/types.h>
+
+// One thread's instance of a benchmark, owning whatever objects (and helper
+// threads or processes) it needs.  The harness calls Run() repeatedly from a
+// single thread and times it.
+class Test {
+public:
+    virtual ~Test() {}
+
+    // Returns NO_ERROR if the test is ready to run.
+    virtual mx_status_t Init() { return NO_ERROR; }
+
+    // Performs |count| operations.
+    virtual void Run(uint32_t count) = 0;
+};
+
+struct Benchmark {
+    const char* name;
+    // what |args| are, or nullptr if the benchmark takes no argument
+    const char* arg_name;
+    const uint32_t* args;
+    size_t num_args;
+    // if true, each operation moves |arg| bytes
+    bool throughput;
+    Test* (*create)(uint32_t arg);
+};
+
+extern const Benchmark kBenchmarks[];
+extern const size_t kNumBenchmarks;
+
+// The path of this binary, for the benchmarks that start a second process.
+extern const char* g_self_path;
+
+// Entry point of the echo process the cross-process benchmarks start.
+int echo_main(void);
@@ -0,0 +1,295 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ipc-perf.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include <magenta/compiler.h>
+#include <magenta/syscalls.h>
+#include <mxtl/unique_ptr.h>
+
+const char* g_self_path;
+
+namespace {
+
+enum class Format { kText, kCsv, kJson };
+
+// Operations are timed in batches at least this long, so that reading the
+// clock doesn't show up in the results.
+constexpr mx_time_t kMinBatchNs = 100 * 1000u;
+
+void argument_error(const char* argv0, const char* message) {
+    fprintf(stderr, "%s: error: %s\nRun with -h for help.\n", argv0, message);
+    exit(EXIT_FAILURE);
+}
+
+// State shared by the threads running one benchmark.
+struct RunState {
+    uint32_t ready = 0;
+    bool start = false;
+    bool stop = false;
+};
+
+struct Worker {
+    RunState* run;
+    Test* test;
+    uint64_t ops;
+    mx_time_t elapsed_ns;
+};
+
+int worker_thread(void* arg) {
+    Worker* w = static_cast<Worker*>(arg);
+
+    // Warm up, growing the batch until it takes long enough to time.
+    uint32_t batch = 1;
+    for (;;) {
+        mx_time_t start = mx_current_time();
+        w->test->Run(batch);
+        if (mx_current_time() - start >= kMinBatchNs || batch >= (1u << 30))
+            break;
+        batch *= 2;
+    }
+
+    __atomic_fetch_add(&w->run->ready, 1, __ATOMIC_SEQ_CST);
+    while (!__atomic_load_n(&w->run->start, __ATOMIC_SEQ_CST))
+        ;
+
+    uint64_t ops = 0;
+    mx_time_t start = mx_current_time();
+    do {
+        w->test->Run(batch);
+        ops += batch;
+    } while (!__atomic_load_n(&w->run->stop, __ATOMIC_SEQ_CST));
+    w->elapsed_ns = mx_current_time() - start;
+    w->ops = ops;
+    return 0;
+}
+
+void print_header(Format format) {
+    switch (format) {
+        case Format::kText:
+            printf("%-28s %-16s %7s %12s %14s %10s\n", "benchmark", "arg", "threads",
+                   "ns/op", "ops/s", "MB/s");
+            break;
+        case Format::kCsv:
+            printf("name,arg_name,arg,threads,cpus,ops,ns_per_op,ops_per_sec,mb_per_sec\n");
+            break;
+        case Format::kJson:
+            break;
+    }
+}
+
+void print_result(Format format, const Benchmark& b, uint32_t arg, uint32_t threads,
+                  uint64_t ops, double ns_per_op, double ops_per_sec) {
+    double mb_per_sec = b.throughput ? ops_per_sec * arg / 1000000.0 : 0.0;
+    const char* arg_name = b.arg_name ? b.arg_name : "";
+    uint32_t cpus = mx_num_cpus();
+
+    switch (format) {
+        case Format::kText: {
+            char arg_str[32] = "";
+            if (b.arg_name)
+                snprintf(arg_str, sizeof(arg_str), "%s=%" PRIu32, arg_name, arg);
+            printf("%-28s %-16s %7" PRIu32 " %12.1f %14.0f", b.name, arg_str, threads,
+                   ns_per_op, ops_per_sec);
+            if (b.throughput)
+                printf(" %10.1f", mb_per_sec);
+            printf("\n");
+            break;
+        }
+        case Format::kCsv:
+            printf("%s,%s,%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu64 ",%.1f,%.0f,%.1f\n",
+                   b.name, arg_name, arg, threads, cpus, ops, ns_per_op, ops_per_sec,
+                   mb_per_sec);
+            break;
+        case Format::kJson:
+            printf("{\"name\":\"%s\",\"arg_name\":\"%s\",\"arg\":%" PRIu32
+                   ",\"threads\":%" PRIu32 ",\"cpus\":%" PRIu32 ",\"ops\":%" PRIu64
+                   ",\"ns_per_op\":%.1f,\"ops_per_sec\":%.0f,\"mb_per_sec\":%.1f}\n",
+                   b.name, arg_name, arg, threads, cpus, ops, ns_per_op, ops_per_sec,
+                   mb_per_sec);
+            break;
+    }
+    fflush(stdout);
+}
+
+// Runs |b| on |threads| threads at once for |duration_ms|.  Returns false if
+// the benchmark couldn't be set up.
+bool run_benchmark(const Benchmark& b, uint32_t arg, uint32_t threads, uint32_t duration_ms,
+                   Format format) {
+    mxtl::unique_ptr<mxtl::unique_ptr<Test>[]> tests(new mxtl::unique_ptr<Test>[threads]);
+    for (uint32_t i = 0; i < threads; i++) {
+        tests[i].reset(b.create(arg));
+        mx_status_t status = tests[i]->Init();
+        if (status != NO_ERROR) {
+            fprintf(stderr, "%s (%" PRIu32 "): setup failed: %d\n", b.name, arg, status);
+            return false;
+        }
+    }
+
+    RunState run;
+    mxtl::unique_ptr<Worker[]> workers(new Worker[threads]);
+    mxtl::unique_ptr<thrd_t[]> handles(new thrd_t[threads]);
+    uint32_t started = 0;
+    for (; started < threads; started++) {
+        workers[started] = {&run, tests[started].get(), 0, 0};
+        if (thrd_create_with_name(&handles[started], worker_thread, &workers[started],
+                                  b.name) != thrd_success) {
+            fprintf(stderr, "%s: can't start thread %" PRIu32 "\n", b.name, started);
+            break;
+        }
+    }
+
+    while (__atomic_load_n(&run.ready, __ATOMIC_SEQ_CST) < started)
+        mx_nanosleep(1000 * 1000u);
+    __atomic_store_n(&run.start, true, __ATOMIC_SEQ_CST);
+    mx_nanosleep(duration_ms * 1000ull * 1000u);
+    __atomic_store_n(&run.stop, true, __ATOMIC_SEQ_CST);
+    for (uint32_t i = 0; i < started; i++)
+        thrd_join(handles[i], nullptr);
+    if (started < threads)
+        return false;
+
+    uint64_t ops = 0;
+    double ns_per_op = 0.0;
+    double ops_per_sec = 0.0;
+    for (uint32_t i = 0; i < threads; i++) {
+        double elapsed = static_cast<double>(workers[i].elapsed_ns);
+        ops += workers[i].ops;
+        ns_per_op += elapsed / static_cast<double>(workers[i].ops) / threads;
+        ops_per_sec += static_cast<double>(workers[i].ops) * 1000000000.0 / elapsed;
+    }
+    print_result(format, b, arg, threads, ops, ns_per_op, ops_per_sec);
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    static constexpr char help[] =
+        "Usage: %s [options ...]\n"
+        "\n"
+        "Runs each benchmark on 1, 2, 4, ... threads at once, up to the\n"
+        "number of cpus, and reports the time per operation on each thread\n"
+        "and the operations per second over all of them.\n"
+        "\n"
+        "Options:\n"
+        "  -h         show help (this)\n"
+        "  -l         list the benchmarks\n"
+        "  -b PREFIX  only run the benchmarks whose names start with PREFIX\n"
+        "  -d N       run each benchmark for N milliseconds (default: 200)\n"
+        "  -t N       sweep up to N threads (default: the number of cpus)\n"
+        "  -T N       only run on N threads\n"
+        "  -f FORMAT  text, csv or json, one object per line (default: text)\n";
+
+    g_self_path = argv[0];
+
+    const char* prefix = "";               // -b
+    uint32_t duration_ms = 200;            // -d
+    uint32_t max_threads = mx_num_cpus();  // -t
+    uint32_t only_threads = 0;             // -T
+    Format format = Format::kText;         // -f
+    bool list = false;                     // -l
+
+    int opt;
+    while ((opt = getopt(argc, argv, "+hlEb:d:t:T:f:")) != -1) {
+        uint32_t value = 0;
+        if (optarg && (opt == 'd' || opt == 't' || opt == 'T')) {
+            errno = 0;
+            char* endptr = nullptr;
+            unsigned long long v = strtoull(optarg, &endptr, 10);
+            if (errno != 0 || *endptr != '\0' || v == 0 || v > UINT32_MAX)
+                argument_error(argv[0], "invalid numeric optional value");
+            value = static_cast<uint32_t>(v);
+        }
+
+        switch (opt) {
+            case 'h':
+                printf(help, argv[0]);
+                return EXIT_SUCCESS;
+            case 'l':
+                list = true;
+                break;
+            case 'E':
+                // Not for humans: the cross-process benchmarks start us
+                // with this to echo messages back to them.
+                return echo_main();
+            case 'b':
+                prefix = optarg;
+                break;
+            case 'd':
+                duration_ms = value;
+                break;
+            case 't':
+                max_threads = value;
+                break;
+            case 'T':
+                only_threads = value;
+                break;
+            case 'f':
+                if (!strcmp(optarg, "text")) {
+                    format = Format::kText;
+                } else if (!strcmp(optarg, "csv")) {
+                    format = Format::kCsv;
+                } else if (!strcmp(optarg, "json")) {
+                    format = Format::kJson;
+                } else {
+                    argument_error(argv[0], "unknown format");
+                }
+                break;
+            default:  // '?'
+                argument_error(argv[0], "invalid option");
+                break;
+        }
+    }
+    if (optind < argc)
+        argument_error(argv[0], "unexpected positional argument");
+
+    if (list) {
+        for (size_t i = 0; i < kNumBenchmarks; i++) {
+            const Benchmark& b = kBenchmarks[i];
+            printf("%s", b.name);
+            if (b.arg_name) {
+                printf(" (%s:", b.arg_name);
+                for (size_t j = 0; j < b.num_args; j++)
+                    printf(" %" PRIu32, b.args[j]);
+                printf(")");
+            }
+            printf("\n");
+        }
+        return EXIT_SUCCESS;
+    }
+
+    int result = EXIT_SUCCESS;
+    print_header(format);
+    for (size_t i = 0; i < kNumBenchmarks; i++) {
+        const Benchmark& b = kBenchmarks[i];
+        if (strncmp(b.name, prefix, strlen(prefix)))
+            continue;
+
+        static constexpr uint32_t kNoArg = 0;
+        const uint32_t* args = b.num_args ? b.args : &kNoArg;
+        size_t num_args = b.num_args ? b.num_args : 1;
+        for (size_t j = 0; j < num_args; j++) {
+            uint32_t threads = only_threads ? only_threads : 1;
+            for (;;) {
+                if (!run_benchmark(b, args[j], threads, duration_ms, format))
+                    result = EXIT_FAILURE;
+                if (only_threads || threads >= max_threads)
+                    break;
+                threads = (threads * 2 > max_threads) ? max_threads : threads * 2;
+            }
+        }
+    }
+
+    return result;
+}
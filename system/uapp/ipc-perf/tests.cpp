@@ -0,0 +1,601 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ipc-perf.h"
+
+#include <assert.h>
+#include <string.h>
+#include <threads.h>
+
+#include <launchpad/launchpad.h>
+#include <magenta/compiler.h>
+#include <magenta/process.h>
+#include <magenta/processargs.h>
+#include <magenta/syscalls.h>
+#include <mxio/util.h>
+#include <mxtl/unique_ptr.h>
+
+namespace {
+
+constexpr uint32_t kMessageSizes[] = {8, 64, 512, 4096, 32768, 65536};
+constexpr uint32_t kHandleCounts[] = {1, 2, 8, 64};
+constexpr uint32_t kWaitCounts[] = {1, 4, 16, 64, 256};
+constexpr uint32_t kStreamSizes[] = {64, 512, 4096, 32768, 65536};
+constexpr uint32_t kVmoSizes[] = {64, 4096, 65536, 1048576};
+constexpr uint32_t kMapSizes[] = {4096, 65536, 1048576};
+
+// Fills |size| bytes with a pattern.
+mxtl::unique_ptr<uint8_t[]> make_buffer(uint32_t size) {
+    mxtl::unique_ptr<uint8_t[]> buf(new uint8_t[size ? size : 1]);
+    memset(buf.get(), 0x5a, size);
+    return buf;
+}
+
+// Enters and leaves the kernel, doing nothing.
+class NullSyscallTest : public Test {
+public:
+    void Run(uint32_t count) override {
+        for (uint32_t i = 0; i < count; i++)
+            mx_syscall_test_0();
+    }
+};
+
+class HandleDuplicateTest : public Test {
+public:
+    ~HandleDuplicateTest() override {
+        if (event_ > 0)
+            mx_handle_close(event_);
+    }
+
+    mx_status_t Init() override {
+        event_ = mx_event_create(0u);
+        return (event_ > 0) ? NO_ERROR : event_;
+    }
+
+    void Run(uint32_t count) override {
+        for (uint32_t i = 0; i < count; i++) {
+            mx_handle_t dup = mx_handle_duplicate(event_, MX_RIGHT_SAME_RIGHTS);
+            assert(dup > 0);
+            __UNUSED mx_status_t status = mx_handle_close(dup);
+            assert(status == NO_ERROR);
+        }
+    }
+
+private:
+    mx_handle_t event_ = MX_HANDLE_INVALID;
+};
+
+// Writes a message into a pipe and reads it back out, on one thread.
+class MsgpipeTest : public Test {
+public:
+    MsgpipeTest(uint32_t size, uint32_t num_handles)
+        : size_(size), num_handles_(num_handles), data_(make_buffer(size)),
+          handles_(new mx_handle_t[num_handles ? num_handles : 1]) {}
+
+    ~MsgpipeTest() override {
+        for (uint32_t i = 0; i < handles_created_; i++)
+            mx_handle_close(handles_[i]);
+        mx_handle_close(pipe_[0]);
+        mx_handle_close(pipe_[1]);
+    }
+
+    mx_status_t Init() override {
+        mx_status_t status = mx_msgpipe_create(pipe_, 0u);
+        if (status != NO_ERROR)
+            return status;
+        // The same handles go back and forth through the pipe.
+        for (; handles_created_ < num_handles_; handles_created_++) {
+            handles_[handles_created_] = mx_event_create(0u);
+            if (handles_[handles_created_] < 0)
+                return handles_[handles_created_];
+        }
+        return NO_ERROR;
+    }
+
+    void Run(uint32_t count) override {
+        for (uint32_t i = 0; i < count; i++) {
+            __UNUSED mx_status_t status = mx_msgpipe_write(pipe_[0], data_.get(), size_,
+                                                           handles_.get(), num_handles_, 0u);
+            assert(status == NO_ERROR);
+            uint32_t size = size_;
+            uint32_t num_handles = num_handles_;
+            status = mx_msgpipe_read(pipe_[1], data_.get(), &size, handles_.get(),
+                                     &num_handles, 0u);
+            assert(status == NO_ERROR);
+            assert(size == size_ && num_handles == num_handles_);
+        }
+    }
+
+private:
+    const uint32_t size_;
+    const uint32_t num_handles_;
+    uint32_t handles_created_ = 0;
+    mxtl::unique_ptr<uint8_t[]> data_;
+    mxtl::unique_ptr<mx_handle_t[]> handles_;
+    mx_handle_t pipe_[2] = {MX_HANDLE_INVALID, MX_HANDLE_INVALID};
+};
+
+// Sends whatever arrives on |pipe| straight back, until the other end
+// goes away.
+void echo_loop(mx_handle_t pipe) {
+    uint8_t data[65536];
+    for (;;) {
+        mx_signals_state_t state;
+        mx_status_t status = mx_handle_wait_one(pipe, MX_SIGNAL_READABLE | MX_SIGNAL_PEER_CLOSED,
+                                                MX_TIME_INFINITE, &state);
+        if (status != NO_ERROR || !(state.satisfied & MX_SIGNAL_READABLE))
+            break;
+        uint32_t size = sizeof(data);
+        if (mx_msgpipe_read(pipe, data, &size, nullptr, nullptr, 0u) != NO_ERROR)
+            break;
+        if (mx_msgpipe_write(pipe, data, size, nullptr, 0u, 0u) != NO_ERROR)
+            break;
+    }
+    mx_handle_close(pipe);
+}
+
+// Round trips a message through an echo thread, or an echo process.
+class MsgpipePingPongTest : public Test {
+public:
+    MsgpipePingPongTest(uint32_t size, bool cross_process)
+        : size_(size), cross_process_(cross_process), data_(make_buffer(size)) {}
+
+    ~MsgpipePingPongTest() override {
+        // Closing our end makes the echo loop exit.
+        mx_handle_close(pipe_);
+        if (thread_started_)
+            thrd_join(thread_, nullptr);
+        if (process_ > 0) {
+            mx_handle_wait_one(process_, MX_SIGNAL_SIGNALED, MX_TIME_INFINITE, nullptr);
+            mx_handle_close(process_);
+        }
+    }
+
+    mx_status_t Init() override {
+        mx_handle_t pipe[2];
+        mx_status_t status = mx_msgpipe_create(pipe, 0u);
+        if (status != NO_ERROR)
+            return status;
+        pipe_ = pipe[0];
+
+        if (cross_process_) {
+            const char* argv[] = {g_self_path, "-E"};
+            uint32_t id = MX_HND_INFO(MX_HND_TYPE_USER0, 0);
+            process_ = launchpad_launch_mxio_etc(g_self_path, countof(argv), argv, nullptr,
+                                                 1, &pipe[1], &id);
+            return (process_ > 0) ? NO_ERROR : process_;
+        }
+
+        echo_pipe_ = pipe[1];
+        if (thrd_create(&thread_, EchoThread, this) != thrd_success) {
+            mx_handle_close(echo_pipe_);
+            return ERR_NO_RESOURCES;
+        }
+        thread_started_ = true;
+        return NO_ERROR;
+    }
+
+    void Run(uint32_t count) override {
+        for (uint32_t i = 0; i < count; i++) {
+            __UNUSED mx_status_t status = mx_msgpipe_write(pipe_, data_.get(), size_,
+                                                           nullptr, 0u, 0u);
+            assert(status == NO_ERROR);
+            status = mx_handle_wait_one(pipe_, MX_SIGNAL_READABLE, MX_TIME_INFINITE, nullptr);
+            assert(status == NO_ERROR);
+            uint32_t size = size_;
+            status = mx_msgpipe_read(pipe_, data_.get(), &size, nullptr, nullptr, 0u);
+            assert(status == NO_ERROR && size == size_);
+        }
+    }
+
+private:
+    static int EchoThread(void* arg) {
+        echo_loop(static_cast<MsgpipePingPongTest*>(arg)->echo_pipe_);
+        return 0;
+    }
+
+    const uint32_t size_;
+    const bool cross_process_;
+    mxtl::unique_ptr<uint8_t[]> data_;
+    mx_handle_t pipe_ = MX_HANDLE_INVALID;
+    mx_handle_t echo_pipe_ = MX_HANDLE_INVALID;
+    mx_handle_t process_ = MX_HANDLE_INVALID;
+    thrd_t thread_;
+    bool thread_started_ = false;
+};
+
+// Base for the tests that bounce a wakeup off a helper thread.
+class PingPongThreadTest : public Test {
+public:
+    ~PingPongThreadTest() override {
+        // Subclasses must have called StopThread() by now.
+        assert(!thread_started_);
+    }
+
+protected:
+    mx_status_t StartThread() {
+        if (thrd_create(&thread_, ThreadEntry, this) != thrd_success)
+            return ERR_NO_RESOURCES;
+        thread_started_ = true;
+        return NO_ERROR;
+    }
+
+    // Sets the stop flag, and calls Ping() so the helper notices.
+    void StopThread() {
+        if (!thread_started_)
+            return;
+        __atomic_store_n(&stop_, true, __ATOMIC_SEQ_CST);
+        Ping();
+        thrd_join(thread_, nullptr);
+        thread_started_ = false;
+    }
+
+    bool stopping() const { return __atomic_load_n(&stop_, __ATOMIC_SEQ_CST); }
+
+    // Wakes the helper thread.
+    virtual void Ping() = 0;
+    // The helper thread: waits for pings and answers each one until stopping().
+    virtual void Pong() = 0;
+
+private:
+    static int ThreadEntry(void* arg) {
+        static_cast<PingPongThreadTest*>(arg)->Pong();
+        return 0;
+    }
+
+    thrd_t thread_;
+    bool thread_started_ = false;
+    bool stop_ = false;
+};
+
+// Signals an event and waits for a helper thread to signal one back.
+class EventPingPongTest : public PingPongThreadTest {
+public:
+    ~EventPingPongTest() override {
+        StopThread();
+        mx_handle_close(ping_);
+        mx_handle_close(pong_);
+    }
+
+    mx_status_t Init() override {
+        if ((ping_ = mx_event_create(0u)) < 0)
+            return ping_;
+        if ((pong_ = mx_event_create(0u)) < 0)
+            return pong_;
+        return StartThread();
+    }
+
+    void Run(uint32_t count) override {
+        for (uint32_t i = 0; i < count; i++) {
+            Ping();
+            __UNUSED mx_status_t status = mx_handle_wait_one(pong_, MX_SIGNAL_SIGNALED,
+                                                             MX_TIME_INFINITE, nullptr);
+            assert(status == NO_ERROR);
+            mx_object_signal(pong_, MX_SIGNAL_SIGNALED, 0u);
+        }
+    }
+
+private:
+    void Ping() override {
+        mx_object_signal(ping_, 0u, MX_SIGNAL_SIGNALED);
+    }
+
+    void Pong() override {
+        for (;;) {
+            mx_handle_wait_one(ping_, MX_SIGNAL_SIGNALED, MX_TIME_INFINITE, nullptr);
+            mx_object_signal(ping_, MX_SIGNAL_SIGNALED, 0u);
+            if (stopping())
+                break;
+            mx_object_signal(pong_, 0u, MX_SIGNAL_SIGNALED);
+        }
+    }
+
+    mx_handle_t ping_ = MX_HANDLE_INVALID;
+    mx_handle_t pong_ = MX_HANDLE_INVALID;
+};
+
+// Wakes a helper thread blocked in futex_wait and waits to be woken back.
+class FutexPingPongTest : public PingPongThreadTest {
+public:
+    ~FutexPingPongTest() override {
+        StopThread();
+    }
+
+    mx_status_t Init() override {
+        return StartThread();
+    }
+
+    void Run(uint32_t count) override {
+        for (uint32_t i = 0; i < count; i++) {
+            Ping();
+            Wait(&pong_);
+        }
+    }
+
+private:
+    static void Wake(int* futex) {
+        __atomic_store_n(futex, 1, __ATOMIC_SEQ_CST);
+        mx_futex_wake(futex, 1u);
+    }
+
+    static void Wait(int* futex) {
+        while (__atomic_load_n(futex, __ATOMIC_SEQ_CST) == 0)
+            mx_futex_wait(futex, 0, MX_TIME_INFINITE);
+        __atomic_store_n(futex, 0, __ATOMIC_SEQ_CST);
+    }
+
+    void Ping() override {
+        Wake(&ping_);
+    }
+
+    void Pong() override {
+        for (;;) {
+            Wait(&ping_);
+            if (stopping())
+                break;
+            Wake(&pong_);
+        }
+    }
+
+    int ping_ = 0;
+    int pong_ = 0;
+};
+
+// Queues a user packet on a port and takes it back off.
+class PortTest : public Test {
+public:
+    ~PortTest() override {
+        if (port_ > 0)
+            mx_handle_close(port_);
+    }
+
+    mx_status_t Init() override {
+        port_ = mx_port_create(0u);
+        return (port_ > 0) ? NO_ERROR : port_;
+    }
+
+    void Run(uint32_t count) override {
+        Packet packet = {};
+        for (uint32_t i = 0; i < count; i++) {
+            packet.hdr.key = i;
+            __UNUSED mx_status_t status = mx_port_queue(port_, &packet, sizeof(packet));
+            assert(status == NO_ERROR);
+            status = mx_port_wait(port_, &packet, sizeof(packet));
+            assert(status == NO_ERROR);
+        }
+    }
+
+private:
+    struct Packet {
+        mx_packet_header_t hdr;
+        uint64_t payload;
+    };
+
+    mx_handle_t port_ = MX_HANDLE_INVALID;
+};
+
+// Waits on |count| events, of which only the last is signalled.
+class WaitManyTest : public Test {
+public:
+    explicit WaitManyTest(uint32_t count)
+        : count_(count), handles_(new mx_handle_t[count]), signals_(new mx_signals_t[count]) {}
+
+    ~WaitManyTest() override {
+        for (uint32_t i = 0; i < created_; i++)
+            mx_handle_close(handles_[i]);
+    }
+
+    mx_status_t Init() override {
+        for (; created_ < count_; created_++) {
+            handles_[created_] = mx_event_create(0u);
+            if (handles_[created_] < 0)
+                return handles_[created_];
+            signals_[created_] = MX_SIGNAL_SIGNALED;
+        }
+        return mx_object_signal(handles_[count_ - 1], 0u, MX_SIGNAL_SIGNALED);
+    }
+
+    void Run(uint32_t count) override {
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t index;
+            __UNUSED mx_status_t status = mx_handle_wait_many(count_, handles_.get(),
+                                                              signals_.get(), MX_TIME_INFINITE,
+                                                              &index, nullptr);
+            assert(status == NO_ERROR && index == count_ - 1);
+        }
+    }
+
+private:
+    const uint32_t count_;
+    uint32_t created_ = 0;
+    mxtl::unique_ptr<mx_handle_t[]> handles_;
+    mxtl::unique_ptr<mx_signals_t[]> signals_;
+};
+
+// Streams |size| bytes through a socket, writing and reading on one thread.
+class SocketTest : public Test {
+public:
+    explicit SocketTest(uint32_t size) : size_(size), data_(make_buffer(size)) {}
+
+    ~SocketTest() override {
+        mx_handle_close(socket_[0]);
+        mx_handle_close(socket_[1]);
+    }
+
+    mx_status_t Init() override {
+        return mx_socket_create(socket_, 0u);
+    }
+
+    void Run(uint32_t count) override {
+        for (uint32_t i = 0; i < count; i++) {
+            __UNUSED mx_ssize_t n = mx_socket_write(socket_[0], 0u, size_, data_.get());
+            assert(n == static_cast<mx_ssize_t>(size_));
+            n = mx_socket_read(socket_[1], 0u, size_, data_.get());
+            assert(n == static_cast<mx_ssize_t>(size_));
+        }
+    }
+
+private:
+    const uint32_t size_;
+    mxtl::unique_ptr<uint8_t[]> data_;
+    mx_handle_t socket_[2] = {MX_HANDLE_INVALID, MX_HANDLE_INVALID};
+};
+
+// Streams |size| bytes through a data pipe, writing and reading on one thread.
+class DatapipeTest : public Test {
+public:
+    explicit DatapipeTest(uint32_t size) : size_(size), data_(make_buffer(size)) {}
+
+    ~DatapipeTest() override {
+        if (producer_ > 0)
+            mx_handle_close(producer_);
+        if (consumer_ > 0)
+            mx_handle_close(consumer_);
+    }
+
+    mx_status_t Init() override {
+        producer_ = mx_datapipe_create(0u, 1u, kCapacity, &consumer_);
+        return (producer_ > 0) ? NO_ERROR : producer_;
+    }
+
+    void Run(uint32_t count) override {
+        for (uint32_t i = 0; i < count; i++) {
+            __UNUSED mx_ssize_t n = mx_datapipe_write(producer_, 0u, size_, data_.get());
+            assert(n == static_cast<mx_ssize_t>(size_));
+            n = mx_datapipe_read(consumer_, 0u, size_, data_.get());
+            assert(n == static_cast<mx_ssize_t>(size_));
+        }
+    }
+
+private:
+    static constexpr mx_size_t kCapacity = 256 * 1024u;
+
+    const uint32_t size_;
+    mxtl::unique_ptr<uint8_t[]> data_;
+    mx_handle_t producer_ = MX_HANDLE_INVALID;
+    mx_handle_t consumer_ = MX_HANDLE_INVALID;
+};
+
+// Writes |size| bytes into a committed vmo and reads them back out.
+class VmoReadWriteTest : public Test {
+public:
+    explicit VmoReadWriteTest(uint32_t size) : size_(size), data_(make_buffer(size)) {}
+
+    ~VmoReadWriteTest() override {
+        if (vmo_ > 0)
+            mx_handle_close(vmo_);
+    }
+
+    mx_status_t Init() override {
+        if ((vmo_ = mx_vmo_create(size_)) < 0)
+            return vmo_;
+        // Commit up front so we don't time the page allocations.
+        return mx_vmo_op_range(vmo_, MX_VMO_OP_COMMIT, 0, size_, nullptr, 0);
+    }
+
+    void Run(uint32_t count) override {
+        for (uint32_t i = 0; i < count; i++) {
+            __UNUSED mx_ssize_t n = mx_vmo_write(vmo_, data_.get(), 0, size_);
+            assert(n == static_cast<mx_ssize_t>(size_));
+            n = mx_vmo_read(vmo_, data_.get(), 0, size_);
+            assert(n == static_cast<mx_ssize_t>(size_));
+        }
+    }
+
+private:
+    const uint32_t size_;
+    mxtl::unique_ptr<uint8_t[]> data_;
+    mx_handle_t vmo_ = MX_HANDLE_INVALID;
+};
+
+// Maps |size| bytes of a committed vmo into our address space and unmaps it.
+class VmoMapTest : public Test {
+public:
+    explicit VmoMapTest(uint32_t size) : size_(size) {}
+
+    ~VmoMapTest() override {
+        if (vmo_ > 0)
+            mx_handle_close(vmo_);
+    }
+
+    mx_status_t Init() override {
+        if ((vmo_ = mx_vmo_create(size_)) < 0)
+            return vmo_;
+        return mx_vmo_op_range(vmo_, MX_VMO_OP_COMMIT, 0, size_, nullptr, 0);
+    }
+
+    void Run(uint32_t count) override {
+        for (uint32_t i = 0; i < count; i++) {
+            uintptr_t addr;
+            __UNUSED mx_status_t status = mx_process_map_vm(
+                mx_process_self(), vmo_, 0, size_, &addr,
+                MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE);
+            assert(status == NO_ERROR);
+            status = mx_process_unmap_vm(mx_process_self(), addr, 0);
+            assert(status == NO_ERROR);
+        }
+    }
+
+private:
+    const uint32_t size_;
+    mx_handle_t vmo_ = MX_HANDLE_INVALID;
+};
+
+template <typename T>
+Test* create(uint32_t) {
+    return new T();
+}
+
+template <typename T>
+Test* create_arg(uint32_t arg) {
+    return new T(arg);
+}
+
+Test* create_msgpipe(uint32_t size) {
+    return new MsgpipeTest(size, 0u);
+}
+
+Test* create_msgpipe_handles(uint32_t num_handles) {
+    return new MsgpipeTest(8u, num_handles);
+}
+
+Test* create_msgpipe_thread(uint32_t size) {
+    return new MsgpipePingPongTest(size, false);
+}
+
+Test* create_msgpipe_process(uint32_t size) {
+    return new MsgpipePingPongTest(size, true);
+}
+
+}  // namespace
+
+#define ARGS(a) a, countof(a)
+
+const Benchmark kBenchmarks[] = {
+    {"syscall.null", nullptr, nullptr, 0, false, create<NullSyscallTest>},
+    {"handle.duplicate_close", nullptr, nullptr, 0, false, create<HandleDuplicateTest>},
+    {"msgpipe.write_read", "bytes", ARGS(kMessageSizes), true, create_msgpipe},
+    {"msgpipe.write_read_handles", "handles", ARGS(kHandleCounts), false,
+     create_msgpipe_handles},
+    {"msgpipe.pingpong_thread", "bytes", ARGS(kMessageSizes), true, create_msgpipe_thread},
+    {"msgpipe.pingpong_process", "bytes", ARGS(kMessageSizes), true, create_msgpipe_process},
+    {"event.pingpong", nullptr, nullptr, 0, false, create<EventPingPongTest>},
+    {"futex.pingpong", nullptr, nullptr, 0, false, create<FutexPingPongTest>},
+    {"port.queue_wait", nullptr, nullptr, 0, false, create<PortTest>},
+    {"handle.wait_many", "handles", ARGS(kWaitCounts), false, create_arg<WaitManyTest>},
+    {"socket.write_read", "bytes", ARGS(kStreamSizes), true, create_arg<SocketTest>},
+    {"datapipe.write_read", "bytes", ARGS(kStreamSizes), true, create_arg<DatapipeTest>},
+    {"vmo.write_read", "bytes", ARGS(kVmoSizes), true, create_arg<VmoReadWriteTest>},
+    {"vmo.map_unmap", "bytes", ARGS(kMapSizes), false, create_arg<VmoMapTest>},
+};
+
+const size_t kNumBenchmarks = countof(kBenchmarks);
+
+int echo_main(void) {
+    mx_handle_t pipe = mxio_get_startup_handle(MX_HND_INFO(MX_HND_TYPE_USER0, 0));
+    if (pipe < 0)
+        return -1;
+    echo_loop(pipe);
+    return 0;
+}
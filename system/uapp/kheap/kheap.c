@@ -0,0 +1,128 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <magenta/device/sysinfo.h>
+#include <magenta/syscalls.h>
+
+// Returns the root resource, which reading the heap sites requires, or a negative error.
+static mx_handle_t get_root_resource(void) {
+    int fd = open("/dev/misc/sysinfo", O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "kheap: could not open /dev/misc/sysinfo\n");
+        return ERR_NOT_FOUND;
+    }
+    mx_handle_t root_resource;
+    ssize_t n = ioctl_sysinfo_get_root_resource(fd, &root_resource);
+    close(fd);
+    if (n != sizeof(root_resource)) {
+        fprintf(stderr, "kheap: could not get the root resource: %zd\n", n);
+        return n < 0 ? (mx_status_t)n : ERR_BAD_STATE;
+    }
+    return root_resource;
+}
+
+// Returns a malloc'd snapshot of the kernel heap allocation sites, or NULL on failure.
+static mx_info_kernel_heap_sites_t* get_sites(mx_handle_t root_resource) {
+    uint32_t count = 256;
+    for (;;) {
+        size_t size = sizeof(mx_info_kernel_heap_sites_t) +
+                      count * sizeof(mx_record_kernel_heap_site_t);
+        mx_info_kernel_heap_sites_t* sites = malloc(size);
+        if (sites == NULL)
+            return NULL;
+        mx_ssize_t ret = mx_object_get_info(root_resource, MX_INFO_KERNEL_HEAP_SITES,
+                                            sizeof(mx_record_kernel_heap_site_t), sites, size);
+        if (ret < 0) {
+            if (ret == ERR_NOT_SUPPORTED) {
+                fprintf(stderr, "kheap: the kernel was not built with HEAP_PROFILE=1\n");
+            } else {
+                fprintf(stderr, "kheap: could not get heap sites: %zd\n", ret);
+            }
+            free(sites);
+            return NULL;
+        }
+        if (sites->hdr.count >= sites->hdr.avail_count)
+            return sites;
+        // new sites showed up since we sized the buffer; leave some slack and retry
+        count = sites->hdr.avail_count + 16;
+        free(sites);
+    }
+}
+
+static int cmp_count(const void* a, const void* b) {
+    const mx_record_kernel_heap_site_t* sa = a;
+    const mx_record_kernel_heap_site_t* sb = b;
+    if (sa->live_count != sb->live_count)
+        return sa->live_count < sb->live_count ? 1 : -1;
+    return sa->live_bytes < sb->live_bytes ? 1 : (sa->live_bytes > sb->live_bytes ? -1 : 0);
+}
+
+static void print_sites(const char* title, const mx_record_kernel_heap_site_t* rec, size_t n) {
+    printf("top %zu kernel heap sites by %s:\n", n, title);
+    printf("%18s %12s %10s %12s %10s %10s\n",
+           "CALLER", "LIVE BYTES", "LIVE", "TOTAL", "MIN SIZE", "MAX SIZE");
+    for (size_t i = 0; i < n; i++) {
+        printf("%#18" PRIx64 " %12" PRIu64 " %10" PRIu64 " %12" PRIu64 " %10" PRIu64
+               " %10" PRIu64 "\n",
+               rec[i].caller, rec[i].live_bytes, rec[i].live_count, rec[i].total_count,
+               rec[i].min_size, rec[i].max_size);
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: kheap [-n <count>]\n"
+                    "  -n  number of sites to show in each list (default 20)\n"
+                    "callers are kernel addresses, symbolize them against the kernel image\n");
+}
+
+int main(int argc, char** argv) {
+    int top = 20;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            top = atoi(argv[++i]);
+            if (top <= 0) {
+                usage();
+                return -1;
+            }
+        } else {
+            usage();
+            return -1;
+        }
+    }
+
+    mx_handle_t root_resource = get_root_resource();
+    if (root_resource < 0)
+        return -1;
+    mx_info_kernel_heap_sites_t* sites = get_sites(root_resource);
+    mx_handle_close(root_resource);
+    if (sites == NULL)
+        return -1;
+
+    uint64_t total_bytes = 0;
+    uint64_t total_count = 0;
+    for (uint32_t i = 0; i < sites->hdr.count; i++) {
+        total_bytes += sites->rec[i].live_bytes;
+        total_count += sites->rec[i].live_count;
+    }
+
+    // the kernel returns the sites sorted by live bytes
+    size_t n = sites->hdr.count < (uint32_t)top ? sites->hdr.count : (size_t)top;
+    print_sites("bytes", sites->rec, n);
+    printf("\n");
+    qsort(sites->rec, sites->hdr.count, sizeof(sites->rec[0]), cmp_count);
+    print_sites("count", sites->rec, n);
+
+    printf("%u sites, %" PRIu64 " bytes in %" PRIu64 " live allocations\n",
+           sites->hdr.count, total_bytes, total_count);
+    free(sites);
+    return 0;
+}
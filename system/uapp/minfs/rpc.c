@@ -16,6 +16,8 @@
 #include <magenta/syscalls.h>
 #include <magenta/types.h>
 
+#include <trace/trace.h>
+
 #include "vfs.h"
 
 struct vnode {
@@ -103,7 +105,7 @@ mx_handle_t vfs_rpc_server(vnode_t* vn, const char* where) {
     return NO_ERROR;
 }
 
-static mx_status_t vfs_handler(mxrio_msg_t* msg, mx_handle_t rh, void* cookie) {
+static mx_status_t vfs_dispatch(mxrio_msg_t* msg, mx_handle_t rh, void* cookie) {
     iostate_t* ios = cookie;
     vnode_t* vn = ios->vn;
     uint32_t len = msg->datalen;
@@ -285,3 +287,11 @@ static mx_status_t vfs_handler(mxrio_msg_t* msg, mx_handle_t rh, void* cookie) {
         return ERR_NOT_SUPPORTED;
     }
 }
+
+static mx_status_t vfs_handler(mxrio_msg_t* msg, mx_handle_t rh, void* cookie) {
+    uint32_t op = MXRIO_OP(msg->op);
+    TRACE_BEGIN("minfs.rpc", op);
+    mx_status_t r = vfs_dispatch(msg, rh, cookie);
+    TRACE_END("minfs.rpc", op);
+    return r;
+}
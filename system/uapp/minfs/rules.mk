@@ -27,4 +27,6 @@ MODULE_SRCS += \
 
 MODULE_LIBS := ulib/magenta ulib/mxio ulib/musl
 
+MODULE_STATIC_LIBS := ulib/trace
+
 include make/module.mk
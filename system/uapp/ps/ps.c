@@ -0,0 +1,175 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <magenta/device/sysinfo.h>
+#include <magenta/syscalls.h>
+
+typedef struct {
+    mx_koid_t koid;
+    char name[32];
+    mx_record_process_memory_t mem;
+} ps_entry_t;
+
+// Returns the root resource, which listing the processes requires, or a negative error.
+static mx_handle_t get_root_resource(void) {
+    int fd = open("/dev/misc/sysinfo", O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "ps: could not open /dev/misc/sysinfo\n");
+        return ERR_NOT_FOUND;
+    }
+    mx_handle_t root_resource;
+    ssize_t n = ioctl_sysinfo_get_root_resource(fd, &root_resource);
+    close(fd);
+    if (n != sizeof(root_resource)) {
+        fprintf(stderr, "ps: could not get the root resource: %zd\n", n);
+        return n < 0 ? (mx_status_t)n : ERR_BAD_STATE;
+    }
+    return root_resource;
+}
+
+// Returns a malloc'd snapshot of the process list, or NULL on failure.
+static mx_info_process_list_t* get_process_list(mx_handle_t root_resource) {
+    uint32_t count = 64;
+    for (;;) {
+        size_t size = sizeof(mx_info_process_list_t) + count * sizeof(mx_record_process_list_t);
+        mx_info_process_list_t* list = malloc(size);
+        if (list == NULL)
+            return NULL;
+        mx_ssize_t ret = mx_object_get_info(root_resource, MX_INFO_PROCESS_LIST,
+                                            sizeof(mx_record_process_list_t), list, size);
+        if (ret < 0) {
+            fprintf(stderr, "ps: could not get process list: %zd\n", ret);
+            free(list);
+            return NULL;
+        }
+        if (list->hdr.count >= list->hdr.avail_count)
+            return list;
+        // processes were created since we sized the buffer; leave some slack and retry
+        count = list->hdr.avail_count + 16;
+        free(list);
+    }
+}
+
+static size_t collect(mx_handle_t root_resource, ps_entry_t** entries_out) {
+    mx_info_process_list_t* list = get_process_list(root_resource);
+    if (list == NULL)
+        return 0;
+
+    ps_entry_t* entries = calloc(list->hdr.count, sizeof(ps_entry_t));
+    if (entries == NULL) {
+        free(list);
+        return 0;
+    }
+
+    size_t n = 0;
+    for (uint32_t i = 0; i < list->hdr.count; i++) {
+        mx_handle_t proc = mx_debug_task_get_child(MX_HANDLE_INVALID, list->rec[i].koid);
+        if (proc < 0) {
+            // the process may have exited since the list was taken
+            continue;
+        }
+        mx_info_process_memory_t info;
+        mx_ssize_t ret = mx_object_get_info(proc, MX_INFO_PROCESS_MEMORY,
+                                            sizeof(info.rec), &info, sizeof(info));
+        mx_handle_close(proc);
+        if (ret != sizeof(info))
+            continue;
+
+        entries[n].koid = list->rec[i].koid;
+        memcpy(entries[n].name, list->rec[i].name, sizeof(entries[n].name));
+        entries[n].name[sizeof(entries[n].name) - 1] = 0;
+        entries[n].mem = info.rec;
+        n++;
+    }
+
+    free(list);
+    *entries_out = entries;
+    return n;
+}
+
+static int cmp_resident(const void* a, const void* b) {
+    const ps_entry_t* ea = a;
+    const ps_entry_t* eb = b;
+    if (ea->mem.resident_bytes != eb->mem.resident_bytes)
+        return ea->mem.resident_bytes < eb->mem.resident_bytes ? 1 : -1;
+    return ea->koid < eb->koid ? -1 : (ea->koid > eb->koid);
+}
+
+static void print_entries(ps_entry_t* entries, size_t n) {
+    uint64_t total_resident = 0;
+    uint64_t total_committed = 0;
+
+    printf("%8s %10s %10s %10s %s\n", "KOID", "MAPPED(K)", "RES(K)", "COMMIT(K)", "NAME");
+    for (size_t i = 0; i < n; i++) {
+        printf("%8" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %s\n",
+               entries[i].koid,
+               entries[i].mem.mapped_bytes / 1024,
+               entries[i].mem.resident_bytes / 1024,
+               entries[i].mem.committed_bytes / 1024,
+               entries[i].name);
+        total_resident += entries[i].mem.resident_bytes;
+        total_committed += entries[i].mem.committed_bytes;
+    }
+    // committed memory may be shared between processes, so the total may overcount it
+    printf("%zu processes, %" PRIu64 "K resident, %" PRIu64 "K committed\n",
+           n, total_resident / 1024, total_committed / 1024);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: ps [-t <seconds>]\n"
+                    "  -t  redisplay every <seconds>, sorted by resident memory\n");
+}
+
+int main(int argc, char** argv) {
+    int period = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            period = atoi(argv[++i]);
+            if (period <= 0) {
+                usage();
+                return -1;
+            }
+        } else {
+            usage();
+            return -1;
+        }
+    }
+
+    mx_handle_t root_resource = get_root_resource();
+    if (root_resource < 0)
+        return -1;
+
+    for (;;) {
+        ps_entry_t* entries = NULL;
+        size_t n = collect(root_resource, &entries);
+        if (entries == NULL) {
+            mx_handle_close(root_resource);
+            return -1;
+        }
+
+        if (period > 0) {
+            qsort(entries, n, sizeof(ps_entry_t), cmp_resident);
+            // clear the screen, top style
+            printf("\033[2J\033[H");
+        }
+        print_entries(entries, n);
+        free(entries);
+
+        if (period == 0)
+            break;
+        mx_nanosleep(MX_SEC(period));
+    }
+
+    mx_handle_close(root_resource);
+    return 0;
+}
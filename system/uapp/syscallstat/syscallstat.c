@@ -0,0 +1,233 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <magenta/device/sysinfo.h>
+#include <magenta/syscalls.h>
+
+// Returns the root resource, which reading the syscall stats requires, or a negative error.
+static mx_handle_t get_root_resource(void) {
+    int fd = open("/dev/misc/sysinfo", O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "syscallstat: could not open /dev/misc/sysinfo\n");
+        return ERR_NOT_FOUND;
+    }
+    mx_handle_t root_resource;
+    ssize_t n = ioctl_sysinfo_get_root_resource(fd, &root_resource);
+    close(fd);
+    if (n != sizeof(root_resource)) {
+        fprintf(stderr, "syscallstat: could not get the root resource: %zd\n", n);
+        return n < 0 ? (mx_status_t)n : ERR_BAD_STATE;
+    }
+    return root_resource;
+}
+
+// Returns a malloc'd snapshot of the syscall statistics, or NULL on failure.
+static mx_info_syscall_stats_t* get_stats(mx_handle_t root_resource) {
+    uint32_t count = 256;
+    for (;;) {
+        size_t size = sizeof(mx_info_syscall_stats_t) + count * sizeof(mx_record_syscall_stat_t);
+        mx_info_syscall_stats_t* stats = malloc(size);
+        if (stats == NULL)
+            return NULL;
+        mx_ssize_t ret = mx_object_get_info(root_resource, MX_INFO_SYSCALL_STATS,
+                                            sizeof(mx_record_syscall_stat_t), stats, size);
+        if (ret < 0) {
+            fprintf(stderr, "syscallstat: could not get syscall stats: %zd\n", ret);
+            free(stats);
+            return NULL;
+        }
+        if (stats->hdr.count >= stats->hdr.avail_count)
+            return stats;
+        // more syscalls were made on more cpus since we sized the buffer; retry
+        count = stats->hdr.avail_count + 64;
+        free(stats);
+    }
+}
+
+static mx_record_syscall_stat_t* find(mx_record_syscall_stat_t* rec, uint32_t n,
+                                      uint32_t num, uint32_t cpu) {
+    for (uint32_t i = 0; i < n; i++) {
+        if (rec[i].num == num && rec[i].cpu == cpu)
+            return &rec[i];
+    }
+    return NULL;
+}
+
+// Folds the per-cpu records together, leaving one per syscall.  Returns the new count.
+static uint32_t merge_cpus(mx_record_syscall_stat_t* rec, uint32_t n) {
+    uint32_t out = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        rec[i].cpu = 0;
+        mx_record_syscall_stat_t* r = find(rec, out, rec[i].num, 0);
+        if (r == NULL) {
+            rec[out++] = rec[i];
+            continue;
+        }
+        r->calls += rec[i].calls;
+        r->timed_calls += rec[i].timed_calls;
+        r->errors += rec[i].errors;
+        r->cycles += rec[i].cycles;
+        if (rec[i].max_cycles > r->max_cycles)
+            r->max_cycles = rec[i].max_cycles;
+    }
+    return out;
+}
+
+// Subtracts |before| from |after|; max_cycles stays the maximum since boot.
+static void subtract(mx_record_syscall_stat_t* after, uint32_t n,
+                     mx_record_syscall_stat_t* before, uint32_t before_n) {
+    for (uint32_t i = 0; i < n; i++) {
+        mx_record_syscall_stat_t* b = find(before, before_n, after[i].num, after[i].cpu);
+        if (b == NULL)
+            continue;
+        after[i].calls -= b->calls;
+        after[i].timed_calls -= b->timed_calls;
+        after[i].errors -= b->errors;
+        after[i].cycles -= b->cycles;
+    }
+}
+
+static enum { BY_CYCLES, BY_CALLS, BY_ERRORS } sort_by = BY_CYCLES;
+
+static int cmp_stat(const void* a, const void* b) {
+    const mx_record_syscall_stat_t* sa = a;
+    const mx_record_syscall_stat_t* sb = b;
+    uint64_t va, vb;
+    switch (sort_by) {
+    case BY_CALLS:
+        va = sa->calls;
+        vb = sb->calls;
+        break;
+    case BY_ERRORS:
+        va = sa->errors;
+        vb = sb->errors;
+        break;
+    default:
+        va = sa->cycles;
+        vb = sb->cycles;
+        break;
+    }
+    if (va != vb)
+        return va < vb ? 1 : -1;
+    return (sa->cpu > sb->cpu) - (sa->cpu < sb->cpu);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: syscallstat [-c] [-s cycles|calls|errors] [-n <count>] [-d <seconds>]\n"
+                    "  -c  show each cpu separately\n"
+                    "  -s  what to sort by (default cycles)\n"
+                    "  -n  number of syscalls to show (default all)\n"
+                    "  -d  only count the calls made over the next <seconds>\n"
+                    "max cycles are since boot; cycles, and the average, only cover calls\n"
+                    "that finish on the cpu they started on\n");
+}
+
+int main(int argc, char** argv) {
+    bool per_cpu = false;
+    int top = 0;
+    int seconds = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-c")) {
+            per_cpu = true;
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            const char* key = argv[++i];
+            if (!strcmp(key, "cycles")) {
+                sort_by = BY_CYCLES;
+            } else if (!strcmp(key, "calls")) {
+                sort_by = BY_CALLS;
+            } else if (!strcmp(key, "errors")) {
+                sort_by = BY_ERRORS;
+            } else {
+                usage();
+                return -1;
+            }
+        } else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            top = atoi(argv[++i]);
+            if (top <= 0) {
+                usage();
+                return -1;
+            }
+        } else if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+            seconds = atoi(argv[++i]);
+            if (seconds <= 0) {
+                usage();
+                return -1;
+            }
+        } else {
+            usage();
+            return -1;
+        }
+    }
+
+    mx_handle_t root_resource = get_root_resource();
+    if (root_resource < 0)
+        return -1;
+
+    mx_info_syscall_stats_t* before = NULL;
+    if (seconds) {
+        before = get_stats(root_resource);
+        if (before == NULL) {
+            mx_handle_close(root_resource);
+            return -1;
+        }
+        mx_nanosleep(seconds * 1000000000ull);
+    }
+
+    mx_info_syscall_stats_t* stats = get_stats(root_resource);
+    mx_handle_close(root_resource);
+    if (stats == NULL) {
+        free(before);
+        return -1;
+    }
+    uint32_t n = stats->hdr.count;
+    if (before) {
+        subtract(stats->rec, n, before->rec, before->hdr.count);
+        free(before);
+    }
+    if (!per_cpu)
+        n = merge_cpus(stats->rec, n);
+    qsort(stats->rec, n, sizeof(stats->rec[0]), cmp_stat);
+
+    uint64_t total_calls = 0;
+    uint64_t total_errors = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        total_calls += stats->rec[i].calls;
+        total_errors += stats->rec[i].errors;
+    }
+
+    if (per_cpu)
+        printf("%-4s ", "CPU");
+    printf("%-24s %5s %12s %10s %14s %10s %12s\n",
+           "SYSCALL", "NUM", "CALLS", "ERRORS", "CYCLES", "AVG", "MAX");
+    size_t shown = (top && (uint32_t)top < n) ? (size_t)top : n;
+    for (size_t i = 0; i < shown; i++) {
+        const mx_record_syscall_stat_t* r = &stats->rec[i];
+        if (r->calls == 0)
+            continue;
+        if (per_cpu)
+            printf("%-4u ", r->cpu);
+        if (r->num == UINT32_MAX) {
+            printf("%-24s %5s", r->name, "-");
+        } else {
+            printf("%-24s %5u", r->name, r->num);
+        }
+        printf(" %12" PRIu64 " %10" PRIu64 " %14" PRIu64 " %10" PRIu64 " %12" PRIu64 "\n",
+               r->calls, r->errors, r->cycles,
+               r->timed_calls ? r->cycles / r->timed_calls : 0, r->max_cycles);
+    }
+
+    printf("%" PRIu64 " calls, %" PRIu64 " errors%s\n", total_calls, total_errors,
+           seconds ? "" : " since boot");
+    free(stats);
+    return 0;
+}
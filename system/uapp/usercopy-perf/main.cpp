@@ -0,0 +1,181 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures the cost of copying data between user and kernel memory, by timing
+// syscalls whose work is dominated by their user copies.
+
+#include <assert.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <magenta/compiler.h>
+#include <magenta/syscalls.h>
+#include <mxtl/unique_ptr.h>
+
+namespace {
+
+constexpr uint32_t kSizes[] = {
+    8, 32, 64, 128, 256, 512, 1024, 4096, 16384, 65536, 262144, 1048576,
+};
+
+// Message pipes refuse messages larger than this.
+constexpr uint32_t kMaxMessageSize = 65536;
+
+void argument_error(const char* argv0, const char* message) {
+    fprintf(stderr, "%s: error: %s\nRun with -h for help.\n", argv0, message);
+    exit(EXIT_FAILURE);
+}
+
+void print_result(const char* name, uint32_t size, uint64_t iterations, uint64_t elapsed_ns) {
+    double ns_per_it = static_cast<double>(elapsed_ns) / static_cast<double>(iterations);
+    // Each iteration copies |size| bytes in and |size| bytes back out.
+    double mb_per_sec = (2.0 * size * static_cast<double>(iterations)) /
+                        (static_cast<double>(elapsed_ns) / 1000000000.0) / (1024.0 * 1024.0);
+    printf("%-8s %8" PRIu32 " bytes: %10.0f ns/iteration %10.1f MB/s\n",
+           name, size, ns_per_it, mb_per_sec);
+}
+
+// Writes |size| bytes into a committed vmo and reads them back out.
+void vmo_test(uint32_t duration, uint32_t size, uint8_t* buf) {
+    __UNUSED mx_status_t status;
+
+    mx_handle_t vmo = mx_vmo_create(size);
+    assert(vmo > 0);
+    // Commit up front so we don't time the page allocations.
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_COMMIT, 0, size, nullptr, 0);
+    assert(status == NO_ERROR);
+
+    uint64_t duration_ns = duration * 1000000000ull;
+    static constexpr uint32_t big_it_size = 100;
+    uint64_t its = 0;
+    uint64_t start_ns = mx_current_time();
+    uint64_t end_ns;
+    for (;;) {
+        for (uint32_t i = 0; i < big_it_size; i++) {
+            __UNUSED mx_ssize_t ret = mx_vmo_write(vmo, buf, 0, size);
+            assert(ret == static_cast<mx_ssize_t>(size));
+            ret = mx_vmo_read(vmo, buf, 0, size);
+            assert(ret == static_cast<mx_ssize_t>(size));
+        }
+        its += big_it_size;
+
+        end_ns = mx_current_time();
+        if ((end_ns - start_ns) >= duration_ns)
+            break;
+    }
+
+    status = mx_handle_close(vmo);
+    assert(status == NO_ERROR);
+
+    print_result("vmo", size, its, end_ns - start_ns);
+}
+
+// Writes a |size| byte message into a pipe and reads it back out.
+void msgpipe_test(uint32_t duration, uint32_t size, uint8_t* buf) {
+    __UNUSED mx_status_t status;
+
+    mx_handle_t mp[2] = {MX_HANDLE_INVALID, MX_HANDLE_INVALID};
+    status = mx_msgpipe_create(mp, 0u);
+    assert(status == NO_ERROR);
+
+    uint64_t duration_ns = duration * 1000000000ull;
+    static constexpr uint32_t big_it_size = 100;
+    uint64_t its = 0;
+    uint64_t start_ns = mx_current_time();
+    uint64_t end_ns;
+    for (;;) {
+        for (uint32_t i = 0; i < big_it_size; i++) {
+            status = mx_msgpipe_write(mp[0], buf, size, nullptr, 0u, 0u);
+            assert(status == NO_ERROR);
+            uint32_t r_size = size;
+            status = mx_msgpipe_read(mp[1], buf, &r_size, nullptr, nullptr, 0u);
+            assert(status == NO_ERROR);
+            assert(r_size == size);
+        }
+        its += big_it_size;
+
+        end_ns = mx_current_time();
+        if ((end_ns - start_ns) >= duration_ns)
+            break;
+    }
+
+    status = mx_handle_close(mp[0]);
+    assert(status == NO_ERROR);
+    status = mx_handle_close(mp[1]);
+    assert(status == NO_ERROR);
+
+    print_result("msgpipe", size, its, end_ns - start_ns);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    static constexpr char help[] =
+        "Usage: %s [options ...]\n"
+        "\n"
+        "Options:\n"
+        "  -h    show help (this)\n"
+        "  -d N  set the duration of each test to N seconds (default: 1)\n"
+        "  -S N  only test copies of N bytes (default: a range of sizes)\n";
+
+    uint32_t duration = 1;  // -d
+    uint32_t size = 0;      // -S
+
+    int opt;
+    while ((opt = getopt(argc, argv, "+hd:S:")) != -1) {
+        uint32_t value = 0;
+        if (optarg) {
+            errno = 0;
+            char* endptr = nullptr;
+            unsigned long long v = strtoull(optarg, &endptr, 10);
+            if (errno != 0 || *endptr != '\0' || v > UINT32_MAX)
+                argument_error(argv[0], "invalid numeric optional value");
+            value = static_cast<uint32_t>(v);
+        }
+
+        switch (opt) {
+            case 'h':
+                printf(help, argv[0]);
+                return EXIT_SUCCESS;
+            case 'd':
+                duration = value;
+                break;
+            case 'S':
+                if (value == 0)
+                    argument_error(argv[0], "size must be positive");
+                size = value;
+                break;
+            default:  // '?'
+                argument_error(argv[0], "invalid option");
+                break;
+        }
+    }
+    if (optind < argc)
+        argument_error(argv[0], "unexpected positional argument");
+
+    uint32_t max_size = size ? size : kSizes[countof(kSizes) - 1];
+    mxtl::unique_ptr<uint8_t[]> buf(new uint8_t[max_size]);
+    memset(buf.get(), 0x5a, max_size);
+
+    const uint32_t* sizes = kSizes;
+    size_t num_sizes = countof(kSizes);
+    if (size) {
+        sizes = &size;
+        num_sizes = 1;
+    }
+
+    for (size_t i = 0; i < num_sizes; i++)
+        vmo_test(duration, sizes[i], buf.get());
+    for (size_t i = 0; i < num_sizes; i++) {
+        if (sizes[i] <= kMaxMessageSize)
+            msgpipe_test(duration, sizes[i], buf.get());
+    }
+
+    return EXIT_SUCCESS;
+}
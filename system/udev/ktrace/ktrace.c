@@ -5,6 +5,7 @@
 #include <ddk/device.h>
 #include <ddk/driver.h>
 
+#include <magenta/device/ktrace.h>
 #include <magenta/syscalls.h>
 #include <magenta/types.h>
 
@@ -21,9 +22,29 @@ static mx_off_t ktrace_get_size(mx_device_t* dev) {
     return mx_ktrace_read(get_root_resource(), NULL, 0, 0);
 }
 
+static ssize_t ktrace_ioctl(mx_device_t* dev, uint32_t op,
+                            const void* cmd, size_t cmdlen, void* reply, size_t max) {
+    switch (op) {
+    case IOCTL_KTRACE_GET_VMO: {
+        if (max < sizeof(mx_handle_t)) {
+            return ERR_BUFFER_TOO_SMALL;
+        }
+        mx_handle_t vmo = mx_ktrace_get_vmo(get_root_resource());
+        if (vmo < 0) {
+            return vmo;
+        }
+        *((mx_handle_t*)reply) = vmo;
+        return sizeof(mx_handle_t);
+    }
+    default:
+        return ERR_INVALID_ARGS;
+    }
+}
+
 static mx_protocol_device_t ktrace_device_proto = {
     .read = ktrace_read,
     .get_size = ktrace_get_size,
+    .ioctl = ktrace_ioctl,
 };
 
 mx_status_t ktrace_init(mx_driver_t* driver) {
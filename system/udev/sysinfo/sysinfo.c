@@ -0,0 +1,54 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <ddk/device.h>
+#include <ddk/driver.h>
+
+#include <magenta/device/sysinfo.h>
+#include <magenta/syscalls.h>
+#include <magenta/types.h>
+
+#include <stdlib.h>
+
+static ssize_t sysinfo_ioctl(mx_device_t* dev, uint32_t op,
+                             const void* cmd, size_t cmdlen, void* reply, size_t max) {
+    switch (op) {
+    case IOCTL_SYSINFO_GET_ROOT_RESOURCE: {
+        if (max < sizeof(mx_handle_t)) {
+            return ERR_BUFFER_TOO_SMALL;
+        }
+        mx_handle_t h = mx_handle_duplicate(get_root_resource(), MX_RIGHT_SAME_RIGHTS);
+        if (h < 0) {
+            return h;
+        }
+        *((mx_handle_t*)reply) = h;
+        return sizeof(mx_handle_t);
+    }
+    default:
+        return ERR_INVALID_ARGS;
+    }
+}
+
+static mx_protocol_device_t sysinfo_device_proto = {
+    .ioctl = sysinfo_ioctl,
+};
+
+mx_status_t sysinfo_init(mx_driver_t* driver) {
+    mx_device_t* dev;
+    if (device_create(&dev, driver, "sysinfo", &sysinfo_device_proto) == NO_ERROR) {
+        mx_status_t status;
+        if ((status = device_add(dev, driver_get_misc_device())) < 0) {
+            free(dev);
+            return status;
+        }
+    }
+    return NO_ERROR;
+}
+
+mx_driver_t _driver_sysinfo BUILTIN_DRIVER = {
+    .name = "sysinfo",
+    .ops = {
+        .init = sysinfo_init,
+    },
+};
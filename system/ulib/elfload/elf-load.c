@@ -138,31 +138,16 @@ static mx_status_t choose_load_bias(mx_handle_t proc,
     return NO_ERROR;
 }
 
-// TODO(mcgrathr): Temporary hack to avoid modifying the file VMO.
-// This will go away when we have copy-on-write.
-static mx_handle_t get_writable_vmo(mx_handle_t proc_self,
-                                    mx_handle_t vmo, size_t data_size,
+// Make a copy-on-write clone of the file's data pages so that the
+// segment's writes (including zeroing the partial page) don't touch
+// the file VMO itself.
+static mx_handle_t get_writable_vmo(mx_handle_t vmo, size_t data_size,
                                     uintptr_t* file_start,
                                     uintptr_t* file_end) {
-    mx_handle_t copy_vmo = mx_vmo_create(data_size);
+    mx_handle_t copy_vmo = mx_vmo_clone(vmo, MX_VMO_CLONE_COPY_ON_WRITE,
+                                        *file_start, data_size);
     if (copy_vmo < 0)
         return copy_vmo;
-    uintptr_t window = 0;
-    mx_status_t status = mx_process_map_vm(proc_self, vmo,
-                                           *file_start, data_size, &window,
-                                           MX_VM_FLAG_PERM_READ);
-    if (status < 0) {
-        mx_handle_close(copy_vmo);
-        return status;
-    }
-    mx_ssize_t n = mx_vmo_write(copy_vmo, (void*)window, 0, data_size);
-    mx_process_unmap_vm(proc_self, window, 0);
-    if (n >= 0 && n != (mx_ssize_t)data_size)
-        n = ERR_IO;
-    if (n < 0) {
-        mx_handle_close(copy_vmo);
-        return n;
-    }
     *file_end -= *file_start;
     *file_start = 0;
     return copy_vmo;
@@ -263,7 +248,7 @@ static mx_status_t load_segment(mx_handle_t proc_self,
                                    file_start, file_end, partial_page);
 
     // For a writable segment, we need a writable VMO.
-    mx_handle_t writable_vmo = get_writable_vmo(proc_self, vmo, data_size,
+    mx_handle_t writable_vmo = get_writable_vmo(vmo, data_size,
                                                 &file_start, &file_end);
     if (writable_vmo < 0)
         return writable_vmo;
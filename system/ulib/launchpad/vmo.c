@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <magenta/device/device.h>
 #include <magenta/syscalls.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -37,6 +38,12 @@ static ssize_t my_pread (int fd, void* buf, size_t nbytes, off_t offset) {
 #define MAX_WINDOW ((size_t)64 << 20)
 
 mx_handle_t launchpad_vmo_from_fd(int fd) {
+    // Filesystems that can hand out the file's pages directly, like bootfs,
+    // give us a copy-on-write clone, so nothing is read until it is touched.
+    mx_handle_t file_vmo;
+    if (ioctl_device_get_file_vmo(fd, &file_vmo) == sizeof(file_vmo))
+        return file_vmo;
+
     mx_handle_t current_proc_handle = mx_process_self();
 
     struct stat st;
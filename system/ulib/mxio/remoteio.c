@@ -174,14 +174,16 @@ mx_status_t mxrio_txn_handoff(mx_handle_t srv, mx_handle_t rh, mxrio_msg_t* msg)
 
 // on success, msg->hcount indicates number of valid handles in msg->handle
 // on error there are never any handles
-static mx_status_t mxrio_txn(mxrio_t* rio, mxrio_msg_t* msg) {
+// if data is not NULL, the request payload is taken from there rather
+// than from msg->data, saving a copy into msg
+static mx_status_t mxrio_txn_data(mxrio_t* rio, mxrio_msg_t* msg, const void* data) {
     msg->magic = MXRIO_MAGIC;
     if (!is_message_valid(msg)) {
         return ERR_INVALID_ARGS;
     }
 
     xprintf("txn h=%x op=%d len=%u\n", rio->h, msg->op, msg->datalen);
-    uint32_t dsize = MXRIO_HDR_SZ + msg->datalen;
+    uint32_t dsize;
 
     mx_status_t r;
 
@@ -199,7 +201,11 @@ static mx_status_t mxrio_txn(mxrio_t* rio, mxrio_msg_t* msg) {
     msg->op |= MXRIO_REPLY_PIPE;
     msg->handle[msg->hcount++] = rpipe[1];
 
-    if ((r = mx_msgpipe_write(rio->h, msg, dsize, msg->handle, msg->hcount, 0)) < 0) {
+    mx_iovec_t iov[2] = {
+        { msg, MXRIO_HDR_SZ },
+        { data ? (void*)data : msg->data, msg->datalen },
+    };
+    if ((r = mx_msgpipe_writev(rio->h, iov, 2, msg->handle, msg->hcount, 0)) < 0) {
         msg->hcount--;
         goto fail_discard_handles;
     }
@@ -258,6 +264,10 @@ fail_close_reply_pipe:
     return r;
 }
 
+static mx_status_t mxrio_txn(mxrio_t* rio, mxrio_msg_t* msg) {
+    return mxrio_txn_data(rio, msg, NULL);
+}
+
 static ssize_t mxrio_ioctl(mxio_t* io, uint32_t op, const void* in_buf,
                            size_t in_len, void* out_buf, size_t out_len) {
     mxrio_t* rio = (mxrio_t*)io;
@@ -320,9 +330,9 @@ static ssize_t write_common(uint32_t op, mxio_t* io, const void* _data, size_t l
         msg.datalen = xfer;
         if (op == MXRIO_WRITE_AT)
             msg.arg2.off = offset;
-        memcpy(msg.data, data, xfer);
 
-        if ((r = mxrio_txn(rio, &msg)) < 0) {
+        // the payload goes straight from the caller's buffer
+        if ((r = mxrio_txn_data(rio, &msg, data)) < 0) {
             break;
         }
         discard_handles(msg.handle, msg.hcount);
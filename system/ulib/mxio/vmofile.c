@@ -7,6 +7,7 @@
 #include <string.h>
 #include <threads.h>
 
+#include <magenta/device/device.h>
 #include <magenta/processargs.h>
 #include <magenta/syscalls.h>
 #include <mxio/io.h>
@@ -101,6 +102,28 @@ static mx_status_t vmofile_misc(mxio_t* io, uint32_t op, uint32_t maxreply, void
     }
 }
 
+static ssize_t vmofile_ioctl(mxio_t* io, uint32_t op, const void* in_buf, size_t in_len,
+                             void* out_buf, size_t out_len) {
+    vmofile_t* vf = (vmofile_t*)io;
+    switch (op) {
+    case IOCTL_DEVICE_GET_FILE_VMO: {
+        if ((in_len != 0) || (out_len < sizeof(mx_handle_t))) {
+            return ERR_INVALID_ARGS;
+        }
+        // the file is a range of a larger vmo; clone just that range
+        mx_handle_t vmo = mx_vmo_clone(vf->vmo, MX_VMO_CLONE_COPY_ON_WRITE,
+                                       vf->off, vf->end - vf->off);
+        if (vmo < 0) {
+            return vmo;
+        }
+        memcpy(out_buf, &vmo, sizeof(vmo));
+        return sizeof(vmo);
+    }
+    default:
+        return ERR_NOT_SUPPORTED;
+    }
+}
+
 static mxio_ops_t vmofile_ops = {
     .read = vmofile_read,
     .write = mxio_default_write,
@@ -110,7 +133,7 @@ static mxio_ops_t vmofile_ops = {
     .open = mxio_default_open,
     .clone = mxio_default_clone,
     .wait = mxio_default_wait,
-    .ioctl = mxio_default_ioctl,
+    .ioctl = vmofile_ioctl,
 };
 
 mxio_t* mxio_vmofile_create(mx_handle_t h, mx_off_t off, mx_off_t len) {
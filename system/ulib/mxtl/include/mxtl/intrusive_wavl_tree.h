@@ -98,13 +98,29 @@ private:
     WAVLTreeNodeState<PtrType, bool> wavl_node_state_;
 };
 
+// Augment traits let users keep a summary of each node's subtree in the node
+// (for example, the subtree's maximum key or element count) that the tree keeps
+// up to date through inserts, erases and rebalancing.  If IsAugmented is true,
+// the tree calls UpdateAugmentedState for every node whose subtree has changed,
+// always visiting children before their parents.  It is handed the node along
+// with its left and right children (nullptr if absent) and should recompute the
+// node's summary from the node and its children.  The default traits keep no
+// summary and fall out of the code during template expansion.
+struct DefaultWAVLTreeAugmentTraits {
+    static constexpr bool IsAugmented = false;
+
+    template <typename RawPtrType>
+    static void UpdateAugmentedState(RawPtrType node, RawPtrType left, RawPtrType right) { }
+};
+
 template <typename _KeyType,
           typename _PtrType,
-          typename _KeyTraits  = DefaultKeyedObjectTraits<
-                                    _KeyType,
-                                    typename internal::ContainerPtrTraits<_PtrType>::ValueType>,
-          typename _NodeTraits = DefaultWAVLTreeTraits<_PtrType>,
-          typename _Observer   = tests::intrusive_containers::DefaultWAVLTreeObserver>
+          typename _KeyTraits     = DefaultKeyedObjectTraits<
+                                        _KeyType,
+                                        typename internal::ContainerPtrTraits<_PtrType>::ValueType>,
+          typename _NodeTraits    = DefaultWAVLTreeTraits<_PtrType>,
+          typename _AugmentTraits = DefaultWAVLTreeAugmentTraits,
+          typename _Observer      = tests::intrusive_containers::DefaultWAVLTreeObserver>
 class WAVLTree {
 private:
     // Private fwd decls of the iterator implementation.
@@ -118,11 +134,13 @@ public:
     using PtrType       = _PtrType;
     using KeyTraits     = _KeyTraits;
     using NodeTraits    = _NodeTraits;
+    using AugmentTraits = _AugmentTraits;
     using Observer      = _Observer;
     using PtrTraits     = internal::ContainerPtrTraits<PtrType>;
     using RawPtrType    = typename PtrTraits::RawPtrType;
     using ValueType     = typename PtrTraits::ValueType;
-    using ContainerType = WAVLTree<KeyType, PtrType, KeyTraits, NodeTraits, Observer>;
+    using ContainerType = WAVLTree<KeyType, PtrType, KeyTraits, NodeTraits, AugmentTraits,
+                                   Observer>;
     using CheckerType   = ::mxtl::tests::intrusive_containers::WAVLTreeChecker;
 
     // Declarations of the standard iterator types.
@@ -182,6 +200,12 @@ public:
     // make_iterator : construct an iterator out of a pointer to an object
     iterator make_iterator(ValueType& obj) { return iterator(&obj); }
 
+    // root : return an iterator to the root node of the tree, or end() if the
+    // tree is empty.  Together with the iterator's left() and right() methods,
+    // this allows users of augmented trees to walk the tree structure directly.
+    iterator       root()       { return iterator(root_ != nullptr ? PtrTraits::GetRaw(root_) : sentinel()); }
+    const_iterator root() const { return const_iterator(root_ != nullptr ? PtrTraits::GetRaw(root_) : sentinel()); }
+
     // is_empty : True if the tree has at least one element in it, false otherwise.
     bool is_empty() const { return root_ == nullptr; }
 
@@ -558,6 +582,20 @@ private:
         typename IterTraits::RefType operator*()     const { DEBUG_ASSERT(node_); return *node_; }
         typename IterTraits::RawPtrType operator->() const { DEBUG_ASSERT(node_); return node_; }
 
+        // Move to the left or right child of the current node in the tree
+        // structure (not the in-order sequence).  The result is invalid if
+        // there is no such child.  It is an error to call these on an invalid
+        // iterator.
+        iterator_impl left() const {
+            DEBUG_ASSERT(IsValid());
+            return iterator_impl(PtrTraits::GetRaw(NodeTraits::node_state(*node_).left_));
+        }
+
+        iterator_impl right() const {
+            DEBUG_ASSERT(IsValid());
+            return iterator_impl(PtrTraits::GetRaw(NodeTraits::node_state(*node_).right_));
+        }
+
     private:
         friend ContainerType;
 
@@ -647,6 +685,7 @@ private:
 
             ++count_;
             Observer::RecordInsert();
+            UpdateAugmentedStateToRoot(PtrTraits::GetRaw(root_));
             return;
         }
 
@@ -723,6 +762,10 @@ private:
         ++count_;
         Observer::RecordInsert();
 
+        // Bring any augmented state up to date along the path to the new node
+        // before rebalancing; rotations will then maintain it locally.
+        UpdateAugmentedStateToRoot(PtrTraits::GetRaw(*owner));
+
         // Finally, perform post-insert balance operations.
         BalancePostInsert(PtrTraits::GetRaw(*owner));
     }
@@ -866,6 +909,11 @@ private:
         // Time to rebalance.  We know that we don't need to rebalance if we
         // just removed the root (IOW - its parent was the sentinel value).
         if (!PtrTraits::IsSentinel(parent)) {
+            // Every node whose subtree lost the target lies on the path from
+            // the target's old parent to the root (this includes the node which
+            // was swapped into the target's position, if any).
+            UpdateAugmentedStateToRoot(parent);
+
             if (was_one_child) {
                 // If the node we removed was a 1-child, then we may have just
                 // turned its parent into a 2,2 leaf node.  If so, we have a
@@ -1241,6 +1289,38 @@ private:
         Z_ns.parent_ = X;
         if (Y)
             NodeTraits::node_state(*Y).parent_ = Z;
+
+        // Z is now X's child, so fix its augmented state first.  The set of
+        // nodes below X is the set which used to be below Z, so nothing above
+        // X needs to change.
+        if (AugmentTraits::IsAugmented) {
+            UpdateAugmentedState(Z);
+            UpdateAugmentedState(X);
+        }
+    }
+
+    // UpdateAugmentedState
+    //
+    // Recompute the augmented state for a single node from the
+    // node and its children.  Sentinel children are reported as nullptr.
+    void UpdateAugmentedState(RawPtrType node) {
+        auto& ns = NodeTraits::node_state(*node);
+        RawPtrType left  = PtrTraits::IsValid(ns.left_)  ? PtrTraits::GetRaw(ns.left_)  : nullptr;
+        RawPtrType right = PtrTraits::IsValid(ns.right_) ? PtrTraits::GetRaw(ns.right_) : nullptr;
+        AugmentTraits::UpdateAugmentedState(node, left, right);
+    }
+
+    // UpdateAugmentedStateToRoot
+    //
+    // Recompute the augmented state of node and each of its ancestors.
+    void UpdateAugmentedStateToRoot(RawPtrType node) {
+        if (!AugmentTraits::IsAugmented)
+            return;
+
+        while (PtrTraits::IsValid(node)) {
+            UpdateAugmentedState(node);
+            node = NodeTraits::node_state(*node).parent_;
+        }
     }
 
     // PostInsertFixupLR<LRTraits>
@@ -1668,13 +1748,17 @@ private:
     size_t     count_      = 0;
 };
 
-template <typename KeyType, typename PtrType, typename KeyTraits, typename NodeTraits, typename Obs>
-constexpr bool WAVLTree<KeyType, PtrType, KeyTraits, NodeTraits, Obs>::SupportsConstantOrderErase;
-template <typename KeyType, typename PtrType, typename KeyTraits, typename NodeTraits, typename Obs>
-constexpr bool WAVLTree<KeyType, PtrType, KeyTraits, NodeTraits, Obs>::SupportsConstantOrderSize;
-template <typename KeyType, typename PtrType, typename KeyTraits, typename NodeTraits, typename Obs>
-constexpr bool WAVLTree<KeyType, PtrType, KeyTraits, NodeTraits, Obs>::IsAssociative;
-template <typename KeyType, typename PtrType, typename KeyTraits, typename NodeTraits, typename Obs>
-constexpr bool WAVLTree<KeyType, PtrType, KeyTraits, NodeTraits, Obs>::IsSequenced;
+template <typename KeyType, typename PtrType, typename KeyTraits, typename NodeTraits,
+          typename AugTraits, typename Obs>
+constexpr bool WAVLTree<KeyType, PtrType, KeyTraits, NodeTraits, AugTraits, Obs>::SupportsConstantOrderErase;
+template <typename KeyType, typename PtrType, typename KeyTraits, typename NodeTraits,
+          typename AugTraits, typename Obs>
+constexpr bool WAVLTree<KeyType, PtrType, KeyTraits, NodeTraits, AugTraits, Obs>::SupportsConstantOrderSize;
+template <typename KeyType, typename PtrType, typename KeyTraits, typename NodeTraits,
+          typename AugTraits, typename Obs>
+constexpr bool WAVLTree<KeyType, PtrType, KeyTraits, NodeTraits, AugTraits, Obs>::IsAssociative;
+template <typename KeyType, typename PtrType, typename KeyTraits, typename NodeTraits,
+          typename AugTraits, typename Obs>
+constexpr bool WAVLTree<KeyType, PtrType, KeyTraits, NodeTraits, AugTraits, Obs>::IsSequenced;
 
 }  // namespace mxtl
@@ -26,6 +26,7 @@ public:
     ~RefCounted() {}
 
     using internal::RefCountedBase::AddRef;
+    using internal::RefCountedBase::AddRefMaybeInDestructor;
     using internal::RefCountedBase::Release;
 
 #if (LK_DEBUGLEVEL > 1)
@@ -19,6 +19,20 @@ protected:
         // TODO(jamesr): Replace uses of GCC builtins with something safer.
         __atomic_fetch_add(&ref_count_, 1, __ATOMIC_RELAXED);
     }
+    // Like AddRef, but for objects that may be concurrently on their way to
+    // being destroyed (found through a raw pointer in a list that the
+    // destructor unlinks from under a lock). Returns false, without taking a
+    // reference, if the count has already dropped to zero.
+    bool AddRefMaybeInDestructor() __WARN_UNUSED_RESULT {
+        DEBUG_ASSERT(adopted_);
+        int old = __atomic_load_n(&ref_count_, __ATOMIC_RELAXED);
+        do {
+            if (old == 0)
+                return false;
+        } while (!__atomic_compare_exchange_n(&ref_count_, &old, old + 1, true,
+                                              __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+        return true;
+    }
     // Returns true if the object should self-delete.
     bool Release() __WARN_UNUSED_RESULT {
         DEBUG_ASSERT(adopted_);
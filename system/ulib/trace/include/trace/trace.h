@@ -0,0 +1,109 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+#include <magenta/compiler.h>
+#include <magenta/ktrace.h>
+#include <magenta/syscalls.h>
+
+__BEGIN_CDECLS
+
+// User trace events
+//
+// These go into the kernel trace alongside the kernel's own events, stamped
+// with the calling thread and process, so a server's requests line up with
+// the context switches and syscalls they caused.  Each event is one syscall,
+// which returns straight away when the user group (KTRACE_GRP_USER) isn't
+// being traced.
+//
+// Events are named.  trace_register() turns a name into the id the events
+// carry and records the name in the trace.  Ids are a hash of the name, so
+// the same name gets the same id in every process.  Names only last until
+// the trace is next started or rewound, so the TRACE_* macros keep a
+// trace_site_t per call site that notices when that has happened and
+// records the name again.
+
+// Returns the id for |name|, recording the name in the trace.
+uint32_t trace_register(const char* name);
+
+// Returns the id for |name| without recording it.
+uint32_t trace_id(const char* name);
+
+typedef struct trace_site {
+    const char* name;
+    uint32_t id;
+    // the trace generation the name was last recorded in, zero for never
+    uint32_t generation;
+} trace_site_t;
+
+// Records |site|'s name for trace |generation|, as returned by
+// mx_ktrace_write().
+void trace_site_register(trace_site_t* site, uint32_t generation);
+
+static inline void trace_site_write(trace_site_t* site, uint32_t tag,
+                                    uint32_t arg0, uint32_t arg1) {
+    if (site->id == 0) {
+        site->id = trace_id(site->name);
+    }
+    mx_status_t generation = mx_ktrace_write(tag, site->id, arg0, arg1);
+    if ((generation > 0) && ((uint32_t)generation != site->generation)) {
+        trace_site_register(site, (uint32_t)generation);
+    }
+}
+
+// Durations: a begin and the matching end on the same thread.
+static inline void trace_begin(uint32_t id, uint32_t arg) {
+    mx_ktrace_write(TAG_USER_BEGIN, id, arg, 0);
+}
+
+static inline void trace_end(uint32_t id, uint32_t arg) {
+    mx_ktrace_write(TAG_USER_END, id, arg, 0);
+}
+
+// Counters: the value of |id| from now on.
+static inline void trace_counter(uint32_t id, uint64_t value) {
+    mx_ktrace_write(TAG_USER_COUNTER, id, (uint32_t)value, (uint32_t)(value >> 32));
+}
+
+// Flows: connect work done on behalf of one request, |flow|, across
+// threads and processes.  The caller picks |flow|, for example a
+// transaction id that both ends of a message pipe know.
+static inline void trace_flow_begin(uint32_t id, uint64_t flow) {
+    mx_ktrace_write(TAG_USER_FLOW_BEGIN, id, (uint32_t)flow, (uint32_t)(flow >> 32));
+}
+
+static inline void trace_flow_step(uint32_t id, uint64_t flow) {
+    mx_ktrace_write(TAG_USER_FLOW_STEP, id, (uint32_t)flow, (uint32_t)(flow >> 32));
+}
+
+static inline void trace_flow_end(uint32_t id, uint64_t flow) {
+    mx_ktrace_write(TAG_USER_FLOW_END, id, (uint32_t)flow, (uint32_t)(flow >> 32));
+}
+
+#define TRACE_SITE_(name) ({ \
+    static trace_site_t trace_site_ = { name, 0, 0 }; \
+    &trace_site_; \
+})
+
+#define TRACE_BEGIN(name, arg) \
+    trace_site_write(TRACE_SITE_(name), TAG_USER_BEGIN, (arg), 0)
+#define TRACE_END(name, arg) \
+    trace_site_write(TRACE_SITE_(name), TAG_USER_END, (arg), 0)
+#define TRACE_COUNTER(name, value) ({ \
+    uint64_t trace_value_ = (value); \
+    trace_site_write(TRACE_SITE_(name), TAG_USER_COUNTER, \
+                     (uint32_t)trace_value_, (uint32_t)(trace_value_ >> 32)); \
+})
+#define TRACE_FLOW_(tag, name, flow) ({ \
+    uint64_t trace_flow_ = (flow); \
+    trace_site_write(TRACE_SITE_(name), (tag), \
+                     (uint32_t)trace_flow_, (uint32_t)(trace_flow_ >> 32)); \
+})
+#define TRACE_FLOW_BEGIN(name, flow) TRACE_FLOW_(TAG_USER_FLOW_BEGIN, name, flow)
+#define TRACE_FLOW_STEP(name, flow) TRACE_FLOW_(TAG_USER_FLOW_STEP, name, flow)
+#define TRACE_FLOW_END(name, flow) TRACE_FLOW_(TAG_USER_FLOW_END, name, flow)
+
+__END_CDECLS
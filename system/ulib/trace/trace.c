@@ -0,0 +1,34 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <magenta/syscalls.h>
+#include <trace/trace.h>
+
+uint32_t trace_id(const char* name) {
+    // 32-bit FNV-1a, never zero so zero can mean unregistered
+    uint32_t id = 2166136261u;
+    for (const char* p = name; *p; p++) {
+        id = (id ^ (uint8_t)*p) * 16777619u;
+    }
+    if (id == 0) {
+        id = 1;
+    }
+    return id;
+}
+
+uint32_t trace_register(const char* name) {
+    uint32_t id = trace_id(name);
+    mx_ktrace_name(id, name, strlen(name));
+    return id;
+}
+
+void trace_site_register(trace_site_t* site, uint32_t generation) {
+    // if the name is dropped for being over quota, try again next generation
+    // rather than on every event
+    mx_ktrace_name(site->id, site->name, strlen(site->name));
+    site->generation = generation;
+}
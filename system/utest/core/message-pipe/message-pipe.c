@@ -8,6 +8,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <threads.h>
 #include <unistd.h>
 
@@ -364,6 +365,68 @@ static bool message_pipe_multithread_read(void) {
     END_TEST;
 }
 
+static bool message_pipe_vectored(void) {
+    BEGIN_TEST;
+    mx_handle_t pipe[2];
+    mx_status_t status = mx_msgpipe_create(pipe, 0);
+    ASSERT_EQ(status, NO_ERROR, "error in message pipe create");
+
+    mx_handle_t event = mx_event_create(0u);
+    ASSERT_GT(event, 0, "could not create event");
+
+    // Gather a header and a payload into one message, with a handle.
+    uint32_t header = 0x12345678;
+    char payload[] = "payload";
+    mx_iovec_t wiov[] = {
+        { &header, sizeof(header) },
+        { payload, sizeof(payload) },
+    };
+    status = mx_msgpipe_writev(pipe[0], wiov, 2, &event, 1u, 0u);
+    ASSERT_EQ(status, NO_ERROR, "writev failed");
+
+    // It reads back as one contiguous message.
+    char buf[64];
+    uint32_t num_bytes = sizeof(buf);
+    mx_handle_t h;
+    uint32_t num_handles = 1u;
+    status = mx_msgpipe_read(pipe[1], buf, &num_bytes, &h, &num_handles, 0u);
+    ASSERT_EQ(status, NO_ERROR, "read failed");
+    ASSERT_EQ(num_bytes, sizeof(header) + sizeof(payload), "wrong message size");
+    ASSERT_EQ(num_handles, 1u, "wrong handle count");
+    ASSERT_EQ(memcmp(buf, &header, sizeof(header)), 0, "wrong header");
+    ASSERT_EQ(memcmp(buf + sizeof(header), payload, sizeof(payload)), 0, "wrong payload");
+
+    // Scatter a plain message across two buffers.
+    status = mx_msgpipe_write(pipe[1], buf, num_bytes, NULL, 0u, 0u);
+    ASSERT_EQ(status, NO_ERROR, "write failed");
+
+    uint32_t read_header = 0;
+    char read_payload[sizeof(payload)];
+    mx_iovec_t riov[] = {
+        { &read_header, sizeof(read_header) },
+        { read_payload, sizeof(read_payload) },
+    };
+    num_bytes = 0u;
+    status = mx_msgpipe_readv(pipe[0], riov, 2, &num_bytes, NULL, NULL, 0u);
+    ASSERT_EQ(status, NO_ERROR, "readv failed");
+    ASSERT_EQ(num_bytes, sizeof(header) + sizeof(payload), "wrong message size");
+    ASSERT_EQ(read_header, header, "wrong header");
+    ASSERT_EQ(memcmp(read_payload, payload, sizeof(payload)), 0, "wrong payload");
+
+    // A message that doesn't fit in the buffers is left in the pipe.
+    status = mx_msgpipe_write(pipe[1], buf, sizeof(buf), NULL, 0u, 0u);
+    ASSERT_EQ(status, NO_ERROR, "write failed");
+    num_bytes = 0u;
+    status = mx_msgpipe_readv(pipe[0], riov, 2, &num_bytes, NULL, NULL, 0u);
+    ASSERT_EQ(status, ERR_BUFFER_TOO_SMALL, "readv into small buffers");
+    ASSERT_EQ(num_bytes, sizeof(buf), "size of pending message");
+
+    mx_handle_close(h);
+    mx_handle_close(pipe[0]);
+    mx_handle_close(pipe[1]);
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(message_pipe_tests)
 RUN_TEST(message_pipe_test)
 RUN_TEST(message_pipe_read_error_test)
@@ -371,6 +434,7 @@ RUN_TEST(message_pipe_close_test)
 RUN_TEST(message_pipe_non_transferable)
 RUN_TEST(message_pipe_duplicate_handles)
 RUN_TEST(message_pipe_multithread_read)
+RUN_TEST(message_pipe_vectored)
 END_TEST_CASE(message_pipe_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -18,6 +18,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 static mx_signals_t get_satisfied_signals(mx_handle_t handle) {
@@ -176,10 +177,90 @@ static bool socket_oob(void) {
 }
 
 
+static bool socket_vectored(void) {
+    BEGIN_TEST;
+
+    mx_status_t status;
+    mx_ssize_t ssize;
+
+    mx_handle_t h[2];
+    status = mx_socket_create(h, 0);
+    ASSERT_EQ(status, NO_ERROR, "");
+
+    // Gather three buffers and scatter them back across two.
+    char a[] = "hello", b[] = ", ", c[] = "world";
+    mx_iovec_t wiov[] = {
+        { a, 5 },
+        { b, 2 },
+        { c, 5 },
+    };
+    ssize = mx_socket_writev(h[0], 0u, wiov, 3);
+    ASSERT_EQ(ssize, 12, "");
+
+    char r0[3] = {0}, r1[16] = {0};
+    mx_iovec_t riov[] = {
+        { r0, sizeof(r0) },
+        { r1, sizeof(r1) },
+    };
+    ssize = mx_socket_readv(h[1], 0u, riov, 2);
+    ASSERT_EQ(ssize, 12, "");
+    ASSERT_EQ(memcmp(r0, "hel", 3), 0, "");
+    ASSERT_EQ(memcmp(r1, "lo, world", 9), 0, "");
+
+    // Push the ring's head and tail most of the way round, so the next
+    // vectored write and read have to wrap.
+    const int kSkip = 200 * 1024;
+    const int kSize = 100 * 1024;
+    char* buf = malloc(kSkip);
+    ASSERT_NEQ(buf, NULL, "");
+    ssize = mx_socket_write(h[0], 0u, kSkip, buf);
+    ASSERT_EQ(ssize, kSkip, "");
+    ssize = mx_socket_read(h[1], 0u, kSkip, buf);
+    ASSERT_EQ(ssize, kSkip, "");
+
+    for (int i = 0; i < kSize; i++)
+        buf[i] = (char)i;
+    mx_iovec_t big_wiov[] = {
+        { buf, kSize / 2 },
+        { buf + kSize / 2, kSize / 2 },
+    };
+    ssize = mx_socket_writev(h[0], 0u, big_wiov, 2);
+    ASSERT_EQ(ssize, kSize, "");
+
+    char* out = malloc(kSize);
+    ASSERT_NEQ(out, NULL, "");
+    mx_iovec_t big_riov[] = {
+        { out, 1000 },
+        { out + 1000, kSize - 1000 },
+    };
+    ssize = mx_socket_readv(h[1], 0u, big_riov, 2);
+    ASSERT_EQ(ssize, kSize, "");
+    ASSERT_EQ(memcmp(buf, out, kSize), 0, "");
+
+    free(buf);
+    free(out);
+
+    // Too many entries, and control messages, are refused.
+    mx_iovec_t many[MX_IOVEC_MAX + 1];
+    for (size_t i = 0; i < countof(many); i++) {
+        many[i].buffer = a;
+        many[i].length = 1;
+    }
+    ssize = mx_socket_writev(h[0], 0u, many, countof(many));
+    ASSERT_EQ(ssize, ERR_OUT_OF_RANGE, "");
+    ssize = mx_socket_writev(h[0], MX_SOCKET_CONTROL, wiov, 3);
+    ASSERT_EQ(ssize, ERR_INVALID_ARGS, "");
+
+    mx_handle_close(h[0]);
+    mx_handle_close(h[1]);
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(socket_tests)
 RUN_TEST(socket_basic)
 RUN_TEST(socket_signals)
 RUN_TEST(socket_oob)
+RUN_TEST(socket_vectored)
 END_TEST_CASE(socket_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -0,0 +1,261 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inttypes.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <magenta/syscalls.h>
+#include <unittest/unittest.h>
+
+#define NUM_THREADS 8
+#define NUM_SLOTS 1024
+#define NUM_OPS 100000
+
+static uint32_t rand32(uint32_t* state) {
+    *state = *state * 1103515245 + 12345;
+    return *state >> 1;
+}
+
+// Picks a size, mostly small, sometimes past the slab size classes.
+static size_t rand_size(uint32_t* state) {
+    uint32_t r = rand32(state);
+    switch (r % 8) {
+    case 0:
+        return r % 16384;
+    case 1:
+    case 2:
+        return r % 2560;
+    default:
+        return r % 256;
+    }
+}
+
+static uint8_t fill_byte(const void* p) {
+    uintptr_t v = (uintptr_t)p;
+    return (uint8_t)((v >> 4) ^ (v >> 12) ^ 0xa5);
+}
+
+static bool check_fill(const uint8_t* p, size_t size) {
+    uint8_t b = fill_byte(p);
+    for (size_t i = 0; i < size; i++) {
+        if (p[i] != b)
+            return false;
+    }
+    return true;
+}
+
+bool malloc_basic_test(void) {
+    BEGIN_TEST;
+
+    static const size_t sizes[] = {
+        0, 1, 15, 16, 17, 100, 128, 129, 1000, 2047, 2048, 2049, 4096, 100000, 1 << 20,
+    };
+    for (size_t i = 0; i < countof(sizes); i++) {
+        size_t size = sizes[i];
+        uint8_t* p = malloc(size);
+        ASSERT_NONNULL(p, "malloc");
+        EXPECT_EQ(0u, (uintptr_t)p % 16, "malloc alignment");
+        EXPECT_GE(malloc_usable_size(p), size, "malloc_usable_size");
+        memset(p, 0xcc, malloc_usable_size(p));
+
+        uint8_t* z = calloc(1, size);
+        ASSERT_NONNULL(z, "calloc");
+        for (size_t j = 0; j < size; j++) {
+            if (z[j] != 0) {
+                EXPECT_EQ(0, z[j], "calloc memory not zeroed");
+                break;
+            }
+        }
+
+        free(z);
+        free(p);
+    }
+
+    free(NULL);
+
+    END_TEST;
+}
+
+bool malloc_realloc_test(void) {
+    BEGIN_TEST;
+
+    // Grow one block through every size class and out into the chunk
+    // allocator's sizes, then back down, checking the contents survive.
+    uint8_t* p = NULL;
+    size_t old_size = 0;
+    for (size_t size = 1; size <= 65536; size = size * 3 / 2 + 1) {
+        p = realloc(p, size);
+        ASSERT_NONNULL(p, "realloc grow");
+        for (size_t i = 0; i < old_size; i++) {
+            if (p[i] != (uint8_t)i) {
+                EXPECT_EQ((uint8_t)i, p[i], "realloc lost contents");
+                break;
+            }
+        }
+        for (size_t i = old_size; i < size; i++)
+            p[i] = (uint8_t)i;
+        old_size = size;
+    }
+    for (size_t size = old_size; size > 0; size /= 3) {
+        p = realloc(p, size);
+        ASSERT_NONNULL(p, "realloc shrink");
+        for (size_t i = 0; i < size; i++) {
+            if (p[i] != (uint8_t)i) {
+                EXPECT_EQ((uint8_t)i, p[i], "realloc lost contents");
+                break;
+            }
+        }
+    }
+    free(p);
+
+    END_TEST;
+}
+
+bool malloc_memalign_test(void) {
+    BEGIN_TEST;
+
+    for (size_t align = sizeof(void*); align <= 8192; align *= 2) {
+        for (size_t size = 1; size <= 4096; size *= 4) {
+            void* p = NULL;
+            int ret = posix_memalign(&p, align, size);
+            ASSERT_EQ(0, ret, "posix_memalign");
+            EXPECT_EQ(0u, (uintptr_t)p % align, "posix_memalign alignment");
+            EXPECT_GE(malloc_usable_size(p), size, "malloc_usable_size");
+            memset(p, 0x5a, size);
+            free(p);
+
+            p = aligned_alloc(align, size);
+            ASSERT_NONNULL(p, "aligned_alloc");
+            EXPECT_EQ(0u, (uintptr_t)p % align, "aligned_alloc alignment");
+            free(p);
+        }
+    }
+
+    END_TEST;
+}
+
+// Blocks handed from one thread to another, to be freed by the receiver.
+static void* volatile mailbox[NUM_SLOTS];
+
+static atomic_int stress_failures;
+
+static void* stress_thread(void* arg) {
+    uint32_t seed = (uint32_t)(uintptr_t)arg * 7919u + 1u;
+    void* slots[NUM_SLOTS] = {};
+    size_t sizes[NUM_SLOTS] = {};
+
+    for (int op = 0; op < NUM_OPS; op++) {
+        uint32_t i = rand32(&seed) % NUM_SLOTS;
+        uint8_t* p = slots[i];
+        if (p != NULL) {
+            if (!check_fill(p, sizes[i]))
+                atomic_fetch_add(&stress_failures, 1);
+            slots[i] = NULL;
+            if (rand32(&seed) % 4 == 0) {
+                // Free it on some other thread.
+                p = __atomic_exchange_n(&mailbox[i], p, __ATOMIC_ACQ_REL);
+            }
+            free(p);
+        } else {
+            size_t size = rand_size(&seed);
+            p = malloc(size);
+            if (p == NULL) {
+                atomic_fetch_add(&stress_failures, 1);
+                continue;
+            }
+            memset(p, fill_byte(p), size);
+            slots[i] = p;
+            sizes[i] = size;
+        }
+    }
+
+    for (size_t i = 0; i < NUM_SLOTS; i++)
+        free(slots[i]);
+    return NULL;
+}
+
+bool malloc_stress_test(void) {
+    BEGIN_TEST;
+
+    atomic_store(&stress_failures, 0);
+
+    pthread_t threads[NUM_THREADS];
+    mx_time_t start = mx_current_time();
+    for (uintptr_t i = 0; i < NUM_THREADS; i++) {
+        int ret = pthread_create(&threads[i], NULL, stress_thread, (void*)i);
+        ASSERT_EQ(0, ret, "pthread_create");
+    }
+    for (size_t i = 0; i < NUM_THREADS; i++)
+        pthread_join(threads[i], NULL);
+    mx_time_t elapsed = mx_current_time() - start;
+
+    for (size_t i = 0; i < NUM_SLOTS; i++) {
+        free(mailbox[i]);
+        mailbox[i] = NULL;
+    }
+
+    EXPECT_EQ(0, atomic_load(&stress_failures), "corrupted or failed allocations");
+    unittest_printf("%d threads x %d ops: %" PRIu64 " ns/op\n", NUM_THREADS, NUM_OPS,
+                    elapsed / (NUM_THREADS * NUM_OPS));
+
+    END_TEST;
+}
+
+static void* bench_thread(void* arg) {
+    size_t size = (size_t)(uintptr_t)arg;
+    void* ptrs[64];
+    for (int round = 0; round < NUM_OPS / 64; round++) {
+        for (size_t i = 0; i < countof(ptrs); i++)
+            ptrs[i] = malloc(size);
+        for (size_t i = 0; i < countof(ptrs); i++)
+            free(ptrs[i]);
+    }
+    return NULL;
+}
+
+// Times malloc/free pairs of one size with 1 and NUM_THREADS threads, so
+// scaling problems show up as a jump in ns/op.
+bool malloc_scaling_benchmark(void) {
+    BEGIN_TEST;
+
+    static const size_t sizes[] = {16, 128, 1024, 8192};
+    for (size_t s = 0; s < countof(sizes); s++) {
+        for (size_t nthreads = 1; nthreads <= NUM_THREADS; nthreads *= NUM_THREADS) {
+            pthread_t threads[NUM_THREADS];
+            void* arg = (void*)(uintptr_t)sizes[s];
+            mx_time_t start = mx_current_time();
+            for (size_t i = 0; i < nthreads; i++) {
+                int ret = pthread_create(&threads[i], NULL, bench_thread, arg);
+                ASSERT_EQ(0, ret, "pthread_create");
+            }
+            for (size_t i = 0; i < nthreads; i++)
+                pthread_join(threads[i], NULL);
+            mx_time_t elapsed = mx_current_time() - start;
+
+            uint64_t ops = (uint64_t)nthreads * (NUM_OPS / 64) * 64;
+            unittest_printf("size %5zu, %zu threads: %" PRIu64 " ns/op\n",
+                            sizes[s], nthreads, elapsed / ops);
+        }
+    }
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(malloc_tests)
+RUN_TEST(malloc_basic_test)
+RUN_TEST(malloc_realloc_test)
+RUN_TEST(malloc_memalign_test)
+RUN_TEST(malloc_stress_test)
+RUN_TEST(malloc_scaling_benchmark)
+END_TEST_CASE(malloc_tests)
+
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
@@ -227,6 +227,21 @@ private:
 // Static storage for the observer.
 WAVLBalanceTestObserver::OpCounts WAVLBalanceTestObserver::op_counts_;
 
+// WAVLBalanceTestAugmentTraits
+//
+// Keeps the number of nodes in each subtree up to date so that the BalanceTest
+// can verify that augmented per-subtree state survives all of the insert, erase
+// and rotation cases.
+struct WAVLBalanceTestAugmentTraits {
+    static constexpr bool IsAugmented = true;
+
+    template <typename RawPtrType>
+    static void UpdateAugmentedState(RawPtrType node, RawPtrType left, RawPtrType right) {
+        node->SetSubtreeCount(1 + (left  ? left->SubtreeCount()  : 0)
+                                + (right ? right->SubtreeCount() : 0));
+    }
+};
+
 // Test objects during the balance test will be allocated as a block all at once
 // and cleaned up at the end of the test.  Our test containers, however, are
 // containers of unique pointers with a no-op Deleter trait.  This allows the
@@ -242,6 +257,7 @@ using BalanceTestTree    = WAVLTree<BalanceTestKeyType,
                                     BalanceTestObjPtr,
                                     DefaultKeyedObjectTraits<BalanceTestKeyType, BalanceTestObj>,
                                     DefaultWAVLTreeTraits<BalanceTestObjPtr, int32_t>,
+                                    WAVLBalanceTestAugmentTraits,
                                     WAVLBalanceTestObserver>;
 
 class BalanceTestObj {
@@ -252,6 +268,9 @@ public:
     }
 
     BalanceTestKeyType GetKey() const { return key_; }
+
+    size_t SubtreeCount() const { return subtree_count_; }
+    void SetSubtreeCount(size_t count) { subtree_count_ = count; }
     BalanceTestObj* EraseDeckPtr() const { return erase_deck_ptr_; };
 
     void SwapEraseDeckPtr(BalanceTestObj& other) {
@@ -267,11 +286,35 @@ private:
 
     BalanceTestKeyType key_;
     BalanceTestObj* erase_deck_ptr_;
+    size_t subtree_count_ = 0;
     WAVLTreeNodeState<BalanceTestObjPtr, int32_t> wavl_node_state_;
 };
 
 static constexpr size_t kBalanceTestSize = 2048;
 
+// Walk the structure of the tree, checking the subtree counts maintained by the
+// observer against the actual number of nodes in each subtree.
+static size_t CheckSubtreeCounts(const BalanceTestTree::iterator& node, bool* ok) {
+    if (!node.IsValid())
+        return 0;
+
+    size_t count = 1 + CheckSubtreeCounts(node.left(), ok) + CheckSubtreeCounts(node.right(), ok);
+    if (node->SubtreeCount() != count)
+        *ok = false;
+
+    return count;
+}
+
+static bool DoBalanceTestCheckAugmentation(BalanceTestTree& tree) {
+    BEGIN_TEST;
+
+    bool counts_ok = true;
+    ASSERT_EQ(tree.size(), CheckSubtreeCounts(tree.root(), &counts_ok), "");
+    ASSERT_TRUE(counts_ok, "Augmented subtree counts are inconsistent!");
+
+    END_TEST;
+}
+
 static bool DoBalanceTestInsert(BalanceTestTree& tree, BalanceTestObj* ptr) {
     BEGIN_TEST;
 
@@ -283,6 +326,7 @@ static bool DoBalanceTestInsert(BalanceTestTree& tree, BalanceTestObj* ptr) {
     // sanity check the tree.
     ASSERT_TRUE(tree.insert_or_find(BalanceTestObjPtr(ptr)), "");
     ASSERT_TRUE(WAVLTreeChecker::SanityCheck(tree), "");
+    ASSERT_TRUE(DoBalanceTestCheckAugmentation(tree), "");
 
     END_TEST;
 }
@@ -303,6 +347,7 @@ static bool DoBalanceTestErase(BalanceTestTree& tree, BalanceTestObj* ptr) {
     // Run a full sanity check on the tree.  Its depth should be
     // consistent with a tree which has seen both inserts and erases.
     ASSERT_TRUE(WAVLTreeChecker::SanityCheck(tree), "");
+    ASSERT_TRUE(DoBalanceTestCheckAugmentation(tree), "");
 
     END_TEST;
 }
@@ -56,6 +56,29 @@ static bool ref_counted_test() {
     END_TEST;
 }
 
+static bool add_ref_maybe_in_destructor_test() {
+    BEGIN_TEST;
+
+    bool destroyed = false;
+    AllocChecker ac;
+    DestructionTracker* tracker = new (&ac) DestructionTracker(&destroyed);
+    EXPECT_TRUE(ac.check(), "");
+    mxtl::RefPtr<DestructionTracker> ptr = mxtl::AdoptRef(tracker);
+
+    EXPECT_TRUE(tracker->AddRefMaybeInDestructor(), "live object should take a ref");
+    EXPECT_FALSE(tracker->Release(), "extra ref should not be the last");
+
+    // drop the count to zero by hand, as if the destructor were about to run
+    EXPECT_TRUE(ptr.leak_ref()->Release(), "should be the last ref");
+    EXPECT_FALSE(tracker->AddRefMaybeInDestructor(), "dying object should not take a ref");
+    EXPECT_FALSE(destroyed, "nothing has deleted it yet");
+
+    delete tracker;
+    EXPECT_TRUE(destroyed, "");
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(ref_counted_tests)
 RUN_NAMED_TEST("Ref Counted", ref_counted_test)
+RUN_NAMED_TEST("AddRefMaybeInDestructor", add_ref_maybe_in_destructor_test)
 END_TEST_CASE(ref_counted_tests);
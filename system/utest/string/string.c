@@ -0,0 +1,430 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Checks the libc string routines against simple C versions across sizes
+// and alignments, and compares their throughput.
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <magenta/syscalls.h>
+#include <unittest/unittest.h>
+
+// Keep GCC from turning the reference loops back into calls to the routines
+// they are checking.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("no-tree-loop-distribute-patterns")
+#endif
+
+#define MAX_SIZE 8192
+#define MAX_ALIGN 64
+// Bytes checked on each side of the destination for stray writes.
+#define GUARD 64
+#define BUF_SIZE (GUARD + MAX_ALIGN + MAX_SIZE + GUARD)
+
+static uint8_t src_buf[BUF_SIZE];
+static uint8_t dst_buf[BUF_SIZE];
+static uint8_t ref_buf[BUF_SIZE];
+
+// These are musl's portable C versions, which the optimized routines
+// replaced on x86-64 and arm64.
+
+#define WS (sizeof(size_t))
+#define ONES ((size_t)-1 / UCHAR_MAX)
+#define HIGHS (ONES * (UCHAR_MAX / 2 + 1))
+#define HASZERO(x) (((x)-ONES) & ~(x)&HIGHS)
+
+static void* ref_memcpy(void* dest, const void* src, size_t n) {
+    uint8_t* d = dest;
+    const uint8_t* s = src;
+    for (; (uintptr_t)s % WS && n; n--)
+        *d++ = *s++;
+    if ((uintptr_t)d % WS == 0) {
+        for (; n >= WS; s += WS, d += WS, n -= WS)
+            *(size_t*)d = *(const size_t*)s;
+    }
+    for (; n; n--)
+        *d++ = *s++;
+    return dest;
+}
+
+static void* ref_memset(void* dest, int c, size_t n) {
+    uint8_t* d = dest;
+    for (; (uintptr_t)d % WS && n; n--)
+        *d++ = (uint8_t)c;
+    size_t k = ONES * (uint8_t)c;
+    for (; n >= WS; d += WS, n -= WS)
+        *(size_t*)d = k;
+    for (; n; n--)
+        *d++ = (uint8_t)c;
+    return dest;
+}
+
+static int ref_memcmp(const void* vl, const void* vr, size_t n) {
+    const uint8_t *l = vl, *r = vr;
+    for (; n && *l == *r; n--, l++, r++)
+        ;
+    return n ? *l - *r : 0;
+}
+
+static size_t ref_strlen(const char* s) {
+    const char* a = s;
+    for (; (uintptr_t)s % WS; s++)
+        if (!*s)
+            return s - a;
+    const size_t* w;
+    for (w = (const void*)s; !HASZERO(*w); w++)
+        ;
+    for (s = (const void*)w; *s; s++)
+        ;
+    return s - a;
+}
+
+static void* ref_memchr(const void* src, int c, size_t n) {
+    const uint8_t* s = src;
+    c = (uint8_t)c;
+    for (; ((uintptr_t)s % WS) && n && *s != c; s++, n--)
+        ;
+    if (n && *s != c) {
+        const size_t* w;
+        size_t k = ONES * c;
+        for (w = (const void*)s; n >= WS && !HASZERO(*w ^ k); w++, n -= WS)
+            ;
+        for (s = (const void*)w; n && *s != c; s++, n--)
+            ;
+    }
+    return n ? (void*)s : NULL;
+}
+
+static int sign(int x) {
+    return (x > 0) - (x < 0);
+}
+
+static uint32_t rand_state = 1;
+
+static uint8_t rand8(void) {
+    rand_state = rand_state * 1103515245 + 12345;
+    return (uint8_t)(rand_state >> 16);
+}
+
+static void fill_random(uint8_t* buf, size_t len) {
+    for (size_t i = 0; i < len; i++)
+        buf[i] = rand8();
+}
+
+// Every size up to 300 covers all the small-size branches; past that a few
+// sizes around the loop and rep-string thresholds are enough.
+static const size_t big_sizes[] = {
+    511, 512, 513, 1000, 2047, 2048, 2049, 4095, 4096, 4097, 8191, MAX_SIZE,
+};
+
+static size_t test_size(size_t i) {
+    return i <= 300 ? i : big_sizes[i - 301];
+}
+
+#define NUM_TEST_SIZES (301 + countof(big_sizes))
+
+// Small sizes get every alignment, big ones a spread of them.
+static size_t align_step(size_t size) {
+    return size <= 300 ? 1 : 7;
+}
+
+bool memcpy_test(void) {
+    BEGIN_TEST;
+
+    for (size_t i = 0; i < NUM_TEST_SIZES; i++) {
+        size_t size = test_size(i);
+        for (size_t sa = 0; sa < MAX_ALIGN; sa += align_step(size)) {
+            for (size_t da = 0; da < MAX_ALIGN; da += align_step(size) * 3) {
+                fill_random(src_buf, BUF_SIZE);
+                fill_random(dst_buf, BUF_SIZE);
+                memcpy(ref_buf, dst_buf, BUF_SIZE);
+
+                uint8_t* dst = dst_buf + GUARD + da;
+                uint8_t* src = src_buf + GUARD + sa;
+                ASSERT_EQ(dst, memcpy(dst, src, size), "memcpy return value");
+                ref_memcpy(ref_buf + GUARD + da, src, size);
+                ASSERT_EQ(0, ref_memcmp(dst_buf, ref_buf, BUF_SIZE), "memcpy result");
+            }
+        }
+    }
+
+    END_TEST;
+}
+
+bool memmove_test(void) {
+    BEGIN_TEST;
+
+    // Overlapping moves in both directions, by every distance up to
+    // MAX_ALIGN.
+    for (size_t i = 0; i < NUM_TEST_SIZES; i++) {
+        size_t size = test_size(i);
+        for (size_t from = 0; from < MAX_ALIGN; from += align_step(size)) {
+            for (size_t to = 0; to < MAX_ALIGN; to += align_step(size) * 3) {
+                fill_random(dst_buf, BUF_SIZE);
+                memcpy(ref_buf, dst_buf, BUF_SIZE);
+
+                uint8_t* base = dst_buf + GUARD;
+                ASSERT_EQ(base + to, memmove(base + to, base + from, size),
+                          "memmove return value");
+                // Copy out of an untouched copy of the buffer for the
+                // expected result.
+                memcpy(src_buf, ref_buf, BUF_SIZE);
+                ref_memcpy(ref_buf + GUARD + to, src_buf + GUARD + from, size);
+                ASSERT_EQ(0, ref_memcmp(dst_buf, ref_buf, BUF_SIZE), "memmove result");
+            }
+        }
+    }
+
+    END_TEST;
+}
+
+bool memset_test(void) {
+    BEGIN_TEST;
+
+    for (size_t i = 0; i < NUM_TEST_SIZES; i++) {
+        size_t size = test_size(i);
+        for (size_t da = 0; da < MAX_ALIGN; da += align_step(size)) {
+            fill_random(dst_buf, BUF_SIZE);
+            memcpy(ref_buf, dst_buf, BUF_SIZE);
+            int c = rand8();
+
+            uint8_t* dst = dst_buf + GUARD + da;
+            ASSERT_EQ(dst, memset(dst, c, size), "memset return value");
+            ref_memset(ref_buf + GUARD + da, c, size);
+            ASSERT_EQ(0, ref_memcmp(dst_buf, ref_buf, BUF_SIZE), "memset result");
+        }
+    }
+
+    END_TEST;
+}
+
+bool memcmp_test(void) {
+    BEGIN_TEST;
+
+    for (size_t i = 0; i < NUM_TEST_SIZES; i++) {
+        size_t size = test_size(i);
+        for (size_t la = 0; la < MAX_ALIGN; la += align_step(size)) {
+            size_t ra = (la * 5 + 3) % MAX_ALIGN;
+            uint8_t* l = src_buf + GUARD + la;
+            uint8_t* r = dst_buf + GUARD + ra;
+            fill_random(l, size);
+            memcpy(r, l, size);
+            ASSERT_EQ(0, memcmp(l, r, size), "memcmp of equal buffers");
+            if (size == 0)
+                continue;
+
+            // A difference at the start, the end and somewhere between,
+            // in both directions.
+            size_t positions[] = {0, size - 1, (la * 31) % size};
+            for (size_t p = 0; p < countof(positions); p++) {
+                size_t pos = positions[p];
+                uint8_t saved = r[pos];
+                r[pos] = (uint8_t)(saved + 1 + rand8() % 255);
+                int expected = sign(ref_memcmp(l, r, size));
+                ASSERT_NEQ(0, expected, "reference memcmp");
+                EXPECT_EQ(expected, sign(memcmp(l, r, size)), "memcmp result");
+                EXPECT_EQ(-expected, sign(memcmp(r, l, size)), "memcmp result");
+                r[pos] = saved;
+            }
+        }
+    }
+
+    END_TEST;
+}
+
+bool strlen_test(void) {
+    BEGIN_TEST;
+
+    memset(src_buf, 'x', BUF_SIZE);
+    for (size_t i = 0; i < NUM_TEST_SIZES; i++) {
+        size_t size = test_size(i);
+        for (size_t a = 0; a < MAX_ALIGN; a += align_step(size)) {
+            char* s = (char*)src_buf + GUARD + a;
+            s[size] = '\0';
+            EXPECT_EQ(ref_strlen(s), strlen(s), "strlen");
+            EXPECT_EQ(size, strlen(s), "strlen");
+            s[size] = 'x';
+        }
+    }
+
+    END_TEST;
+}
+
+bool memchr_test(void) {
+    BEGIN_TEST;
+
+    memset(src_buf, 'x', BUF_SIZE);
+    for (size_t i = 0; i < NUM_TEST_SIZES; i++) {
+        size_t size = test_size(i);
+        for (size_t a = 0; a < MAX_ALIGN; a += align_step(size)) {
+            uint8_t* s = src_buf + GUARD + a;
+            EXPECT_EQ(NULL, memchr(s, 'y', size), "memchr of a missing byte");
+
+            // Matches just outside the buffer must not be found.
+            s[-1] = 'y';
+            s[size] = 'y';
+            EXPECT_EQ(NULL, memchr(s, 'y', size), "memchr outside the buffer");
+
+            if (size > 0) {
+                size_t pos = (a * 131) % size;
+                s[pos] = 'y';
+                EXPECT_EQ(ref_memchr(s, 'y', size), memchr(s, 'y', size), "memchr");
+                EXPECT_EQ(s + pos, memchr(s, 'y', size), "memchr");
+                // Callers pass SIZE_MAX for an unbounded search.
+                EXPECT_EQ(s + pos, memchr(s, 'y', SIZE_MAX), "memchr with SIZE_MAX");
+                s[pos] = 'x';
+            }
+            s[-1] = 'x';
+            s[size] = 'x';
+        }
+    }
+
+    END_TEST;
+}
+
+// Strings and buffers that end at the end of a mapping, so reading past
+// them would fault.
+bool page_end_test(void) {
+    BEGIN_TEST;
+
+    mx_handle_t vmo = mx_vmo_create(PAGE_SIZE);
+    ASSERT_GT(vmo, 0, "vmo_create");
+    uintptr_t addr;
+    mx_status_t status = mx_process_map_vm(mx_process_self(), vmo, 0, PAGE_SIZE, &addr,
+                                           MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE);
+    ASSERT_EQ(NO_ERROR, status, "process_map_vm");
+    uint8_t* page = (uint8_t*)addr;
+    uint8_t* end = page + PAGE_SIZE;
+
+    for (size_t size = 0; size <= 256; size++) {
+        uint8_t* p = end - size;
+        memset(page, 'x', PAGE_SIZE);
+        EXPECT_EQ(NULL, memchr(p, 'y', size), "memchr");
+        EXPECT_EQ(0, memcmp(p, p, size), "memcmp");
+        memcpy(p, page, size);
+        memset(p, 'x', size);
+        if (size > 0) {
+            p[size - 1] = '\0';
+            EXPECT_EQ(size - 1, strlen((char*)p), "strlen");
+        }
+    }
+
+    mx_process_unmap_vm(mx_process_self(), addr, 0);
+    mx_handle_close(vmo);
+
+    END_TEST;
+}
+
+typedef void (*bench_fn)(size_t size);
+
+static void bench_memcpy(size_t size) {
+    memcpy(dst_buf, src_buf + 1, size);
+}
+
+static void bench_ref_memcpy(size_t size) {
+    ref_memcpy(dst_buf, src_buf + 1, size);
+}
+
+static void bench_memset(size_t size) {
+    memset(dst_buf + 1, 0x5a, size);
+}
+
+static void bench_ref_memset(size_t size) {
+    ref_memset(dst_buf + 1, 0x5a, size);
+}
+
+static void bench_memcmp(size_t size) {
+    __asm__ volatile("" ::"r"(memcmp(src_buf, dst_buf, size)) : "memory");
+}
+
+static void bench_ref_memcmp(size_t size) {
+    __asm__ volatile("" ::"r"(ref_memcmp(src_buf, dst_buf, size)) : "memory");
+}
+
+static void bench_strlen(size_t size) {
+    __asm__ volatile("" ::"r"(strlen((const char*)src_buf)) : "memory");
+}
+
+static void bench_ref_strlen(size_t size) {
+    __asm__ volatile("" ::"r"(ref_strlen((const char*)src_buf)) : "memory");
+}
+
+static void bench_memchr(size_t size) {
+    __asm__ volatile("" ::"r"(memchr(src_buf, 'y', size)) : "memory");
+}
+
+static void bench_ref_memchr(size_t size) {
+    __asm__ volatile("" ::"r"(ref_memchr(src_buf, 'y', size)) : "memory");
+}
+
+static double bench_one(bench_fn fn, size_t size) {
+    const mx_time_t duration = MX_MSEC(50);
+    uint64_t iterations = 0;
+    mx_time_t start = mx_current_time();
+    mx_time_t elapsed;
+    do {
+        for (int i = 0; i < 100; i++)
+            fn(size);
+        iterations += 100;
+        elapsed = mx_current_time() - start;
+    } while (elapsed < duration);
+    // Megabytes per second.
+    return (double)size * iterations * 1000.0 / (double)elapsed;
+}
+
+static const struct {
+    const char* name;
+    bench_fn fn;
+    bench_fn ref_fn;
+} benchmarks[] = {
+    {"memcpy", bench_memcpy, bench_ref_memcpy},
+    {"memset", bench_memset, bench_ref_memset},
+    {"memcmp", bench_memcmp, bench_ref_memcmp},
+    {"strlen", bench_strlen, bench_ref_strlen},
+    {"memchr", bench_memchr, bench_ref_memchr},
+};
+
+bool string_throughput_test(void) {
+    BEGIN_TEST;
+
+    static const size_t sizes[] = {16, 64, 256, 1024, 4096, MAX_SIZE};
+
+    for (size_t b = 0; b < countof(benchmarks); b++) {
+        // memcmp runs to the end of equal buffers.
+        memset(src_buf, 'x', BUF_SIZE);
+        memset(dst_buf, 'x', BUF_SIZE);
+        for (size_t i = 0; i < countof(sizes); i++) {
+            size_t size = sizes[i];
+            // strlen runs to the terminator rather than taking a size.
+            src_buf[size] = '\0';
+            double mbps = bench_one(benchmarks[b].fn, size);
+            double ref_mbps = bench_one(benchmarks[b].ref_fn, size);
+            src_buf[size] = 'x';
+            unittest_printf("%s %5zu bytes: %8.0f MB/s, C version %8.0f MB/s (%.1fx)\n",
+                            benchmarks[b].name, size, mbps, ref_mbps, mbps / ref_mbps);
+        }
+    }
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(string_tests)
+RUN_TEST(memcpy_test)
+RUN_TEST(memmove_test)
+RUN_TEST(memset_test)
+RUN_TEST(memcmp_test)
+RUN_TEST(strlen_test)
+RUN_TEST(memchr_test)
+RUN_TEST(page_end_test)
+RUN_TEST(string_throughput_test)
+END_TEST_CASE(string_tests)
+
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
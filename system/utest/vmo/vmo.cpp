@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 #include <unistd.h>
 
 #include <magenta/syscalls.h>
@@ -329,6 +330,336 @@ bool vmo_lookup_test() {
     END_TEST;
 }
 
+bool vmo_willneed_test() {
+    BEGIN_TEST;
+
+    mx_handle_t vmo;
+    mx_status_t status;
+
+    const size_t size = 16384;
+    mx_paddr_t buf[size / PAGE_SIZE];
+
+    vmo = mx_vmo_create(size);
+    EXPECT_LT(0, vmo, "vm_object_create");
+
+    // nothing outstanding yet
+    mx_signals_state_t state;
+    status = mx_handle_wait_one(vmo, MX_VMO_SIGNAL_PREFETCHED, 0u, &state);
+    EXPECT_EQ(NO_ERROR, status, "prefetched signal initially");
+
+    uintptr_t ptr;
+    status = mx_process_map_vm(mx_process_self(), vmo, 0, size, &ptr,
+                               MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE);
+    EXPECT_EQ(NO_ERROR, status, "vm_map");
+
+    // ask for the whole object and wait for the prefetch to finish
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_WILLNEED, 0, size, nullptr, 0);
+    EXPECT_EQ(NO_ERROR, status, "willneed");
+
+    status = mx_handle_wait_one(vmo, MX_VMO_SIGNAL_PREFETCHED, MX_TIME_INFINITE, &state);
+    EXPECT_EQ(NO_ERROR, status, "wait for prefetch");
+
+    // the pages should now be committed
+    memset(buf, 0, sizeof(buf));
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_LOOKUP, 0, size, buf, sizeof(buf));
+    EXPECT_EQ(NO_ERROR, status, "lookup on prefetched vmo");
+
+    for (auto addr: buf)
+        EXPECT_NEQ(0u, addr, "looked up address");
+
+    // and read back as zero through the mapping
+    uint8_t zero[size] = {};
+    EXPECT_BYTES_EQ(zero, (uint8_t*)ptr, size, "mapped buffer");
+
+    // a zero length request completes right away
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_WILLNEED, 0, 0, nullptr, 0);
+    EXPECT_EQ(NO_ERROR, status, "zero size willneed");
+
+    // out of range
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_WILLNEED, size, 1, nullptr, 0);
+    EXPECT_EQ(ERR_OUT_OF_RANGE, status, "out of range");
+
+    status = mx_process_unmap_vm(mx_process_self(), ptr, 0);
+    EXPECT_EQ(NO_ERROR, status, "vm_unmap");
+
+    // prefetching an object that isn't mapped only commits it
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_WILLNEED, 0, size, nullptr, 0);
+    EXPECT_EQ(NO_ERROR, status, "willneed unmapped");
+
+    status = mx_handle_wait_one(vmo, MX_VMO_SIGNAL_PREFETCHED, MX_TIME_INFINITE, &state);
+    EXPECT_EQ(NO_ERROR, status, "wait for prefetch");
+
+    // without the read right the op is refused
+    mx_handle_t ro = mx_handle_duplicate(vmo, MX_RIGHT_MAP);
+    EXPECT_LT(0, ro, "duplicate");
+
+    status = mx_vmo_op_range(ro, MX_VMO_OP_WILLNEED, 0, size, nullptr, 0);
+    EXPECT_EQ(ERR_ACCESS_DENIED, status, "willneed without read right");
+
+    EXPECT_EQ(NO_ERROR, mx_handle_close(ro), "handle_close");
+
+    // close the handle
+    status = mx_handle_close(vmo);
+    EXPECT_EQ(NO_ERROR, status, "handle_close");
+
+    END_TEST;
+}
+
+static int vmo_pager_reader(void* arg) {
+    mx_handle_t vmo = *static_cast<mx_handle_t*>(arg);
+
+    // blocks until the pager supplies the second page
+    uint8_t buf[16];
+    if (mx_vmo_read(vmo, buf, PAGE_SIZE + 8, sizeof(buf)) != (mx_ssize_t)sizeof(buf))
+        return -1;
+
+    for (auto b: buf) {
+        if (b != 0x55)
+            return -1;
+    }
+    return 0;
+}
+
+bool vmo_pager_test() {
+    BEGIN_TEST;
+
+    mx_status_t status;
+
+    const size_t size = PAGE_SIZE * 2;
+    const uint64_t key = 0x1234;
+
+    mx_handle_t port = mx_port_create(0u);
+    ASSERT_GT(port, 0, "port_create");
+
+    mx_handle_t vmo = mx_vmo_create_paged(size, port, key);
+    ASSERT_GT(vmo, 0, "vmo_create_paged");
+
+    thrd_t reader;
+    int ret = thrd_create_with_name(&reader, vmo_pager_reader, &vmo, "reader");
+    ASSERT_EQ(ret, thrd_success, "Error during thread creation");
+
+    // serve the reader's request
+    mx_page_request_packet_t pkt;
+    status = mx_port_wait(port, &pkt, sizeof(pkt));
+    EXPECT_EQ(NO_ERROR, status, "port_wait");
+    EXPECT_EQ(key, pkt.hdr.key, "packet key");
+    EXPECT_EQ(MX_PORT_PKT_TYPE_PAGE_REQUEST, pkt.hdr.type, "packet type");
+    EXPECT_EQ((uint64_t)PAGE_SIZE, pkt.offset, "requested offset");
+
+    uint8_t page[PAGE_SIZE];
+    memset(page, 0x55, sizeof(page));
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_SUPPLY, pkt.offset, sizeof(page), page, sizeof(page));
+    EXPECT_EQ(NO_ERROR, status, "supply");
+
+    int reader_ret;
+    EXPECT_EQ(thrd_join(reader, &reader_ret), thrd_success, "Error during wait");
+    EXPECT_EQ(0, reader_ret, "reader saw the supplied page");
+
+    // only the pager can fill in pages
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_COMMIT, 0, size, nullptr, 0);
+    EXPECT_EQ(ERR_NOT_SUPPORTED, status, "commit");
+
+    // willneed asks for the missing page without waiting for it
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_WILLNEED, 0, size, nullptr, 0);
+    EXPECT_EQ(NO_ERROR, status, "willneed");
+
+    status = mx_port_wait(port, &pkt, sizeof(pkt));
+    EXPECT_EQ(NO_ERROR, status, "port_wait");
+    EXPECT_EQ(0u, pkt.offset, "requested offset");
+
+    // supply part of the page, the rest of it reads as zero
+    const uint8_t data[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_SUPPLY, 0, sizeof(data), (void*)data, sizeof(data));
+    EXPECT_EQ(NO_ERROR, status, "partial supply");
+
+    uintptr_t ptr;
+    status = mx_process_map_vm(mx_process_self(), vmo, 0, size, &ptr, MX_VM_FLAG_PERM_READ);
+    EXPECT_EQ(NO_ERROR, status, "vm_map");
+
+    const uint8_t* mapped = (const uint8_t*)ptr;
+    EXPECT_BYTES_EQ(data, mapped, sizeof(data), "supplied data");
+    bool zero = true;
+    for (size_t i = sizeof(data); i < PAGE_SIZE; i++)
+        zero = zero && (mapped[i] == 0);
+    EXPECT_TRUE(zero, "rest of the page is zero");
+    EXPECT_BYTES_EQ(page, mapped + PAGE_SIZE, PAGE_SIZE, "second page");
+
+    status = mx_process_unmap_vm(mx_process_self(), ptr, 0);
+    EXPECT_EQ(NO_ERROR, status, "vm_unmap");
+
+    // supplying an unaligned offset fails
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_SUPPLY, 1, sizeof(data), (void*)data, sizeof(data));
+    EXPECT_EQ(ERR_INVALID_ARGS, status, "unaligned supply");
+
+    EXPECT_EQ(NO_ERROR, mx_handle_close(vmo), "handle_close");
+    EXPECT_EQ(NO_ERROR, mx_handle_close(port), "handle_close");
+
+    END_TEST;
+}
+
+bool vmo_info_test() {
+    BEGIN_TEST;
+
+    mx_status_t status;
+    const size_t size = 16384;
+
+    mx_handle_t vmo = mx_vmo_create(size);
+    EXPECT_LT(0, vmo, "vm_object_create");
+
+    // a fresh object has nothing committed
+    mx_info_vmo_t info;
+    mx_ssize_t ret = mx_object_get_info(vmo, MX_INFO_VMO, sizeof(info.rec), &info, sizeof(info));
+    EXPECT_EQ((mx_ssize_t)sizeof(info), ret, "get_info");
+    EXPECT_EQ(size, info.rec.size, "vmo size");
+    EXPECT_EQ(0u, info.rec.committed_bytes, "committed before commit");
+
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_COMMIT, 0, size, nullptr, 0);
+    EXPECT_EQ(NO_ERROR, status, "commit");
+
+    ret = mx_object_get_info(vmo, MX_INFO_VMO, sizeof(info.rec), &info, sizeof(info));
+    EXPECT_EQ((mx_ssize_t)sizeof(info), ret, "get_info");
+    EXPECT_EQ(size, info.rec.committed_bytes, "committed after commit");
+
+    // touching a mapping of the object makes it resident in this process
+    mx_info_process_memory_t before, after;
+    ret = mx_object_get_info(mx_process_self(), MX_INFO_PROCESS_MEMORY, sizeof(before.rec),
+                             &before, sizeof(before));
+    EXPECT_EQ((mx_ssize_t)sizeof(before), ret, "get_info process memory");
+
+    uintptr_t ptr;
+    status = mx_process_map_vm(mx_process_self(), vmo, 0, size, &ptr,
+                               MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE);
+    EXPECT_EQ(NO_ERROR, status, "vm_map");
+    memset((void*)ptr, 0x5a, size);
+
+    ret = mx_object_get_info(mx_process_self(), MX_INFO_PROCESS_MEMORY, sizeof(after.rec),
+                             &after, sizeof(after));
+    EXPECT_EQ((mx_ssize_t)sizeof(after), ret, "get_info process memory");
+    EXPECT_LE(before.rec.mapped_bytes + size, after.rec.mapped_bytes, "mapped bytes");
+    EXPECT_LE(size, after.rec.resident_bytes, "resident bytes");
+    EXPECT_LE(after.rec.resident_bytes, after.rec.mapped_bytes, "resident <= mapped");
+
+    status = mx_process_unmap_vm(mx_process_self(), ptr, 0);
+    EXPECT_EQ(NO_ERROR, status, "vm_unmap");
+
+    // listing the processes takes the root resource, which tests aren't given
+    const size_t list_size = sizeof(mx_info_process_list_t) + 256 * sizeof(mx_record_process_list_t);
+    mx_info_process_list_t* list = (mx_info_process_list_t*)malloc(list_size);
+    ret = mx_object_get_info(MX_HANDLE_INVALID, MX_INFO_PROCESS_LIST,
+                             sizeof(mx_record_process_list_t), list, list_size);
+    EXPECT_EQ(ERR_BAD_HANDLE, ret, "process list without a resource");
+    ret = mx_object_get_info(mx_process_self(), MX_INFO_PROCESS_LIST,
+                             sizeof(mx_record_process_list_t), list, list_size);
+    EXPECT_EQ(ERR_WRONG_TYPE, ret, "process list with a process handle");
+    free(list);
+
+    // the vmo topic needs a vmo handle
+    ret = mx_object_get_info(mx_process_self(), MX_INFO_VMO, sizeof(info.rec), &info, sizeof(info));
+    EXPECT_EQ(ERR_WRONG_TYPE, ret, "vmo info on a process");
+
+    status = mx_handle_close(vmo);
+    EXPECT_EQ(NO_ERROR, status, "handle_close");
+
+    END_TEST;
+}
+
+bool vmo_decommit_test() {
+    BEGIN_TEST;
+
+    mx_status_t status;
+    const size_t size = 16384;
+
+    mx_handle_t vmo = mx_vmo_create(size);
+    EXPECT_LT(0, vmo, "vm_object_create");
+
+    uintptr_t ptr;
+    status = mx_process_map_vm(mx_process_self(), vmo, 0, size, &ptr,
+                               MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE);
+    EXPECT_EQ(NO_ERROR, status, "vm_map");
+    memset((void*)ptr, 0x5a, size);
+
+    // drop the middle two pages
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_DECOMMIT, 4096, 8192, nullptr, 0);
+    EXPECT_EQ(NO_ERROR, status, "decommit");
+
+    mx_info_vmo_t info;
+    mx_ssize_t ret = mx_object_get_info(vmo, MX_INFO_VMO, sizeof(info.rec), &info, sizeof(info));
+    EXPECT_EQ((mx_ssize_t)sizeof(info), ret, "get_info");
+    EXPECT_EQ(size - 8192, info.rec.committed_bytes, "committed after decommit");
+
+    // the decommitted pages read back as zero through the mapping, the rest is untouched
+    const uint8_t* p = (const uint8_t*)ptr;
+    EXPECT_EQ(0x5a, p[0], "first page");
+    EXPECT_EQ(0, p[4096], "second page");
+    EXPECT_EQ(0, p[8191 + 4096], "third page");
+    EXPECT_EQ(0x5a, p[size - 1], "last page");
+
+    // and can be written again
+    memset((void*)(ptr + 4096), 0x33, 4096);
+    EXPECT_EQ(0x33, p[4096], "second page rewritten");
+
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_DECOMMIT, size, 4096, nullptr, 0);
+    EXPECT_EQ(ERR_OUT_OF_RANGE, status, "decommit past the end");
+
+    status = mx_process_unmap_vm(mx_process_self(), ptr, 0);
+    EXPECT_EQ(NO_ERROR, status, "vm_unmap");
+
+    // decommit needs write rights
+    mx_handle_t ro = mx_handle_duplicate(vmo, MX_RIGHT_READ | MX_RIGHT_TRANSFER);
+    EXPECT_LT(0, ro, "handle_duplicate");
+    status = mx_vmo_op_range(ro, MX_VMO_OP_DECOMMIT, 0, size, nullptr, 0);
+    EXPECT_EQ(ERR_ACCESS_DENIED, status, "decommit without write");
+    EXPECT_EQ(NO_ERROR, mx_handle_close(ro), "handle_close");
+
+    status = mx_handle_close(vmo);
+    EXPECT_EQ(NO_ERROR, status, "handle_close");
+
+    END_TEST;
+}
+
+static mx_rights_t get_rights(mx_handle_t handle) {
+    mx_info_handle_basic_t info;
+    mx_ssize_t ret = mx_object_get_info(handle, MX_INFO_HANDLE_BASIC, sizeof(info.rec),
+                                        &info, sizeof(info));
+    return ret == (mx_ssize_t)sizeof(info) ? info.rec.rights : 0;
+}
+
+bool vmo_clone_rights_test() {
+    BEGIN_TEST;
+
+    const size_t size = PAGE_SIZE;
+    mx_handle_t vmo = mx_vmo_create(size);
+    EXPECT_LT(0, vmo, "vm_object_create");
+
+    // cloning takes read and duplicate rights
+    mx_handle_t ro = mx_handle_duplicate(vmo, MX_RIGHT_READ);
+    EXPECT_LT(0, ro, "handle_duplicate");
+    mx_handle_t clone = mx_vmo_clone(ro, MX_VMO_CLONE_COPY_ON_WRITE, 0, size);
+    EXPECT_EQ(ERR_ACCESS_DENIED, clone, "clone without duplicate");
+    EXPECT_EQ(NO_ERROR, mx_handle_close(ro), "handle_close");
+
+    // the clone may be written, but gets nothing else the source lacked
+    ro = mx_handle_duplicate(vmo, MX_RIGHT_READ | MX_RIGHT_DUPLICATE);
+    EXPECT_LT(0, ro, "handle_duplicate");
+    clone = mx_vmo_clone(ro, MX_VMO_CLONE_COPY_ON_WRITE, 0, size);
+    EXPECT_LT(0, clone, "vmo_clone");
+    EXPECT_EQ(MX_RIGHT_READ | MX_RIGHT_DUPLICATE | MX_RIGHT_WRITE, get_rights(clone),
+              "clone rights");
+
+    char buf[16] = "clone";
+    EXPECT_EQ((mx_ssize_t)sizeof(buf), mx_vmo_write(clone, buf, 0, sizeof(buf)), "write clone");
+    uintptr_t ptr;
+    EXPECT_EQ(ERR_ACCESS_DENIED,
+              mx_process_map_vm(mx_process_self(), clone, 0, size, &ptr, MX_VM_FLAG_PERM_READ),
+              "map clone");
+
+    EXPECT_EQ(NO_ERROR, mx_handle_close(clone), "handle_close");
+    EXPECT_EQ(NO_ERROR, mx_handle_close(ro), "handle_close");
+    EXPECT_EQ(NO_ERROR, mx_handle_close(vmo), "handle_close");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(vmo_tests)
 RUN_TEST(vmo_create_test);
 RUN_TEST(vmo_read_write_test);
@@ -336,6 +667,11 @@ RUN_TEST(vmo_read_only_map_test);
 RUN_TEST(vmo_resize_test);
 RUN_TEST(vmo_rights_test);
 RUN_TEST(vmo_lookup_test);
+RUN_TEST(vmo_willneed_test);
+RUN_TEST(vmo_pager_test);
+RUN_TEST(vmo_info_test);
+RUN_TEST(vmo_decommit_test);
+RUN_TEST(vmo_clone_rights_test);
 END_TEST_CASE(vmo_tests)
 
 int main(int argc, char** argv) {
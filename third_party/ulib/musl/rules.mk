@@ -361,6 +361,7 @@ LOCAL_SRCS := \
     $(LOCAL_DIR)/src/malloc/malloc_usable_size.c \
     $(LOCAL_DIR)/src/malloc/memalign.c \
     $(LOCAL_DIR)/src/malloc/posix_memalign.c \
+    $(LOCAL_DIR)/src/malloc/slab_malloc.c \
     $(LOCAL_DIR)/src/math/__expo2.c \
     $(LOCAL_DIR)/src/math/__expo2f.c \
     $(LOCAL_DIR)/src/math/__fpclassify.c \
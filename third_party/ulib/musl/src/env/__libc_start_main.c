@@ -19,6 +19,8 @@ __attribute__((__weak__, __visibility__("hidden"))) extern void (*const __init_a
 static void dummy1(void* p) {}
 weak_alias(dummy1, __init_ssp);
 
+weak_alias(dummy, __init_string_features);
+
 void __init_security(void) {
 // TODO(kulakowski) Re-enable this once we have file descriptors up.
 #if 0
@@ -56,6 +58,8 @@ void* __libc_intercept_arg(void*) __attribute__((weak));
 
 _Noreturn void __libc_start_main(int (*main)(int, char**, char**),
                                  uintptr_t stack_end, void* arg) {
+    __init_string_features();
+
     if (&__libc_intercept_arg != NULL)
         arg = __libc_intercept_arg(arg);
 
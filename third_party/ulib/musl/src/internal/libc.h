@@ -43,6 +43,11 @@ extern struct __libc __libc ATTR_LIBC_VISIBILITY;
 #define libc __libc
 
 extern size_t __hwcap ATTR_LIBC_VISIBILITY;
+
+// Picks the string routine variants for this CPU, on arches that have more
+// than one.  Until it runs they use the baseline ones.
+void __init_string_features(void) ATTR_LIBC_VISIBILITY;
+
 extern char *__progname, *__progname_full;
 
 int __lockfile(FILE*) ATTR_LIBC_VISIBILITY;
@@ -27,3 +27,21 @@ struct chunk {
 
 void __donate_heap(void* start, void* end)
     __attribute__((visibility("hidden")));
+
+// The chunk allocator in malloc.c. It serves the allocations that are too
+// big or too aligned for the slab allocator in slab_malloc.c, which provides
+// the public malloc and free.
+void* __chunk_malloc(size_t) __attribute__((visibility("hidden")));
+void* __chunk_malloc0(size_t) __attribute__((visibility("hidden")));
+void* __chunk_realloc(void*, size_t) __attribute__((visibility("hidden")));
+void __chunk_free(void*) __attribute__((visibility("hidden")));
+
+// Alignment of everything the slab allocator hands out.
+#define SLAB_ALIGN 16
+
+// Whether p was allocated by the slab allocator, and if so how big it is.
+int __slab_owns(const void* p) __attribute__((visibility("hidden")));
+size_t __slab_usable_size(const void* p) __attribute__((visibility("hidden")));
+
+// Gives the calling thread's cached blocks back before it exits.
+void __malloc_thread_cleanup(void) __attribute__((visibility("hidden")));
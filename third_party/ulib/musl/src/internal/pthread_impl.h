@@ -44,6 +44,7 @@ struct pthread {
     char* dlerror_buf;
     int dlerror_flag;
     void* stdio_locks;
+    void* malloc_tcache;
     uintptr_t canary_at_end;
     void** dtv_copy;
     mxr_thread_t* mxr_thread;
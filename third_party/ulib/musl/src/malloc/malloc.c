@@ -266,6 +266,8 @@ static int pretrim(struct chunk* self, size_t n, int i, int j) {
     return 1;
 }
 
+static void internal_free(void* p);
+
 static void trim(struct chunk* self, size_t n) {
     size_t n1 = CHUNK_SIZE(self);
     struct chunk *next, *split;
@@ -281,10 +283,10 @@ static void trim(struct chunk* self, size_t n) {
     next->psize = n1 - n | C_INUSE;
     self->csize = n | C_INUSE;
 
-    free(CHUNK_TO_MEM(split));
+    internal_free(CHUNK_TO_MEM(split));
 }
 
-void* malloc(size_t n) {
+void* __chunk_malloc(size_t n) {
     struct chunk* c;
     int i, j;
 
@@ -335,8 +337,8 @@ void* malloc(size_t n) {
     return CHUNK_TO_MEM(c);
 }
 
-void* __malloc0(size_t n) {
-    void* p = malloc(n);
+void* __chunk_malloc0(size_t n) {
+    void* p = __chunk_malloc(n);
     if (p && !IS_MMAPPED(MEM_TO_CHUNK(p))) {
         size_t* z;
         n = (n + sizeof *z - 1) / sizeof *z;
@@ -347,13 +349,13 @@ void* __malloc0(size_t n) {
     return p;
 }
 
-void* realloc(void* p, size_t n) {
+void* __chunk_realloc(void* p, size_t n) {
     struct chunk *self, *next;
     size_t n0, n1;
     void* new;
 
     if (!p)
-        return malloc(n);
+        return __chunk_malloc(n);
 
     if (adjust_size(&n) < 0)
         return 0;
@@ -369,9 +371,9 @@ void* realloc(void* p, size_t n) {
         /* Crash on realloc of freed chunk */
         if (extra & 1)
             a_crash();
-        if (newlen < PAGE_SIZE && (new = malloc(n))) {
+        if (newlen < PAGE_SIZE && (new = __chunk_malloc(n))) {
             memcpy(new, p, n - OVERHEAD);
-            free(p);
+            internal_free(p);
             return new;
         }
         newlen = (newlen + PAGE_SIZE - 1) & -PAGE_SIZE;
@@ -414,16 +416,16 @@ void* realloc(void* p, size_t n) {
     }
 
     /* As a last resort, allocate a new chunk and copy to it. */
-    new = malloc(n - OVERHEAD);
+    new = __chunk_malloc(n - OVERHEAD);
     if (!new)
         return 0;
     memcpy(new, p, n0 - OVERHEAD);
-    free(CHUNK_TO_MEM(self));
+    internal_free(CHUNK_TO_MEM(self));
     return new;
 }
 
 // This is static so __donate_heap (below) can call it without PLT
-// indirection.  The public name free is an alias for this.
+// indirection.  __chunk_free is an alias for this.
 static void internal_free(void* p) {
     struct chunk* self = MEM_TO_CHUNK(p);
     struct chunk* next;
@@ -512,7 +514,7 @@ static void internal_free(void* p) {
     unlock_bin(i);
 }
 
-void free(void*) __attribute__((alias("internal_free")));
+void __chunk_free(void*) __attribute__((alias("internal_free")));
 
 // "Donate" a memory block to the heap by setting up a minimal malloc
 // structure and then freeing it.
@@ -4,5 +4,7 @@
 void* (*const __realloc_dep)(void*, size_t) = realloc;
 
 size_t malloc_usable_size(void* p) {
+    if (__slab_owns(p))
+        return __slab_usable_size(p);
     return p ? CHUNK_SIZE(MEM_TO_CHUNK(p)) - OVERHEAD : 0;
 }
@@ -1,11 +1,13 @@
 #include "libc.h"
+#include "malloc_impl.h"
 #include <errno.h>
 #include <stdint.h>
 #include <stdlib.h>
 
 /* This function should work with most dlmalloc-like chunk bookkeeping
  * systems, but it's only guaranteed to work with the native implementation
- * used in this library. */
+ * used in this library. Alignments the slab allocator can't promise are
+ * served by the chunk allocator. */
 
 void* __memalign(size_t align, size_t len) {
     unsigned char *mem, *new, *end;
@@ -21,13 +23,16 @@ void* __memalign(size_t align, size_t len) {
         return NULL;
     }
 
+    if (align <= SLAB_ALIGN)
+        return malloc(len);
+
     if (align <= 4 * sizeof(size_t)) {
-        if (!(mem = malloc(len)))
+        if (!(mem = __chunk_malloc(len)))
             return NULL;
         return mem;
     }
 
-    if (!(mem = malloc(len + align - 1)))
+    if (!(mem = __chunk_malloc(len + align - 1)))
         return NULL;
 
     new = (void*)((uintptr_t)mem + align - 1 & -align);
@@ -50,7 +55,7 @@ void* __memalign(size_t align, size_t len) {
     ((size_t*)new)[-1] = header & 7 | end - new;
     ((size_t*)end)[-2] = footer & 7 | end - new;
 
-    free(mem);
+    __chunk_free(mem);
     return new;
 }
 
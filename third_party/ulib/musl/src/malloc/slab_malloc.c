@@ -0,0 +1,414 @@
+#include "libc.h"
+#include "malloc_impl.h"
+#include "pthread_impl.h"
+#include <magenta/syscalls.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+// Thread-caching slab allocator.
+//
+// Allocations of up to SLAB_MAX_SIZE bytes are rounded up to one of
+// NUM_CLASSES size classes and carved out of 64k spans, each of which holds
+// objects of a single class. Spans live in a fixed range of the address space
+// backed by one VMO per 4M arena, so telling slab blocks from chunk allocator
+// blocks is a single range check.
+//
+// Every thread keeps a LIFO list of free blocks per class. malloc and free
+// only touch that list; it is refilled from and spilled back to the class's
+// spans in batches, under the class lock. A span with nothing in use is
+// decommitted and put back in the pool of free spans, except for one per
+// class that is kept around to absorb alloc/free churn at a span boundary.
+//
+// Anything bigger, or more aligned than SLAB_ALIGN, goes to the chunk
+// allocator in malloc.c, as does everything if the slab range can't be
+// mapped.
+
+#define SPAN_SIZE ((size_t)64 << 10)
+#define ARENA_SIZE ((size_t)4 << 20)
+#if _LP64
+// Far above the chunk allocator's heap, which starts at 1TB.
+#define SLAB_BASE ((uintptr_t)1 << 41)
+#define SLAB_SIZE ((size_t)1 << 30)
+#else
+#define SLAB_BASE ((uintptr_t)0x60000000)
+#define SLAB_SIZE ((size_t)1 << 28)
+#endif
+#define NUM_ARENAS (SLAB_SIZE / ARENA_SIZE)
+#define NUM_SPANS (SLAB_SIZE / SPAN_SIZE)
+
+#define SLAB_MAX_SIZE 2048
+#define NUM_CLASSES 24
+
+// A thread caches at most this many bytes' worth of blocks of each class,
+// within [TCACHE_MIN, TCACHE_MAX] blocks.
+#define TCACHE_CLASS_BYTES 16384
+#define TCACHE_MIN 8
+#define TCACHE_MAX 64
+
+// malloc_tcache of a thread that has exited, or is exiting.
+#define TCACHE_DEAD ((struct tcache*)1)
+
+#define FREE_FILL 0x77
+
+// 16 byte steps up to 128, then four classes per power of two.
+static const uint16_t class_size[NUM_CLASSES] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256, 320, 384, 448, 512,
+    640, 768, 896, 1024, 1280, 1536, 1792, 2048,
+};
+
+// Lives at the start of every span. The objects follow it.
+struct span {
+    struct span* next;  // in the class's partial list
+    struct span* prev;
+    void* free_list;    // objects given back to the span
+    char* bump;         // objects from here to end have never been handed out
+    char* end;
+    uint32_t in_use;    // objects handed out of the span
+    uint16_t size_class;
+    bool partial;       // on the class's partial list
+};
+
+#define SPAN_HEADER_SIZE 64
+_Static_assert(sizeof(struct span) <= SPAN_HEADER_SIZE, "span header too big");
+_Static_assert(SPAN_HEADER_SIZE % SLAB_ALIGN == 0, "span header misaligns objects");
+
+struct size_class {
+    mtx_t lock;
+    struct span* partial;  // spans with objects to hand out
+    struct span* empty;    // a span with nothing in use, not on the partial list
+};
+
+struct tcache {
+    void* lists[NUM_CLASSES];
+    uint32_t counts[NUM_CLASSES];
+};
+
+static struct size_class classes[NUM_CLASSES];
+
+static struct {
+    mtx_t lock;
+    bool failed;                      // the slab range could not be mapped
+    size_t top;                       // offset of the first span never handed out
+    size_t num_free;                  // entries in free_spans
+    uint16_t free_spans[NUM_SPANS];   // decommitted spans, by index
+    mx_handle_t arenas[NUM_ARENAS];   // the VMO behind each arena
+} slab;
+
+static inline int size_to_class(size_t n) {
+    if (n <= 128)
+        return n ? (int)((n - 1) >> 4) : 0;
+    size_t m = n - 1;
+    int order = (int)(8 * sizeof(long)) - 1 - __builtin_clzl(m);
+    return 8 + (order - 7) * 4 + (int)((m >> (order - 2)) & 3);
+}
+
+static inline struct span* span_of(const void* p) {
+    return (struct span*)((uintptr_t)p & -SPAN_SIZE);
+}
+
+static inline uint32_t tcache_limit(int c) {
+    uint32_t n = TCACHE_CLASS_BYTES / class_size[c];
+    return n < TCACHE_MIN ? TCACHE_MIN : (n > TCACHE_MAX ? TCACHE_MAX : n);
+}
+
+int __slab_owns(const void* p) {
+    return (uintptr_t)p - SLAB_BASE < SLAB_SIZE;
+}
+
+size_t __slab_usable_size(const void* p) {
+    return class_size[span_of(p)->size_class];
+}
+
+// Called with slab.lock held.
+static bool map_arena(size_t index) {
+    mx_handle_t vmo = _mx_vmo_create(ARENA_SIZE);
+    if (vmo < 0)
+        return false;
+    uintptr_t addr = SLAB_BASE + index * ARENA_SIZE;
+    mx_status_t status = _mx_process_map_vm(
+        libc.proc, vmo, 0, ARENA_SIZE, &addr,
+        MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE | MX_VM_FLAG_FIXED);
+    if (status < 0) {
+        _mx_handle_close(vmo);
+        return false;
+    }
+    // Kept open for decommitting spans.
+    slab.arenas[index] = vmo;
+    return true;
+}
+
+static struct span* span_alloc(void) {
+    struct span* span = NULL;
+    mtx_lock(&slab.lock);
+    if (slab.num_free > 0) {
+        span = (struct span*)(SLAB_BASE + slab.free_spans[--slab.num_free] * SPAN_SIZE);
+    } else if (slab.top < SLAB_SIZE && !slab.failed) {
+        if (slab.top % ARENA_SIZE != 0 || map_arena(slab.top / ARENA_SIZE)) {
+            span = (struct span*)(SLAB_BASE + slab.top);
+            slab.top += SPAN_SIZE;
+        } else if (slab.top == 0) {
+            // Someone else has the range; don't keep trying.
+            slab.failed = true;
+        }
+    }
+    mtx_unlock(&slab.lock);
+    return span;
+}
+
+static void span_release(struct span* span) {
+    size_t offset = (uintptr_t)span - SLAB_BASE;
+    _mx_vmo_op_range(slab.arenas[offset / ARENA_SIZE], MX_VMO_OP_DECOMMIT,
+                     offset % ARENA_SIZE, SPAN_SIZE, NULL, 0);
+    mtx_lock(&slab.lock);
+    slab.free_spans[slab.num_free++] = (uint16_t)(offset / SPAN_SIZE);
+    mtx_unlock(&slab.lock);
+}
+
+static void span_init(struct span* span, int c) {
+    size_t size = class_size[c];
+    span->next = span->prev = NULL;
+    span->free_list = NULL;
+    span->bump = (char*)span + SPAN_HEADER_SIZE;
+    span->end = span->bump + (SPAN_SIZE - SPAN_HEADER_SIZE) / size * size;
+    span->in_use = 0;
+    span->size_class = (uint16_t)c;
+    span->partial = false;
+}
+
+static void partial_push(struct size_class* sc, struct span* span) {
+    span->prev = NULL;
+    span->next = sc->partial;
+    if (sc->partial)
+        sc->partial->prev = span;
+    sc->partial = span;
+    span->partial = true;
+}
+
+static void partial_remove(struct size_class* sc, struct span* span) {
+    if (span->prev)
+        span->prev->next = span->next;
+    else
+        sc->partial = span->next;
+    if (span->next)
+        span->next->prev = span->prev;
+    span->next = span->prev = NULL;
+    span->partial = false;
+}
+
+// Takes up to count objects of class c from its spans, linked through their
+// first words. Returns how many it got.
+static size_t central_alloc(int c, size_t count, void** head) {
+    struct size_class* sc = &classes[c];
+    size_t size = class_size[c];
+    void* list = NULL;
+    size_t got = 0;
+
+    mtx_lock(&sc->lock);
+    while (got < count) {
+        struct span* span = sc->partial;
+        if (span == NULL) {
+            span = sc->empty;
+            sc->empty = NULL;
+            if (span == NULL) {
+                span = span_alloc();
+                if (span == NULL)
+                    break;
+                span_init(span, c);
+            }
+            partial_push(sc, span);
+        }
+
+        while (got < count) {
+            void* obj;
+            if (span->free_list) {
+                obj = span->free_list;
+                span->free_list = *(void**)obj;
+            } else if (span->bump < span->end) {
+                obj = span->bump;
+                span->bump += size;
+            } else {
+                break;
+            }
+            *(void**)obj = list;
+            list = obj;
+            span->in_use++;
+            got++;
+        }
+        if (span->free_list == NULL && span->bump == span->end)
+            partial_remove(sc, span);
+    }
+    mtx_unlock(&sc->lock);
+
+    *head = list;
+    return got;
+}
+
+// Gives a list of objects of class c back to their spans.
+static void central_free(int c, void* list) {
+    struct size_class* sc = &classes[c];
+    struct span* release = NULL;
+
+    mtx_lock(&sc->lock);
+    while (list) {
+        void* obj = list;
+        list = *(void**)obj;
+
+        struct span* span = span_of(obj);
+        *(void**)obj = span->free_list;
+        span->free_list = obj;
+        span->in_use--;
+        if (span->in_use == 0) {
+            if (span->partial)
+                partial_remove(sc, span);
+            if (sc->empty == NULL) {
+                sc->empty = span;
+            } else {
+                span->next = release;
+                release = span;
+            }
+        } else if (!span->partial) {
+            partial_push(sc, span);
+        }
+    }
+    mtx_unlock(&sc->lock);
+
+    // Decommitting takes a syscall, so do it outside the class lock.
+    while (release) {
+        struct span* span = release;
+        release = span->next;
+        span_release(span);
+    }
+}
+
+static struct tcache* tcache_get(void) {
+    // Too early in startup to have a thread pointer.
+    if (mxr_tp_get() == NULL)
+        return NULL;
+
+    pthread_t self = __pthread_self();
+    struct tcache* tc = self->malloc_tcache;
+    if (tc == TCACHE_DEAD)
+        return NULL;
+    if (tc == NULL) {
+        void* mem;
+        if (!central_alloc(size_to_class(sizeof(struct tcache)), 1, &mem))
+            return NULL;
+        tc = mem;
+        memset(tc, 0, sizeof(*tc));
+        self->malloc_tcache = tc;
+    }
+    return tc;
+}
+
+static void* slab_alloc(int c) {
+    struct tcache* tc = tcache_get();
+    void* obj;
+    if (tc == NULL)
+        return central_alloc(c, 1, &obj) ? obj : NULL;
+
+    obj = tc->lists[c];
+    if (obj) {
+        tc->lists[c] = *(void**)obj;
+        tc->counts[c]--;
+        return obj;
+    }
+
+    size_t got = central_alloc(c, tcache_limit(c) / 2, &obj);
+    if (!got)
+        return NULL;
+    tc->lists[c] = *(void**)obj;
+    tc->counts[c] = got - 1;
+    return obj;
+}
+
+static void slab_free(void* p) {
+    int c = span_of(p)->size_class;
+#if LK_DEBUGLEVEL > 1
+    memset(p, FREE_FILL, class_size[c]);
+#endif
+
+    struct tcache* tc = tcache_get();
+    if (tc == NULL) {
+        *(void**)p = NULL;
+        central_free(c, p);
+        return;
+    }
+
+    *(void**)p = tc->lists[c];
+    tc->lists[c] = p;
+    uint32_t limit = tcache_limit(c);
+    if (++tc->counts[c] <= limit)
+        return;
+
+    // Keep the most recently freed half, which is likeliest to be warm.
+    void* last = p;
+    for (uint32_t i = 1; i < limit / 2; i++)
+        last = *(void**)last;
+    void* spill = *(void**)last;
+    *(void**)last = NULL;
+    tc->counts[c] = limit / 2;
+    central_free(c, spill);
+}
+
+void __malloc_thread_cleanup(void) {
+    pthread_t self = __pthread_self();
+    struct tcache* tc = self->malloc_tcache;
+    self->malloc_tcache = TCACHE_DEAD;
+    if (tc == NULL || tc == TCACHE_DEAD)
+        return;
+
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        if (tc->lists[c])
+            central_free(c, tc->lists[c]);
+    }
+    *(void**)tc = NULL;
+    central_free(size_to_class(sizeof(struct tcache)), tc);
+}
+
+void* malloc(size_t n) {
+    if (n <= SLAB_MAX_SIZE && !slab.failed) {
+        void* p = slab_alloc(size_to_class(n));
+        if (p)
+            return p;
+    }
+    return __chunk_malloc(n);
+}
+
+void* __malloc0(size_t n) {
+    if (n <= SLAB_MAX_SIZE && !slab.failed) {
+        void* p = slab_alloc(size_to_class(n));
+        if (p) {
+            memset(p, 0, n);
+            return p;
+        }
+    }
+    return __chunk_malloc0(n);
+}
+
+void* realloc(void* p, size_t n) {
+    if (!p)
+        return malloc(n);
+    if (!__slab_owns(p))
+        return __chunk_realloc(p, n);
+
+    size_t old = __slab_usable_size(p);
+    if (n <= old)
+        return p;
+    void* new = malloc(n);
+    if (!new)
+        return NULL;
+    memcpy(new, p, old);
+    slab_free(p);
+    return new;
+}
+
+void free(void* p) {
+    if (__slab_owns(p))
+        slab_free(p);
+    else
+        __chunk_free(p);
+}
@@ -0,0 +1,42 @@
+// memchr for arm64.  Like strlen.s, scans aligned 16 byte blocks, clearing
+// mask bits for bytes before the start of the buffer in the first block and
+// rejecting matches past its end in the last.  x2 counts the bytes left from
+// the start of the current block.
+
+.text
+.global memchr
+.type memchr,%function
+memchr:
+	cbz x2, .Lnull
+	dup v1.16b, w1
+	and x3, x0, #15
+	and x4, x0, #-16
+	adds x2, x2, x3
+	b.cc 1f
+	mov x2, #-1
+1:	ldr q0, [x4]
+	cmeq v0.16b, v0.16b, v1.16b
+	shrn v0.8b, v0.8h, #4
+	fmov x5, d0
+	lsl x3, x3, #2
+	lsr x5, x5, x3
+	lsl x5, x5, x3
+	cbnz x5, 2f
+1:	subs x2, x2, #16
+	b.ls .Lnull
+	add x4, x4, #16
+	ldr q0, [x4]
+	cmeq v0.16b, v0.16b, v1.16b
+	shrn v0.8b, v0.8h, #4
+	fmov x5, d0
+	cbz x5, 1b
+2:	rbit x5, x5
+	clz x5, x5
+	lsr x5, x5, #2
+	cmp x5, x2
+	b.hs .Lnull
+	add x0, x4, x5
+	ret
+.Lnull:
+	mov x0, #0
+	ret
@@ -0,0 +1,94 @@
+// memcmp for arm64.  Compares 16 bytes at a time with NEON, finishing with
+// an overlapping compare of the last 16.  Shorter buffers are compared as
+// overlapping 8 or 4 byte words, byte reversed so an unsigned comparison
+// orders them like the bytes.
+
+.text
+.global memcmp
+.type memcmp,%function
+memcmp:
+	cmp x2, #16
+	b.hs .Lge16
+	add x5, x0, x2
+	add x6, x1, x2
+	cmp x2, #8
+	b.lo 1f
+	ldr x3, [x0]
+	ldr x4, [x1]
+	cmp x3, x4
+	b.ne 2f
+	ldr x3, [x5, #-8]
+	ldr x4, [x6, #-8]
+	cmp x3, x4
+	b.ne 2f
+	mov w0, #0
+	ret
+2:	rev x3, x3
+	rev x4, x4
+	cmp x3, x4
+	mov w0, #1
+	cneg w0, w0, lo
+	ret
+1:	tbz x2, #2, 1f
+	ldr w3, [x0]
+	ldr w4, [x1]
+	cmp w3, w4
+	b.ne 2f
+	ldr w3, [x5, #-4]
+	ldr w4, [x6, #-4]
+	cmp w3, w4
+	b.ne 2f
+	mov w0, #0
+	ret
+2:	rev w3, w3
+	rev w4, w4
+	cmp w3, w4
+	mov w0, #1
+	cneg w0, w0, lo
+	ret
+1:	cbz x2, 2f
+1:	ldrb w3, [x0], #1
+	ldrb w4, [x1], #1
+	subs w3, w3, w4
+	b.ne 3f
+	subs x2, x2, #1
+	b.ne 1b
+2:	mov w0, #0
+	ret
+3:	mov w0, w3
+	ret
+
+.Lge16:
+	add x5, x0, x2
+	add x6, x1, x2
+	sub x5, x5, #16
+	sub x6, x6, #16
+1:	ldr q0, [x0]
+	ldr q1, [x1]
+	cmeq v0.16b, v0.16b, v1.16b
+	not v0.16b, v0.16b
+	shrn v0.8b, v0.8h, #4
+	fmov x3, d0
+	cbnz x3, 2f
+	add x0, x0, #16
+	add x1, x1, #16
+	cmp x0, x5
+	b.lo 1b
+	mov x0, x5
+	mov x1, x6
+	ldr q0, [x0]
+	ldr q1, [x1]
+	cmeq v0.16b, v0.16b, v1.16b
+	not v0.16b, v0.16b
+	shrn v0.8b, v0.8h, #4
+	fmov x3, d0
+	cbnz x3, 2f
+	mov w0, #0
+	ret
+2:	rbit x3, x3
+	clz x3, x3
+	lsr x3, x3, #2
+	ldrb w4, [x0, x3]
+	ldrb w5, [x1, x3]
+	sub w0, w4, w5
+	ret
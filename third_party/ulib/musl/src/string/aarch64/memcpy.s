@@ -0,0 +1,76 @@
+// memcpy for arm64.  Copies of up to 64 bytes use overlapping unaligned
+// loads and stores from both ends.  Longer copies load the first 16 and last
+// 64 bytes up front, copy the middle 64 bytes at a time to 16 byte aligned
+// destinations, and store the ends last.
+
+.text
+.global memcpy
+.type memcpy,%function
+memcpy:
+	add x4, x1, x2
+	add x5, x0, x2
+	cmp x2, #16
+	b.hi .Lgt16
+	cmp x2, #8
+	b.lo 1f
+	ldr x6, [x1]
+	ldr x7, [x4, #-8]
+	str x6, [x0]
+	str x7, [x5, #-8]
+	ret
+1:	tbz x2, #2, 1f
+	ldr w6, [x1]
+	ldr w7, [x4, #-4]
+	str w6, [x0]
+	str w7, [x5, #-4]
+	ret
+1:	cbz x2, 2f
+	lsr x3, x2, #1
+	ldrb w6, [x1]
+	ldrb w7, [x4, #-1]
+	ldrb w8, [x1, x3]
+	strb w6, [x0]
+	strb w8, [x0, x3]
+	strb w7, [x5, #-1]
+2:	ret
+
+.Lgt16:
+	cmp x2, #32
+	b.hi 1f
+	ldr q0, [x1]
+	ldr q1, [x4, #-16]
+	str q0, [x0]
+	str q1, [x5, #-16]
+	ret
+1:	cmp x2, #64
+	b.hi .Lgt64
+	ldp q0, q1, [x1]
+	ldp q2, q3, [x4, #-32]
+	stp q0, q1, [x0]
+	stp q2, q3, [x5, #-32]
+	ret
+
+.Lgt64:
+	ldr q4, [x1]
+	ldp q5, q6, [x4, #-64]
+	ldp q7, q16, [x4, #-32]
+	and x3, x0, #15
+	mov x6, #16
+	sub x3, x6, x3
+	add x1, x1, x3
+	add x6, x0, x3
+	sub x2, x2, x3
+1:	cmp x2, #64
+	b.ls 2f
+	ldp q0, q1, [x1]
+	ldp q2, q3, [x1, #32]
+	stp q0, q1, [x6]
+	stp q2, q3, [x6, #32]
+	add x1, x1, #64
+	add x6, x6, #64
+	sub x2, x2, #64
+	b 1b
+2:	stp q5, q6, [x5, #-64]
+	stp q7, q16, [x5, #-32]
+	str q4, [x0]
+	ret
@@ -0,0 +1,54 @@
+// memset for arm64.  Fills of up to 64 bytes use overlapping stores from
+// both ends.  Longer fills store both ends unaligned and the middle 64 bytes
+// at a time to 16 byte aligned addresses.
+
+.text
+.global memset
+.type memset,%function
+memset:
+	dup v0.16b, w1
+	add x5, x0, x2
+	cmp x2, #16
+	b.hi .Lgt16
+	fmov x6, d0
+	cmp x2, #8
+	b.lo 1f
+	str x6, [x0]
+	str x6, [x5, #-8]
+	ret
+1:	tbz x2, #2, 1f
+	str w6, [x0]
+	str w6, [x5, #-4]
+	ret
+1:	cbz x2, 2f
+	strb w1, [x0]
+	strb w1, [x5, #-1]
+	cmp x2, #2
+	b.ls 2f
+	strb w1, [x0, #1]
+2:	ret
+
+.Lgt16:
+	cmp x2, #32
+	b.hi 1f
+	str q0, [x0]
+	str q0, [x5, #-16]
+	ret
+1:	cmp x2, #64
+	b.hi 1f
+	stp q0, q0, [x0]
+	stp q0, q0, [x5, #-32]
+	ret
+1:	str q0, [x0]
+	stp q0, q0, [x5, #-64]
+	stp q0, q0, [x5, #-32]
+	add x6, x0, #16
+	and x6, x6, #-16
+	sub x7, x5, #64
+1:	cmp x6, x7
+	b.hs 2f
+	stp q0, q0, [x6]
+	stp q0, q0, [x6, #32]
+	add x6, x6, #64
+	b 1b
+2:	ret
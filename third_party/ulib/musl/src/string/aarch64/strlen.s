@@ -0,0 +1,32 @@
+// strlen for arm64.  Scans aligned 16 byte blocks for a zero byte, which
+// never reads across a page boundary.  shrn packs each block's compare
+// result into a 64-bit mask with four bits per byte.
+
+.text
+.global strlen
+.type strlen,%function
+strlen:
+	and x3, x0, #15
+	and x1, x0, #-16
+	ldr q0, [x1]
+	cmeq v0.16b, v0.16b, #0
+	shrn v0.8b, v0.8h, #4
+	fmov x2, d0
+	lsl x3, x3, #2
+	lsr x2, x2, x3
+	cbz x2, 1f
+	rbit x2, x2
+	clz x2, x2
+	lsr x0, x2, #2
+	ret
+1:	add x1, x1, #16
+	ldr q0, [x1]
+	cmeq v0.16b, v0.16b, #0
+	shrn v0.8b, v0.8h, #4
+	fmov x2, d0
+	cbz x2, 1b
+	rbit x2, x2
+	clz x2, x2
+	sub x0, x1, x0
+	add x0, x0, x2, lsr #2
+	ret
@@ -4,8 +4,6 @@ LOCAL_SRCS += \
     $(GET_LOCAL_DIR)/bzero.c \
     $(GET_LOCAL_DIR)/index.c \
     $(GET_LOCAL_DIR)/memccpy.c \
-    $(GET_LOCAL_DIR)/memchr.c \
-    $(GET_LOCAL_DIR)/memcmp.c \
     $(GET_LOCAL_DIR)/memmem.c \
     $(GET_LOCAL_DIR)/mempcpy.c \
     $(GET_LOCAL_DIR)/memrchr.c \
@@ -24,7 +22,6 @@ LOCAL_SRCS += \
     $(GET_LOCAL_DIR)/strerror_r.c \
     $(GET_LOCAL_DIR)/strlcat.c \
     $(GET_LOCAL_DIR)/strlcpy.c \
-    $(GET_LOCAL_DIR)/strlen.c \
     $(GET_LOCAL_DIR)/strncasecmp.c \
     $(GET_LOCAL_DIR)/strncat.c \
     $(GET_LOCAL_DIR)/strncmp.c \
@@ -72,21 +69,31 @@ LOCAL_SRCS += \
 
 ifeq ($(ARCH),arm64)
 LOCAL_SRCS += \
-    $(GET_LOCAL_DIR)/memcpy.c \
+    $(GET_LOCAL_DIR)/aarch64/memchr.s \
+    $(GET_LOCAL_DIR)/aarch64/memcmp.s \
+    $(GET_LOCAL_DIR)/aarch64/memcpy.s \
+    $(GET_LOCAL_DIR)/aarch64/memset.s \
+    $(GET_LOCAL_DIR)/aarch64/strlen.s \
     $(GET_LOCAL_DIR)/memmove.c \
-    $(GET_LOCAL_DIR)/memset.c \
 
 else ifeq ($(ARCH),arm)
 LOCAL_SRCS += \
+    $(GET_LOCAL_DIR)/memchr.c \
+    $(GET_LOCAL_DIR)/memcmp.c \
     $(GET_LOCAL_DIR)/memcpy.c \
     $(GET_LOCAL_DIR)/memmove.c \
     $(GET_LOCAL_DIR)/memset.c \
+    $(GET_LOCAL_DIR)/strlen.c \
 
 else ifeq ($(SUBARCH),x86-64)
 LOCAL_SRCS += \
+    $(GET_LOCAL_DIR)/x86_64/cpu_features.c \
+    $(GET_LOCAL_DIR)/x86_64/memchr.s \
+    $(GET_LOCAL_DIR)/x86_64/memcmp.s \
     $(GET_LOCAL_DIR)/x86_64/memcpy.s \
     $(GET_LOCAL_DIR)/x86_64/memmove.s \
     $(GET_LOCAL_DIR)/x86_64/memset.s \
+    $(GET_LOCAL_DIR)/x86_64/strlen.s \
 
 else
 error Unsupported architecture for musl build!
@@ -0,0 +1,42 @@
+#include "libc.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Bits tested by the string routines in this directory, which use the SSE2
+// baseline until this is set.
+#define X86_STRING_AVX2 1
+#define X86_STRING_ERMS 2
+
+int __x86_string_features ATTR_LIBC_VISIBILITY;
+
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+    __asm__("cpuid"
+            : "=a"(regs[0]), "=b"(regs[1]), "=c"(regs[2]), "=d"(regs[3])
+            : "a"(leaf), "c"(subleaf));
+}
+
+void __init_string_features(void) {
+    uint32_t regs[4];
+    cpuid(0, 0, regs);
+    if (regs[0] < 7)
+        return;
+
+    cpuid(1, 0, regs);
+    // AVX needs the OS to save the ymm registers as well as the CPU to
+    // have it.
+    const uint32_t osxsave_avx = (1u << 27) | (1u << 28);
+    bool ymm_enabled = false;
+    if ((regs[2] & osxsave_avx) == osxsave_avx) {
+        uint32_t xcr0_lo, xcr0_hi;
+        __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        ymm_enabled = (xcr0_lo & 6) == 6;
+    }
+
+    cpuid(7, 0, regs);
+    int features = 0;
+    if (ymm_enabled && (regs[1] & (1u << 5)))
+        features |= X86_STRING_AVX2;
+    if (regs[1] & (1u << 9))
+        features |= X86_STRING_ERMS;
+    __x86_string_features = features;
+}
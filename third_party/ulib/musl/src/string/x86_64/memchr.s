@@ -0,0 +1,79 @@
+# memchr for x86-64.  Like strlen.s, scans aligned 16 byte blocks (32 with
+# AVX2), masking off bytes before the start of the buffer in the first block
+# and rejecting matches past its end in the last.  %rdx counts the bytes
+# left from the start of the current block.
+
+.hidden __x86_string_features
+
+.global memchr
+.type memchr,@function
+memchr:
+	test %rdx,%rdx
+	jz .Lnull
+	testl $1,__x86_string_features(%rip)
+	jnz .Lavx2
+	movd %esi,%xmm0
+	punpcklbw %xmm0,%xmm0
+	punpcklwd %xmm0,%xmm0
+	pshufd $0,%xmm0,%xmm0
+	mov %edi,%ecx
+	and $15,%ecx
+	and $-16,%rdi
+	add %rcx,%rdx
+	jnc 1f
+	mov $-1,%rdx
+1:	movdqa (%rdi),%xmm1
+	pcmpeqb %xmm0,%xmm1
+	pmovmskb %xmm1,%eax
+	mov $-1,%r8d
+	shl %cl,%r8d
+	and %r8d,%eax
+	jnz 2f
+1:	sub $16,%rdx
+	jbe .Lnull
+	add $16,%rdi
+	movdqa (%rdi),%xmm1
+	pcmpeqb %xmm0,%xmm1
+	pmovmskb %xmm1,%eax
+	test %eax,%eax
+	jz 1b
+2:	bsf %eax,%eax
+	cmp %rdx,%rax
+	jae .Lnull
+	add %rdi,%rax
+	ret
+.Lnull:
+	xor %eax,%eax
+	ret
+
+.Lavx2:
+	movd %esi,%xmm0
+	vpbroadcastb %xmm0,%ymm0
+	mov %edi,%ecx
+	and $31,%ecx
+	and $-32,%rdi
+	add %rcx,%rdx
+	jnc 1f
+	mov $-1,%rdx
+1:	vpcmpeqb (%rdi),%ymm0,%ymm1
+	vpmovmskb %ymm1,%eax
+	mov $-1,%r8d
+	shl %cl,%r8d
+	and %r8d,%eax
+	jnz 2f
+1:	sub $32,%rdx
+	jbe 3f
+	add $32,%rdi
+	vpcmpeqb (%rdi),%ymm0,%ymm1
+	vpmovmskb %ymm1,%eax
+	test %eax,%eax
+	jz 1b
+2:	bsf %eax,%eax
+	cmp %rdx,%rax
+	jae 3f
+	add %rdi,%rax
+	vzeroupper
+	ret
+3:	xor %eax,%eax
+	vzeroupper
+	ret
@@ -0,0 +1,87 @@
+# memcmp for x86-64.  Compares 16 bytes at a time with SSE2, finishing with
+# an overlapping compare of the last 16.  Shorter buffers are compared as
+# overlapping 8 or 4 byte words, byte swapped so an unsigned comparison
+# orders them like the bytes.
+
+.global memcmp
+.type memcmp,@function
+memcmp:
+	cmp $16,%rdx
+	jae .Lge16
+	cmp $8,%edx
+	jb 1f
+	mov (%rdi),%rax
+	mov (%rsi),%rcx
+	cmp %rcx,%rax
+	jne 2f
+	mov -8(%rdi,%rdx),%rax
+	mov -8(%rsi,%rdx),%rcx
+	cmp %rcx,%rax
+	jne 2f
+	xor %eax,%eax
+	ret
+2:	bswap %rax
+	bswap %rcx
+	cmp %rcx,%rax
+	sbb %eax,%eax
+	or $1,%eax
+	ret
+1:	cmp $4,%edx
+	jb 1f
+	mov (%rdi),%eax
+	mov (%rsi),%ecx
+	cmp %ecx,%eax
+	jne 2f
+	mov -4(%rdi,%rdx),%eax
+	mov -4(%rsi,%rdx),%ecx
+	cmp %ecx,%eax
+	jne 2f
+	xor %eax,%eax
+	ret
+2:	bswap %eax
+	bswap %ecx
+	cmp %ecx,%eax
+	sbb %eax,%eax
+	or $1,%eax
+	ret
+1:	xor %eax,%eax
+	test %edx,%edx
+	jz 2f
+1:	movzbl (%rdi),%eax
+	movzbl (%rsi),%ecx
+	sub %ecx,%eax
+	jnz 2f
+	inc %rdi
+	inc %rsi
+	dec %edx
+	jnz 1b
+2:	ret
+
+.Lge16:
+	lea -16(%rdi,%rdx),%r8
+	lea -16(%rsi,%rdx),%r9
+1:	movdqu (%rdi),%xmm0
+	movdqu (%rsi),%xmm1
+	pcmpeqb %xmm1,%xmm0
+	pmovmskb %xmm0,%eax
+	xor $0xffff,%eax
+	jnz 2f
+	add $16,%rdi
+	add $16,%rsi
+	cmp %r8,%rdi
+	jb 1b
+	mov %r8,%rdi
+	mov %r9,%rsi
+	movdqu (%rdi),%xmm0
+	movdqu (%rsi),%xmm1
+	pcmpeqb %xmm1,%xmm0
+	pmovmskb %xmm0,%eax
+	xor $0xffff,%eax
+	jnz 2f
+	ret
+2:	bsf %eax,%eax
+	movzbl (%rdi,%rax),%ecx
+	movzbl (%rsi,%rax),%eax
+	sub %eax,%ecx
+	mov %ecx,%eax
+	ret
@@ -1,3 +1,13 @@
+# memcpy for x86-64.  Copies of up to 64 bytes use overlapping unaligned
+# loads and stores from both ends, so they never branch on the exact size.
+# Longer copies load both ends up front, copy the middle with aligned stores
+# and store the ends last.  That keeps __memcpy_fwd safe for memmove when
+# the destination is below the source.  Copies of 2k or more use rep movsb
+# on CPUs with enhanced rep movsb, and AVX2 replaces SSE2 when the CPU has
+# it; see __x86_string_features in cpu_features.c.
+
+.hidden __x86_string_features
+
 .global memcpy
 .global __memcpy_fwd
 .hidden __memcpy_fwd
@@ -5,21 +15,142 @@
 memcpy:
 __memcpy_fwd:
 	mov %rdi,%rax
-	cmp $8,%rdx
-	jc 1f
-	test $7,%edi
+	cmp $16,%rdx
+	ja .Lgt16
+	cmp $8,%edx
+	jb 1f
+	mov (%rsi),%rcx
+	mov -8(%rsi,%rdx),%r8
+	mov %rcx,(%rdi)
+	mov %r8,-8(%rdi,%rdx)
+	ret
+1:	cmp $4,%edx
+	jb 1f
+	mov (%rsi),%ecx
+	mov -4(%rsi,%rdx),%r8d
+	mov %ecx,(%rdi)
+	mov %r8d,-4(%rdi,%rdx)
+	ret
+1:	test %edx,%edx
 	jz 1f
-2:	movsb
-	dec %rdx
-	test $7,%edi
-	jnz 2b
-1:	mov %rdx,%rcx
-	shr $3,%rcx
-	rep
-	movsq
-	and $7,%edx
-	jz 1f
-2:	movsb
-	dec %edx
-	jnz 2b
+	movzbl (%rsi),%ecx
+	movzbl -1(%rsi,%rdx),%r8d
+	lea -1(%rdi,%rdx),%r10
+	shr %edx
+	movzbl (%rsi,%rdx),%r9d
+	mov %cl,(%rdi)
+	mov %r9b,(%rdi,%rdx)
+	mov %r8b,(%r10)
 1:	ret
+
+.Lgt16:
+	cmp $32,%rdx
+	ja 1f
+	movdqu (%rsi),%xmm0
+	movdqu -16(%rsi,%rdx),%xmm1
+	movdqu %xmm0,(%rdi)
+	movdqu %xmm1,-16(%rdi,%rdx)
+	ret
+1:	cmp $64,%rdx
+	ja .Lgt64
+	movdqu (%rsi),%xmm0
+	movdqu 16(%rsi),%xmm1
+	movdqu -32(%rsi,%rdx),%xmm2
+	movdqu -16(%rsi,%rdx),%xmm3
+	movdqu %xmm0,(%rdi)
+	movdqu %xmm1,16(%rdi)
+	movdqu %xmm2,-32(%rdi,%rdx)
+	movdqu %xmm3,-16(%rdi,%rdx)
+	ret
+
+.Lgt64:
+	cmp $2048,%rdx
+	jb 1f
+	testl $2,__x86_string_features(%rip)
+	jz 1f
+	mov %rdx,%rcx
+	rep
+	movsb
+	ret
+1:	testl $1,__x86_string_features(%rip)
+	jnz .Lavx2
+
+	movdqu (%rsi),%xmm4
+	movdqu -64(%rsi,%rdx),%xmm5
+	movdqu -48(%rsi,%rdx),%xmm6
+	movdqu -32(%rsi,%rdx),%xmm7
+	movdqu -16(%rsi,%rdx),%xmm8
+	lea (%rdi,%rdx),%r9
+	lea 16(%rdi),%r8
+	and $-16,%r8
+	sub %rdi,%r8
+	add %r8,%rsi
+	add %r8,%rdi
+	sub %r8,%rdx
+1:	cmp $64,%rdx
+	jbe 2f
+	movdqu (%rsi),%xmm0
+	movdqu 16(%rsi),%xmm1
+	movdqu 32(%rsi),%xmm2
+	movdqu 48(%rsi),%xmm3
+	movdqa %xmm0,(%rdi)
+	movdqa %xmm1,16(%rdi)
+	movdqa %xmm2,32(%rdi)
+	movdqa %xmm3,48(%rdi)
+	add $64,%rsi
+	add $64,%rdi
+	sub $64,%rdx
+	jmp 1b
+2:	movdqu %xmm5,-64(%r9)
+	movdqu %xmm6,-48(%r9)
+	movdqu %xmm7,-32(%r9)
+	movdqu %xmm8,-16(%r9)
+	movdqu %xmm4,(%rax)
+	ret
+
+.Lavx2:
+	cmp $128,%rdx
+	ja 1f
+	vmovdqu (%rsi),%ymm0
+	vmovdqu 32(%rsi),%ymm1
+	vmovdqu -64(%rsi,%rdx),%ymm2
+	vmovdqu -32(%rsi,%rdx),%ymm3
+	vmovdqu %ymm0,(%rdi)
+	vmovdqu %ymm1,32(%rdi)
+	vmovdqu %ymm2,-64(%rdi,%rdx)
+	vmovdqu %ymm3,-32(%rdi,%rdx)
+	vzeroupper
+	ret
+1:	vmovdqu (%rsi),%ymm4
+	vmovdqu -128(%rsi,%rdx),%ymm5
+	vmovdqu -96(%rsi,%rdx),%ymm6
+	vmovdqu -64(%rsi,%rdx),%ymm7
+	vmovdqu -32(%rsi,%rdx),%ymm8
+	lea (%rdi,%rdx),%r9
+	lea 32(%rdi),%r8
+	and $-32,%r8
+	sub %rdi,%r8
+	add %r8,%rsi
+	add %r8,%rdi
+	sub %r8,%rdx
+1:	cmp $128,%rdx
+	jbe 2f
+	vmovdqu (%rsi),%ymm0
+	vmovdqu 32(%rsi),%ymm1
+	vmovdqu 64(%rsi),%ymm2
+	vmovdqu 96(%rsi),%ymm3
+	vmovdqa %ymm0,(%rdi)
+	vmovdqa %ymm1,32(%rdi)
+	vmovdqa %ymm2,64(%rdi)
+	vmovdqa %ymm3,96(%rdi)
+	sub $-128,%rsi
+	sub $-128,%rdi
+	add $-128,%rdx
+	jmp 1b
+2:	vmovdqu %ymm5,-128(%r9)
+	vmovdqu %ymm6,-96(%r9)
+	vmovdqu %ymm7,-64(%r9)
+	vmovdqu %ymm8,-32(%r9)
+	vmovdqu %ymm4,(%rax)
+	vzeroupper
+	ret
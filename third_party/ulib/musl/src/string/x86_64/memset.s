@@ -1,72 +1,113 @@
+# memset for x86-64.  Fills of up to 64 bytes use overlapping stores from
+# both ends.  Longer fills store both ends unaligned and the middle with
+# aligned stores, 64 bytes at a time with SSE2 or 128 with AVX2.  Fills of
+# 2k or more use rep stosb on CPUs with enhanced rep movsb/stosb.
+
+.hidden __x86_string_features
+
 .global memset
 .type memset,@function
 memset:
-	movzbq %sil,%rax
+	movzbl %sil,%ecx
 	mov $0x101010101010101,%r8
-	imul %r8,%rax
-
-	cmp $126,%rdx
-	ja 2f
-
-	test %edx,%edx
+	imul %rcx,%r8
+	mov %rdi,%rax
+	cmp $16,%rdx
+	ja .Lgt16
+	cmp $8,%edx
+	jb 1f
+	mov %r8,(%rdi)
+	mov %r8,-8(%rdi,%rdx)
+	ret
+1:	cmp $4,%edx
+	jb 1f
+	mov %r8d,(%rdi)
+	mov %r8d,-4(%rdi,%rdx)
+	ret
+1:	test %edx,%edx
 	jz 1f
-
-	mov %sil,(%rdi)
-	mov %sil,-1(%rdi,%rdx)
+	mov %r8b,(%rdi)
+	mov %r8b,-1(%rdi,%rdx)
 	cmp $2,%edx
 	jbe 1f
+	mov %r8b,1(%rdi)
+1:	ret
 
-	mov %ax,1(%rdi)
-	mov %ax,(-1-2)(%rdi,%rdx)
-	cmp $6,%edx
-	jbe 1f
-
-	mov %eax,(1+2)(%rdi)
-	mov %eax,(-1-2-4)(%rdi,%rdx)
-	cmp $14,%edx
-	jbe 1f
-
-	mov %rax,(1+2+4)(%rdi)
-	mov %rax,(-1-2-4-8)(%rdi,%rdx)
-	cmp $30,%edx
-	jbe 1f
-
-	mov %rax,(1+2+4+8)(%rdi)
-	mov %rax,(1+2+4+8+8)(%rdi)
-	mov %rax,(-1-2-4-8-16)(%rdi,%rdx)
-	mov %rax,(-1-2-4-8-8)(%rdi,%rdx)
-	cmp $62,%edx
-	jbe 1f
-
-	mov %rax,(1+2+4+8+16)(%rdi)
-	mov %rax,(1+2+4+8+16+8)(%rdi)
-	mov %rax,(1+2+4+8+16+16)(%rdi)
-	mov %rax,(1+2+4+8+16+24)(%rdi)
-	mov %rax,(-1-2-4-8-16-32)(%rdi,%rdx)
-	mov %rax,(-1-2-4-8-16-24)(%rdi,%rdx)
-	mov %rax,(-1-2-4-8-16-16)(%rdi,%rdx)
-	mov %rax,(-1-2-4-8-16-8)(%rdi,%rdx)
-
-1:	mov %rdi,%rax
+.Lgt16:
+	movq %r8,%xmm0
+	punpcklqdq %xmm0,%xmm0
+	cmp $32,%rdx
+	ja 1f
+	movdqu %xmm0,(%rdi)
+	movdqu %xmm0,-16(%rdi,%rdx)
+	ret
+1:	cmp $64,%rdx
+	ja .Lgt64
+	movdqu %xmm0,(%rdi)
+	movdqu %xmm0,16(%rdi)
+	movdqu %xmm0,-32(%rdi,%rdx)
+	movdqu %xmm0,-16(%rdi,%rdx)
 	ret
 
-2:	test $15,%edi
-	mov %rdi,%r8
-	mov %rax,-8(%rdi,%rdx)
+.Lgt64:
+	cmp $2048,%rdx
+	jb 1f
+	testl $2,__x86_string_features(%rip)
+	jz 1f
+	mov %rdi,%r9
 	mov %rdx,%rcx
-	jnz 2f
-
-1:	shr $3,%rcx
+	movzbl %sil,%eax
 	rep
-	stosq
-	mov %r8,%rax
+	stosb
+	mov %r9,%rax
 	ret
+1:	lea (%rdi,%rdx),%r9
+	testl $1,__x86_string_features(%rip)
+	jnz .Lavx2
 
-2:	xor %edx,%edx
-	sub %edi,%edx
-	and $15,%edx
-	mov %rax,(%rdi)
-	mov %rax,8(%rdi)
-	sub %rdx,%rcx
-	add %rdx,%rdi
+	movdqu %xmm0,(%rdi)
+	movdqu %xmm0,-64(%r9)
+	movdqu %xmm0,-48(%r9)
+	movdqu %xmm0,-32(%r9)
+	movdqu %xmm0,-16(%r9)
+	lea 16(%rdi),%rcx
+	and $-16,%rcx
+	lea -64(%r9),%rdx
+1:	cmp %rdx,%rcx
+	jae 2f
+	movdqa %xmm0,(%rcx)
+	movdqa %xmm0,16(%rcx)
+	movdqa %xmm0,32(%rcx)
+	movdqa %xmm0,48(%rcx)
+	add $64,%rcx
 	jmp 1b
+2:	ret
+
+.Lavx2:
+	vpbroadcastq %xmm0,%ymm0
+	cmp $128,%rdx
+	ja 1f
+	vmovdqu %ymm0,(%rdi)
+	vmovdqu %ymm0,32(%rdi)
+	vmovdqu %ymm0,-64(%r9)
+	vmovdqu %ymm0,-32(%r9)
+	vzeroupper
+	ret
+1:	vmovdqu %ymm0,(%rdi)
+	vmovdqu %ymm0,-128(%r9)
+	vmovdqu %ymm0,-96(%r9)
+	vmovdqu %ymm0,-64(%r9)
+	vmovdqu %ymm0,-32(%r9)
+	lea 32(%rdi),%rcx
+	and $-32,%rcx
+	lea -128(%r9),%rdx
+1:	cmp %rdx,%rcx
+	jae 2f
+	vmovdqa %ymm0,(%rcx)
+	vmovdqa %ymm0,32(%rcx)
+	vmovdqa %ymm0,64(%rcx)
+	vmovdqa %ymm0,96(%rcx)
+	sub $-128,%rcx
+	jmp 1b
+2:	vzeroupper
+	ret
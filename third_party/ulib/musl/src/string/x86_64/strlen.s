@@ -0,0 +1,60 @@
+# strlen for x86-64.  Scans aligned 16 byte blocks (32 with AVX2) for a zero
+# byte.  Aligned loads never cross into the next page, so reading past the
+# terminator is safe.  Bits for bytes before the start of the string are
+# shifted out of the first block's mask.
+
+.hidden __x86_string_features
+
+.global strlen
+.type strlen,@function
+strlen:
+	testl $1,__x86_string_features(%rip)
+	jnz .Lavx2
+	pxor %xmm0,%xmm0
+	mov %edi,%ecx
+	and $15,%ecx
+	mov %rdi,%rdx
+	and $-16,%rdx
+	movdqa (%rdx),%xmm1
+	pcmpeqb %xmm0,%xmm1
+	pmovmskb %xmm1,%eax
+	shr %cl,%eax
+	test %eax,%eax
+	jz 1f
+	bsf %eax,%eax
+	ret
+1:	add $16,%rdx
+	movdqa (%rdx),%xmm1
+	pcmpeqb %xmm0,%xmm1
+	pmovmskb %xmm1,%eax
+	test %eax,%eax
+	jz 1b
+	bsf %eax,%eax
+	sub %rdi,%rdx
+	add %rdx,%rax
+	ret
+
+.Lavx2:
+	vpxor %ymm0,%ymm0,%ymm0
+	mov %edi,%ecx
+	and $31,%ecx
+	mov %rdi,%rdx
+	and $-32,%rdx
+	vpcmpeqb (%rdx),%ymm0,%ymm1
+	vpmovmskb %ymm1,%eax
+	shr %cl,%eax
+	test %eax,%eax
+	jz 1f
+	bsf %eax,%eax
+	vzeroupper
+	ret
+1:	add $32,%rdx
+	vpcmpeqb (%rdx),%ymm0,%ymm1
+	vpmovmskb %ymm1,%eax
+	test %eax,%eax
+	jz 1b
+	bsf %eax,%eax
+	sub %rdi,%rdx
+	add %rdx,%rax
+	vzeroupper
+	ret